@@ -12,14 +12,17 @@
 #include <string>
 #include <cctype>
 
-CityMap::CityMap() {
+CityMap::CityMap(bool withGraphics) : graphics(withGraphics) {
     initMaps();
-    loadTextures();
+    roads.build(&tileMap[0][0], COLS, ROWS);
+    if (graphics) loadTextures();
     buildFacilities();
-    cube = LoadModelFromMesh(GenMeshCube(1, 1, 1));
+    if (graphics) cube = LoadModelFromMesh(GenMeshCube(1, 1, 1));
 }
 
-CityMap::~CityMap() { UnloadModel(cube); }
+CityMap::~CityMap() {
+    if (graphics) UnloadModel(cube);
+}
 
 void CityMap::initMaps() {
     int tm[10][10] = {
@@ -130,8 +133,8 @@ void CityMap::DrawTile(Texture2D texture, Vector3 pos, float rotationY) {
 // ... CityMap constructor and loadTextures (Keep your existing ones) ...
 
 void CityMap::draw() {
-    for (int y = 0; y < H; y++) {
-        for (int x = 0; x < W; x++) {
+    for (int y = 0; y < ROWS; y++) {
+        for (int x = 0; x < COLS; x++) {
             float offset = TILE / 2.0f; // This is 2.0f
             Vector3 pos = { (float)x * TILE + offset, 0, (float)y * TILE + offset };
             DrawTile(texG, pos, 0); 
@@ -257,8 +260,8 @@ void CityMap::draw() {
 }
 void CityMap::buildFacilities() {
     buildings.clear();
-    for (int y = 0; y < H; y++) {
-        for (int x = 0; x < W; x++) {
+    for (int y = 0; y < ROWS; y++) {
+        for (int x = 0; x < COLS; x++) {
             FacilityType f = facilityMap[y][x];
             // Only place buildings on Grass tiles that have a facility assigned
             if (f == NO || tileMap[y][x] != GRASS) continue;
@@ -331,7 +334,7 @@ Vector3 CityMap::tileCenter(int y, int x) const {
 }
 
 bool CityMap::isDriveableTile(int y, int x) const {
-    if (y < 0 || y >= H || x < 0 || x >= W) return false;
+    if (y < 0 || y >= ROWS || x < 0 || x >= COLS) return false;
     int t = tileMap[y][x];
     // Driveable surfaces are all non-grass road-like tiles. Playground should not be driveable.
     return (t != GRASS && t != PLAYGROUND3);
@@ -346,8 +349,8 @@ bool CityMap::isDriveableWorld(Vector3 world) const {
 Vector3 CityMap::clampToDriveable(Vector3 world) const {
     int y, x;
     if (!worldToTile(world, y, x)) {
-        int cx = (int)Clamp(world.x / TILE, 0.0f, (float)(W - 1));
-        int cy = (int)Clamp(world.z / TILE, 0.0f, (float)(H - 1));
+        int cx = (int)Clamp(world.x / TILE, 0.0f, (float)(COLS - 1));
+        int cy = (int)Clamp(world.z / TILE, 0.0f, (float)(ROWS - 1));
         return tileCenter(cy, cx);
     }
     if (isDriveableTile(y, x)) return world;
@@ -367,79 +370,38 @@ Vector3 CityMap::clampToDriveable(Vector3 world) const {
 }
 
 
-bool CityMap::isDrivableTile(int t, bool emergency) const {
-    switch ((TileType)t) {
-        case ROAD_H: case ROAD_V: case PROAD_V: 
-        case PROAD_V1: case INTERSECTION: case ROUNDABOUT:
-        case CURVERTOP: case CURVERTOP1: 
-        case CURVERBOTTOM: case CURVERBOTTOM1:
-        case TROAD: case TROAD1: case ROTROAD: 
-            return true; // Only roads are now drivable
-        default: 
-            return false;
-    }
-}
 bool CityMap::worldToTile(Vector3 world, int& outY, int& outX) const {
     // world.x corresponds to Columns (W)
     // world.z corresponds to Rows (H)
     outX = (int)floorf(world.x / TILE);
     outY = (int)floorf(world.z / TILE); 
     
-    if (outX < 0) outX = 0; if (outX >= W) outX = W - 1;
-    if (outY < 0) outY = 0; if (outY >= H) outY = H - 1;
+    if (outX < 0) outX = 0; if (outX >= COLS) outX = COLS - 1;
+    if (outY < 0) outY = 0; if (outY >= ROWS) outY = ROWS - 1;
     return true;
 }
-float CityMap::tileSpeedLimit(int t, bool emergency) const {
-    return 5.0f;
+void CityMap::setTile(int y, int x, int t) {
+    if (y < 0 || y >= ROWS || x < 0 || x >= COLS) return;
+    tileMap[y][x] = t;
+    roads.setTile(y, x, t);
+}
+
+void CityMap::setRoadClosed(int y, int x, bool closed) {
+    roads.setClosed(y, x, closed);
 }
 
-std::vector<Vector3> CityMap::findFastestPath(Vector3 startWorld, Vector3 goalWorld, bool emergency) const {
+std::vector<Vector3> CityMap::findFastestPath(Vector3 startWorld, Vector3 goalWorld, bool emergency, int startHeading,
+                                              const float* edgeDelay) const {
     int sy, sx, gy, gx;
     worldToTile(startWorld, sy, sx);
     worldToTile(goalWorld, gy, gx);
 
-    const int N = W*H;
-    auto idx = [&](int y,int x){ return y*W+x; };
-    const float INF = std::numeric_limits<float>::infinity();
-    std::vector<float> dist(N, INF);
-    std::vector<int> prev(N, -1);
-    struct Node { float d; int id; };
-    struct Cmp { bool operator()(const Node& a, const Node& b) const { return a.d > b.d; } };
-    std::priority_queue<Node, std::vector<Node>, Cmp> pq;
-
-    int s = idx(sy,sx), g = idx(gy,gx);
-    dist[s] = 0.0f;
-    pq.push({0.0f, s});
-    int dirs[4][2] = {{1,0},{-1,0},{0,1},{0,-1}};
-
-    while(!pq.empty()){
-        Node cur = pq.top(); pq.pop();
-        if (cur.d > dist[cur.id]) continue;
-        if (cur.id == g) break;
-
-        int y = cur.id / W, x = cur.id % W;
-        for(auto& d:dirs){
-            int ny=y+d[0], nx=x+d[1];
-            if(ny<0||ny>=H||nx<0||nx>=W) continue;
-            if (!isDrivableTile(tileMap[ny][nx], emergency)) continue;
-
-            float cost = 1.0f;
-            int nid = idx(ny,nx);
-            if (cur.d + cost < dist[nid]) {
-                dist[nid] = cur.d + cost;
-                prev[nid] = cur.id;
-                pq.push({dist[nid], nid});
-            }
-        }
-    }
-
-    if (dist[g] == INF) return {};
+    int start = roads.id(sy, sx), goal = roads.id(gy, gx);
+    std::vector<int> tiles = roads.findPath(start, goal, emergency, startHeading, edgeDelay);
+    // Nothing reachable straight ahead: fall back to turning around where the rules allow it
+    if (tiles.empty() && startHeading >= 0) tiles = roads.findPath(start, goal, emergency, -1, edgeDelay);
     std::vector<Vector3> wp;
-    for(int cur=g; cur!=-1; cur=prev[cur]) {
-        int y = cur / W, x = cur % W;
-        wp.push_back(tileCenter(y,x));
-    }
-    std::reverse(wp.begin(), wp.end());
-    if (!wp.empty()) wp.back() = tileCenter(gy,gx);
+    wp.reserve(tiles.size());
+    for (int t : tiles) wp.push_back(tileCenter(t / COLS, t % COLS));
     return wp;
 }
\ No newline at end of file
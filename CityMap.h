@@ -2,6 +2,7 @@
 #define CITYMAP_H
 
 #include "GameCommon.h"
+#include "RoadGraph.h"
 #include <vector>
 
 struct Building {
@@ -13,12 +14,14 @@ struct Building {
 
 class CityMap {
 public:
-    static const int W = 10;
-    static const int H = 10;
-    int tileMap[H][W];
-    FacilityType facilityMap[H][W];
+    // Not W/H: GameCommon.h uses H as the ROAD_H map macro
+    static const int COLS = 10;
+    static const int ROWS = 10;
+    int tileMap[ROWS][COLS];
+    FacilityType facilityMap[ROWS][COLS];
 
-    CityMap();
+    // Without graphics no textures or models are loaded, so no window is needed (nor draw())
+    explicit CityMap(bool withGraphics = true);
     ~CityMap();
 
     void draw(); 
@@ -27,13 +30,21 @@ public:
     bool isDriveableTile(int y, int x) const;
     bool isDriveableWorld(Vector3 world) const;
     Vector3 clampToDriveable(Vector3 world) const;
-    std::vector<Vector3> findFastestPath(Vector3 startWorld, Vector3 goalWorld, bool emergency) const;
+    // startHeading (RoadDir) keeps the route from starting with an illegal u-turn, -1 = any direction.
+    // edgeDelay is an optional congestion profile (see EdgeTravelTimes).
+    std::vector<Vector3> findFastestPath(Vector3 startWorld, Vector3 goalWorld, bool emergency, int startHeading = -1,
+                                         const float* edgeDelay = nullptr) const;
+
+    // Map edits go through here so the road graph (and everything caching routes on it) stays in sync
+    void setTile(int y, int x, int t);
+    void setRoadClosed(int y, int x, bool closed);
+    const RoadGraph& roadGraph() const { return roads; }
 
 private:
-    Model cube;
+    bool graphics;
+    Model cube{};
     std::vector<Building> buildings;
-    bool isDrivableTile(int t, bool emergency) const;
-    float tileSpeedLimit(int t, bool emergency) const;
+    RoadGraph roads;
     
     void initMaps();
     void loadTextures();
@@ -0,0 +1,136 @@
+#include "CoverageField.h"
+#include <queue>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+static const float INF_TIME = std::numeric_limits<float>::infinity();
+
+float CoverageField::tileTime(int tile) const {
+    float best = INF_TIME;
+    for (int hd = 0; hd < 4; hd++) best = std::min(best, time[RoadGraph::stateOf(tile, hd)]);
+    return best;
+}
+
+void CoverageField::relax(const RoadGraph& g, std::vector<int>& frontier) {
+    struct Node { float d; int id; };
+    struct Cmp { bool operator()(const Node& a, const Node& b) const { return a.d > b.d; } };
+    std::priority_queue<Node, std::vector<Node>, Cmp> pq;
+    for (int st : frontier) pq.push({time[st], st});
+
+    while (!pq.empty()) {
+        Node cur = pq.top(); pq.pop();
+        if (cur.d > time[cur.id]) continue;
+        g.forEachSuccessor(cur.id, true, [&](int next, float cost) {
+            float nd = cur.d + cost;
+            if (nd < time[next]) {
+                time[next] = nd;
+                parent[next] = cur.id;
+                pq.push({nd, next});
+            }
+        });
+    }
+}
+
+void CoverageField::solve(const RoadGraph& g) {
+    time.assign(g.stateCount(), INF_TIME);
+    parent.assign(g.stateCount(), -1);
+    std::vector<int> frontier;
+    for (int s : sources) {
+        if (!g.isPassable(s, true)) continue;
+        for (int hd = 0; hd < 4; hd++) {
+            time[RoadGraph::stateOf(s, hd)] = 0.0f;
+            frontier.push_back(RoadGraph::stateOf(s, hd));
+        }
+    }
+    relax(g, frontier);
+}
+
+void CoverageField::repairTile(const RoadGraph& g, int tile) {
+    // The edited tile's states, plus its neighbours' (they can gain or lose a dead-end u-turn)
+    std::vector<int> roots;
+    for (int d = -1; d < 4; d++) {
+        int t = (d < 0) ? tile : g.neighbour(tile, d);
+        if (t < 0 || std::binary_search(sources.begin(), sources.end(), t)) continue;
+        for (int hd = 0; hd < 4; hd++) roots.push_back(RoadGraph::stateOf(t, hd));
+    }
+
+    // Everything routed through those states loses its time. A child of state u can only
+    // be (neighbour in direction e, heading e), whatever the graph looks like now.
+    std::vector<int> invalid;
+    std::vector<int> stack = roots;
+    while (!stack.empty()) {
+        int u = stack.back(); stack.pop_back();
+        invalid.push_back(u);
+        time[u] = INF_TIME;
+        parent[u] = -1;
+        for (int e = 0; e < 4; e++) {
+            int n = g.neighbour(RoadGraph::stateTile(u), e);
+            if (n < 0) continue;
+            int child = RoadGraph::stateOf(n, e);
+            if (parent[child] == u) stack.push_back(child);
+        }
+    }
+
+    // Re-seed the hole from its still-valid border, then let Dijkstra fill it (and any shortcut it opened)
+    std::vector<int> frontier;
+    for (int u : invalid) {
+        g.forEachPredecessor(u, true, [&](int prev, float cost) {
+            if (time[prev] + cost < time[u]) {
+                time[u] = time[prev] + cost;
+                parent[u] = prev;
+            }
+        });
+        if (time[u] < INF_TIME) frontier.push_back(u);
+    }
+    relax(g, frontier);
+}
+
+CoverageField::Stats CoverageField::stats(const RoadGraph& g, float targetSeconds) const {
+    int roadTiles = 0, reached = 0, covered = 0;
+    double sum = 0.0;
+    float worst = 0.0f;
+    for (int tile = 0; tile < g.size(); tile++) {
+        if (g.isPassable(tile, true)) roadTiles++;
+        float t = tileTime(tile);
+        if (t == INF_TIME) continue;
+        reached++;
+        sum += t;
+        worst = std::max(worst, t);
+        if (t <= targetSeconds) covered++;
+    }
+    Stats s;
+    s.meanTime = reached ? (float)(sum / reached) : INF_TIME;
+    s.worstTime = worst;
+    s.coveredShare = roadTiles ? (float)covered / roadTiles : 0.0f;
+    return s;
+}
+
+std::vector<CoverageField::Stats> CoverageField::sweep(const RoadGraph& base, const CoverageField* fields, int count,
+                                                       const std::vector<std::vector<int>>& closedTiles,
+                                                       float targetSeconds, int threads) {
+    std::vector<Stats> results(closedTiles.size() * count);
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, (int)std::max<size_t>(1, closedTiles.size()));
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        std::vector<CoverageField> local(count);
+        for (int i = 0; i < count; i++) local[i].sources = fields[i].sources;
+
+        for (size_t s = next++; s < closedTiles.size(); s = next++) {
+            RoadGraph g = base;
+            for (int t : closedTiles[s]) g.setClosed(t / g.width(), t % g.width(), true);
+            for (int i = 0; i < count; i++) {
+                local[i].solve(g);
+                results[s * count + i] = local[i].stats(g, targetSeconds);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) workers.emplace_back(worker);
+    for (std::thread& w : workers) w.join();
+    return results;
+}
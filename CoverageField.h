@@ -0,0 +1,40 @@
+#ifndef COVERAGEFIELD_H
+#define COVERAGEFIELD_H
+
+#include "RoadGraph.h"
+#include <vector>
+
+// Travel time over the lane graph from a set of source tiles to every lane state, with the
+// shortest-path tree that produced it so a tile edit only re-solves what was routed through it.
+// Needs nothing but the road graph, so it runs headless as well as under CoverageMap.
+struct CoverageField {
+    std::vector<int> sources; // access tiles, sorted
+    std::vector<float> time;  // per lane state
+    std::vector<int> parent;  // per lane state, -1 for sources and unreached states
+
+    struct Stats {
+        float meanTime;     // over reachable road tiles
+        float worstTime;
+        float coveredShare; // share of road tiles reached within the target time
+    };
+
+    // From scratch
+    void solve(const RoadGraph& g);
+    // After `tile` was edited in g
+    void repairTile(const RoadGraph& g, int tile);
+
+    float tileTime(int tile) const;
+    Stats stats(const RoadGraph& g, float targetSeconds) const;
+
+    // Re-solves every field with each closure set applied to a copy of `base`.
+    // Returns Stats per scenario and field: results[scenario * count + field].
+    // threads = 0 uses every core.
+    static std::vector<Stats> sweep(const RoadGraph& base, const CoverageField* fields, int count,
+                                    const std::vector<std::vector<int>>& closedTiles,
+                                    float targetSeconds, int threads = 0);
+
+private:
+    void relax(const RoadGraph& g, std::vector<int>& frontier);
+};
+
+#endif
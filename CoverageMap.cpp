@@ -0,0 +1,128 @@
+#include "CoverageMap.h"
+#include "CityMap.h"
+#include <limits>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+
+static const float INF_TIME = std::numeric_limits<float>::infinity();
+
+CoverageMap::CoverageMap(const CityMap& cityMap) : map(cityMap) {
+    recompute();
+}
+
+void CoverageMap::findSources() {
+    const RoadGraph& g = map.roadGraph();
+    for (CoverageField& f : field) f.sources.clear();
+
+    for (int t = 0; t < g.size(); t++) {
+        FacilityGroup group;
+        if (!facilityGroupOf(map.facilityMap[t / g.width()][t % g.width()], group)) continue;
+        std::vector<int>& sources = field[(int)group].sources;
+        for (int d = 0; d < 4; d++) {
+            int n = g.neighbour(t, d);
+            if (n < 0 || !g.isPassable(n, true)) continue;
+            if (std::find(sources.begin(), sources.end(), n) == sources.end()) sources.push_back(n);
+        }
+    }
+    for (CoverageField& f : field) std::sort(f.sources.begin(), f.sources.end());
+}
+
+void CoverageMap::recompute() {
+    const RoadGraph& g = map.roadGraph();
+    findSources();
+    std::vector<std::thread> workers;
+    for (CoverageField& f : field) workers.emplace_back([&g, &f]() { f.solve(g); });
+    for (std::thread& w : workers) w.join();
+    seenRevision = g.revision();
+}
+
+void CoverageMap::sync() {
+    const RoadGraph& g = map.roadGraph();
+    if (g.revision() == seenRevision) return;
+
+    std::vector<int> oldSources[GROUPS];
+    for (int i = 0; i < GROUPS; i++) oldSources[i] = field[i].sources;
+    findSources();
+
+    const std::vector<int>& log = g.changeLog();
+    for (int i = 0; i < GROUPS; i++) {
+        if (field[i].sources != oldSources[i]) { field[i].solve(g); continue; }
+        for (uint32_t e = seenRevision; e < log.size(); e++) field[i].repairTile(g, log[e]);
+    }
+    seenRevision = g.revision();
+}
+
+float CoverageMap::worstTime(FacilityGroup g) const {
+    float worst = 0.0f;
+    for (float t : field[(int)g].time) if (t < INF_TIME) worst = std::max(worst, t);
+    return worst;
+}
+
+std::vector<CoverageMap::ScenarioResult> CoverageMap::sweep(const std::vector<std::vector<int>>& closedTiles,
+                                                            float targetSeconds, int threads) const {
+    std::vector<CoverageField::Stats> stats =
+        CoverageField::sweep(map.roadGraph(), field, GROUPS, closedTiles, targetSeconds, threads);
+    std::vector<ScenarioResult> results(closedTiles.size());
+    for (size_t s = 0; s < results.size(); s++) {
+        for (int i = 0; i < GROUPS; i++) {
+            const CoverageField::Stats& st = stats[s * GROUPS + i];
+            results[s].meanTime[i] = st.meanTime;
+            results[s].worstTime[i] = st.worstTime;
+            results[s].coveredShare[i] = st.coveredShare;
+        }
+    }
+    return results;
+}
+
+bool CoverageMap::exportPGM(const char* path, FacilityGroup g, float maxSeconds) const {
+    const RoadGraph& graph = map.roadGraph();
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+
+    fprintf(f, "P5\n%d %d\n255\n", graph.width(), graph.height());
+    std::vector<unsigned char> row(graph.size());
+    for (int t = 0; t < graph.size(); t++) {
+        float v = timeAt(g, t);
+        row[t] = (v == INF_TIME) ? 0 : (unsigned char)(255.0f * (1.0f - Clamp(v / maxSeconds, 0.0f, 1.0f)));
+    }
+    bool ok = fwrite(row.data(), 1, row.size(), f) == row.size();
+    fclose(f);
+    return ok;
+}
+
+bool CoverageMap::exportCSV(const char* path) const {
+    const RoadGraph& g = map.roadGraph();
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+
+    fprintf(f, "y,x,hospital,fire,police\n");
+    for (int t = 0; t < g.size(); t++) {
+        if (!g.isRoadType(g.tileType(t), true)) continue;
+        fprintf(f, "%d,%d", t / g.width(), t % g.width());
+        for (int i = 0; i < GROUPS; i++) {
+            float v = field[i].tileTime(t);
+            fprintf(f, ",%.3f", v == INF_TIME ? -1.0f : v);
+        }
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return true;
+}
+
+void CoverageMap::draw(FacilityGroup g, float maxSeconds) const {
+    const RoadGraph& graph = map.roadGraph();
+    for (int t = 0; t < graph.size(); t++) {
+        if (!graph.isRoadType(graph.tileType(t), true)) continue;
+
+        Vector3 pos = map.tileCenter(t / graph.width(), t % graph.width());
+        pos.y = 0.12f;
+        float v = timeAt(g, t);
+        Color c = DARKGRAY;
+        if (v < INF_TIME) {
+            float k = Clamp(v / maxSeconds, 0.0f, 1.0f);
+            c = (k < 0.5f) ? ColorLerp(GREEN, YELLOW, k * 2.0f) : ColorLerp(YELLOW, RED, (k - 0.5f) * 2.0f);
+        }
+        DrawCube(pos, TILE * 0.9f, 0.02f, TILE * 0.9f, Fade(c, 0.55f));
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef COVERAGEMAP_H
+#define COVERAGEMAP_H
+
+#include "GameCommon.h"
+#include "RoadGraph.h"
+#include "FacilityRoutes.h"
+#include "CoverageField.h"
+#include <vector>
+#include <cstdint>
+
+class CityMap;
+
+// Emergency response isochrones: for every road tile, the travel time from the nearest
+// hospital / fire / police site over the lane graph. Road edits are applied incrementally,
+// full recomputes and scenario sweeps run on worker threads.
+class CoverageMap {
+public:
+    static const int GROUPS = (int)FacilityGroup::Count;
+
+    struct ScenarioResult {
+        float meanTime[GROUPS];     // over reachable road tiles
+        float worstTime[GROUPS];
+        float coveredShare[GROUPS]; // share of road tiles reached within the target time
+    };
+
+    explicit CoverageMap(const CityMap& map);
+
+    // Rebuild every group from scratch (one thread per group)
+    void recompute();
+    // Apply road graph edits since the last call, touching only the affected tiles
+    void sync();
+
+    float timeAt(FacilityGroup g, int tile) const { return field[(int)g].tileTime(tile); }
+    float worstTime(FacilityGroup g) const;
+
+    // Evaluate many closure sets against the current map. threads = 0 uses every core.
+    std::vector<ScenarioResult> sweep(const std::vector<std::vector<int>>& closedTiles,
+                                      float targetSeconds, int threads = 0) const;
+
+    // 8-bit greyscale raster, one pixel per tile: white = instant, black = maxSeconds or unreachable
+    bool exportPGM(const char* path, FacilityGroup g, float maxSeconds) const;
+    // y,x,hospital,fire,police seconds (-1 when unreachable)
+    bool exportCSV(const char* path) const;
+
+    // Translucent green-to-red tile overlay
+    void draw(FacilityGroup g, float maxSeconds) const;
+
+private:
+    const CityMap& map;
+    CoverageField field[GROUPS];
+    uint32_t seenRevision{0};
+
+    void findSources();
+};
+
+#endif
@@ -0,0 +1,227 @@
+#include "Dispatch.h"
+#include <cstdio>
+#include <limits>
+#include <functional>
+#include <string>
+
+static const float UNREACHED = std::numeric_limits<float>::infinity();
+static const char* KIND_NAMES[Dispatch::KINDS] = { "ambulance", "fire", "police" };
+static const int METRICS = 7;
+static const char* METRIC_NAMES[METRICS] = { "wait", "travel", "response", "hospital", "mission", "eta_late", "eta_early" };
+static LatencyHistogram Dispatch::Stats::* const METRIC[METRICS] = {
+    &Dispatch::Stats::wait, &Dispatch::Stats::travel, &Dispatch::Stats::response, &Dispatch::Stats::hospital,
+    &Dispatch::Stats::mission, &Dispatch::Stats::late, &Dispatch::Stats::early,
+};
+
+void Dispatch::setGraph(const Graph& g) {
+    graph = g;
+    for (int k = 0; k < KINDS; k++) field[k].dirty = true;
+}
+
+int Dispatch::addUnit(int kind, int state) {
+    units.push_back({ kind, state, -1 });
+    availableCount[kind]++;
+    field[kind].dirty = true;
+    return (int)units.size() - 1;
+}
+
+int Dispatch::report(int kind, int tile, int priority, float now) {
+    int id = (int)log.size();
+    log.push_back({ kind, tile, priority, -1, now, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f });
+    queue[kind].push({ priority, now, id });
+    return id;
+}
+
+void Dispatch::search(int kind) {
+    Field& f = field[kind];
+    int states = (int)graph.first.size() - 1;
+    f.time.assign(states > 0 ? states : 0, UNREACHED);
+    f.unit.assign(f.time.size(), -1);
+    f.dirty = false;
+    searchCount++;
+
+    typedef std::pair<float, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    for (int u = 0; u < (int)units.size(); u++) {
+        const Unit& unit = units[u];
+        if (unit.kind != kind || unit.incident >= 0 || unit.state < 0 || unit.state >= states) continue;
+        if (f.time[unit.state] == 0.0f) continue; // two units on one lane: the first one is as near
+        f.time[unit.state] = 0.0f;
+        f.unit[unit.state] = u;
+        open.push({ 0.0f, unit.state });
+    }
+    while (!open.empty()) {
+        Entry e = open.top();
+        open.pop();
+        int s = e.second;
+        if (e.first > f.time[s]) continue;
+        for (int k = graph.first[s]; k < graph.first[s + 1]; k++) {
+            int n = graph.to[k];
+            float t = e.first + graph.cost[k];
+            if (t >= f.time[n]) continue;
+            f.time[n] = t;
+            f.unit[n] = f.unit[s];
+            open.push({ t, n });
+        }
+    }
+}
+
+int Dispatch::nearest(int kind, int tile, float* eta) {
+    if (availableCount[kind] == 0) return -1;
+    Field& f = field[kind];
+    if (f.dirty) search(kind);
+    int best = -1;
+    float bestTime = UNREACHED;
+    for (int h = 0; h < 4; h++) {
+        int s = tile * 4 + h;
+        if (s < 0 || s >= (int)f.time.size() || f.time[s] >= bestTime) continue;
+        bestTime = f.time[s];
+        best = f.unit[s];
+    }
+    if (eta) *eta = bestTime;
+    return best;
+}
+
+void Dispatch::assign(float now, std::vector<Assignment>& out) {
+    for (int k = 0; k < KINDS; k++) {
+        std::vector<Waiting> unreachable;
+        while (!queue[k].empty() && availableCount[k] > 0) {
+            Waiting w = queue[k].top();
+            queue[k].pop();
+            Incident& inc = log[w.id];
+            float eta;
+            int u = nearest(k, inc.tile, &eta);
+            if (u < 0) {
+                unreachable.push_back(w); // no free unit gets there now; keep its place in the queue
+                continue;
+            }
+            units[u].incident = w.id;
+            availableCount[k]--;
+            field[k].dirty = true;
+            inc.unit = u;
+            inc.assigned = now;
+            inc.predicted = eta;
+            timing[k].wait.record(now - inc.reported);
+            out.push_back({ u, w.id, eta });
+        }
+        for (const Waiting& w : unreachable) queue[k].push(w);
+    }
+}
+
+void Dispatch::moved(int unit, int state) {
+    Unit& u = units[unit];
+    if (u.state == state) return;
+    u.state = state;
+    if (u.incident < 0) field[u.kind].dirty = true;
+}
+
+void Dispatch::timeArrival(const Incident& inc) {
+    Stats& st = timing[inc.kind];
+    float travel = inc.arrived - inc.assigned;
+    st.travel.record(travel);
+    st.response.record(inc.arrived - inc.reported);
+    if (travel >= inc.predicted) st.late.record(travel - inc.predicted);
+    else st.early.record(inc.predicted - travel);
+}
+
+void Dispatch::arrived(int unit, float now) {
+    int id = units[unit].incident;
+    if (id < 0 || log[id].arrived >= 0.0f) return;
+    log[id].arrived = now;
+    timeArrival(log[id]);
+}
+
+void Dispatch::delivered(int unit, float now) {
+    int id = units[unit].incident;
+    if (id < 0 || log[id].arrived < 0.0f || log[id].delivered >= 0.0f) return;
+    log[id].delivered = now;
+    timing[log[id].kind].hospital.record(now - log[id].arrived);
+}
+
+void Dispatch::release(int unit, float now) {
+    Unit& u = units[unit];
+    if (u.incident < 0) return;
+    Incident& inc = log[u.incident];
+    if (inc.arrived < 0.0f) {
+        inc.arrived = now;
+        timeArrival(inc);
+    }
+    inc.cleared = now;
+    timing[u.kind].mission.record(now - inc.reported);
+    u.incident = -1;
+    availableCount[u.kind]++;
+    field[u.kind].dirty = true;
+}
+
+bool Dispatch::exportCSV(const char* path) const {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "id,kind,priority,tile,unit,reported,assigned,arrived,delivered,cleared,response,predicted,travel\n");
+    for (size_t i = 0; i < log.size(); i++) {
+        const Incident& inc = log[i];
+        float response = inc.arrived >= 0.0f ? inc.arrived - inc.reported : -1.0f;
+        float travel = inc.arrived >= 0.0f ? inc.arrived - inc.assigned : -1.0f;
+        fprintf(f, "%zu,%d,%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", i, inc.kind, inc.priority, inc.tile,
+                inc.unit, inc.reported, inc.assigned, inc.arrived, inc.delivered, inc.cleared, response, inc.predicted,
+                travel);
+    }
+    fclose(f);
+    return true;
+}
+
+bool Dispatch::exportHistograms(const char* path) const {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "kind,metric,count,mean,p50,p90,p99,p99.9,max\n");
+    for (int k = 0; k < KINDS; k++) {
+        for (int m = 0; m < METRICS; m++) {
+            const LatencyHistogram& h = timing[k].*METRIC[m];
+            fprintf(f, "%s,%s,%llu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", KIND_NAMES[k], METRIC_NAMES[m],
+                    (unsigned long long)h.count(), h.mean(), h.percentile(50.0f), h.percentile(90.0f),
+                    h.percentile(99.0f), h.percentile(99.9f), h.max());
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+void Dispatch::save(SnapshotWriter& w) const {
+    w.array("dispatch.units", units);
+    w.array("dispatch.incidents", log);
+    for (int k = 0; k < KINDS; k++) {
+        std::priority_queue<Waiting> q = queue[k];
+        std::vector<Waiting> waiting;
+        for (; !q.empty(); q.pop()) waiting.push_back(q.top());
+        w.array((std::string("dispatch.queue.") + KIND_NAMES[k]).c_str(), waiting);
+        w.array((std::string("dispatch.field.") + KIND_NAMES[k] + ".time").c_str(), field[k].time);
+        w.array((std::string("dispatch.field.") + KIND_NAMES[k] + ".unit").c_str(), field[k].unit);
+        w.value((std::string("dispatch.field.") + KIND_NAMES[k] + ".dirty").c_str(), (uint8_t)field[k].dirty);
+        for (int m = 0; m < METRICS; m++)
+            (timing[k].*METRIC[m]).save(w, std::string("dispatch.") + KIND_NAMES[k] + "." + METRIC_NAMES[m]);
+    }
+    w.array("dispatch.available", availableCount, KINDS);
+    w.value("dispatch.searches", searchCount);
+}
+
+bool Dispatch::load(const SnapshotReader& r) {
+    std::vector<int> available;
+    if (!r.array("dispatch.units", units) || !r.array("dispatch.incidents", log) ||
+        !r.array("dispatch.available", available) || available.size() != KINDS ||
+        !r.value("dispatch.searches", searchCount)) return false;
+    for (int k = 0; k < KINDS; k++) {
+        std::vector<Waiting> waiting;
+        if (!r.array((std::string("dispatch.queue.") + KIND_NAMES[k]).c_str(), waiting)) return false;
+        uint8_t dirty;
+        std::string f = std::string("dispatch.field.") + KIND_NAMES[k];
+        if (!r.array((f + ".time").c_str(), field[k].time) || !r.array((f + ".unit").c_str(), field[k].unit) ||
+            !r.value((f + ".dirty").c_str(), dirty)) return false;
+        field[k].dirty = dirty != 0 || field[k].time.size() != graph.first.size() - 1; // saved over another graph
+        queue[k] = std::priority_queue<Waiting>(waiting.begin(), waiting.end()); // a total order: pops as before
+        for (int m = 0; m < METRICS; m++) {
+            if (!(timing[k].*METRIC[m]).load(r, std::string("dispatch.") + KIND_NAMES[k] + "." + METRIC_NAMES[m]))
+                return false;
+        }
+        availableCount[k] = available[k];
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "LatencyHistogram.h"
+#include <vector>
+#include <queue>
+#include <cstdint>
+
+// Emergency dispatch: the ambulances, fire engines and police units of the city and the incidents
+// waiting for them. Incidents queue per kind, most urgent first and then oldest. Each goes to the
+// available unit of its kind that reaches it soonest: one search over the lane graph, started from
+// every available unit at once, labels every lane state with its nearest unit, so finding the unit
+// for an incident is a lookup. The labels are rebuilt only when a lookup follows a change in which
+// units are available or where they are. Units are available when idle and on the way back from
+// an incident; the simulation drives them and reports where they are and when they arrive.
+// Every step of an incident is timed, and the times go into histograms per kind as they happen.
+class Dispatch {
+public:
+    enum Kind { AMBULANCE = 0, FIRE, POLICE, KINDS }; // same order as FacilityGroup
+
+    // Lane state graph (RoadGraph encoding, tile * 4 + heading) in compressed rows: the moves out
+    // of state s go to to[first[s] .. first[s + 1]), each taking cost seconds
+    struct Graph {
+        std::vector<int> first;
+        std::vector<int> to;
+        std::vector<float> cost;
+    };
+
+    struct Incident {
+        int kind;
+        int tile;
+        int priority;    // 0 is the most urgent
+        int unit;        // -1 while queued
+        float reported;
+        float assigned;  // -1 until a unit is sent
+        float arrived;   // on scene, -1 until then
+        float delivered; // patient at the hospital, -1 until then and for other kinds
+        float cleared;   // -1 until then
+        float predicted; // seconds from assigned to arrived expected when the unit was sent
+    };
+    // Seconds per kind
+    struct Stats {
+        LatencyHistogram wait;     // reported to assigned
+        LatencyHistogram travel;   // assigned to arrived
+        LatencyHistogram response; // reported to arrived
+        LatencyHistogram hospital; // arrived to delivered
+        LatencyHistogram mission;  // reported to cleared
+        LatencyHistogram late;     // travel longer than predicted, by how much
+        LatencyHistogram early;    // travel shorter than predicted, by how much
+    };
+    struct Assignment {
+        int unit;
+        int incident;
+        float eta; // seconds, as searched
+    };
+
+    void setGraph(const Graph& g);
+    // A unit waiting at a lane state; units are numbered in the order they are added
+    int addUnit(int kind, int state);
+
+    int report(int kind, int tile, int priority, float now);
+    // Hands queued incidents to available units, most urgent first, and appends what was sent.
+    // Each is predicted to take the searched time until predict() says otherwise.
+    void assign(float now, std::vector<Assignment>& out);
+    void predict(int incident, float seconds) { log[incident].predicted = seconds; }
+
+    void moved(int unit, int state);
+    void arrived(int unit, float now);
+    void delivered(int unit, float now);
+    // The unit is done with its incident and available again from where it is
+    void release(int unit, float now);
+
+    // Available unit of a kind that reaches a tile soonest, -1 if none can
+    int nearest(int kind, int tile, float* eta = nullptr);
+
+    int unitCount() const { return (int)units.size(); }
+    int unitKind(int unit) const { return units[unit].kind; }
+    int incidentOf(int unit) const { return units[unit].incident; } // -1 when available
+    int queued(int kind) const { return (int)queue[kind].size(); }
+    int available(int kind) const { return availableCount[kind]; }
+    const std::vector<Incident>& incidents() const { return log; }
+    const Stats& stats(int kind) const { return timing[kind]; }
+    uint64_t searches() const { return searchCount; }
+
+    // One line per incident with its timestamps and response time (report to on scene)
+    bool exportCSV(const char* path) const;
+    // One line per kind and histogram: count, mean, p50, p90, p99, p99.9 and max
+    bool exportHistograms(const char* path) const;
+
+    // Units, incidents, queues, nearest-unit fields and histograms. The graph isn't saved: it is
+    // set again from the map the snapshot was taken on, before load() so the fields are kept.
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r);
+
+private:
+    struct Unit {
+        int kind;
+        int state;
+        int incident;
+    };
+    struct Waiting {
+        int priority;
+        float reported;
+        int id;
+        bool operator<(const Waiting& o) const { // std::priority_queue keeps the largest on top
+            if (priority != o.priority) return priority > o.priority;
+            if (reported != o.reported) return reported > o.reported;
+            return id > o.id;
+        }
+    };
+    // Nearest available unit per lane state
+    struct Field {
+        std::vector<float> time;
+        std::vector<int> unit;
+        bool dirty{true};
+    };
+
+    Graph graph;
+    std::vector<Unit> units;
+    std::vector<Incident> log;
+    std::priority_queue<Waiting> queue[KINDS];
+    Field field[KINDS];
+    Stats timing[KINDS];
+    int availableCount[KINDS]{};
+    uint64_t searchCount{0};
+
+    void search(int kind);
+    void timeArrival(const Incident& inc);
+};
+
+#endif
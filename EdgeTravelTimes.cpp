@@ -0,0 +1,64 @@
+#include "EdgeTravelTimes.h"
+#include <cmath>
+#include <algorithm>
+
+EdgeTravelTimes::EdgeTravelTimes(const RoadGraph& graph, float smoothing, float forgetSeconds)
+    : alpha(smoothing), horizon(forgetSeconds) {
+    time.assign(graph.stateCount(), 0.0f);
+    excess.assign(graph.stateCount(), 0.0f);
+    for (float& t : slicedAt) t = 0.0f;
+}
+
+void EdgeTravelTimes::record(int tile, int exitDir, float seconds, float freeSeconds) {
+    int e = RoadGraph::edgeOf(tile, exitDir);
+    if (e < 0 || e >= (int)time.size()) return;
+    float over = std::max(0.0f, seconds - freeSeconds);
+    time[e] = (time[e] == 0.0f) ? seconds : time[e] + alpha * (seconds - time[e]);
+    excess[e] += alpha * (over - excess[e]);
+}
+
+void EdgeTravelTimes::age(float now) {
+    int s = nextSlice;
+    nextSlice = (nextSlice + 1) % SLICES;
+    float k = std::exp(-(now - slicedAt[s]) / horizon);
+    slicedAt[s] = now;
+
+    size_t per = (excess.size() + SLICES - 1) / SLICES;
+    size_t begin = std::min(excess.size(), s * per);
+    size_t end = std::min(excess.size(), begin + per);
+    for (size_t e = begin; e < end; e++) excess[e] *= k;
+}
+
+bool EdgeTravelTimes::reroute(const RoadGraph& graph, const std::vector<int>& rest, int goal, int heading, bool emergency,
+                              float minGain, std::vector<int>& out) const {
+    if (rest.empty()) return false;
+    float current = graph.pathCost(rest, emergency, heading, delays());
+    float best;
+    out = graph.findPath(rest[0], goal, emergency, heading, delays(), &best);
+    return !out.empty() && best <= current - minGain;
+}
+
+void EdgeTravelTimes::clear() {
+    std::fill(time.begin(), time.end(), 0.0f);
+    std::fill(excess.begin(), excess.end(), 0.0f);
+}
+
+void EdgeTravelTimes::save(SnapshotWriter& w) const {
+    w.array("edges.time", time);
+    w.array("edges.excess", excess);
+    w.array("edges.slicedAt", slicedAt, SLICES);
+    w.value("edges.nextSlice", nextSlice);
+}
+
+bool EdgeTravelTimes::load(const SnapshotReader& r) {
+    std::vector<float> t, x, sliced;
+    int next;
+    if (!r.array("edges.time", t) || !r.array("edges.excess", x) || !r.array("edges.slicedAt", sliced) ||
+        !r.value("edges.nextSlice", next)) return false;
+    if (t.size() != time.size() || x.size() != excess.size() || sliced.size() != SLICES) return false;
+    time.swap(t);
+    excess.swap(x);
+    std::copy(sliced.begin(), sliced.end(), slicedAt);
+    nextSlice = next;
+    return true;
+}
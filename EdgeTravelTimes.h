@@ -0,0 +1,48 @@
+#ifndef EDGETRAVELTIMES_H
+#define EDGETRAVELTIMES_H
+
+#include "RoadGraph.h"
+#include "Snapshot.h"
+#include <vector>
+
+// Live travel times per directed road edge (RoadGraph::edgeOf), measured from vehicles as
+// they leave a tile and smoothed with an exponential moving average. The excess over each
+// vehicle's free-flow time is exposed as a per-edge delay array that RoadGraph::findPath
+// adds to its costs. Recording is O(1); ageing touches one slice of the table per call.
+class EdgeTravelTimes {
+public:
+    explicit EdgeTravelTimes(const RoadGraph& graph, float smoothing = 0.25f, float forgetSeconds = 30.0f);
+
+    // A vehicle spent `seconds` on `tile` before leaving towards exitDir; freeSeconds is
+    // what the same crossing takes it with the road to itself
+    void record(int tile, int exitDir, float seconds, float freeSeconds);
+    // Decays one slice of the table towards free flow, so edges nobody drives any more recover
+    void age(float now);
+    void clear();
+
+    // Sections edges.*; false if the file was saved over a different number of edges
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r);
+
+    float smoothedTime(int edge) const { return time[edge]; }
+    float delay(int edge) const { return excess[edge]; }
+    // Routing cost profile, indexed by RoadGraph::edgeOf
+    const float* delays() const { return excess.data(); }
+
+    // Re-plans the rest of a trip (`rest` starts on the vehicle's tile, entered heading `heading`)
+    // against the delays. True, with the new tiles in `out`, when it saves at least minGain seconds.
+    bool reroute(const RoadGraph& graph, const std::vector<int>& rest, int goal, int heading, bool emergency,
+                 float minGain, std::vector<int>& out) const;
+
+private:
+    static const int SLICES = 32;
+
+    float alpha;
+    float horizon;
+    std::vector<float> time;   // EMA of measured seconds, 0 until the first sample
+    std::vector<float> excess; // EMA of seconds above free flow
+    float slicedAt[SLICES];
+    int nextSlice{0};
+};
+
+#endif
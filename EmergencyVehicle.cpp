@@ -4,8 +4,8 @@
 #include "raymath.h"
 #include "rlgl.h" 
 
-EmergencyVehicle::EmergencyVehicle(Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor, std::string vType)
-    : Vehicle(startPos, endPos, vSpeed, vColor), type(vType), isSirenActive(false),
+EmergencyVehicle::EmergencyVehicle(RouteTable& routeTable, Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor, std::string vType)
+    : Vehicle(routeTable, startPos, endPos, vSpeed, vColor), type(vType), isSirenActive(false),
       sirenMultiplier(1.5f), normalMultiplier(1.0f) {}
 
 void EmergencyVehicle::setSirenActive(bool on) {
@@ -19,7 +19,7 @@ void EmergencyVehicle::toggleSiren(bool on) {
 
 void EmergencyVehicle::assignIncident(CityMap* map, Vector3 targetPos) {
     setSirenActive(true);
-    std::vector<Vector3> newPath = map->findFastestPath(position, targetPos, true);
+    std::vector<Vector3> newPath = map->findFastestPath(position, targetPos, true, headingOf(getForwardDir()));
     if (!newPath.empty()) {
         setPath(newPath);
     }
@@ -18,10 +18,11 @@ private:
     bool isReturning;
 
 public:
-    EmergencyVehicle(Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor, std::string vType);
+    EmergencyVehicle(RouteTable& routeTable, Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor, std::string vType);
 
     void setSirenActive(bool on);
     bool getSirenActive() const { return isSirenActive; }
+    float getSirenSpeed() const { return baseSpeed * sirenMultiplier; }
     void toggleSiren(bool on);
 
     // UPDATED: Uses CityMap to find path
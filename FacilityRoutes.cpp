@@ -0,0 +1,283 @@
+#include "FacilityRoutes.h"
+#include "CityMap.h"
+#include <queue>
+#include <limits>
+#include <algorithm>
+
+static const float INF_TIME = std::numeric_limits<float>::infinity();
+
+bool facilityGroupOf(FacilityType f, FacilityGroup& out) {
+    switch (f) {
+        case HOSPITAL: case HOSPITAL1: case HOSPITAL2: case HOSPITAL3:
+            out = FacilityGroup::Hospital; return true;
+        case FIRES: case FIRES1: case FIRES2:
+            out = FacilityGroup::Fire; return true;
+        case POLICES: case POLICES1: case POLICES2:
+            out = FacilityGroup::Police; return true;
+        default:
+            return false;
+    }
+}
+
+FacilityRoutes::FacilityRoutes(const CityMap& cityMap) : map(cityMap) {
+    rebuild();
+}
+
+void FacilityRoutes::rebuild() {
+    const RoadGraph& g = map.roadGraph();
+    trees.clear();
+    seenRevision = g.revision();
+
+    // Adjacent facility tiles of the same group form one site (e.g. the 4-tile hospital)
+    std::vector<bool> seen(g.size(), false);
+    for (int start = 0; start < g.size(); start++) {
+        FacilityGroup group;
+        if (seen[start] || !facilityGroupOf(map.facilityMap[start / g.width()][start % g.width()], group)) continue;
+
+        Tree tree;
+        tree.group = group;
+        tree.dirty = true;
+        std::vector<int> stack{start};
+        seen[start] = true;
+        while (!stack.empty()) {
+            int t = stack.back(); stack.pop_back();
+            tree.facilityTiles.push_back(t);
+            for (int d = 0; d < 4; d++) {
+                int n = g.neighbour(t, d);
+                FacilityGroup ng;
+                if (n < 0 || seen[n]) continue;
+                if (!facilityGroupOf(map.facilityMap[n / g.width()][n % g.width()], ng) || ng != group) continue;
+                seen[n] = true;
+                stack.push_back(n);
+            }
+        }
+        findAccess(tree);
+        trees.push_back(tree);
+    }
+}
+
+bool FacilityRoutes::touchesSite(const Tree& tree, int tile) const {
+    const RoadGraph& g = map.roadGraph();
+    for (int f : tree.facilityTiles) {
+        if (f == tile) return true;
+        for (int d = 0; d < 4; d++) {
+            if (g.neighbour(f, d) == tile) return true;
+        }
+    }
+    return false;
+}
+
+void FacilityRoutes::findAccess(Tree& tree) const {
+    const RoadGraph& g = map.roadGraph();
+    tree.access.clear();
+    for (int f : tree.facilityTiles) {
+        for (int d = 0; d < 4; d++) {
+            int n = g.neighbour(f, d);
+            if (n < 0 || !g.isPassable(n, true)) continue;
+            bool dup = false;
+            for (int a : tree.access) dup = dup || (a == n);
+            if (!dup) tree.access.push_back(n);
+        }
+    }
+}
+
+void FacilityRoutes::buildTree(Tree& tree) const {
+    const RoadGraph& g = map.roadGraph();
+    tree.nextHop.assign(g.stateCount(), HOP_NONE);
+    tree.dist.assign(g.stateCount(), INF_TIME);
+
+    std::vector<int> frontier;
+    for (int a : tree.access) {
+        for (int hd = 0; hd < 4; hd++) {
+            int st = RoadGraph::stateOf(a, hd);
+            tree.dist[st] = 0.0f;
+            tree.nextHop[st] = HOP_ARRIVED;
+            frontier.push_back(st);
+        }
+    }
+    relax(tree, frontier);
+    tree.dirty = false;
+}
+
+void FacilityRoutes::relax(Tree& tree, std::vector<int>& frontier) const {
+    const RoadGraph& g = map.roadGraph();
+    struct Node { float d; int id; };
+    struct Cmp { bool operator()(const Node& a, const Node& b) const { return a.d > b.d; } };
+    std::priority_queue<Node, std::vector<Node>, Cmp> pq;
+    for (int st : frontier) pq.push({tree.dist[st], st});
+
+    // Reverse search over lane states: each predecessor's next hop is the heading it moves into
+    while (!pq.empty()) {
+        Node cur = pq.top(); pq.pop();
+        if (cur.d > tree.dist[cur.id]) continue;
+        g.forEachPredecessor(cur.id, true, [&](int prev, float cost) {
+            float nd = cur.d + cost;
+            if (nd < tree.dist[prev]) {
+                tree.dist[prev] = nd;
+                tree.nextHop[prev] = (int8_t)RoadGraph::stateHeading(cur.id);
+                pq.push({nd, prev});
+            }
+        });
+    }
+}
+
+void FacilityRoutes::repairTile(Tree& tree, int tile) const {
+    const RoadGraph& g = map.roadGraph();
+    // The edited tile's states, plus its neighbours' (they can gain or lose a dead-end u-turn)
+    std::vector<int> roots;
+    for (int d = -1; d < 4; d++) {
+        int t = (d < 0) ? tile : g.neighbour(tile, d);
+        if (t < 0 || std::find(tree.access.begin(), tree.access.end(), t) != tree.access.end()) continue;
+        for (int hd = 0; hd < 4; hd++) roots.push_back(RoadGraph::stateOf(t, hd));
+    }
+
+    // Everything whose next hops lead through those states loses its time. The states that move
+    // into state u sit on the tile behind it, facing any way, with u's heading as their next hop.
+    std::vector<int> invalid;
+    std::vector<int> stack = roots;
+    while (!stack.empty()) {
+        int u = stack.back(); stack.pop_back();
+        invalid.push_back(u);
+        tree.dist[u] = INF_TIME;
+        tree.nextHop[u] = HOP_NONE;
+        int heading = RoadGraph::stateHeading(u);
+        int behind = g.neighbour(RoadGraph::stateTile(u), oppositeDir(heading));
+        if (behind < 0) continue;
+        for (int hd = 0; hd < 4; hd++) {
+            int child = RoadGraph::stateOf(behind, hd);
+            if (tree.nextHop[child] == heading) stack.push_back(child);
+        }
+    }
+
+    // Re-seed the hole from its still-valid successors, then let the search fill it (and any
+    // shortcut it opened)
+    std::vector<int> frontier;
+    for (int u : invalid) {
+        g.forEachSuccessor(u, true, [&](int next, float cost) {
+            if (tree.dist[next] + cost < tree.dist[u]) {
+                tree.dist[u] = tree.dist[next] + cost;
+                tree.nextHop[u] = (int8_t)RoadGraph::stateHeading(next);
+            }
+        });
+        if (tree.dist[u] < INF_TIME) frontier.push_back(u);
+    }
+    relax(tree, frontier);
+}
+
+float FacilityRoutes::stateDist(const Tree& tree, int tile, int heading) {
+    if (heading >= 0) return tree.dist[RoadGraph::stateOf(tile, heading)];
+    float best = INF_TIME;
+    for (int hd = 0; hd < 4; hd++) best = std::min(best, tree.dist[RoadGraph::stateOf(tile, hd)]);
+    return best;
+}
+
+bool FacilityRoutes::reaches(const Tree& tree, int tile) const {
+    const RoadGraph& g = map.roadGraph();
+    if (stateDist(tree, tile, -1) < INF_TIME) return true;
+    for (int d = 0; d < 4; d++) {
+        int n = g.neighbour(tile, d);
+        if (n >= 0 && stateDist(tree, n, -1) < INF_TIME) return true;
+    }
+    return false;
+}
+
+void FacilityRoutes::sync() {
+    const RoadGraph& g = map.roadGraph();
+    const std::vector<int>& log = g.changeLog();
+    for (uint32_t i = seenRevision; i < log.size(); i++) {
+        int tile = log[i];
+        for (Tree& tree : trees) {
+            if (touchesSite(tree, tile)) {
+                findAccess(tree);
+                tree.dirty = true;
+            }
+            // An edit can only matter if the tree reaches the tile or one of its neighbours
+            // (neighbours can gain or lose their dead-end u-turn)
+            if (!tree.dirty && reaches(tree, tile)) repairTile(tree, tile);
+        }
+    }
+    seenRevision = g.revision();
+}
+
+int FacilityRoutes::siteCount(FacilityGroup g) const {
+    int count = 0;
+    for (const Tree& tree : trees) if (tree.group == g) count++;
+    return count;
+}
+
+std::vector<int> FacilityRoutes::siteAccess(FacilityGroup g) {
+    sync();
+    std::vector<int> tiles;
+    for (const Tree& tree : trees) {
+        if (tree.group == g && !tree.access.empty()) tiles.push_back(tree.access.front());
+    }
+    return tiles;
+}
+
+FacilityRoutes::Tree* FacilityRoutes::nearestTree(FacilityGroup g, int tile, int heading) {
+    sync();
+    Tree* best = nullptr;
+    float bestDist = INF_TIME;
+    for (Tree& tree : trees) {
+        if (tree.group != g) continue;
+        if (tree.dirty) buildTree(tree);
+        float d = stateDist(tree, tile, heading);
+        if (d < bestDist) { bestDist = d; best = &tree; }
+    }
+    return best;
+}
+
+float FacilityRoutes::timeToNearest(FacilityGroup g, int tile) {
+    Tree* tree = nearestTree(g, tile, -1);
+    return tree ? stateDist(*tree, tile, -1) : INF_TIME;
+}
+
+std::vector<Vector3> FacilityRoutes::routeToNearest(FacilityGroup g, Vector3 startWorld, int heading) {
+    const RoadGraph& graph = map.roadGraph();
+    int sy, sx;
+    map.worldToTile(startWorld, sy, sx);
+    int start = graph.id(sy, sx);
+
+    std::vector<Vector3> wp;
+    int state = -1;
+    Tree* tree = nullptr;
+    if (graph.isPassable(start, true)) {
+        tree = nearestTree(g, start, heading);
+        // Facing a dead direction: accept a route that turns around where the rules allow it
+        if (!tree && heading >= 0) { tree = nearestTree(g, start, -1); heading = -1; }
+        if (!tree) return {};
+        if (heading >= 0) state = RoadGraph::stateOf(start, heading);
+        else {
+            for (int hd = 0; hd < 4; hd++) {
+                int st = RoadGraph::stateOf(start, hd);
+                if (state < 0 || tree->dist[st] < tree->dist[state]) state = st;
+            }
+        }
+    } else {
+        // Off-road start (e.g. parked at a facility): drive onto the best adjacent road
+        float bestTime = INF_TIME;
+        for (int d = 0; d < 4; d++) {
+            int n = graph.neighbour(start, d);
+            if (n < 0 || !graph.isPassable(n, true)) continue;
+            Tree* nt = nearestTree(g, n, d);
+            if (nt && stateDist(*nt, n, d) < bestTime) {
+                bestTime = stateDist(*nt, n, d);
+                tree = nt;
+                state = RoadGraph::stateOf(n, d);
+            }
+        }
+        if (!tree) return {};
+        wp.push_back(map.tileCenter(sy, sx));
+    }
+
+    // O(path length) walk along the next-hop array
+    for (int steps = 0; steps <= graph.stateCount(); steps++) {
+        int tile = RoadGraph::stateTile(state);
+        wp.push_back(map.tileCenter(tile / graph.width(), tile % graph.width()));
+        int8_t hop = tree->nextHop[state];
+        if (hop == HOP_ARRIVED) return wp;
+        if (hop == HOP_NONE) break;
+        state = RoadGraph::stateOf(graph.neighbour(tile, hop), hop);
+    }
+    return {};
+}
@@ -0,0 +1,65 @@
+#ifndef FACILITYROUTES_H
+#define FACILITYROUTES_H
+
+#include "GameCommon.h"
+#include <vector>
+#include <cstdint>
+
+class CityMap;
+
+enum class FacilityGroup { Hospital = 0, Fire, Police, Count };
+
+// Returns false for facilities that are not an emergency base
+bool facilityGroupOf(FacilityType f, FacilityGroup& out);
+
+// Reverse shortest-path trees towards every emergency facility site.
+// Each tree stores a next-hop direction and the travel time per lane state, so "route to the
+// nearest hospital" is a walk along the tree instead of a fresh search, and still obeys the turn
+// rules. The times pick the nearest site; the hops also say which states a tile edit cuts off.
+class FacilityRoutes {
+public:
+    explicit FacilityRoutes(const CityMap& map);
+
+    // Re-scan the facility map and rebuild every tree
+    void rebuild();
+    // Pull road graph edits since the last call. Trees whose site was touched are rebuilt on the
+    // next query; the others only re-solve the states that were routed through an edited tile.
+    void sync();
+
+    int siteCount(FacilityGroup g) const;
+    // One road tile in front of each site of the group, where its units wait
+    std::vector<int> siteAccess(FacilityGroup g);
+    // Travel time from a tile to the nearest site of the group (infinity if unreachable)
+    float timeToNearest(FacilityGroup g, int tile);
+    // Waypoints from startWorld to the road tile in front of the nearest site, empty if unreachable.
+    // heading (RoadDir) is the direction the vehicle is facing, -1 if it can leave either way.
+    std::vector<Vector3> routeToNearest(FacilityGroup g, Vector3 startWorld, int heading = -1);
+
+private:
+    static constexpr int8_t HOP_NONE = -1;   // unreachable
+    static constexpr int8_t HOP_ARRIVED = 4; // access tile of the site
+
+    struct Tree {
+        FacilityGroup group;
+        std::vector<int> facilityTiles;
+        std::vector<int> access;    // road tiles touching the site
+        std::vector<int8_t> nextHop; // per lane state: exit RoadDir towards the site, or HOP_*
+        std::vector<float> dist;     // per lane state: seconds to the site
+        bool dirty;                  // rebuild from scratch before the next query
+    };
+
+    const CityMap& map;
+    std::vector<Tree> trees;
+    uint32_t seenRevision{0};
+
+    bool touchesSite(const Tree& tree, int tile) const;
+    void findAccess(Tree& tree) const;
+    void buildTree(Tree& tree) const;
+    void repairTile(Tree& tree, int tile) const;
+    void relax(Tree& tree, std::vector<int>& frontier) const;
+    static float stateDist(const Tree& tree, int tile, int heading);
+    bool reaches(const Tree& tree, int tile) const;
+    Tree* nearestTree(FacilityGroup g, int tile, int heading);
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "GreenWave.h"
+#include "IdmKernel.h"
+#include <thread>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+static const float HALF_TILE = 2.0f;   // stop lines sit at the edge of a junction tile
+static const float APPROACH = 30.0f;   // road before the first and after the last junction
+static const float DT = 0.2f;
+static const float SATURATION = 0.5f;  // side street discharge, vehicles per second of green
+static const float MIN_SHARE = 0.2f, MAX_SHARE = 0.8f;
+
+GreenWaveOptimizer::GreenWaveOptimizer(const SignalNetwork& network, const Options& options)
+    : net(network), opt(options) {
+    threads = opt.threads > 0 ? opt.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    int n = (int)net.junctions.size();
+    corridorsOf.assign(n, {});
+    std::vector<uint8_t> covered(n, 0);
+    for (int c = 0; c < (int)net.corridors.size(); c++) {
+        for (int j : net.corridors[c].junction) {
+            corridorsOf[j].push_back(c);
+            covered[j] |= (uint8_t)(1u << net.corridors[c].axis);
+        }
+    }
+    sideAxes.resize(n);
+    for (int j = 0; j < n; j++) sideAxes[j] = (uint8_t)(3u & ~covered[j]);
+}
+
+GreenWaveOptimizer::Timing GreenWaveOptimizer::timingOf(const SignalPlan& plan) const {
+    Timing t;
+    for (const SignalNetwork::Junction& j : net.junctions) {
+        const SignalPlan::Entry* e = plan.find(j.tile);
+        t.offset.push_back(e ? fmodf(e->offset, net.timing.cycle) : 0.0f);
+        t.share.push_back(e ? std::min(MAX_SHARE, std::max(MIN_SHARE, e->nsShare)) : 0.5f);
+    }
+    return t;
+}
+
+SignalPlan GreenWaveOptimizer::planOf(const Timing& t) const {
+    SignalPlan plan;
+    plan.timing = net.timing;
+    for (size_t j = 0; j < net.junctions.size(); j++) plan.entries.push_back({ net.junctions[j].tile, t.offset[j], t.share[j] });
+    return plan;
+}
+
+SignalPlan GreenWaveOptimizer::initialPlan() const {
+    return planOf(timingOf(SignalPlan()));
+}
+
+double GreenWaveOptimizer::score(const SignalPlan& plan) const {
+    return evaluate(timingOf(plan));
+}
+
+void GreenWaveOptimizer::corridorDelay(int c, int dir, const Timing& t, double& delay, double& vehicles) const {
+    const SignalNetwork::Corridor& cor = net.corridors[c];
+    const SignalTiming& timing = net.timing;
+    const float cycle = timing.cycle;
+    int n = (int)cor.junction.size();
+
+    // Positions as u = dir * position, so cars always drive towards larger u
+    std::vector<int> order(n);
+    for (int k = 0; k < n; k++) order[k] = k;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return dir * cor.position[a] < dir * cor.position[b]; });
+    std::vector<float> stopLine(n), greenStart(n), greenLength(n), offset(n);
+    for (int k = 0; k < n; k++) {
+        int j = cor.junction[order[k]];
+        stopLine[k] = dir * cor.position[order[k]] - HALF_TILE;
+        throughWindow(coordinatedPhases(net.junctions[j].openings, timing, t.share[j]), timing, cor.axis,
+                      greenStart[k], greenLength[k]);
+        offset[k] = t.offset[j];
+    }
+    const float entry = stopLine.front() - APPROACH, exit = stopLine.back() + 2.0f * HALF_TILE + APPROACH;
+    const float freeTime = (exit - entry) / cor.speed;
+    const float warmup = 2.0f * cycle, end = warmup + opt.minutes * 60.0f;
+
+    IdmParams p;
+    std::mt19937 rng(opt.seed * 7919u + (unsigned)c * 131u + (dir > 0 ? 0u : 1u));
+    std::exponential_distribution<float> headway(std::max(1e-3f, net.mainDemand / 60.0f));
+    float nextArrival = headway(rng);
+    std::vector<float> waiting; // arrival times of cars the entry has no room for yet
+    size_t firstWaiting = 0;
+
+    // Cars front first
+    std::vector<float> u, v, arrived, desired, gap, closing, accel, ds;
+    auto record = [&](float arrival, float spent) {
+        if (arrival < warmup) return;
+        delay += std::max(0.0f, spent);
+        vehicles += 1.0;
+    };
+
+    for (float now = 0.0f; now < end; now += DT) {
+        while (nextArrival <= now) {
+            waiting.push_back(nextArrival);
+            nextArrival += headway(rng);
+        }
+        if (firstWaiting < waiting.size() && (u.empty() || u.back() - p.vehicleLength - p.minGap > entry)) {
+            u.push_back(entry);
+            v.push_back(u.size() > 1 ? std::min(cor.speed, v[v.size() - 1]) : cor.speed);
+            arrived.push_back(waiting[firstWaiting++]);
+        }
+
+        int m = (int)u.size();
+        desired.assign(m, cor.speed);
+        gap.resize(m); closing.resize(m); accel.resize(m); ds.resize(m);
+        for (int i = 0; i < m; i++) {
+            gap[i] = i == 0 ? IDM_FREE_GAP : u[i - 1] - p.vehicleLength - u[i];
+            closing[i] = i == 0 ? 0.0f : v[i] - v[i - 1];
+            // The first stop line ahead: stop there on red, and on yellow if there is room to
+            for (int k = 0; k < n; k++) {
+                if (stopLine[k] <= u[i] - 0.05f) continue;
+                float d = std::max(0.0f, stopLine[k] - u[i]);
+                float inCycle = fmodf(now + offset[k] - greenStart[k], cycle);
+                if (inCycle < 0.0f) inCycle += cycle;
+                bool green = inCycle < greenLength[k];
+                bool yellow = !green && inCycle < greenLength[k] + timing.yellow;
+                bool stop = !green && (!yellow || v[i] * v[i] < 2.0f * p.comfortDecel * d);
+                if (stop && d < gap[i]) { gap[i] = d; closing[i] = v[i]; }
+                break;
+            }
+        }
+        idmAccelerate(p, m, v.data(), desired.data(), gap.data(), closing.data(), accel.data());
+        idmAdvance(m, DT, accel.data(), gap.data(), v.data(), ds.data());
+        for (int i = 0; i < m; i++) u[i] += ds[i];
+
+        int left = 0;
+        while (left < m && u[left] > exit) {
+            record(arrived[left], now + DT - arrived[left] - freeTime);
+            left++;
+        }
+        if (left > 0) {
+            u.erase(u.begin(), u.begin() + left);
+            v.erase(v.begin(), v.begin() + left);
+            arrived.erase(arrived.begin(), arrived.begin() + left);
+        }
+    }
+    // Cars still on the road or waiting to enter are charged what they lost so far
+    for (size_t i = 0; i < u.size(); i++) record(arrived[i], end - arrived[i] - (u[i] - entry) / cor.speed);
+    for (size_t i = firstWaiting; i < waiting.size(); i++) record(waiting[i], end - waiting[i]);
+}
+
+double GreenWaveOptimizer::evaluate(const Timing& t) const {
+    evaluated++;
+    double delay = 0.0, vehicles = 0.0;
+    for (int c = 0; c < (int)net.corridors.size(); c++) {
+        corridorDelay(c, 1, t, delay, vehicles);
+        corridorDelay(c, -1, t, delay, vehicles);
+    }
+
+    // Side streets: Webster's uniform delay for the green their axis gets, growing without bound
+    // once demand exceeds what that green can discharge
+    const double cycle = net.timing.cycle, q = net.crossDemand / 60.0;
+    for (size_t j = 0; j < net.junctions.size(); j++) {
+        if (!sideAxes[j]) continue;
+        std::vector<SignalScheduler::Phase> phases = coordinatedPhases(net.junctions[j].openings, net.timing, t.share[j]);
+        for (int axis = 0; axis < 2; axis++) {
+            uint8_t open = net.junctions[j].openings;
+            int approaches = (open >> axis & 1) + (open >> (axis + 2) & 1);
+            if (!(sideAxes[j] >> axis & 1) || approaches == 0) continue;
+            float start, green;
+            throughWindow(phases, net.timing, axis, start, green);
+            double lambda = green / cycle;
+            double x = lambda > 0.0 ? q / (SATURATION * lambda) : 1e3;
+            double d = 0.5 * cycle * (1.0 - lambda) * (1.0 - lambda) / (1.0 - std::min(1.0, x) * lambda);
+            if (x > 0.95) d += (x - 0.95) * 10.0 * cycle;
+            double count = q * 60.0 * opt.minutes * approaches;
+            delay += d * count;
+            vehicles += count;
+        }
+    }
+    return vehicles > 0.0 ? delay / vehicles : 0.0;
+}
+
+void GreenWaveOptimizer::evaluateAll(const std::vector<Timing>& candidates, std::vector<double>& scores) const {
+    scores.assign(candidates.size(), 0.0);
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t k = next++; k < candidates.size(); k = next++) scores[k] = evaluate(candidates[k]);
+    };
+    int n = std::min(threads, (int)candidates.size());
+    std::vector<std::thread> pool;
+    for (int i = 1; i < n; i++) pool.emplace_back(work);
+    work();
+    for (std::thread& th : pool) th.join();
+}
+
+SignalPlan GreenWaveOptimizer::optimize(const SignalPlan& start) {
+    const float cycle = net.timing.cycle;
+    int n = (int)net.junctions.size();
+    Timing best = timingOf(start);
+    double bestScore = evaluate(best);
+    float offsetStep = cycle * 0.25f, shareStep = 0.1f;
+
+    std::vector<Timing> candidates;
+    std::vector<int> moved; // junction each candidate changes
+    std::vector<double> scores;
+    for (int round = 0; round < opt.rounds && offsetStep >= 0.25f; round++) {
+        candidates.clear();
+        moved.clear();
+        for (int j = 0; j < n; j++) {
+            for (int k = 0; k < 4; k++) {
+                Timing cand = best;
+                if (k < 2) {
+                    cand.offset[j] = fmodf(best.offset[j] + (k == 0 ? offsetStep : cycle - offsetStep), cycle);
+                } else {
+                    float s = best.share[j] + (k == 2 ? shareStep : -shareStep);
+                    s = std::min(MAX_SHARE, std::max(MIN_SHARE, s));
+                    if (s == best.share[j]) continue;
+                    cand.share[j] = s;
+                }
+                candidates.push_back(cand);
+                moved.push_back(j);
+            }
+        }
+        evaluateAll(candidates, scores);
+
+        std::vector<int> better;
+        for (int k = 0; k < (int)candidates.size(); k++) if (scores[k] < bestScore - 1e-6) better.push_back(k);
+        if (better.empty()) {
+            offsetStep *= 0.5f;
+            shareStep *= 0.5f;
+            continue;
+        }
+        std::sort(better.begin(), better.end(), [&](int a, int b) { return scores[a] < scores[b]; });
+
+        // Moves on junctions that share no corridor don't affect each other's score
+        Timing combined = best;
+        std::vector<uint8_t> blocked(n, 0);
+        int taken = 0;
+        for (int k : better) {
+            int j = moved[k];
+            if (blocked[j]) continue;
+            combined.offset[j] = candidates[k].offset[j];
+            combined.share[j] = candidates[k].share[j];
+            taken++;
+            blocked[j] = 1;
+            for (int c : corridorsOf[j]) for (int other : net.corridors[c].junction) blocked[other] = 1;
+        }
+        double combinedScore = taken > 1 ? evaluate(combined) : scores[better[0]];
+        if (combinedScore <= scores[better[0]]) {
+            best = combined;
+            bestScore = combinedScore;
+        } else {
+            best = candidates[better[0]];
+            bestScore = scores[better[0]];
+        }
+    }
+    return planOf(best);
+}
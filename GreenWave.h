@@ -0,0 +1,59 @@
+#ifndef GREENWAVE_H
+#define GREENWAVE_H
+
+#include "SignalPlan.h"
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+// Offline search for signal offsets and splits that give the corridors of a SignalNetwork a green
+// wave. A plan is scored headless: on every corridor, cars in both directions follow each other
+// with the IDM kernel and stop at the through signals of their axis, while side street traffic at
+// each junction is charged the uniform (Webster) delay of the green left to it. Every score uses
+// the same random arrivals, so two plans compare on their timing alone.
+//
+// The search is coordinate descent: each round tries every junction's offset and split one step
+// either way, with the candidate plans scored in parallel on worker threads. The best moves are
+// taken together as long as their junctions share no corridor; steps halve when nothing improves.
+class GreenWaveOptimizer {
+public:
+    struct Options {
+        int threads{0};       // 0 = one per hardware thread
+        int rounds{30};
+        float minutes{10.0f}; // simulated per corridor and direction for each score
+        unsigned seed{1};
+    };
+
+    GreenWaveOptimizer(const SignalNetwork& network, const Options& options);
+
+    // Every junction at offset 0 with an even split
+    SignalPlan initialPlan() const;
+    SignalPlan optimize(const SignalPlan& start);
+    // Mean delay per vehicle in seconds, main road and side street traffic together
+    double score(const SignalPlan& plan) const;
+
+    uint64_t evaluations() const { return evaluated.load(); }
+    int threadCount() const { return threads; }
+
+private:
+    // Offset and N/S share per junction, in the order of network.junctions
+    struct Timing {
+        std::vector<float> offset, share;
+    };
+
+    const SignalNetwork& net;
+    Options opt;
+    int threads;
+    std::vector<std::vector<int>> corridorsOf;  // per junction
+    std::vector<uint8_t> sideAxes;              // per junction, axes no corridor covers (bit per axis)
+    mutable std::atomic<uint64_t> evaluated{0};
+
+    Timing timingOf(const SignalPlan& plan) const;
+    SignalPlan planOf(const Timing& t) const;
+    double evaluate(const Timing& t) const;
+    // Total delay in vehicle-seconds and vehicles counted, one direction of one corridor
+    void corridorDelay(int c, int dir, const Timing& t, double& delay, double& vehicles) const;
+    void evaluateAll(const std::vector<Timing>& candidates, std::vector<double>& scores) const;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "HierarchicalRouter.h"
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <cstdlib>
+
+static const float INF_COST = std::numeric_limits<float>::infinity();
+
+HierarchicalRouter::HierarchicalRouter(const RoadGraph& roads, int chunkSize)
+    : graph(roads), chunk(chunkSize) {
+    rebuild();
+}
+
+int HierarchicalRouter::chunkOf(int tile) const {
+    int y = tile / graph.width(), x = tile % graph.width();
+    return (y / chunk) * chunksX + (x / chunk);
+}
+
+void HierarchicalRouter::rebuild() {
+    chunksX = (graph.width() + chunk - 1) / chunk;
+    chunksY = (graph.height() + chunk - 1) / chunk;
+    nodes.clear();
+    chunkEntries.assign(chunkCount(), {});
+    minTileTime = INF_COST;
+    for (int t = 0; t < graph.size(); t++) {
+        if (graph.isPassable(t, true)) minTileTime = std::min(minTileTime, graph.travelTime(t, true));
+    }
+    if (minTileTime == INF_COST) minTileTime = 0.0f;
+    for (int c = 0; c < chunkCount(); c++) rebuildChunk(c);
+    seenRevision = graph.revision();
+}
+
+void HierarchicalRouter::sync() {
+    const std::vector<int>& log = graph.changeLog();
+    if (seenRevision == log.size()) return;
+
+    // An edit re-costs its own chunk, and the chunks of its neighbours: their crossings
+    // and dead-end u-turns can depend on the edited tile
+    std::vector<int> dirty;
+    for (uint32_t i = seenRevision; i < log.size(); i++) {
+        for (int d = -1; d < 4; d++) {
+            int t = (d < 0) ? log[i] : graph.neighbour(log[i], d);
+            if (t >= 0) dirty.push_back(chunkOf(t));
+        }
+        if (graph.isPassable(log[i], true)) minTileTime = std::min(minTileTime, graph.travelTime(log[i], true));
+    }
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    for (int c : dirty) rebuildChunk(c);
+    seenRevision = graph.revision();
+}
+
+template<class OnExit>
+void HierarchicalRouter::searchChunk(int c, const std::vector<std::pair<int, float>>& seeds, bool emergency,
+                                     std::vector<float>& dist, std::vector<int>& prev, OnExit onExit) const {
+    const int ox = (c % chunksX) * chunk, oy = (c / chunksX) * chunk;
+    auto local = [&](int state) {
+        int tile = RoadGraph::stateTile(state);
+        return ((tile / graph.width() - oy) * chunk + (tile % graph.width() - ox)) * 4 + RoadGraph::stateHeading(state);
+    };
+    auto global = [&](int l) {
+        int cell = l >> 2;
+        return RoadGraph::stateOf(graph.id(oy + cell / chunk, ox + cell % chunk), l & 3);
+    };
+
+    dist.assign(chunk * chunk * 4, INF_COST);
+    prev.assign(chunk * chunk * 4, -1);
+    struct Item { float d; int l; };
+    struct Cmp { bool operator()(const Item& a, const Item& b) const { return a.d > b.d; } };
+    std::priority_queue<Item, std::vector<Item>, Cmp> pq;
+    for (const auto& s : seeds) {
+        if (chunkOf(RoadGraph::stateTile(s.first)) != c) continue;
+        int l = local(s.first);
+        if (s.second < dist[l]) { dist[l] = s.second; pq.push({s.second, l}); }
+    }
+
+    while (!pq.empty()) {
+        Item cur = pq.top(); pq.pop();
+        if (cur.d > dist[cur.l]) continue;
+        graph.forEachSuccessor(global(cur.l), emergency, [&](int next, float cost) {
+            float nd = cur.d + cost;
+            if (chunkOf(RoadGraph::stateTile(next)) != c) { onExit(next, nd, cur.l); return; }
+            int nl = local(next);
+            if (nd < dist[nl]) {
+                dist[nl] = nd;
+                prev[nl] = cur.l;
+                pq.push({nd, nl});
+            }
+        });
+    }
+}
+
+void HierarchicalRouter::rebuildChunk(int c) {
+    for (int s : chunkEntries[c]) nodes.erase(s);
+    chunkEntries[c].clear();
+
+    // Entries: lane states inside the chunk reached by a road crossing from another chunk
+    const int ox = (c % chunksX) * chunk, oy = (c / chunksX) * chunk;
+    for (int y = oy; y < std::min(oy + chunk, graph.height()); y++) {
+        for (int x = ox; x < std::min(ox + chunk, graph.width()); x++) {
+            if (y != oy && y != oy + chunk - 1 && x != ox && x != ox + chunk - 1) continue;
+            int t = graph.id(y, x);
+            for (int hd = 0; hd < 4; hd++) {
+                int from = graph.neighbour(t, oppositeDir(hd));
+                if (from < 0 || chunkOf(from) == c || !graph.connects(from, hd)) continue;
+                chunkEntries[c].push_back(RoadGraph::stateOf(t, hd));
+            }
+        }
+    }
+
+    std::vector<float> dist;
+    std::vector<int> prev;
+    for (int entry : chunkEntries[c]) {
+        Node node;
+        node.chunk = c;
+        std::vector<std::pair<int, float>> seeds{{entry, 0.0f}};
+        searchChunk(c, seeds, true, dist, prev, [&](int next, float cost, int) {
+            for (Edge& e : node.edges) {
+                if (e.to == next) { e.cost = std::min(e.cost, cost); return; }
+            }
+            node.edges.push_back({next, cost});
+        });
+        nodes[entry] = node;
+    }
+}
+
+void HierarchicalRouter::startSeeds(int start, int heading, bool emergency, std::vector<std::pair<int, float>>& seeds) const {
+    seeds.clear();
+    if (graph.isPassable(start, emergency)) {
+        for (int hd = 0; hd < 4; hd++) {
+            if (heading < 0 || hd == heading) seeds.push_back({RoadGraph::stateOf(start, hd), 0.0f});
+        }
+        return;
+    }
+    // Off-road start: drive onto an adjacent road in the same chunk
+    for (int d = 0; d < 4; d++) {
+        int n = graph.neighbour(start, d);
+        if (n < 0 || !graph.isPassable(n, emergency) || chunkOf(n) != chunkOf(start)) continue;
+        seeds.push_back({RoadGraph::stateOf(n, d), graph.travelTime(n, emergency)});
+    }
+}
+
+bool HierarchicalRouter::plan(int start, int goal, bool emergency, int startHeading, Route& out) {
+    sync();
+    out = Route(); // done() until the plan succeeds, so a failed plan is never refined
+    if (!graph.isPassable(goal, emergency)) return false;
+
+    const int gc = chunkOf(goal);
+    const int gox = (gc % chunksX) * chunk, goy = (gc / chunksX) * chunk;
+    auto goalLocal = [&](int state) {
+        int tile = RoadGraph::stateTile(state);
+        return ((tile / graph.width() - goy) * chunk + (tile % graph.width() - gox)) * 4 + RoadGraph::stateHeading(state);
+    };
+
+    // Cost from every lane state of the goal chunk to the goal (reverse search inside the chunk)
+    std::vector<float> toGoal(chunk * chunk * 4, INF_COST);
+    {
+        struct Item { float d; int s; };
+        struct Cmp { bool operator()(const Item& a, const Item& b) const { return a.d > b.d; } };
+        std::priority_queue<Item, std::vector<Item>, Cmp> pq;
+        for (int hd = 0; hd < 4; hd++) {
+            int s = RoadGraph::stateOf(goal, hd);
+            toGoal[goalLocal(s)] = 0.0f;
+            pq.push({0.0f, s});
+        }
+        while (!pq.empty()) {
+            Item cur = pq.top(); pq.pop();
+            if (cur.d > toGoal[goalLocal(cur.s)]) continue;
+            graph.forEachPredecessor(cur.s, emergency, [&](int p, float cost) {
+                if (chunkOf(RoadGraph::stateTile(p)) != gc) return;
+                float nd = cur.d + cost;
+                if (nd < toGoal[goalLocal(p)]) { toGoal[goalLocal(p)] = nd; pq.push({nd, p}); }
+            });
+        }
+    }
+
+    std::vector<std::pair<int, float>> seeds;
+    startSeeds(start, startHeading, emergency, seeds);
+    if (seeds.empty()) return false;
+    const int sc = chunkOf(RoadGraph::stateTile(seeds[0].first));
+
+    // Leave the start chunk: its crossings seed the abstract search
+    struct Open { float f; float g; int s; };
+    struct OpenCmp { bool operator()(const Open& a, const Open& b) const { return a.f > b.f; } };
+    std::priority_queue<Open, std::vector<Open>, OpenCmp> open;
+    std::unordered_map<int, float> best;
+    std::unordered_map<int, int> parent;
+    const int FROM_START = -1;
+    const int GOAL_NODE = -2;
+    auto heuristic = [&](int state) {
+        int tile = RoadGraph::stateTile(state);
+        int dy = std::abs(tile / graph.width() - goal / graph.width());
+        int dx = std::abs(tile % graph.width() - goal % graph.width());
+        return (dy + dx) * minTileTime;
+    };
+    auto push = [&](int state, float g, int from) {
+        auto it = best.find(state);
+        if (it != best.end() && it->second <= g) return;
+        best[state] = g;
+        parent[state] = from;
+        open.push({g + heuristic(state), g, state});
+    };
+
+    std::vector<float> dist;
+    std::vector<int> prev;
+    float goalCost = INF_COST;
+    int goalFrom = FROM_START;
+    searchChunk(sc, seeds, emergency, dist, prev, [&](int next, float cost, int) { push(next, cost, FROM_START); });
+    if (sc == gc) {
+        // Staying inside the start chunk is a candidate too
+        for (int hd = 0; hd < 4; hd++) goalCost = std::min(goalCost, dist[goalLocal(RoadGraph::stateOf(goal, hd))]);
+        if (goalCost < INF_COST) open.push({goalCost, goalCost, GOAL_NODE});
+    }
+
+    while (!open.empty()) {
+        Open cur = open.top(); open.pop();
+        if (cur.s == GOAL_NODE) {
+            if (cur.g > goalCost) continue;
+            break;
+        }
+        if (cur.g > best[cur.s]) continue;
+
+        if (chunkOf(RoadGraph::stateTile(cur.s)) == gc) {
+            float total = cur.g + toGoal[goalLocal(cur.s)];
+            if (total < goalCost) {
+                goalCost = total;
+                goalFrom = cur.s;
+                open.push({total, total, GOAL_NODE});
+            }
+        }
+        auto it = nodes.find(cur.s);
+        if (it == nodes.end()) continue;
+        for (const Edge& e : it->second.edges) {
+            if (nodes.count(e.to)) push(e.to, cur.g + e.cost, cur.s);
+        }
+    }
+
+    if (goalCost == INF_COST) return false;
+    for (int s = goalFrom; s != FROM_START; s = parent[s]) out.entries.push_back(s);
+    std::reverse(out.entries.begin(), out.entries.end());
+    out.start = start;
+    out.goal = goal;
+    out.startHeading = startHeading;
+    out.revision = graph.revision();
+    return true;
+}
+
+bool HierarchicalRouter::refineLeg(int c, const std::vector<std::pair<int, float>>& seeds, int targetState, int goal,
+                                   bool emergency, std::vector<int>& outTiles) const {
+    if (targetState < 0 && chunkOf(goal) != c) return false; // the last leg has to end in the goal's chunk
+    const int ox = (c % chunksX) * chunk, oy = (c / chunksX) * chunk;
+    std::vector<float> dist;
+    std::vector<int> prev;
+    float bestCost = INF_COST;
+    int bestLocal = -1;
+    searchChunk(c, seeds, emergency, dist, prev, [&](int next, float cost, int from) {
+        if (next == targetState && cost < bestCost) { bestCost = cost; bestLocal = from; }
+    });
+    if (targetState < 0) {
+        int gy = goal / graph.width() - oy, gx = goal % graph.width() - ox;
+        for (int hd = 0; hd < 4; hd++) {
+            int l = (gy * chunk + gx) * 4 + hd;
+            if (dist[l] < bestCost) { bestCost = dist[l]; bestLocal = l; }
+        }
+    }
+    if (bestLocal < 0) return false;
+
+    std::vector<int> tiles;
+    for (int l = bestLocal; l >= 0; l = prev[l]) {
+        int cell = l >> 2;
+        tiles.push_back(graph.id(oy + cell / chunk, ox + cell % chunk));
+    }
+    outTiles.insert(outTiles.end(), tiles.rbegin(), tiles.rend());
+    return true;
+}
+
+bool HierarchicalRouter::refine(Route& route, int minTiles, bool emergency, std::vector<int>& outTiles) {
+    if (route.done()) return false;
+    sync();
+
+    size_t before = outTiles.size();
+    while (!route.done() && (int)(outTiles.size() - before) < minTiles) {
+        size_t leg = route.nextLeg;
+        std::vector<std::pair<int, float>> seeds;
+        if (leg == 0) {
+            startSeeds(route.start, route.startHeading, emergency, seeds);
+            if (seeds.empty()) return false;
+            if (!graph.isPassable(route.start, emergency)) outTiles.push_back(route.start);
+        } else {
+            seeds.push_back({route.entries[leg - 1], 0.0f});
+        }
+        int target = (leg < route.entries.size()) ? route.entries[leg] : -1;
+        int c = chunkOf(RoadGraph::stateTile(seeds[0].first));
+        if (!refineLeg(c, seeds, target, route.goal, emergency, outTiles)) return false; // blocked since planning
+        route.nextLeg++;
+    }
+    return outTiles.size() > before;
+}
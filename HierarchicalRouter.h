@@ -0,0 +1,72 @@
+#ifndef HIERARCHICALROUTER_H
+#define HIERARCHICALROUTER_H
+
+#include "RoadGraph.h"
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// HPA*-style router for large maps. The map is cut into square chunks; every road crossing
+// between two chunks is an abstract node (the lane state on the far side of the crossing),
+// linked to the crossings reachable from it through its chunk with precomputed costs.
+// Queries search the small abstract graph, and tile paths are refined one chunk at a time,
+// only as far ahead as the caller asks for.
+class HierarchicalRouter {
+public:
+    // An abstract plan. Legs are refined on demand, so only the chunk crossings are held.
+    struct Route {
+        int start{-1};
+        int goal{-1};
+        int startHeading{-1};
+        std::vector<int> entries; // lane state entering each chunk after the start chunk
+        size_t nextLeg{0};        // legs 0..entries.size(), the last one ends at the goal
+        uint32_t revision{0};     // graph revision the plan was made against
+        bool done() const { return start < 0 || nextLeg > entries.size(); }
+    };
+
+    HierarchicalRouter(const RoadGraph& graph, int chunkSize = 32);
+
+    void rebuild();
+    // Re-cost only the chunks touched by graph edits since the last call
+    void sync();
+
+    int chunkSize() const { return chunk; }
+    int chunkCount() const { return chunksX * chunksY; }
+    int nodeCount() const { return (int)nodes.size(); }
+
+    // Abstract search. Returns false if the goal is unreachable, leaving `out` empty (done()).
+    bool plan(int start, int goal, bool emergency, int startHeading, Route& out);
+    // Appends the tiles of the next legs until at least minTiles were added or the route is complete.
+    // The first call also emits the start tile. Returns false once nothing is left to refine.
+    bool refine(Route& route, int minTiles, bool emergency, std::vector<int>& outTiles);
+
+private:
+    struct Edge { int to; float cost; };
+    struct Node {
+        int chunk;
+        std::vector<Edge> edges; // to entry states of neighbouring chunks
+    };
+
+    const RoadGraph& graph;
+    int chunk;
+    int chunksX{0};
+    int chunksY{0};
+    std::unordered_map<int, Node> nodes;            // keyed by lane state
+    std::vector<std::vector<int>> chunkEntries;     // per chunk
+    uint32_t seenRevision{0};
+    float minTileTime{0.0f};                        // admissible A* heuristic per tile of distance
+
+    int chunkOf(int tile) const;
+    void rebuildChunk(int c);
+    // Dijkstra restricted to one chunk. Seeds are (state, cost) pairs. Crossings out of the chunk
+    // are reported through onExit(nextState, cost, fromState); prev/dist are per lane state.
+    template<class OnExit>
+    void searchChunk(int c, const std::vector<std::pair<int, float>>& seeds, bool emergency,
+                     std::vector<float>& dist, std::vector<int>& prev, OnExit onExit) const;
+    // Tile path from seeds to either the crossing into targetState or, if targetState < 0, the goal tile
+    bool refineLeg(int c, const std::vector<std::pair<int, float>>& seeds, int targetState, int goal,
+                   bool emergency, std::vector<int>& outTiles) const;
+    void startSeeds(int start, int heading, bool emergency, std::vector<std::pair<int, float>>& seeds) const;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "IdmKernel.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define IDM_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IDM_SSE 1
+#endif
+
+const char* idmKernelName() {
+#if defined(IDM_AVX2)
+    return "avx2";
+#elif defined(IDM_SSE)
+    return "sse";
+#else
+    return "scalar";
+#endif
+}
+
+// One vehicle; the vector paths below are this, lane by lane
+static inline float idmOne(const IdmParams& p, float inv2sqrtAB, float v, float v0, float gap, float dv) {
+    float r = v / v0;
+    float r2 = r * r;
+    float desired = p.minGap + std::max(0.0f, v * p.headway + v * dv * inv2sqrtAB);
+    float q = desired / std::max(gap, 0.01f);
+    return p.maxAccel * (1.0f - r2 * r2 - q * q);
+}
+
+static inline void advanceOne(float dt, float a, float gap, float& v, float& ds) {
+    float nv = std::max(0.0f, v + a * dt);
+    float d = 0.5f * (v + nv) * dt;
+    ds = std::min(d, std::max(gap, 0.0f));
+    v = nv;
+}
+
+void idmAccelerateScalar(const IdmParams& p, int n, const float* v, const float* v0, const float* gap,
+                         const float* dv, float* accel) {
+    float k = 0.5f / std::sqrt(p.maxAccel * p.comfortDecel);
+    for (int i = 0; i < n; i++) accel[i] = idmOne(p, k, v[i], v0[i], gap[i], dv[i]);
+}
+
+void idmAdvanceScalar(int n, float dt, const float* accel, const float* gap, float* v, float* ds) {
+    for (int i = 0; i < n; i++) advanceOne(dt, accel[i], gap[i], v[i], ds[i]);
+}
+
+void idmAccelerate(const IdmParams& p, int n, const float* v, const float* v0, const float* gap,
+                   const float* dv, float* accel) {
+    float k = 0.5f / std::sqrt(p.maxAccel * p.comfortDecel);
+    int i = 0;
+#if defined(IDM_AVX2)
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 a = _mm256_set1_ps(p.maxAccel), s0 = _mm256_set1_ps(p.minGap);
+    const __m256 T = _mm256_set1_ps(p.headway), kk = _mm256_set1_ps(k), eps = _mm256_set1_ps(0.01f);
+    for (; i + 8 <= n; i += 8) {
+        __m256 vv = _mm256_loadu_ps(v + i);
+        __m256 r = _mm256_div_ps(vv, _mm256_loadu_ps(v0 + i));
+        __m256 r2 = _mm256_mul_ps(r, r);
+        __m256 dyn = _mm256_fmadd_ps(_mm256_mul_ps(vv, _mm256_loadu_ps(dv + i)), kk, _mm256_mul_ps(vv, T));
+        __m256 desired = _mm256_add_ps(s0, _mm256_max_ps(zero, dyn));
+        __m256 q = _mm256_div_ps(desired, _mm256_max_ps(_mm256_loadu_ps(gap + i), eps));
+        __m256 brake = _mm256_fmadd_ps(r2, r2, _mm256_mul_ps(q, q));
+        _mm256_storeu_ps(accel + i, _mm256_mul_ps(a, _mm256_sub_ps(one, brake)));
+    }
+#elif defined(IDM_SSE)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 a = _mm_set1_ps(p.maxAccel), s0 = _mm_set1_ps(p.minGap);
+    const __m128 T = _mm_set1_ps(p.headway), kk = _mm_set1_ps(k), eps = _mm_set1_ps(0.01f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 vv = _mm_loadu_ps(v + i);
+        __m128 r = _mm_div_ps(vv, _mm_loadu_ps(v0 + i));
+        __m128 r2 = _mm_mul_ps(r, r);
+        __m128 dyn = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(vv, _mm_loadu_ps(dv + i)), kk), _mm_mul_ps(vv, T));
+        __m128 desired = _mm_add_ps(s0, _mm_max_ps(zero, dyn));
+        __m128 q = _mm_div_ps(desired, _mm_max_ps(_mm_loadu_ps(gap + i), eps));
+        __m128 brake = _mm_add_ps(_mm_mul_ps(r2, r2), _mm_mul_ps(q, q));
+        _mm_storeu_ps(accel + i, _mm_mul_ps(a, _mm_sub_ps(one, brake)));
+    }
+#endif
+    for (; i < n; i++) accel[i] = idmOne(p, k, v[i], v0[i], gap[i], dv[i]);
+}
+
+void idmAdvance(int n, float dt, const float* accel, const float* gap, float* v, float* ds) {
+    int i = 0;
+#if defined(IDM_AVX2)
+    const __m256 zero = _mm256_setzero_ps(), vdt = _mm256_set1_ps(dt), half = _mm256_set1_ps(0.5f * dt);
+    for (; i + 8 <= n; i += 8) {
+        __m256 vv = _mm256_loadu_ps(v + i);
+        __m256 nv = _mm256_max_ps(zero, _mm256_fmadd_ps(_mm256_loadu_ps(accel + i), vdt, vv));
+        __m256 d = _mm256_mul_ps(half, _mm256_add_ps(vv, nv));
+        d = _mm256_min_ps(d, _mm256_max_ps(_mm256_loadu_ps(gap + i), zero));
+        _mm256_storeu_ps(v + i, nv);
+        _mm256_storeu_ps(ds + i, d);
+    }
+#elif defined(IDM_SSE)
+    const __m128 zero = _mm_setzero_ps(), vdt = _mm_set1_ps(dt), half = _mm_set1_ps(0.5f * dt);
+    for (; i + 4 <= n; i += 4) {
+        __m128 vv = _mm_loadu_ps(v + i);
+        __m128 nv = _mm_max_ps(zero, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(accel + i), vdt), vv));
+        __m128 d = _mm_mul_ps(half, _mm_add_ps(vv, nv));
+        d = _mm_min_ps(d, _mm_max_ps(_mm_loadu_ps(gap + i), zero));
+        _mm_storeu_ps(v + i, nv);
+        _mm_storeu_ps(ds + i, d);
+    }
+#endif
+    for (; i < n; i++) advanceOne(dt, accel[i], gap[i], v[i], ds[i]);
+}
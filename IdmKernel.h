@@ -0,0 +1,33 @@
+#ifndef IDMKERNEL_H
+#define IDMKERNEL_H
+
+// Intelligent Driver Model car following, as batched kernels over contiguous arrays.
+// The AVX2 or SSE path is picked at compile time (CITYSMART_AVX2 in CMake enables AVX2),
+// the scalar path is always built and is the reference the vector paths are checked against.
+
+struct IdmParams {
+    float maxAccel{2.0f};      // a, units/s^2
+    float comfortDecel{3.0f};  // b, units/s^2
+    float minGap{0.6f};        // s0, bumper to bumper at standstill
+    float headway{0.8f};       // T, seconds
+    float vehicleLength{1.1f}; // matches the Vehicle::draw footprint
+};
+
+// A free road is passed as a gap this large
+const float IDM_FREE_GAP = 1.0e6f;
+
+// accel[i] from own speed v, desired speed v0 (> 0), bumper gap to the leader and closing speed
+// dv = v - vLeader. Exponent delta is fixed at 4.
+void idmAccelerate(const IdmParams& p, int n, const float* v, const float* v0, const float* gap,
+                   const float* dv, float* accel);
+void idmAccelerateScalar(const IdmParams& p, int n, const float* v, const float* v0, const float* gap,
+                         const float* dv, float* accel);
+
+// Ballistic update: v += a * dt (never below 0), ds = distance covered, never more than the gap
+void idmAdvance(int n, float dt, const float* accel, const float* gap, float* v, float* ds);
+void idmAdvanceScalar(int n, float dt, const float* accel, const float* gap, float* v, float* ds);
+
+// "avx2", "sse" or "scalar"
+const char* idmKernelName();
+
+#endif
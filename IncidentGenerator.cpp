@@ -0,0 +1,84 @@
+#include "IncidentGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+void IncidentGenerator::setDensity(int kind, const std::vector<float>& weight) {
+    std::vector<double>& c = cumulative[kind];
+    c.resize(weight.size());
+    double sum = 0.0;
+    for (size_t t = 0; t < weight.size(); t++) {
+        sum += std::max(0.0f, weight[t]);
+        c[t] = sum;
+    }
+}
+
+void IncidentGenerator::restart() {
+    rng.seed(params.seed);
+    count = 0;
+    next = gap();
+}
+
+double IncidentGenerator::uniform() {
+    return ((double)rng() + 0.5) / 4294967296.0;
+}
+
+double IncidentGenerator::gap() {
+    if (params.perHour <= 0.0f) return std::numeric_limits<double>::infinity();
+    return -log(uniform()) * 3600.0 / params.perHour;
+}
+
+int IncidentGenerator::pickTile(int kind) {
+    const std::vector<double>& c = cumulative[kind];
+    double x = uniform() * c.back();
+    return (int)(std::upper_bound(c.begin(), c.end(), x) - c.begin());
+}
+
+void IncidentGenerator::generate(float until, std::vector<Incident>& out) {
+    float kindShare[KINDS];
+    float total = 0.0f;
+    for (int k = 0; k < KINDS; k++) {
+        kindShare[k] = !cumulative[k].empty() && cumulative[k].back() > 0.0 ? params.kindShare[k] : 0.0f;
+        total += kindShare[k];
+    }
+    for (; next < until; next += gap()) {
+        double kindDraw = uniform() * total, priorityDraw = uniform();
+        if (total <= 0.0f) continue;
+        int kind = 0;
+        for (; kind < KINDS - 1; kind++) {
+            if (kindDraw < kindShare[kind]) break;
+            kindDraw -= kindShare[kind];
+        }
+        if (kindShare[kind] <= 0.0f) continue; // rounding past the last kind with a share
+        int priority = 0;
+        for (; priority < PRIORITIES - 1; priority++) {
+            if (priorityDraw < params.priorityShare[priority]) break;
+            priorityDraw -= params.priorityShare[priority];
+        }
+        out.push_back({ (float)next, kind, pickTile(kind), priority });
+        count++;
+    }
+}
+
+void IncidentGenerator::save(SnapshotWriter& w) const {
+    std::ostringstream state;
+    state << rng;
+    w.value("incidents.params", params);
+    for (int k = 0; k < KINDS; k++) w.array(("incidents.density." + std::to_string(k)).c_str(), cumulative[k]);
+    w.value("incidents.next", next);
+    w.value("incidents.count", count);
+    w.text("incidents.rng", state.str());
+}
+
+bool IncidentGenerator::load(const SnapshotReader& r) {
+    std::string state;
+    if (!r.value("incidents.params", params) || !r.value("incidents.next", next) ||
+        !r.value("incidents.count", count) || !r.text("incidents.rng", state)) return false;
+    for (int k = 0; k < KINDS; k++) {
+        if (!r.array(("incidents.density." + std::to_string(k)).c_str(), cumulative[k])) return false;
+    }
+    std::istringstream in(state);
+    in >> rng;
+    return !in.fail();
+}
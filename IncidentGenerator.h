@@ -0,0 +1,68 @@
+#ifndef INCIDENTGENERATOR_H
+#define INCIDENTGENERATOR_H
+
+#include "Snapshot.h"
+#include <vector>
+#include <random>
+#include <cstdint>
+
+// Random incidents for long runs and load tests. Incidents arrive as a Poisson process at a set
+// rate; the kind and priority of each are drawn from fixed shares and its tile from a density map
+// per kind, so incidents happen where the city puts them (around schools, offices, restaurants)
+// instead of evenly everywhere. All draws come from one seeded mt19937 through arithmetic of our
+// own rather than the std distributions, so a seed gives the same incidents with any library.
+class IncidentGenerator {
+public:
+    static const int KINDS = 3;      // as Dispatch::Kind
+    static const int PRIORITIES = 3; // 0 is the most urgent
+
+    struct Params {
+        float perHour{60.0f};
+        float kindShare[KINDS]{ 0.5f, 0.2f, 0.3f };          // ambulance, fire, police
+        float priorityShare[PRIORITIES]{ 0.2f, 0.3f, 0.5f };
+        uint32_t seed{1};
+    };
+    struct Incident {
+        float time;
+        int kind;
+        int tile;
+        int priority;
+    };
+
+    IncidentGenerator() { restart(); }
+    explicit IncidentGenerator(const Params& p) : params(p) { restart(); }
+
+    // Relative chance per tile that an incident of a kind happens there. Tiles of weight 0 get
+    // none, and a kind with no weight anywhere gets no incidents.
+    void setDensity(int kind, const std::vector<float>& weight);
+    // Takes effect from the next arrival
+    void setRate(float perHour) { params.perHour = perHour; }
+    float rate() const { return params.perHour; }
+    // Starts over with the first incident of another seed; densities are kept
+    void setSeed(uint32_t seed) { params.seed = seed; restart(); }
+
+    // Appends the incidents up to `until` seconds, in time order
+    void generate(float until, std::vector<Incident>& out);
+    // Back to the first incident of the seed; densities are kept
+    void restart();
+
+    uint64_t generated() const { return count; }
+
+    // Sections incidents.*: params, densities, the next arrival and the generator's state, so a
+    // restored stream goes on with the incidents the saved one would have produced
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r);
+
+private:
+    Params params;
+    std::mt19937 rng;
+    std::vector<double> cumulative[KINDS]; // running sum of the weights up to each tile
+    double next{0.0};                      // time of the next arrival
+    uint64_t count{0};
+
+    double uniform(); // in (0, 1)
+    double gap();
+    int pickTile(int kind);
+};
+
+#endif
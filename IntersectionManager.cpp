@@ -0,0 +1,125 @@
+#include "IntersectionManager.h"
+#include <cmath>
+#include <algorithm>
+
+// Swept paths in a 4x4 tile centred on the origin (y grows south), right-hand traffic
+static void samplePath(int heading, int exitDir, float out[][2], int samples) {
+    static const float dx[4] = { 0, 1, 0, -1 }, dy[4] = { -1, 0, 1, 0 };
+    const float half = 2.0f, lane = 0.6f;
+    auto rx = [](int d) { return -dy[d]; };
+    auto ry = [](int d) { return dx[d]; };
+
+    float ax = -dx[heading] * half + rx(heading) * lane, ay = -dy[heading] * half + ry(heading) * lane;
+    float bx = dx[exitDir] * half + rx(exitDir) * lane, by = dy[exitDir] * half + ry(exitDir) * lane;
+    float cx, cy;
+    if (exitDir == heading) { cx = (ax + bx) * 0.5f; cy = (ay + by) * 0.5f; }
+    else if (exitDir == ((heading + 2) & 3)) { cx = 0.0f; cy = 0.0f; }
+    else { cx = (rx(heading) + rx(exitDir)) * lane; cy = (ry(heading) + ry(exitDir)) * lane; }
+
+    for (int i = 0; i < samples; i++) {
+        float t = (float)i / (samples - 1), u = 1.0f - t;
+        out[i][0] = u * u * ax + 2 * u * t * cx + t * t * bx;
+        out[i][1] = u * u * ay + 2 * u * t * cy + t * t * by;
+    }
+}
+
+const uint16_t* IntersectionManager::conflictTable() {
+    static uint16_t table[MOVEMENTS];
+    static bool built = false;
+    if (built) return table;
+
+    const int S = 16;
+    const float clearance = 0.75f; // car width plus a margin
+    float path[MOVEMENTS][S][2];
+    for (int m = 0; m < MOVEMENTS; m++) samplePath(m / 4, m % 4, path[m], S);
+
+    for (int a = 0; a < MOVEMENTS; a++) {
+        table[a] = 0;
+        for (int b = 0; b < MOVEMENTS; b++) {
+            // Cars from the same approach queue behind each other; car following handles them
+            if (a / 4 == b / 4) continue;
+            bool hit = false;
+            for (int i = 0; i < S && !hit; i++)
+                for (int j = 0; j < S && !hit; j++) {
+                    float ddx = path[a][i][0] - path[b][j][0], ddy = path[a][i][1] - path[b][j][1];
+                    hit = ddx * ddx + ddy * ddy < clearance * clearance;
+                }
+            if (hit) table[a] |= (uint16_t)(1u << b);
+        }
+    }
+    built = true;
+    return table;
+}
+
+IntersectionManager::IntersectionManager(int tileCount) {
+    slot.assign(tileCount, -1);
+    conflictTable();
+}
+
+void IntersectionManager::addJunction(int tile) {
+    if (slot[tile] >= 0) return;
+    slot[tile] = (int)boxes.size();
+    Box b;
+    std::fill(b.busyUntil, b.busyUntil + MOVEMENTS, -1.0f);
+    boxes.push_back(b);
+}
+
+void IntersectionManager::setApproachOpen(int tile, int heading, bool open) {
+    if (slot[tile] < 0) return;
+    Box& b = boxes[slot[tile]];
+    uint16_t approach = (uint16_t)(0xFu << (heading * 4));
+    if (open) b.openMask |= approach;
+    else b.openMask &= (uint16_t)~approach;
+}
+
+bool IntersectionManager::isApproachOpen(int tile, int heading) const {
+    return slot[tile] < 0 || (boxes[slot[tile]].openMask >> (heading * 4) & 0xFu) != 0;
+}
+
+void IntersectionManager::setOpenMovements(int tile, uint16_t movements) {
+    if (slot[tile] >= 0) boxes[slot[tile]].openMask = movements;
+}
+
+uint16_t IntersectionManager::openMovements(int tile) const {
+    return slot[tile] >= 0 ? boxes[slot[tile]].openMask : (uint16_t)0xFFFF;
+}
+
+bool IntersectionManager::request(int tile, int movement, float enterTime, float leaveTime) {
+    if (slot[tile] < 0) return true;
+    Box& b = boxes[slot[tile]];
+    if (!(b.openMask >> movement & 1u)) { refused++; return false; }
+
+    // Branch-free: one bit per movement still busy at enterTime, masked by the conflict row
+    uint32_t busy = 0;
+    for (int m = 0; m < MOVEMENTS; m++) busy |= (uint32_t)(b.busyUntil[m] > enterTime) << m;
+    if (busy & conflictTable()[movement]) { refused++; return false; }
+    b.busyUntil[movement] = std::max(b.busyUntil[movement], leaveTime);
+    b.granted++;
+    granted++;
+    return true;
+}
+
+void IntersectionManager::hold(int tile, int movement, float until) {
+    if (slot[tile] < 0) return;
+    float& t = boxes[slot[tile]].busyUntil[movement];
+    t = std::max(t, until);
+}
+
+void IntersectionManager::save(SnapshotWriter& w) const {
+    uint64_t totals[2] = { granted, refused };
+    w.array("junctions.slot", slot);
+    w.array("junctions.boxes", boxes);
+    w.array("junctions.totals", totals, 2);
+}
+
+bool IntersectionManager::load(const SnapshotReader& r) {
+    std::vector<int> s;
+    std::vector<Box> b;
+    std::vector<uint64_t> totals;
+    if (!r.array("junctions.slot", s) || !r.array("junctions.boxes", b) || !r.array("junctions.totals", totals)) return false;
+    if (s != slot || b.size() != boxes.size() || totals.size() != 2) return false;
+    boxes.swap(b);
+    granted = totals[0];
+    refused = totals[1];
+    return true;
+}
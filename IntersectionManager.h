@@ -0,0 +1,62 @@
+#ifndef INTERSECTIONMANAGER_H
+#define INTERSECTIONMANAGER_H
+
+#include "Snapshot.h"
+#include <vector>
+#include <cstdint>
+
+// Space-time reservations through junction tiles. A movement is (entry heading, exit direction),
+// with headings numbered like RoadDir; each pair of movements whose swept paths through the tile
+// cross or merge is marked in a static conflict table. A car asks for [enter, leave) on its
+// movement before reaching the stop line and only drives in once granted; the check reads one
+// conflict mask and the busy-until times of the movements in it, so it is O(1).
+// Signals sit on top: a movement that is closed (red) is never granted.
+class IntersectionManager {
+public:
+    static const int MOVEMENTS = 16;
+
+    explicit IntersectionManager(int tileCount);
+
+    void addJunction(int tile);
+    bool isJunction(int tile) const { return slot[tile] >= 0; }
+    int junctionCount() const { return (int)boxes.size(); }
+
+    static int movementOf(int heading, int exitDir) { return heading * 4 + exitDir; }
+    static uint16_t conflicts(int movement) { return conflictTable()[movement]; }
+
+    // Whole approaches (all movements entering with `heading`) or single movements, one bit each
+    void setApproachOpen(int tile, int heading, bool open);
+    bool isApproachOpen(int tile, int heading) const;
+    void setOpenMovements(int tile, uint16_t movements);
+    uint16_t openMovements(int tile) const;
+
+    // Grants the slot if the approach is open and no conflicting movement is busy by enterTime
+    bool request(int tile, int movement, float enterTime, float leaveTime);
+    // A car still inside the box keeps its movement busy (it may be slower than it promised)
+    void hold(int tile, int movement, float until);
+
+    uint32_t crossings(int tile) const { return slot[tile] >= 0 ? boxes[slot[tile]].granted : 0; }
+    uint64_t grantedTotal() const { return granted; }
+    uint64_t refusedTotal() const { return refused; }
+
+    // Sections junctions.*: the reservations and signal masks, on the same junction tiles
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r);
+
+private:
+    struct Box {
+        float busyUntil[MOVEMENTS];
+        uint16_t openMask{0xFFFF}; // bit per movement
+        uint16_t pad{0};
+        uint32_t granted{0};
+    };
+
+    std::vector<int> slot;  // per tile, index into boxes or -1
+    std::vector<Box> boxes;
+    uint64_t granted{0};
+    uint64_t refused{0};
+
+    static const uint16_t* conflictTable();
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "LaneOccupancy.h"
+
+LaneOccupancy::LaneOccupancy(int laneCount, int vehicleCount) {
+    laneHead.assign(laneCount, -1);
+    laneTail.assign(laneCount, -1);
+    this->laneCount.assign(laneCount, 0);
+    resize(vehicleCount);
+}
+
+void LaneOccupancy::resize(int vehicleCount) {
+    for (int id = vehicleCount; id < (int)lane.size(); id++) leave(id);
+    lane.resize(vehicleCount, -1);
+    prevId.resize(vehicleCount, -1);
+    nextId.resize(vehicleCount, -1);
+    pos.resize(vehicleCount, 0.0f);
+}
+
+void LaneOccupancy::unlink(int id) {
+    int l = lane[id];
+    if (prevId[id] >= 0) nextId[prevId[id]] = nextId[id]; else laneHead[l] = nextId[id];
+    if (nextId[id] >= 0) prevId[nextId[id]] = prevId[id]; else laneTail[l] = prevId[id];
+    prevId[id] = nextId[id] = -1;
+    laneCount[l]--;
+}
+
+void LaneOccupancy::link(int id) {
+    // New arrivals are almost always the last car, so walk forward from the tail
+    int l = lane[id];
+    int ahead = laneTail[l];
+    while (ahead >= 0 && pos[ahead] < pos[id]) ahead = prevId[ahead];
+    int behind = (ahead >= 0) ? nextId[ahead] : laneHead[l];
+
+    prevId[id] = ahead;
+    nextId[id] = behind;
+    if (ahead >= 0) nextId[ahead] = id; else laneHead[l] = id;
+    if (behind >= 0) prevId[behind] = id; else laneTail[l] = id;
+    laneCount[l]++;
+}
+
+void LaneOccupancy::enter(int id, int l, float p) {
+    if (lane[id] >= 0) unlink(id);
+    lane[id] = l;
+    pos[id] = p;
+    if (l >= 0) link(id);
+}
+
+void LaneOccupancy::leave(int id) {
+    enter(id, -1, 0.0f);
+}
+
+void LaneOccupancy::setPosition(int id, float p) {
+    pos[id] = p;
+    if (lane[id] < 0) return;
+    bool passed = prevId[id] >= 0 && pos[prevId[id]] < p;
+    bool fellBack = nextId[id] >= 0 && pos[nextId[id]] > p;
+    if (passed || fellBack) {
+        unlink(id);
+        link(id);
+    }
+}
+
+void LaneOccupancy::save(SnapshotWriter& w) const {
+    w.array("lanes.head", laneHead);
+    w.array("lanes.tail", laneTail);
+    w.array("lanes.count", laneCount);
+    w.array("lanes.lane", lane);
+    w.array("lanes.prev", prevId);
+    w.array("lanes.next", nextId);
+    w.array("lanes.pos", pos);
+}
+
+bool LaneOccupancy::load(const SnapshotReader& r) {
+    LaneOccupancy o(0, 0);
+    if (!r.array("lanes.head", o.laneHead) || !r.array("lanes.tail", o.laneTail) || !r.array("lanes.count", o.laneCount) ||
+        !r.array("lanes.lane", o.lane) || !r.array("lanes.prev", o.prevId) || !r.array("lanes.next", o.nextId) ||
+        !r.array("lanes.pos", o.pos)) return false;
+    size_t lanes = laneHead.size(), cars = lane.size();
+    if (o.laneHead.size() != lanes || o.lane.size() != cars) return false;
+    if (o.laneTail.size() != lanes || o.laneCount.size() != lanes || o.prevId.size() != cars ||
+        o.nextId.size() != cars || o.pos.size() != cars) return false;
+
+    // Walk every list, so a bad index fails here instead of on the next tick
+    int listed = 0;
+    for (size_t l = 0; l < lanes; l++) {
+        int count = 0, prev = -1;
+        for (int id = o.laneHead[l]; id != -1; prev = id, id = o.nextId[id]) {
+            if (id < 0 || id >= (int)cars || o.lane[id] != (int)l || o.prevId[id] != prev || ++count > (int)cars) return false;
+        }
+        if (o.laneTail[l] != prev || o.laneCount[l] != count) return false;
+        listed += count;
+    }
+    int placed = 0;
+    for (size_t id = 0; id < cars; id++) {
+        if (o.lane[id] < -1 || o.lane[id] >= (int)lanes) return false;
+        if (o.lane[id] >= 0) placed++;
+        else if (o.prevId[id] != -1 || o.nextId[id] != -1) return false;
+    }
+    if (listed != placed) return false;
+    *this = std::move(o);
+    return true;
+}
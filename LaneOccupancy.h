@@ -0,0 +1,51 @@
+#ifndef LANEOCCUPANCY_H
+#define LANEOCCUPANCY_H
+
+#include "Snapshot.h"
+#include <vector>
+#include <cstdint>
+
+// Which vehicles are on each road graph lane (RoadGraph lane state: tile * 4 + heading), kept as
+// an intrusive doubly linked list per lane ordered by distance driven in the lane, head first.
+// The leader and follower of a car are one link away; storage is two ints and a count per lane.
+class LaneOccupancy {
+public:
+    LaneOccupancy(int laneCount, int vehicleCount);
+    void resize(int vehicleCount);
+
+    // Moves a vehicle onto a lane (leaving its previous one) at `pos` units into it
+    void enter(int id, int lane, float pos);
+    void leave(int id);
+    // Progress within the current lane; re-links the car only if it passed a neighbour
+    void setPosition(int id, float pos);
+
+    int laneOf(int id) const { return lane[id]; }
+    float position(int id) const { return pos[id]; }
+    int leader(int id) const { return prevId[id]; }   // -1 when first in the lane
+    int follower(int id) const { return nextId[id]; } // -1 when last
+    int head(int l) const { return laneHead[l]; }     // furthest along
+    int tail(int l) const { return laneTail[l]; }     // just entered
+    int count(int l) const { return laneCount[l]; }
+    int lanes() const { return (int)laneHead.size(); }
+    int vehicles() const { return (int)lane.size(); }
+
+    // Sections lanes.*, the lists as they are, so cars level in a lane keep their order. Loads
+    // into an index made for the same number of lanes and vehicles, and only lists that hold
+    // together: every link in range and both ways round, each car on the lane it is listed in.
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r);
+
+private:
+    std::vector<int> laneHead;
+    std::vector<int> laneTail;
+    std::vector<uint16_t> laneCount;
+    std::vector<int> lane;
+    std::vector<int> prevId;
+    std::vector<int> nextId;
+    std::vector<float> pos;
+
+    void unlink(int id);
+    void link(int id);
+};
+
+#endif
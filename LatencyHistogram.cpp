@@ -0,0 +1,69 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+int LatencyHistogram::indexOf(uint64_t ms) {
+    if (ms < SUB_COUNT) return (int)ms;
+    int shift = 0;
+    while ((ms >> shift) >= SUB_COUNT) shift++; // top SUB_BITS bits of ms are kept
+    return (int)(SUB_COUNT + (shift - 1) * HALF_COUNT + ((ms >> shift) - HALF_COUNT));
+}
+
+uint64_t LatencyHistogram::highestOf(int index) {
+    if (index < (int)SUB_COUNT) return (uint64_t)index;
+    uint64_t k = (uint64_t)index - SUB_COUNT;
+    int shift = (int)(k / HALF_COUNT) + 1;
+    uint64_t lowest = (k % HALF_COUNT + HALF_COUNT) << shift;
+    return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+void LatencyHistogram::record(float seconds) {
+    uint64_t ms = seconds > 0.0f ? (uint64_t)llround(seconds * 1000.0) : 0;
+    int i = indexOf(ms);
+    if (i >= (int)counts.size()) counts.resize(i + 1, 0);
+    counts[i]++;
+    total++;
+    sum += seconds > 0.0f ? seconds : 0.0f;
+    maxValue = std::max(maxValue, ms);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& o) {
+    if (o.counts.size() > counts.size()) counts.resize(o.counts.size(), 0);
+    for (size_t i = 0; i < o.counts.size(); i++) counts[i] += o.counts[i];
+    total += o.total;
+    sum += o.sum;
+    maxValue = std::max(maxValue, o.maxValue);
+}
+
+void LatencyHistogram::clear() {
+    counts.clear();
+    total = 0;
+    maxValue = 0;
+    sum = 0.0;
+}
+
+float LatencyHistogram::percentile(float percent) const {
+    if (total == 0) return 0.0f;
+    uint64_t rank = (uint64_t)ceil(percent * 0.01 * total);
+    rank = std::min(std::max(rank, (uint64_t)1), total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) return std::min(highestOf((int)i), maxValue) * 0.001f;
+    }
+    return max();
+}
+
+void LatencyHistogram::save(SnapshotWriter& w, const std::string& name) const {
+    w.array((name + ".counts").c_str(), counts);
+    w.value((name + ".totals").c_str(), Totals{ total, maxValue, sum });
+}
+
+bool LatencyHistogram::load(const SnapshotReader& r, const std::string& name) {
+    Totals t;
+    if (!r.array((name + ".counts").c_str(), counts) || !r.value((name + ".totals").c_str(), t)) return false;
+    total = t.total;
+    maxValue = t.maxValue;
+    sum = t.sum;
+    return true;
+}
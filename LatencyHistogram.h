@@ -0,0 +1,43 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include "Snapshot.h"
+#include <vector>
+#include <cstdint>
+
+// Durations in seconds counted in log-linear buckets, the way HdrHistogram does it: whole
+// milliseconds up to 256 ms, then 128 buckets per doubling, so any percentile is read back within
+// 1% of the value recorded, whatever the range, at a fixed cost per record and a few KB each.
+class LatencyHistogram {
+public:
+    void record(float seconds);
+    void merge(const LatencyHistogram& o);
+    void clear();
+
+    uint64_t count() const { return total; }
+    // Smallest value at least `percent` of the recorded ones are at or below; 0 when empty
+    float percentile(float percent) const;
+    float mean() const { return total ? (float)(sum / total) : 0.0f; }
+    float max() const { return maxValue * 0.001f; }
+
+    // Sections `name`.counts and `name`.totals
+    void save(SnapshotWriter& w, const std::string& name) const;
+    bool load(const SnapshotReader& r, const std::string& name);
+
+private:
+    static const int SUB_BITS = 8;
+    static const uint64_t SUB_COUNT = 1u << SUB_BITS;       // exact buckets below this many ms
+    static const uint64_t HALF_COUNT = SUB_COUNT / 2;       // buckets per doubling above them
+
+    std::vector<uint64_t> counts; // per bucket, grown on demand
+    uint64_t total{0};
+    uint64_t maxValue{0};         // ms
+    double sum{0.0};              // seconds
+
+    struct Totals { uint64_t total, maxValue; double sum; };
+
+    static int indexOf(uint64_t ms);
+    static uint64_t highestOf(int index); // largest ms in a bucket
+};
+
+#endif
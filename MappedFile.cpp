@@ -0,0 +1,83 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+bool MappedFile::open(const char* path) {
+    close();
+    HANDLE h = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    file = h;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(h, &size)) {
+        close();
+        return false;
+    }
+    length = (uint64_t)size.QuadPart;
+    return map();
+}
+
+bool MappedFile::map() {
+    if (length == 0) { // nothing to map; an empty mapping can't be created
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA((HANDLE)file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) base = (const uint8_t*)MapViewOfFile((HANDLE)mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if (base) UnmapViewOfFile((LPCVOID)base);
+    if (mapping) CloseHandle((HANDLE)mapping);
+    if (file) CloseHandle((HANDLE)file);
+    base = nullptr;
+    mapping = nullptr;
+    file = nullptr;
+    length = 0;
+}
+
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+bool MappedFile::open(const char* path) {
+    close();
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    length = (uint64_t)st.st_size;
+    return map();
+}
+
+bool MappedFile::map() {
+    void* p = length ? mmap(nullptr, (size_t)length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    base = (const uint8_t*)p;
+    return true;
+}
+
+void MappedFile::close() {
+    if (base) munmap((void*)base, (size_t)length);
+    if (fd >= 0) ::close(fd);
+    base = nullptr;
+    fd = -1;
+    length = 0;
+}
+
+#endif
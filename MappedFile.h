@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstdint>
+#include <cstddef>
+
+// A file mapped into memory. Pages are read in by the OS as they are touched, so a query that
+// looks at a few KB of a multi-GB file reads a few KB, and pages stay cached between queries.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Read only
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const { return base != nullptr; }
+    const uint8_t* data() const { return base; }
+    uint64_t size() const { return length; }
+
+private:
+    const uint8_t* base{nullptr};
+    uint64_t length{0};
+#ifdef _WIN32
+    void* file{nullptr};    // HANDLE
+    void* mapping{nullptr}; // HANDLE
+#else
+    int fd{-1};
+#endif
+
+    bool map();
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "PreemptionArbiter.h"
+#include <algorithm>
+#include <limits>
+
+void PreemptionArbiter::request(int c, int vehicle, uint16_t movements, int severity, float now, float from, float until) {
+    if (c >= (int)junctions.size()) junctions.resize(c + 1);
+    Junction& j = junctions[c];
+    if (!params.arbitrate) {
+        // The last request wins; a vehicle only withdraws its own
+        if (until <= from && j.owner != vehicle) return;
+        j.owner = vehicle;
+        signals.preemptWindow(c, movements, now, from, until);
+        return;
+    }
+    auto it = std::find_if(j.requests.begin(), j.requests.end(), [&](const Request& r) { return r.vehicle == vehicle; });
+    if (until <= from) {
+        if (it == j.requests.end()) return;
+        j.requests.erase(it);
+    } else if (it != j.requests.end()) {
+        it->movements = movements;
+        it->severity = severity;
+        it->from = from;
+        it->until = until;
+    } else {
+        float never = std::numeric_limits<float>::infinity();
+        j.requests.push_back({ vehicle, movements, 0, severity, from, until, never, never });
+    }
+    grant(c, j, now);
+    if (j.requests.size() > 1 && !j.contested) {
+        j.contested = true;
+        contested.push_back(c);
+    }
+}
+
+void PreemptionArbiter::grant(int c, Junction& j, float now) {
+    j.requests.erase(std::remove_if(j.requests.begin(), j.requests.end(),
+                                    [&](const Request& r) { return r.until <= now && r.grantUntil <= now; }),
+                     j.requests.end());
+
+    // Windows already open keep the junction; the rest queue by arrival and severity
+    auto key = [&](const Request& r) { return r.from + r.severity * params.severityWeight; };
+    std::sort(j.requests.begin(), j.requests.end(), [&](const Request& a, const Request& b) {
+        bool aOpen = a.grantFrom <= now, bOpen = b.grantFrom <= now;
+        if (aOpen != bOpen) return aOpen;
+        if (key(a) != key(b)) return key(a) < key(b);
+        return a.vehicle < b.vehicle;
+    });
+
+    // Between two windows the junction clears at least as long as the controller needs to
+    float gap = std::max(params.clearance, signals.clearanceTime(c));
+    float lastFrom = -std::numeric_limits<float>::infinity(), lastEnd = lastFrom;
+    uint16_t lastMovements = 0;
+    for (Request& r : j.requests) {
+        float start;
+        if (r.grantFrom <= now) start = r.grantFrom;
+        else if (r.movements == lastMovements) start = std::max(r.from, lastFrom); // same way through: share
+        else start = std::max(r.from, lastEnd + gap);
+        // The controller's green comes late when the lights showing now can't clear in time
+        if (&r == &j.requests[0] && r.grantFrom > now) start = signals.greenFrom(c, r.movements, now, start);
+        r.grantFrom = start;
+        r.grantUntil = r.until + std::max(0.0f, start - r.from);
+        lastFrom = start;
+        lastEnd = std::max(lastEnd, r.grantUntil);
+        lastMovements = r.movements;
+    }
+
+    // The controller gets the first window, widened by the requests sharing it
+    if (j.requests.empty()) {
+        signals.preemptWindow(c, 0, now, now, now);
+        j.windowUntil = now;
+        return;
+    }
+    const Request& first = j.requests[0];
+    float until = first.grantUntil;
+    for (size_t k = 1; k < j.requests.size() && j.requests[k].movements == first.movements; k++)
+        until = std::max(until, j.requests[k].grantUntil);
+    signals.preemptWindow(c, first.movements, now, first.grantFrom, until);
+    j.windowUntil = until;
+}
+
+void PreemptionArbiter::update(float now) {
+    for (size_t k = 0; k < contested.size();) {
+        int c = contested[k];
+        Junction& j = junctions[c];
+        if (j.windowUntil <= now) grant(c, j, now);
+        if (j.requests.size() > 1) {
+            k++;
+            continue;
+        }
+        j.contested = false;
+        contested[k] = contested.back();
+        contested.pop_back();
+    }
+}
+
+bool PreemptionArbiter::mustWait(int c, int vehicle, float now) const {
+    if (!params.arbitrate || c >= (int)junctions.size()) return false;
+    const Junction& j = junctions[c];
+    const Request* own = nullptr;
+    for (const Request& r : j.requests) if (r.vehicle == vehicle) own = &r;
+    for (const Request& r : j.requests) {
+        if (&r == own || (own && r.movements == own->movements)) continue;
+        if (now >= r.grantFrom && now < r.grantUntil + params.clearance) return true;
+    }
+    return own && own->grantFrom > own->from && now < own->grantFrom;
+}
+
+void PreemptionArbiter::save(SnapshotWriter& w) const {
+    std::vector<Stored> stored;
+    std::vector<Request> requests;
+    for (const Junction& j : junctions) {
+        stored.push_back({ requests.size(), j.requests.size(), j.windowUntil, j.owner, (uint8_t)j.contested });
+        requests.insert(requests.end(), j.requests.begin(), j.requests.end());
+    }
+    w.array("arbiter.junctions", stored);
+    w.array("arbiter.requests", requests);
+    w.array("arbiter.contested", contested);
+}
+
+bool PreemptionArbiter::load(const SnapshotReader& r) {
+    std::vector<Stored> stored;
+    std::vector<Request> requests;
+    if (!r.array("arbiter.junctions", stored) || !r.array("arbiter.requests", requests) ||
+        !r.array("arbiter.contested", contested)) return false;
+    // Junctions are the scheduler's controllers, so there can't be more of them
+    if (stored.size() > (size_t)signals.count()) return false;
+    for (int c : contested) if (c < 0 || c >= (int)stored.size()) return false;
+    junctions.assign(stored.size(), Junction());
+    for (size_t c = 0; c < stored.size(); c++) {
+        const Stored& s = stored[c];
+        if (s.begin > requests.size() || s.count > requests.size() - s.begin) return false;
+        junctions[c].requests.assign(requests.begin() + s.begin, requests.begin() + s.begin + s.count);
+        junctions[c].windowUntil = s.windowUntil;
+        junctions[c].owner = s.owner;
+        junctions[c].contested = s.contested != 0;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef PREEMPTIONARBITER_H
+#define PREEMPTIONARBITER_H
+
+#include "SignalScheduler.h"
+#include <vector>
+#include <cstdint>
+
+// Shares signal preemption between emergency vehicles. A controller holds one preemption window
+// at a time, so two vehicles asking for crossing approaches of the same junction would otherwise
+// overwrite each other's window and both drive in expecting the green. Vehicles request their
+// windows here instead; per junction they are ranked by arrival (the window's start) with
+// `severityWeight` seconds taken off per level of urgency, and granted one after another with
+// `clearance` seconds between them, or the controller's clearance time if that is longer. A vehicle
+// whose window was pushed back, by another vehicle or by the lights still clearing, waits at the
+// stop line until it starts. Requests for the same movements share one window. A window that has
+// started is never taken back, so the vehicle in the junction is never cut off, and since each
+// window is bounded a vehicle waits at most for the windows ranked ahead of it.
+class PreemptionArbiter {
+public:
+    struct Params {
+        float clearance{1.0f};      // seconds between the windows of two vehicles
+        float severityWeight{4.0f}; // seconds of arrival one level of severity is worth
+        bool arbitrate{true};       // false: every request goes straight to the controller
+    };
+
+    explicit PreemptionArbiter(SignalScheduler& s) : signals(s) {}
+    PreemptionArbiter(SignalScheduler& s, const Params& p) : signals(s), params(p) {}
+
+    // Window [from, until) for `vehicle`'s `movements` at controller c, replacing its earlier one
+    // there. Severity 0 is the most urgent. An empty window withdraws the request.
+    void request(int c, int vehicle, uint16_t movements, int severity, float now, float from, float until);
+    // Hands contested junctions on to the next vehicle once a window has run out
+    void update(float now);
+    // The vehicle has to wait before entering: another vehicle's window is open, or its own was
+    // pushed back and hasn't started
+    bool mustWait(int c, int vehicle, float now) const;
+
+    // Junctions more than one vehicle has asked for
+    int contestedCount() const { return (int)contested.size(); }
+    // Trades requests and grants with `other` (one loaded on the side, say); each keeps its
+    // scheduler and params
+    void swap(PreemptionArbiter& other) {
+        junctions.swap(other.junctions);
+        contested.swap(other.contested);
+    }
+
+    // Sections arbiter.*: the requests and grants per junction; the controllers are saved with
+    // the SignalScheduler
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r);
+
+private:
+    struct Request {
+        int vehicle;
+        uint16_t movements;
+        uint16_t pad; // zero, so equal requests save to equal bytes
+        int severity;
+        float from, until;           // as requested
+        float grantFrom, grantUntil; // as granted
+    };
+    struct Junction {
+        std::vector<Request> requests; // in grant order
+        float windowUntil{0.0f};       // end of the window given to the controller
+        bool contested{false};
+        int owner{-1};                 // vehicle that asked last, when not arbitrating
+    };
+
+    struct Stored { uint64_t begin, count; float windowUntil; int owner; uint8_t contested, pad[7]; }; // a junction as saved
+
+    SignalScheduler& signals;
+    Params params;
+    std::vector<Junction> junctions; // per controller, grown on demand
+    std::vector<int> contested;      // controllers with more than one request
+
+    void grant(int c, Junction& j, float now);
+};
+
+#endif
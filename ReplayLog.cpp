@@ -0,0 +1,88 @@
+#include "ReplayLog.h"
+#include <algorithm>
+
+void ReplayLog::clear() {
+    runs.clear();
+    runEnd.clear();
+    commands.clear();
+    keys.clear();
+    data.clear();
+    tickCount = 0;
+}
+
+void ReplayLog::command(int type, int a, int b) {
+    commands.push_back({ tickCount, type, a, b });
+}
+
+void ReplayLog::keyframe(std::vector<uint8_t>&& snapshot) {
+    if (!keys.empty() && keys.back().tick == tickCount) { // taken again for the same tick: keep the last
+        data.resize((size_t)keys.back().offset);
+        keys.pop_back();
+    }
+    keys.push_back({ tickCount, data.size(), snapshot.size() });
+    data.insert(data.end(), snapshot.begin(), snapshot.end());
+}
+
+void ReplayLog::step(float dt) {
+    // Bitwise equal, so a run never merges steps that only compare equal (0 and -0)
+    if (!runs.empty() && memcmp(&runs.back().dt, &dt, sizeof(dt)) == 0 && runs.back().count < UINT32_MAX) {
+        runs.back().count++;
+        runEnd.back()++;
+    } else {
+        runs.push_back({ dt, 1 });
+        runEnd.push_back(tickCount + 1);
+    }
+    tickCount++;
+}
+
+float ReplayLog::stepAt(uint64_t t) const {
+    size_t k = std::upper_bound(runEnd.begin(), runEnd.end(), t) - runEnd.begin();
+    return k < runs.size() ? runs[k].dt : 0.0f;
+}
+
+void ReplayLog::commandsAt(uint64_t t, const Command*& first, const Command*& last) const {
+    auto lo = std::lower_bound(commands.begin(), commands.end(), t, [](const Command& c, uint64_t v) { return c.tick < v; });
+    auto hi = std::upper_bound(lo, commands.end(), t, [](uint64_t v, const Command& c) { return v < c.tick; });
+    first = commands.data() + (lo - commands.begin());
+    last = commands.data() + (hi - commands.begin());
+}
+
+int ReplayLog::keyframeBefore(uint64_t t) const {
+    auto it = std::upper_bound(keys.begin(), keys.end(), t, [](uint64_t v, const Key& k) { return v < k.tick; });
+    return (int)(it - keys.begin()) - 1;
+}
+
+bool ReplayLog::openKeyframe(int k, SnapshotReader& r) const {
+    if (k < 0 || k >= (int)keys.size()) return false;
+    const Key& key = keys[k];
+    return r.open(std::vector<uint8_t>(data.begin() + key.offset, data.begin() + key.offset + key.size));
+}
+
+uint64_t ReplayLog::bytes() const {
+    return runs.size() * sizeof(Run) + commands.size() * sizeof(Command) + keys.size() * sizeof(Key) + data.size();
+}
+
+bool ReplayLog::save(const char* path) const {
+    SnapshotWriter w;
+    if (!w.open(path)) return false;
+    w.value("replay.ticks", tickCount);
+    w.array("replay.steps", runs);
+    w.array("replay.commands", commands);
+    w.array("replay.keyframes", keys);
+    w.array("replay.data", data);
+    return w.close();
+}
+
+bool ReplayLog::load(const char* path) {
+    SnapshotReader r;
+    ReplayLog log;
+    if (!r.open(path) || !r.value("replay.ticks", log.tickCount) || !r.array("replay.steps", log.runs) ||
+        !r.array("replay.commands", log.commands) || !r.array("replay.keyframes", log.keys) ||
+        !r.array("replay.data", log.data)) return false;
+    uint64_t end = 0;
+    for (const Run& run : log.runs) log.runEnd.push_back(end += run.count);
+    if (end != log.tickCount) return false;
+    for (const Key& key : log.keys) if (key.offset + key.size > log.data.size()) return false;
+    *this = std::move(log);
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef REPLAYLOG_H
+#define REPLAYLOG_H
+
+#include "Snapshot.h"
+#include <vector>
+#include <cstdint>
+
+// A run recorded as what was done to it rather than what happened: the time step of every tick,
+// the commands given at each tick (clicks, key presses, incidents reported by hand) and, every so
+// often, a keyframe holding a snapshot of the whole state. Everything else the run does follows
+// from those, so restoring the first keyframe and feeding the same steps and commands back plays it
+// again bit for bit, and seeking restores the last keyframe before the tick and steps on from
+// there. Steps are stored as runs of equal time steps; what a command means is up to the caller.
+class ReplayLog {
+public:
+    struct Command {
+        uint64_t tick; // applied before this tick is stepped
+        int32_t type;
+        int32_t a, b;
+        int32_t pad; // zero, so equal commands save to equal bytes
+    };
+
+    void clear();
+
+    // Recording, in tick order: commands and a keyframe for the tick about to be stepped, then
+    // its time step
+    void command(int type, int a = 0, int b = 0);
+    void keyframe(std::vector<uint8_t>&& snapshot);
+    void step(float dt);
+
+    uint64_t ticks() const { return tickCount; }
+    // Time step of tick t (< ticks())
+    float stepAt(uint64_t t) const;
+    // Commands of tick t, as [first, last)
+    void commandsAt(uint64_t t, const Command*& first, const Command*& last) const;
+
+    int keyframeCount() const { return (int)keys.size(); }
+    // Last keyframe at or before tick t, -1 if there is none
+    int keyframeBefore(uint64_t t) const;
+    uint64_t keyframeTick(int k) const { return keys[k].tick; }
+    // A snapshot reader over keyframe k
+    bool openKeyframe(int k, SnapshotReader& r) const;
+
+    uint64_t bytes() const; // size of the log as saved, roughly
+    // Sections replay.*; false on a write error, or a file that isn't a whole log
+    bool save(const char* path) const;
+    bool load(const char* path);
+
+private:
+    struct Run {
+        float dt;
+        uint32_t count;
+    };
+    struct Key {
+        uint64_t tick;
+        uint64_t offset, size; // into data
+    };
+
+    std::vector<Run> runs;
+    std::vector<uint64_t> runEnd; // tick after each run, for lookups
+    std::vector<Command> commands;
+    std::vector<Key> keys;
+    std::vector<uint8_t> data;    // keyframe snapshots back to back
+    uint64_t tickCount{0};
+};
+
+#endif
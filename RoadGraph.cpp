@@ -0,0 +1,255 @@
+#include "RoadGraph.h"
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static const float TURN_RIGHT_COST = 0.3f;
+static const float TURN_LEFT_COST = 0.8f;  // crosses the oncoming lane
+static const float UTURN_COST = 2.0f;
+
+int headingOf(Vector3 dir) {
+    if (fabsf(dir.x) > fabsf(dir.z)) return dir.x > 0.0f ? DIR_E : DIR_W;
+    return dir.z > 0.0f ? DIR_S : DIR_N;
+}
+
+void RoadGraph::build(const int* tiles, int width, int height) {
+    w = width;
+    h = height;
+    type.assign(tiles, tiles + w * h);
+    flags.assign(w * h, 0);
+    bans.assign(w * h, 0);
+    changes.clear();
+    for (int i = 0; i < w * h; i++) refreshFlags(i);
+}
+
+int RoadGraph::neighbour(int tile, int d) const {
+    int ny = tile / w + dirDY(d);
+    int nx = tile % w + dirDX(d);
+    if (!inBounds(ny, nx)) return -1;
+    return id(ny, nx);
+}
+
+bool RoadGraph::isRoadType(int t, bool emergency) {
+    switch ((TileType)t) {
+        case ROAD_H: case ROAD_V: case PROAD_V:
+        case PROAD_V1: case INTERSECTION: case ROUNDABOUT:
+        case CURVERTOP: case CURVERTOP1:
+        case CURVERBOTTOM: case CURVERBOTTOM1:
+        case TROAD: case TROAD1: case ROTROAD:
+            return true; // Only roads are drivable
+        default:
+            return false;
+    }
+}
+
+float RoadGraph::speedLimit(int t, bool emergency) {
+    return 5.0f;
+}
+
+uint8_t RoadGraph::openings(int t) {
+    const uint8_t n = 1 << DIR_N, e = 1 << DIR_E, s = 1 << DIR_S, west = 1 << DIR_W;
+    switch ((TileType)t) {
+        case ROAD_H: case PROAD_V: case PROAD_V1: return e | west; // parking roads are drawn rotated
+        case ROAD_V: return n | s;
+        case INTERSECTION: case ROUNDABOUT: return n | e | s | west;
+        case CURVERTOP: return e | s;
+        case CURVERTOP1: return n | e;
+        case CURVERBOTTOM: return n | west;
+        case CURVERBOTTOM1: return s | west;
+        case TROAD: return n | e | s;
+        case TROAD1: return n | e | west;
+        case ROTROAD: return n | s | west;
+        default: return 0;
+    }
+}
+
+bool RoadGraph::isPassable(int tile, bool emergency) const {
+    return flags[tile] == FLAG_ROAD;
+}
+
+float RoadGraph::travelTime(int tile, bool emergency) const {
+    return TILE / speedLimit(type[tile], emergency);
+}
+
+bool RoadGraph::connects(int tile, int d) const {
+    int n = neighbour(tile, d);
+    if (n < 0 || !isPassable(tile, true) || !isPassable(n, true)) return false;
+    return (openings(type[tile]) >> d & 1) && (openings(type[n]) >> oppositeDir(d) & 1);
+}
+
+int RoadGraph::exitCount(int tile) const {
+    int count = 0;
+    for (int d = 0; d < 4; d++) if (connects(tile, d)) count++;
+    return count;
+}
+
+bool RoadGraph::canTurn(int tile, int heading, int exitDir) const {
+    if (!connects(tile, exitDir) || (bans[tile] >> (heading * 4 + exitDir) & 1)) return false;
+    if (exitDir != oppositeDir(heading)) return true;
+    return type[tile] == ROUNDABOUT || exitCount(tile) <= 1;
+}
+
+float RoadGraph::turnCost(int heading, int exitDir) {
+    if (exitDir == heading) return 0.0f;
+    if (exitDir == ((heading + 1) & 3)) return TURN_RIGHT_COST;
+    if (exitDir == ((heading + 3) & 3)) return TURN_LEFT_COST;
+    return UTURN_COST;
+}
+
+void RoadGraph::setTurnBanned(int y, int x, int heading, int exitDir, bool banned) {
+    if (!inBounds(y, x)) return;
+    int tile = id(y, x);
+    uint16_t bit = (uint16_t)(1u << (heading * 4 + exitDir));
+    if (banned) bans[tile] |= bit;
+    else bans[tile] &= ~bit;
+    changes.push_back(tile);
+}
+
+void RoadGraph::refreshFlags(int tile) {
+    uint8_t f = flags[tile] & FLAG_CLOSED;
+    if (isRoadType(type[tile], false)) f |= FLAG_ROAD;
+    flags[tile] = f;
+}
+
+void RoadGraph::setTile(int y, int x, int t) {
+    if (!inBounds(y, x)) return;
+    int tile = id(y, x);
+    type[tile] = (uint8_t)t;
+    refreshFlags(tile);
+    changes.push_back(tile);
+}
+
+void RoadGraph::setClosed(int y, int x, bool closed) {
+    if (!inBounds(y, x)) return;
+    int tile = id(y, x);
+    if (isClosed(tile) == closed) return;
+    if (closed) flags[tile] |= FLAG_CLOSED;
+    else flags[tile] &= ~FLAG_CLOSED;
+    changes.push_back(tile);
+}
+
+namespace {
+struct SearchNode { float f, d; int id; }; // f = d + lower bound of what is left
+struct SearchCmp { // lowest f first, and of equal ones the furthest along: on a grid many paths tie
+    bool operator()(const SearchNode& a, const SearchNode& b) const { return a.f > b.f || (a.f == b.f && a.d < b.d); }
+};
+
+// findPath's arrays, kept per thread between calls. A state's distance and predecessor count only
+// when its stamp is the current search's, so a search costs what it visits, not the map's size,
+// and allocates nothing once the arrays have grown.
+struct SearchScratch {
+    std::vector<float> dist;
+    std::vector<int> prev;
+    std::vector<uint32_t> stamp;
+    std::vector<SearchNode> heap;
+    uint32_t current{0};
+
+    void begin(int count) {
+        if ((int)stamp.size() != count) {
+            dist.resize(count);
+            prev.resize(count);
+            stamp.assign(count, 0);
+            current = 0;
+        }
+        if (++current == 0) { // wrapped: forget every old stamp
+            std::fill(stamp.begin(), stamp.end(), 0);
+            current = 1;
+        }
+        heap.clear();
+    }
+    float distOf(int s) const { return stamp[s] == current ? dist[s] : std::numeric_limits<float>::infinity(); }
+    void set(int s, float d, int from) {
+        stamp[s] = current;
+        dist[s] = d;
+        prev[s] = from;
+    }
+    void push(float f, float d, int s) {
+        heap.push_back({f, d, s});
+        std::push_heap(heap.begin(), heap.end(), SearchCmp());
+    }
+    SearchNode pop() {
+        std::pop_heap(heap.begin(), heap.end(), SearchCmp());
+        SearchNode n = heap.back();
+        heap.pop_back();
+        return n;
+    }
+};
+thread_local SearchScratch scratch;
+}
+
+std::vector<int> RoadGraph::findPath(int start, int goal, bool emergency, int startHeading,
+                                     const float* edgeDelay, float* outCost) const {
+    const int FROM_START = -2; // predecessor marker for moves off an off-road start tile
+    const float INF = std::numeric_limits<float>::infinity();
+    SearchScratch& s = scratch;
+    s.begin(stateCount());
+    // A*: no tile is crossed faster than at the highest speed limit, and delays only add to it
+    float fastest = 0.0f;
+    for (int t = 0; t <= PLAYGROUND3; t++) if (isRoadType(t, emergency)) fastest = std::max(fastest, speedLimit(t, emergency));
+    const float perTile = fastest > 0.0f ? TILE / fastest : 0.0f;
+    const int gy = goal / w, gx = goal % w;
+    auto bound = [&](int tile) { return (std::abs(tile / w - gy) + std::abs(tile % w - gx)) * perTile; };
+
+    if (outCost) *outCost = INF;
+    if (start == goal) {
+        if (outCost) *outCost = 0.0f;
+        return { start };
+    }
+    if (isPassable(start, emergency)) {
+        for (int hd = 0; hd < 4; hd++) {
+            if (startHeading >= 0 && hd != startHeading) continue;
+            s.set(stateOf(start, hd), 0.0f, -1);
+            s.push(bound(start), 0.0f, stateOf(start, hd));
+        }
+    } else {
+        // Parked off-road (e.g. at a facility): drive straight onto any adjacent road
+        for (int d = 0; d < 4; d++) {
+            int n = neighbour(start, d);
+            if (n < 0 || !isPassable(n, emergency)) continue;
+            int st = stateOf(n, d);
+            s.set(st, travelTime(n, emergency), FROM_START);
+            s.push(travelTime(n, emergency) + bound(n), travelTime(n, emergency), st);
+        }
+    }
+
+    int found = -1;
+    while (!s.heap.empty()) {
+        SearchNode cur = s.pop();
+        if (cur.d > s.distOf(cur.id)) continue;
+        if (stateTile(cur.id) == goal) { found = cur.id; break; }
+
+        forEachSuccessor(cur.id, emergency, [&](int next, float cost) {
+            float nd = cur.d + cost;
+            if (nd < s.distOf(next)) {
+                s.set(next, nd, cur.id);
+                s.push(nd + bound(stateTile(next)), nd, next);
+            }
+        }, edgeDelay);
+    }
+
+    if (found < 0) return {};
+    if (outCost) *outCost = s.dist[found];
+    std::vector<int> tiles;
+    int cur = found;
+    for (; cur >= 0; cur = s.prev[cur]) tiles.push_back(stateTile(cur));
+    if (cur == FROM_START) tiles.push_back(start);
+    std::reverse(tiles.begin(), tiles.end());
+    return tiles;
+}
+
+float RoadGraph::pathCost(const std::vector<int>& tiles, bool emergency, int startHeading, const float* edgeDelay) const {
+    const float INF = std::numeric_limits<float>::infinity();
+    float cost = 0.0f;
+    int heading = startHeading;
+    for (size_t i = 1; i < tiles.size(); i++) {
+        int e = -1;
+        for (int d = 0; d < 4; d++) if (neighbour(tiles[i - 1], d) == tiles[i]) e = d;
+        if (e < 0) return INF;
+        if (heading >= 0 ? !canTurn(tiles[i - 1], heading, e) : !connects(tiles[i - 1], e)) return INF;
+        cost += travelTime(tiles[i], emergency) + (heading >= 0 ? turnCost(heading, e) : 0.0f);
+        if (edgeDelay) cost += edgeDelay[edgeOf(tiles[i - 1], e)];
+        heading = e;
+    }
+    return cost;
+}
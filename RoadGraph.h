@@ -0,0 +1,113 @@
+#ifndef ROADGRAPH_H
+#define ROADGRAPH_H
+
+#include "GameCommon.h"
+#include <vector>
+#include <cstdint>
+
+// Compass directions between neighbouring tiles (y grows towards the south).
+// Clockwise order, so (d + 1) & 3 is a right turn and (d + 3) & 3 a left turn.
+enum RoadDir { DIR_N = 0, DIR_E, DIR_S, DIR_W };
+
+inline int dirDY(int d) { static const int dy[4] = { -1, 0, 1, 0 }; return dy[d]; }
+inline int dirDX(int d) { static const int dx[4] = { 0, 1, 0, -1 }; return dx[d]; }
+inline int oppositeDir(int d) { return (d + 2) & 3; }
+// Closest compass direction to a world-space (x, z) heading
+int headingOf(Vector3 dir);
+
+// Compact directed road graph shared by all routers.
+// A lane state is (tile, heading): the tile a vehicle is on and the direction it entered it,
+// encoded as tile * 4 + heading. Moves follow the openings of each TileType, respect
+// per-tile turn bans and pay a turn cost; u-turns are only allowed at dead ends and roundabouts.
+// Storage is a few bytes per tile; the state graph itself is implicit.
+class RoadGraph {
+public:
+    void build(const int* tiles, int w, int h);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    int size() const { return w * h; }
+    int stateCount() const { return w * h * 4; }
+    int id(int y, int x) const { return y * w + x; }
+    bool inBounds(int y, int x) const { return y >= 0 && y < h && x >= 0 && x < w; }
+
+    static int stateOf(int tile, int heading) { return tile * 4 + heading; }
+    // Directed edge leaving a tile towards exitDir; same encoding as lane states
+    static int edgeOf(int tile, int exitDir) { return tile * 4 + exitDir; }
+    static int stateTile(int state) { return state >> 2; }
+    static int stateHeading(int state) { return state & 3; }
+
+    // Neighbour of a tile in direction d, or -1 when it falls off the map
+    int neighbour(int tile, int d) const;
+
+    int tileType(int tile) const { return type[tile]; }
+    bool isPassable(int tile, bool emergency) const;
+    bool isClosed(int tile) const { return (flags[tile] & FLAG_CLOSED) != 0; }
+    // Seconds needed to cross a tile
+    float travelTime(int tile, bool emergency) const;
+
+    // True when both tiles are passable and their geometry opens towards each other
+    bool connects(int tile, int d) const;
+    // Whether a vehicle that entered `tile` heading `heading` may leave it towards `exitDir`
+    bool canTurn(int tile, int heading, int exitDir) const;
+    void setTurnBanned(int y, int x, int heading, int exitDir, bool banned);
+    static float turnCost(int heading, int exitDir);
+
+    // Calls fn(nextState, seconds) for every legal move out of a lane state.
+    // edgeDelay (per edgeOf) adds measured congestion on top of free-flow time.
+    template<class Fn> void forEachSuccessor(int state, bool emergency, Fn fn, const float* edgeDelay = nullptr) const {
+        int tile = stateTile(state), heading = stateHeading(state);
+        for (int e = 0; e < 4; e++) {
+            if (!canTurn(tile, heading, e)) continue;
+            int n = neighbour(tile, e);
+            float cost = travelTime(n, emergency) + turnCost(heading, e);
+            if (edgeDelay) cost += edgeDelay[edgeOf(tile, e)];
+            fn(stateOf(n, e), cost);
+        }
+    }
+    // Calls fn(prevState, seconds) for every legal move into a lane state
+    template<class Fn> void forEachPredecessor(int state, bool emergency, Fn fn) const {
+        int tile = stateTile(state), heading = stateHeading(state);
+        int prev = neighbour(tile, oppositeDir(heading));
+        if (prev < 0 || !connects(prev, heading)) return;
+        float enter = travelTime(tile, emergency);
+        for (int ph = 0; ph < 4; ph++) {
+            if (canTurn(prev, ph, heading)) fn(stateOf(prev, ph), enter + turnCost(ph, heading));
+        }
+    }
+
+    // Edits are appended to the change log so cached route data can update incrementally
+    void setTile(int y, int x, int t);
+    void setClosed(int y, int x, bool closed);
+    uint32_t revision() const { return (uint32_t)changes.size(); }
+    const std::vector<int>& changeLog() const { return changes; }
+
+    // A* over lane states (Manhattan distance at the top speed limit as the bound). startHeading < 0
+    // lets the vehicle leave in any direction. Returns the tile ids from start to goal, or empty if
+    // unreachable.
+    std::vector<int> findPath(int start, int goal, bool emergency, int startHeading = -1,
+                              const float* edgeDelay = nullptr, float* outCost = nullptr) const;
+    // Cost of driving a tile sequence under the same rules, infinity if it breaks them
+    float pathCost(const std::vector<int>& tiles, bool emergency, int startHeading = -1,
+                   const float* edgeDelay = nullptr) const;
+
+    static bool isRoadType(int t, bool emergency);
+    static float speedLimit(int t, bool emergency);
+    // Bitmask of the sides (1 << RoadDir) a tile type's road surface reaches
+    static uint8_t openings(int t);
+
+private:
+    enum : uint8_t { FLAG_ROAD = 1, FLAG_CLOSED = 2 };
+
+    int w = 0;
+    int h = 0;
+    std::vector<uint8_t> type;
+    std::vector<uint8_t> flags;
+    std::vector<uint16_t> bans; // bit heading * 4 + exitDir
+    std::vector<int> changes;
+
+    void refreshFlags(int tile);
+    int exitCount(int tile) const;
+};
+
+#endif
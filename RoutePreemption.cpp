@@ -0,0 +1,74 @@
+#include "RoutePreemption.h"
+#include <cmath>
+#include <algorithm>
+
+void RoutePreemption::addStop(int controller, uint16_t movements, float stopArc, float clearArc) {
+    stops.push_back({ controller, movements, 0, stopArc, clearArc, 0.0f, -1.0f, -1.0f });
+}
+
+void RoutePreemption::release(PreemptionArbiter& a, Stop& st, float now) {
+    // Even a window that has run out: the arbiter may have moved it later
+    if (st.until >= st.from) a.request(st.controller, vehicle, st.movements, urgency, now, now, now);
+    st.from = 0.0f;
+    st.until = -1.0f;
+}
+
+void RoutePreemption::update(PreemptionArbiter& a, float now, float arc, float speed) {
+    speed = std::max(speed, 0.1f);
+    // Junctions the vehicle has cleared go back to their own timing straight away
+    while (next < stops.size() && arc >= stops[next].clearArc) release(a, stops[next++], now);
+
+    for (size_t k = next; k < stops.size(); k++) {
+        Stop& st = stops[k];
+        float eta = now + std::max(0.0f, st.stopArc - arc) / speed;
+        if (eta - now > params.horizon) break; // the rest are further along the route
+        float from = std::max(now, eta - params.lead), until = eta + params.hold;
+        // A window given back because the vehicle was held up is asked for again as it closes in
+        if (st.deadline < 0.0f || (st.deadline <= now && eta - now <= params.lead)) st.deadline = until + params.maxDelay;
+        until = std::min(until, st.deadline);
+        // Once in the junction the vehicle keeps it until it is through
+        if (arc >= st.stopArc) until = std::max(until, now + (st.clearArc - arc) / speed);
+        if (until <= now) {
+            if (st.until > now) a.request(st.controller, vehicle, st.movements, urgency, now, now, now);
+            st.until = now;
+            continue;
+        }
+        bool open = st.until >= st.from;
+        if (open && st.until > now && fabsf(until - st.until) <= params.drift) continue;
+        // A window that has started stays open while its end moves, so the light doesn't flicker
+        if (open && st.from <= now) from = st.from;
+        st.from = from;
+        st.until = until;
+        a.request(st.controller, vehicle, st.movements, urgency, now, from, until);
+        issued++;
+    }
+}
+
+void RoutePreemption::clear(PreemptionArbiter& a, float now) {
+    for (size_t k = next; k < stops.size(); k++) release(a, stops[k], now);
+    stops.clear();
+    next = 0;
+}
+
+bool RoutePreemption::mustWait(const PreemptionArbiter& a, float now, float arc, float reach) const {
+    if (next >= stops.size()) return false;
+    const Stop& st = stops[next];
+    if (arc >= st.stopArc || arc < st.stopArc - reach) return false;
+    return a.mustWait(st.controller, vehicle, now);
+}
+
+void RoutePreemption::save(SnapshotWriter& w, const std::string& name) const {
+    w.array((name + ".stops").c_str(), stops);
+    w.value((name + ".progress").c_str(), Progress{ next, issued, vehicle, urgency });
+}
+
+bool RoutePreemption::load(const SnapshotReader& r, const std::string& name) {
+    Progress p;
+    if (!r.array((name + ".stops").c_str(), stops) || !r.value((name + ".progress").c_str(), p) || p.next > stops.size())
+        return false;
+    next = (size_t)p.next;
+    issued = p.issued;
+    vehicle = p.vehicle;
+    urgency = p.urgency;
+    return true;
+}
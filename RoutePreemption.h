@@ -0,0 +1,73 @@
+#ifndef ROUTEPREEMPTION_H
+#define ROUTEPREEMPTION_H
+
+#include "PreemptionArbiter.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Signal preemption planned along an emergency vehicle's route instead of found by checking every
+// light against the vehicle. The signals on the route are registered once, as the route is
+// planned, with the distance along it to their stop lines. Each gets a green window for the
+// vehicle's approach from `lead` seconds before its estimated arrival until `hold` seconds after;
+// a window is issued once the arrival is within `horizon` and moved only when the estimate drifts
+// by more than `drift`, and never past `maxDelay` seconds after the end first planned, so a vehicle
+// that is held up before a junction gives the light back until it is within `lead` seconds of the
+// stop line again; one already in it keeps the junction until it is through. A tick costs one
+// estimate per signal ahead within the horizon. Windows are requested through a PreemptionArbiter,
+// which decides between vehicles wanting the same junction.
+class RoutePreemption {
+public:
+    struct Params {
+        float lead{3.0f};
+        float hold{2.0f};
+        float drift{1.0f};
+        float horizon{15.0f};
+        float maxDelay{5.0f};
+    };
+
+    RoutePreemption() = default;
+    explicit RoutePreemption(const Params& p) : params(p) {}
+
+    // Who the windows are for, and how urgent (0 most) when competing with other vehicles
+    void setVehicle(int id, int severity) { vehicle = id; urgency = severity; }
+    // Distances along the route to the stop line and to where the vehicle has cleared the junction.
+    // Stops are added in route order.
+    void addStop(int controller, uint16_t movements, float stopArc, float clearArc);
+    // `arc` is the vehicle's progress along the route, `speed` what it is expected to keep from here
+    void update(PreemptionArbiter& a, float now, float arc, float speed);
+    // Hands back every light still held or about to be (mission over or route replaced)
+    void clear(PreemptionArbiter& a, float now);
+    // Within `reach` of the next stop line and not to enter yet: the junction is another vehicle's
+    bool mustWait(const PreemptionArbiter& a, float now, float arc, float reach) const;
+
+    int pendingStops() const { return (int)(stops.size() - next); }
+    uint64_t windowsIssued() const { return issued; }
+
+    // Sections `name`.stops and `name`.progress; the arbiter is saved on its own
+    void save(SnapshotWriter& w, const std::string& name) const;
+    bool load(const SnapshotReader& r, const std::string& name);
+
+private:
+    struct Stop {
+        int controller;
+        uint16_t movements;
+        uint16_t pad; // zero, so equal plans save to equal bytes
+        float stopArc, clearArc;
+        float from, until; // window as last issued, until < from before the first
+        float deadline;    // latest end, -1 until the first window is issued
+    };
+
+    Params params;
+    std::vector<Stop> stops;
+    size_t next{0}; // first stop the vehicle hasn't cleared
+    int vehicle{0};
+    int urgency{0};
+    uint64_t issued{0};
+
+    struct Progress { uint64_t next, issued; int vehicle, urgency; };
+
+    void release(PreemptionArbiter& a, Stop& st, float now);
+};
+
+#endif
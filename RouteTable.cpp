@@ -0,0 +1,189 @@
+#include "RouteTable.h"
+#include "raymath.h"
+#include <cstring>
+#include <cmath>
+
+uint64_t RouteTable::hashOf(const std::vector<Vector3>& points, float laneOffset, bool closed) {
+    // FNV-1a over the raw coordinates; identical waypoint lists hash identically
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](uint32_t b) { h ^= b; h *= 1099511628211ull; };
+    for (const Vector3& p : points) {
+        uint32_t bits[3];
+        memcpy(bits, &p, sizeof(bits));
+        for (uint32_t b : bits) mix(b);
+    }
+    uint32_t off;
+    memcpy(&off, &laneOffset, sizeof(off));
+    mix(off);
+    mix(closed ? 1u : 0u);
+    return h;
+}
+
+void RouteTable::bake(Route& r) {
+    Polyline& line = r.line;
+    line = Polyline();
+    const std::vector<Vector3>& pts = r.points;
+    int n = (int)pts.size();
+    line.wpArc.assign(n, 0.0f);
+    if (n == 0) return;
+
+    // Merge repeated waypoints (legs are joined end to start); wpU maps waypoint -> unique point
+    std::vector<Vector3> u;
+    std::vector<int> wpU(n), uWp;
+    for (int i = 0; i < n; i++) {
+        if (u.empty() || Vector3Distance(u.back(), pts[i]) > 0.001f) { u.push_back(pts[i]); uWp.push_back(i); }
+        else uWp.back() = i;
+        wpU[i] = (int)u.size() - 1;
+    }
+    bool closed = r.closed && u.size() > 1;
+    if (closed && u.size() > 2 && Vector3Distance(u.back(), u.front()) <= 0.001f) {
+        for (int& k : wpU) if (k == (int)u.size() - 1) k = 0;
+        u.pop_back();
+        uWp.pop_back();
+    }
+    int m = (int)u.size();
+
+    std::vector<Vector3> d(m); // direction leaving each unique point
+    for (int k = 0; k < m; k++) {
+        int next = (k + 1 < m) ? k + 1 : (closed ? 0 : -1);
+        if (next < 0) d[k] = (k > 0) ? d[k - 1] : Vector3{0, 0, 1};
+        else {
+            Vector3 v = Vector3Subtract(u[next], u[k]);
+            v.y = 0.0f;
+            d[k] = (Vector3Length(v) > 0.0001f) ? Vector3Normalize(v) : Vector3{0, 0, 1};
+        }
+    }
+
+    // Offset every point to the right of travel (same side as Vehicle's lane offset)
+    std::vector<int> uVertex(m);
+    auto right = [](Vector3 dir) { return Vector3{ -dir.z, 0.0f, dir.x }; };
+    for (int k = 0; k < m; k++) {
+        Vector3 din = (k > 0) ? d[k - 1] : (closed ? d[m - 1] : d[0]);
+        Vector3 dout = d[k];
+        Vector3 rin = right(din), rout = right(dout);
+        uVertex[k] = (int)line.vertex.size();
+        if (Vector3DotProduct(din, dout) < -0.5f) {
+            // Hairpin: a mitre would shoot off the road, cross over instead
+            line.vertex.push_back(Vector3Add(u[k], Vector3Scale(rin, r.offset)));
+            line.vertex.push_back(Vector3Add(u[k], Vector3Scale(rout, r.offset)));
+            line.vertexWp.push_back(uWp[k]);
+            line.vertexWp.push_back(uWp[k]);
+        } else {
+            Vector3 miter = Vector3Normalize(Vector3Add(rin, rout));
+            float scale = r.offset / fmaxf(Vector3DotProduct(miter, rin), 0.5f);
+            line.vertex.push_back(Vector3Add(u[k], Vector3Scale(miter, scale)));
+            line.vertexWp.push_back(uWp[k]);
+        }
+    }
+    if (closed) {
+        line.vertex.push_back(line.vertex[0]);
+        line.vertexWp.push_back(line.vertexWp[0]);
+    }
+
+    int vc = (int)line.vertex.size();
+    line.arc.assign(vc, 0.0f);
+    for (int i = 0; i + 1 < vc; i++) {
+        Vector3 v = Vector3Subtract(line.vertex[i + 1], line.vertex[i]);
+        v.y = 0.0f;
+        float len = Vector3Length(v);
+        Vector3 dir = (len > 0.0001f) ? Vector3Scale(v, 1.0f / len) : d[0];
+        if (len <= 0.0001f && !line.dirX.empty()) dir = { line.dirX.back(), 0.0f, line.dirZ.back() };
+        line.arc[i + 1] = line.arc[i] + len;
+        line.dirX.push_back(dir.x);
+        line.dirZ.push_back(dir.z);
+        line.yaw.push_back(atan2f(dir.x, dir.z) * RAD2DEG);
+    }
+    line.length = line.arc.back();
+    line.loops = closed && line.length > 0.0f;
+    for (int i = 0; i < n; i++) line.wpArc[i] = line.arc[uVertex[wpU[i]]];
+}
+
+int RouteTable::intern(const std::vector<Vector3>& points, float laneOffset, bool closed) {
+    uint64_t h = hashOf(points, laneOffset, closed);
+    auto range = byHash.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+        const Route& other = routes[it->second];
+        if (other.offset == laneOffset && other.closed == closed && other.points.size() == points.size() &&
+            memcmp(other.points.data(), points.data(), points.size() * sizeof(Vector3)) == 0) {
+            routes[it->second].refs++;
+            return it->second;
+        }
+    }
+
+    // Bake before touching the table: `points` may belong to a route in it
+    Route r;
+    r.points = points;
+    r.offset = laneOffset;
+    r.closed = closed;
+    r.hash = h;
+    r.refs = 1;
+    bake(r);
+
+    int id;
+    if (!freeIds.empty()) { id = freeIds.back(); freeIds.pop_back(); routes[id] = std::move(r); }
+    else { id = (int)routes.size(); routes.push_back(std::move(r)); }
+    byHash.emplace(h, id);
+    return id;
+}
+
+int RouteTable::variant(int id, float laneOffset, bool closed) {
+    if (routes[id].offset == laneOffset && routes[id].closed == closed) {
+        routes[id].refs++;
+        return id;
+    }
+    return intern(routes[id].points, laneOffset, closed);
+}
+
+void RouteTable::retain(int id) {
+    if (id >= 0) routes[id].refs++;
+}
+
+void RouteTable::release(int id) {
+    if (id < 0 || --routes[id].refs > 0) return;
+    auto range = byHash.equal_range(routes[id].hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == id) { byHash.erase(it); break; }
+    }
+    routes[id] = Route();
+    freeIds.push_back(id);
+}
+
+void RouteTable::save(SnapshotWriter& w) const {
+    std::vector<Stored> header;
+    std::vector<Vector3> points;
+    for (const Route& r : routes) {
+        header.push_back({ (uint32_t)points.size(), (uint32_t)r.points.size(), r.offset, r.refs, (uint8_t)r.closed });
+        points.insert(points.end(), r.points.begin(), r.points.end());
+    }
+    w.array("routes.header", header);
+    w.array("routes.points", points);
+    w.array("routes.free", freeIds);
+}
+
+bool RouteTable::load(const SnapshotReader& r) {
+    std::vector<Stored> header;
+    std::vector<Vector3> points;
+    std::vector<int> free;
+    if (!r.array("routes.header", header) || !r.array("routes.points", points) || !r.array("routes.free", free))
+        return false;
+    for (const Stored& h : header) {
+        if ((uint64_t)h.begin + h.count > points.size()) return false;
+    }
+    for (int id : free) if (id < 0 || id >= (int)header.size() || header[id].refs > 0) return false;
+    routes.assign(header.size(), Route());
+    byHash.clear();
+    freeIds = free;
+    for (size_t id = 0; id < header.size(); id++) {
+        const Stored& h = header[id];
+        if (h.refs <= 0) continue; // a freed id, left empty
+        Route& route = routes[id];
+        route.points.assign(points.begin() + h.begin, points.begin() + h.begin + h.count);
+        route.offset = h.offset;
+        route.closed = h.closed != 0;
+        route.refs = h.refs;
+        route.hash = hashOf(route.points, route.offset, route.closed);
+        bake(route);
+        byHash.emplace(route.hash, (int)id);
+    }
+    return true;
+}
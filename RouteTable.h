@@ -0,0 +1,72 @@
+#ifndef ROUTETABLE_H
+#define ROUTETABLE_H
+
+#include "raylib.h"
+#include "Snapshot.h"
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Interned, reference-counted routes. Vehicles on the same route share one copy and keep only
+// the route id and their own cursor. Freed ids are recycled.
+// Each route is baked once into the polyline a car actually drives: the waypoints shifted by the
+// lane offset (mitred at corners, split at u-turns) with cumulative arc length, so following it
+// is s += v * dt plus a segment lookup.
+class RouteTable {
+public:
+    struct Polyline {
+        std::vector<Vector3> vertex;
+        std::vector<float> arc;      // distance from the first vertex, per vertex
+        std::vector<float> dirX;     // unit direction per segment (vertex i -> i + 1)
+        std::vector<float> dirZ;
+        std::vector<float> yaw;      // per segment, degrees, same convention as Vehicle::rotation
+        std::vector<int> vertexWp;   // waypoint each vertex was made from
+        std::vector<float> wpArc;    // arc length at which each waypoint is reached
+        float length{0.0f};
+        bool loops{false};           // closed and long enough to drive around
+        int segments() const { return (int)vertex.size() - 1; }
+    };
+
+    // Returns the id of an identical route if there is one, else bakes a new one. Adds a reference.
+    // closed routes loop back from the last waypoint to the first.
+    int intern(const std::vector<Vector3>& points, float laneOffset = 0.0f, bool closed = false);
+    // Same waypoints baked for another lane offset / loop mode (may return id itself). Adds a reference.
+    int variant(int id, float laneOffset, bool closed);
+    void retain(int id);
+    void release(int id);
+
+    // Sections routes.*: waypoints, offsets and reference counts under the same ids, so vehicles
+    // restored with their route ids find them; polylines are baked again on load
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r);
+
+    const std::vector<Vector3>& points(int id) const { return routes[id].points; }
+    const Polyline& polyline(int id) const { return routes[id].line; }
+    int length(int id) const { return (int)routes[id].points.size(); }
+    bool isClosed(int id) const { return routes[id].closed; }
+    float laneOffset(int id) const { return routes[id].offset; }
+    int refCount(int id) const { return routes[id].refs; }
+    int liveCount() const { return (int)(routes.size() - freeIds.size()); }
+
+private:
+    struct Route {
+        std::vector<Vector3> points;
+        Polyline line;
+        float offset{0.0f};
+        bool closed{false};
+        uint64_t hash{0};
+        int refs{0};
+    };
+
+    // A route as saved, its waypoints a range of one shared array
+    struct Stored { uint32_t begin, count; float offset; int32_t refs; uint8_t closed, pad[3]; };
+
+    std::vector<Route> routes;
+    std::vector<int> freeIds;
+    std::unordered_multimap<uint64_t, int> byHash;
+
+    static uint64_t hashOf(const std::vector<Vector3>& points, float laneOffset, bool closed);
+    static void bake(Route& r);
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "SignalPlan.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <map>
+
+// A phase made only of protected left turns (movement heading * 4 + exitDir, left = heading - 1)
+static bool isLeftPhase(uint16_t movements) {
+    if (movements == 0) return false;
+    for (int m = 0; m < 16; m++) {
+        if ((movements >> m & 1) && (m & 3) != (((m >> 2) + 3) & 3)) return false;
+    }
+    return true;
+}
+
+// 0 for N/S headings, 1 for E/W; -1 for an empty phase
+static int axisOf(uint16_t movements) {
+    for (int m = 0; m < 16; m++) if (movements >> m & 1) return (m >> 2) & 1;
+    return -1;
+}
+
+std::vector<SignalScheduler::Phase> coordinatedPhases(uint8_t openings, const SignalTiming& timing, float nsShare) {
+    std::vector<SignalScheduler::Phase> list = SignalScheduler::standardPhases(openings, 0.0f, timing.leftGreen);
+    float lost = 0.0f;
+    bool served[2] = { false, false };
+    for (const SignalScheduler::Phase& ph : list) {
+        lost += ph.green + timing.yellow + timing.allRed;
+        int axis = axisOf(ph.movements);
+        if (axis >= 0 && !isLeftPhase(ph.movements)) served[axis] = true;
+    }
+    float available = std::max(2.0f, timing.cycle - lost);
+    nsShare = std::min(0.9f, std::max(0.1f, nsShare));
+    // An axis without through movements leaves its share to the other one
+    float share[2] = { served[1] ? nsShare : 1.0f, served[0] ? 1.0f - nsShare : 1.0f };
+    for (SignalScheduler::Phase& ph : list) {
+        int axis = axisOf(ph.movements);
+        if (axis < 0) ph.green = available;
+        else if (!isLeftPhase(ph.movements)) ph.green = available * share[axis];
+    }
+    return list;
+}
+
+void throughWindow(const std::vector<SignalScheduler::Phase>& phases, const SignalTiming& timing, int axis,
+                   float& start, float& length) {
+    float t = 0.0f;
+    for (const SignalScheduler::Phase& ph : phases) {
+        if (axisOf(ph.movements) == axis && !isLeftPhase(ph.movements)) {
+            start = t;
+            length = ph.green;
+            return;
+        }
+        t += ph.green + timing.yellow + timing.allRed;
+    }
+    start = 0.0f;
+    length = 0.0f;
+}
+
+// Both files are lines of a keyword and numbers; '#' starts a comment line
+static bool readTiming(const char* line, SignalTiming& timing) {
+    return sscanf(line, "timing %f %f %f %f", &timing.cycle, &timing.leftGreen, &timing.yellow, &timing.allRed) == 4;
+}
+
+static void writeTiming(FILE* f, const SignalTiming& timing) {
+    fprintf(f, "timing %.3f %.3f %.3f %.3f\n", timing.cycle, timing.leftGreen, timing.yellow, timing.allRed);
+}
+
+bool SignalNetwork::save(const char* path) const {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# CitySmart signal network v1\n");
+    writeTiming(f, timing);
+    fprintf(f, "demand %.3f %.3f\n", mainDemand, crossDemand);
+    for (const Junction& j : junctions) fprintf(f, "junction %d %d\n", j.tile, (int)j.openings);
+    for (const Corridor& c : corridors) {
+        fprintf(f, "corridor %d %.3f %d", c.axis, c.speed, (int)c.junction.size());
+        for (size_t k = 0; k < c.junction.size(); k++) fprintf(f, " %d %.3f", junctions[c.junction[k]].tile, c.position[k]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return true;
+}
+
+bool SignalNetwork::load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    junctions.clear();
+    corridors.clear();
+    std::map<int, int> indexOf; // tile -> junction
+    char line[4096];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (strncmp(line, "timing", 6) == 0) {
+            ok = readTiming(line, timing);
+        } else if (strncmp(line, "demand", 6) == 0) {
+            ok = sscanf(line, "demand %f %f", &mainDemand, &crossDemand) == 2;
+        } else if (strncmp(line, "junction", 8) == 0) {
+            int tile, openings;
+            ok = sscanf(line, "junction %d %d", &tile, &openings) == 2;
+            indexOf[tile] = (int)junctions.size();
+            junctions.push_back({ tile, (uint8_t)openings });
+        } else if (strncmp(line, "corridor", 8) == 0) {
+            Corridor c;
+            int n, used;
+            ok = sscanf(line, "corridor %d %f %d%n", &c.axis, &c.speed, &n, &used) == 3;
+            const char* p = line + used;
+            for (int k = 0; ok && k < n; k++) {
+                int tile;
+                float position;
+                ok = sscanf(p, "%d %f%n", &tile, &position, &used) == 2 && indexOf.count(tile);
+                if (!ok) break;
+                p += used;
+                c.junction.push_back(indexOf[tile]);
+                c.position.push_back(position);
+            }
+            if (ok) corridors.push_back(c);
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+bool SignalPlan::save(const char* path) const {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# CitySmart signal plan v1: tile, offset (s), N/S share of the through green\n");
+    writeTiming(f, timing);
+    for (const Entry& e : entries) fprintf(f, "junction %d %.3f %.3f\n", e.tile, e.offset, e.nsShare);
+    fclose(f);
+    return true;
+}
+
+bool SignalPlan::load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    entries.clear();
+    char line[256];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (strncmp(line, "timing", 6) == 0) {
+            ok = readTiming(line, timing) && timing.cycle > 0.0f;
+        } else if (strncmp(line, "junction", 8) == 0) {
+            Entry e;
+            ok = sscanf(line, "junction %d %f %f", &e.tile, &e.offset, &e.nsShare) == 3;
+            entries.push_back(e);
+        }
+    }
+    fclose(f);
+    if (!ok) entries.clear();
+    return ok;
+}
+
+const SignalPlan::Entry* SignalPlan::find(int tile) const {
+    for (const Entry& e : entries) if (e.tile == tile) return &e;
+    return nullptr;
+}
@@ -0,0 +1,70 @@
+#ifndef SIGNALPLAN_H
+#define SIGNALPLAN_H
+
+#include "SignalScheduler.h"
+#include <vector>
+#include <cstdint>
+
+// Coordinated fixed-time timing, exchanged as text files between the simulation and the offline
+// optimizer: the simulation exports its signalised junctions and the straight roads linking them
+// (SignalNetwork), the optimizer searches offsets and splits over it and writes a SignalPlan, which
+// the simulation loads at start-up. Coordinated junctions share one cycle and keep the standard
+// phase order; only how the through green is split between the N/S and E/W axes and where the
+// cycle starts differ per junction.
+
+// Defaults match the left-turn and clearance times of the simulation's signals
+struct SignalTiming {
+    float cycle{30.0f};
+    float leftGreen{2.0f};
+    float yellow{1.5f};
+    float allRed{0.5f};
+};
+
+struct SignalNetwork {
+    struct Junction {
+        int tile;
+        uint8_t openings; // 1 << RoadDir
+    };
+    // Junctions along one straight road, ordered by position
+    struct Corridor {
+        int axis;                    // 0 N/S, 1 E/W
+        float speed;                 // free speed, units per second
+        std::vector<int> junction;   // into junctions
+        std::vector<float> position; // along the road, units
+    };
+
+    SignalTiming timing;
+    float mainDemand{8.0f};  // vehicles per minute entering each end of a corridor
+    float crossDemand{3.0f}; // vehicles per minute per side street approach
+    std::vector<Junction> junctions;
+    std::vector<Corridor> corridors;
+
+    bool save(const char* path) const;
+    bool load(const char* path);
+};
+
+struct SignalPlan {
+    struct Entry {
+        int tile;
+        float offset;  // seconds into the cycle at time 0, as in SignalScheduler::add
+        float nsShare; // fraction of the through green given to the N/S axis
+    };
+
+    SignalTiming timing;
+    std::vector<Entry> entries;
+
+    bool save(const char* path) const;
+    bool load(const char* path);
+    const Entry* find(int tile) const;
+};
+
+// Phases of a coordinated junction: the standard plan with its through greens sized so that the
+// cycle is exactly timing.cycle, nsShare of them on the N/S axis
+std::vector<SignalScheduler::Phase> coordinatedPhases(uint8_t openings, const SignalTiming& timing, float nsShare);
+
+// When, from the start of the cycle, the through movements of `axis` have the green; length 0 if
+// no phase serves them
+void throughWindow(const std::vector<SignalScheduler::Phase>& phases, const SignalTiming& timing, int axis,
+                   float& start, float& length);
+
+#endif
@@ -0,0 +1,382 @@
+#include "SignalScheduler.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+
+int SignalScheduler::addPlan(const std::vector<Phase>& list, float yellow, float allRed) {
+    Plan p{};
+    p.first = (uint32_t)phases.size();
+    p.count = (uint8_t)list.size();
+    p.yellow = yellow;
+    p.allRed = allRed;
+    p.cycle = 0.0f;
+    for (const Phase& ph : list) {
+        phases.push_back({ ph.movements, 0, ph.green });
+        p.cycle += ph.green + yellow + allRed;
+    }
+    plans.push_back(p);
+    return (int)plans.size() - 1;
+}
+
+std::vector<SignalScheduler::Phase> SignalScheduler::standardPhases(uint8_t openings, float throughGreen, float leftGreen) {
+    // Movement from `heading` to `exitDir` exists if the car can come in on the side behind it
+    // and leave on the exit side; no u-turns at signals
+    auto movement = [&](int heading, int exitDir) -> uint16_t {
+        bool in = openings >> ((heading + 2) & 3) & 1, out = openings >> exitDir & 1;
+        return (in && out && exitDir != ((heading + 2) & 3)) ? (uint16_t)(1u << (heading * 4 + exitDir)) : 0;
+    };
+
+    std::vector<Phase> list;
+    for (int axis = 0; axis < 2; axis++) {
+        int a = axis, b = axis + 2; // N/S, then E/W
+        uint16_t lefts = 0, rest = 0;
+        int approaches = 0;
+        for (int h : { a, b }) {
+            uint16_t all = movement(h, (h + 3) & 3) | movement(h, h) | movement(h, (h + 1) & 3);
+            if (all) approaches++;
+            lefts |= movement(h, (h + 3) & 3);
+            rest |= movement(h, h) | movement(h, (h + 1) & 3);
+        }
+        if (approaches == 0) continue;
+        if (approaches == 1) {
+            list.push_back({ (uint16_t)(lefts | rest), 0, throughGreen });
+            continue;
+        }
+        if (lefts) list.push_back({ lefts, 0, leftGreen });
+        if (rest) list.push_back({ rest, 0, throughGreen });
+    }
+    if (list.empty()) list.push_back({ 0, 0, throughGreen });
+    return list;
+}
+
+int SignalScheduler::addStandardPlan(uint8_t openings, float throughGreen, float leftGreen, float yellow, float allRed) {
+    return addPlan(standardPhases(openings, throughGreen, leftGreen), yellow, allRed);
+}
+
+int SignalScheduler::add(int plan, float startOffset) {
+    assert(plan >= 0 && plan < (int)plans.size());
+    int c = (int)planOf.size();
+    planOf.push_back((uint32_t)plan);
+    actSlot.push_back(-1);
+    offset.push_back(fmodf(startOffset, plans[plan].cycle));
+    clearFrom.push_back(-std::numeric_limits<float>::infinity());
+    preemptFrom.push_back(-std::numeric_limits<float>::infinity());
+    preemptUntil.push_back(-std::numeric_limits<float>::infinity());
+    preemptMask.push_back(0);
+    clearOpen.push_back(0);
+    clearYellow.push_back(0);
+    clearPending.push_back(0);
+    stamp.push_back(0);
+    currentOpen.push_back(openAt(c, 0.0f));
+    currentYellow.push_back(yellowAt(c, 0.0f));
+    schedule(c, nextChange(c, 0.0f));
+    return c;
+}
+
+int SignalScheduler::addActuated(int plan, const Actuation& params) {
+    Actuated a;
+    a.params = params;
+    a.end = params.minGreen;
+    act.push_back(a);
+    int c = add(plan, 0.0f);
+    actSlot[c] = (int)act.size() - 1;
+    // add() scheduled the fixed-time transition; supersede it
+    stamp[c]++;
+    currentOpen[c] = openAt(c, 0.0f);
+    currentYellow[c] = yellowAt(c, 0.0f);
+    schedule(c, nextChange(c, 0.0f));
+    return c;
+}
+
+void SignalScheduler::reportQueued(int c, int movement, int cars) {
+    if (actSlot[c] < 0 || cars <= 0) return;
+    Actuated& a = act[actSlot[c]];
+    if (!a.touched) { a.touched = true; touched.push_back(actSlot[c]); }
+    a.queued[movement] = (uint8_t)std::min(255, a.queued[movement] + cars);
+}
+
+void SignalScheduler::reportArrival(int c, int movement) {
+    if (actSlot[c] >= 0) act[actSlot[c]].arrived |= (uint16_t)(1u << movement);
+}
+
+void SignalScheduler::stepActuated(Actuated& a, const Plan& p, float now) {
+    const Actuation& q = a.params;
+    auto queuedOn = [&](uint16_t mask) {
+        int cars = 0;
+        for (int m = 0; m < 16; m++) if (mask >> m & 1) cars += a.queued[m];
+        return cars;
+    };
+    while (now >= a.end) {
+        uint16_t mask = phases[p.first + a.phase].movements;
+        if (a.interval == 0) {
+            bool here = queuedOn(mask) > 0 || (a.arrived & mask);
+            bool elsewhere = queuedOn((uint16_t)~mask) > 0 || (a.arrived & ~mask);
+            a.arrived &= (uint16_t)~mask;
+            // Rest in green while nobody else waits, extend while this phase still has cars
+            float until = elsewhere ? std::min(now + q.gap, a.greenStart + q.maxGreen) : now + q.gap;
+            if ((!elsewhere || here) && until > now) { a.end = until; continue; }
+            a.interval = 1;
+            a.end = now + p.yellow;
+        } else if (a.interval == 1) {
+            a.interval = 2;
+            a.end = now + p.allRed;
+        } else {
+            int next = (a.phase + 1) % p.count;
+            for (int k = 1; k <= p.count; k++) {
+                int ph = (a.phase + k) % p.count;
+                uint16_t m = phases[p.first + ph].movements;
+                if (queuedOn(m) > 0 || (a.arrived & m)) { next = ph; break; }
+            }
+            a.phase = (uint8_t)next;
+            a.interval = 0;
+            a.greenStart = now;
+            a.end = now + q.minGreen;
+        }
+    }
+}
+
+void SignalScheduler::clear() {
+    phases.clear();
+    plans.clear();
+    planOf.clear();
+    offset.clear();
+    clearFrom.clear();
+    preemptFrom.clear();
+    preemptUntil.clear();
+    preemptMask.clear();
+    clearOpen.clear();
+    clearYellow.clear();
+    clearPending.clear();
+    currentOpen.clear();
+    currentYellow.clear();
+    stamp.clear();
+    actSlot.clear();
+    act.clear();
+    touched.clear();
+    events.clear();
+}
+
+SignalScheduler::Position SignalScheduler::locate(int c, float t) const {
+    const Plan& p = plans[planOf[c]];
+    // Double precision so phases stay exact over long runs
+    double inCycle = fmod((double)t + offset[c], (double)p.cycle);
+    if (inCycle < 0.0) inCycle += p.cycle;
+    double start = (double)t - inCycle, at = 0.0;
+    for (int k = 0; k < p.count; k++) {
+        const float lengths[3] = { phases[p.first + k].green, p.yellow, p.allRed };
+        for (int interval = 0; interval < 3; interval++) {
+            at += lengths[interval];
+            if (inCycle < at) return { k, interval, start + at };
+        }
+    }
+    return { 0, 0, start + p.cycle + phases[p.first].green }; // rounding at the very end of the cycle
+}
+
+uint16_t SignalScheduler::planOpenAt(int c, float t) const {
+    if (actSlot[c] >= 0) {
+        const Actuated& a = act[actSlot[c]];
+        return a.interval == 0 ? phases[plans[planOf[c]].first + a.phase].movements : 0;
+    }
+    Position pos = locate(c, t);
+    return pos.interval == 0 ? phases[plans[planOf[c]].first + pos.phase].movements : 0;
+}
+
+uint16_t SignalScheduler::planYellowAt(int c, float t) const {
+    if (actSlot[c] >= 0) {
+        const Actuated& a = act[actSlot[c]];
+        return a.interval == 1 ? phases[plans[planOf[c]].first + a.phase].movements : 0;
+    }
+    Position pos = locate(c, t);
+    return pos.interval == 1 ? phases[plans[planOf[c]].first + pos.phase].movements : 0;
+}
+
+// Clearance before the window: what was green and doesn't belong to it turns yellow, then red,
+// while the window's movements already green stay green. After the window its movements the plan
+// doesn't have green clear the same way, and the plan's other greens wait until they have.
+uint16_t SignalScheduler::openAt(int c, float t) const {
+    if (t >= clearFrom[c] && t < preemptFrom[c]) return clearOpen[c] & preemptMask[c];
+    if (isPreempted(c, t)) return preemptMask[c];
+    if (t >= preemptUntil[c] && t < preemptUntil[c] + clearanceTime(c)) return planOpenAt(c, t) & preemptMask[c];
+    return planOpenAt(c, t);
+}
+
+uint16_t SignalScheduler::yellowAt(int c, float t) const {
+    float yellow = plans[planOf[c]].yellow;
+    if (t >= clearFrom[c] && t < preemptFrom[c])
+        return t < clearFrom[c] + yellow ? (uint16_t)((clearOpen[c] | clearYellow[c]) & ~preemptMask[c]) : 0;
+    if (isPreempted(c, t)) return 0;
+    if (t >= preemptUntil[c] && t < preemptUntil[c] + clearanceTime(c))
+        return t < preemptUntil[c] + yellow ? (uint16_t)(preemptMask[c] & ~planOpenAt(c, t)) : 0;
+    return planYellowAt(c, t);
+}
+
+LightState SignalScheduler::movementStateAt(int c, int movement, float t) const {
+    if (openAt(c, t) >> movement & 1) return LightState::Green;
+    if (yellowAt(c, t) >> movement & 1) return LightState::Yellow;
+    return LightState::Red;
+}
+
+float SignalScheduler::nextChange(int c, float t) const {
+    double end = std::numeric_limits<double>::infinity();
+    // The plan's own transitions show outside the clearance and window, and actuated ones are held
+    bool inWindow = t >= clearFrom[c] && t < preemptUntil[c];
+    if (!inWindow && !(actSlot[c] >= 0 && holding(c, t)))
+        end = actSlot[c] >= 0 ? (double)act[actSlot[c]].end : locate(c, t).end;
+    float yellow = plans[planOf[c]].yellow;
+    const float bounds[6] = { clearFrom[c], clearFrom[c] + yellow, preemptFrom[c],
+                              preemptUntil[c], preemptUntil[c] + yellow, preemptUntil[c] + clearanceTime(c) };
+    for (float b : bounds) if (b > t) end = std::min(end, (double)b);
+    // Never schedule at or before t, whatever the rounding
+    return std::max((float)end, std::nextafter(t, std::numeric_limits<float>::infinity()));
+}
+
+LightState SignalScheduler::approachState(int c, int heading) const {
+    uint16_t approach = (uint16_t)(0xFu << (heading * 4));
+    if (currentOpen[c] & approach) return LightState::Green;
+    if (currentYellow[c] & approach) return LightState::Yellow;
+    return LightState::Red;
+}
+
+void SignalScheduler::schedule(int c, float time) {
+    events.push_back({ time, c, stamp[c] });
+    std::push_heap(events.begin(), events.end(), Later());
+}
+
+void SignalScheduler::advance(float now, std::vector<int>& changed) {
+    changed.clear();
+    while (!events.empty() && events.front().time <= now) {
+        std::pop_heap(events.begin(), events.end(), Later());
+        Event e = events.back();
+        events.pop_back();
+        if (e.stamp != stamp[e.c]) continue;
+        handled++;
+        if (actSlot[e.c] >= 0 && !holding(e.c, now)) stepActuated(act[actSlot[e.c]], plans[planOf[e.c]], now);
+        if (clearPending[e.c] && now >= clearFrom[e.c]) {
+            clearOpen[e.c] = currentOpen[e.c];
+            clearYellow[e.c] = currentYellow[e.c];
+            clearPending[e.c] = 0;
+        }
+        uint16_t o = openAt(e.c, now), y = yellowAt(e.c, now);
+        if (o != currentOpen[e.c] || y != currentYellow[e.c]) {
+            currentOpen[e.c] = o;
+            currentYellow[e.c] = y;
+            changed.push_back(e.c);
+        }
+        schedule(e.c, nextChange(e.c, now));
+    }
+    for (int slot : touched) {
+        std::fill(act[slot].queued, act[slot].queued + 16, (uint8_t)0);
+        act[slot].touched = false;
+    }
+    touched.clear();
+}
+
+void SignalScheduler::preempt(int c, uint16_t movements, float now, float until) {
+    if (isPreempted(c, now) && movements == preemptMask[c]) {
+        if (until > preemptUntil[c]) preemptWindow(c, movements, now, preemptFrom[c], until);
+        return;
+    }
+    preemptWindow(c, movements, now, now, until);
+}
+
+float SignalScheduler::greenFrom(int c, uint16_t movements, float now, float from) const {
+    // Already clearing for, or in, the same window
+    if (movements == preemptMask[c] && now >= clearFrom[c] && now < preemptUntil[c]) return preemptFrom[c];
+    // Nothing showing that would have to clear first
+    if (from <= now && ((openAt(c, now) | yellowAt(c, now)) & ~movements) == 0) return now;
+    float lead = clearanceTime(c);
+    float start = holding(c, now) ? now : std::max(now, from - lead);
+    return std::max(from, start + lead);
+}
+
+void SignalScheduler::preemptWindow(int c, uint16_t movements, float now, float from, float until) {
+    const float never = -std::numeric_limits<float>::infinity();
+    if (until <= from) {
+        // Cancelled: a window already clearing or open ends now and clears after itself
+        if (now >= clearFrom[c] && now < preemptUntil[c]) {
+            if (now < preemptFrom[c]) preemptMask[c] &= clearOpen[c];
+            preemptFrom[c] = std::min(preemptFrom[c], now);
+            preemptUntil[c] = now;
+        } else if (!holding(c, now)) {
+            clearFrom[c] = preemptFrom[c] = preemptUntil[c] = never;
+            preemptMask[c] = 0;
+            clearPending[c] = 0;
+        } else {
+            return;
+        }
+    } else if (movements == preemptMask[c] && now >= clearFrom[c] && now < preemptUntil[c]) {
+        // The same window, moved or stretched: its clearance has started, so only the end can change
+        if (until == preemptUntil[c]) return;
+        preemptUntil[c] = std::max(until, now);
+    } else {
+        float green = greenFrom(c, movements, now, from);
+        bool showing = holding(c, now);
+        float start = std::max(now, green - clearanceTime(c));
+        if (showing || green == now) start = now;
+        if (!showing && green == preemptFrom[c] && until == preemptUntil[c] && movements == preemptMask[c]) return;
+        // The clearance starts from whatever shows then: known now, or the fixed-time plan's state
+        // then; an actuated controller's is only known once it gets there
+        clearOpen[c] = start == now ? openAt(c, now) : planOpenAt(c, start);
+        clearYellow[c] = start == now ? yellowAt(c, now) : planYellowAt(c, start);
+        clearPending[c] = (uint8_t)(start > now && actSlot[c] >= 0);
+        clearFrom[c] = start;
+        preemptFrom[c] = green;
+        preemptUntil[c] = std::max(until, green);
+        preemptMask[c] = movements;
+    }
+    stamp[c]++;
+    schedule(c, now);
+}
+
+void SignalScheduler::save(SnapshotWriter& w) const {
+    w.array("signals.phases", phases);
+    w.array("signals.plans", plans);
+    w.array("signals.planOf", planOf);
+    w.array("signals.offset", offset);
+    w.array("signals.clearFrom", clearFrom);
+    w.array("signals.preemptFrom", preemptFrom);
+    w.array("signals.preemptUntil", preemptUntil);
+    w.array("signals.preemptMask", preemptMask);
+    w.array("signals.clearOpen", clearOpen);
+    w.array("signals.clearYellow", clearYellow);
+    w.array("signals.clearPending", clearPending);
+    w.array("signals.open", currentOpen);
+    w.array("signals.yellow", currentYellow);
+    w.array("signals.stamp", stamp);
+    w.array("signals.actSlot", actSlot);
+    w.array("signals.act", act);
+    w.array("signals.touched", touched);
+    w.array("signals.events", events);
+    w.value("signals.handled", handled);
+}
+
+bool SignalScheduler::load(const SnapshotReader& r) {
+    bool ok = r.array("signals.phases", phases) && r.array("signals.plans", plans) && r.array("signals.planOf", planOf) &&
+           r.array("signals.offset", offset) && r.array("signals.clearFrom", clearFrom) &&
+           r.array("signals.preemptFrom", preemptFrom) && r.array("signals.preemptUntil", preemptUntil) &&
+           r.array("signals.preemptMask", preemptMask) && r.array("signals.clearOpen", clearOpen) &&
+           r.array("signals.clearYellow", clearYellow) && r.array("signals.clearPending", clearPending) &&
+           r.array("signals.open", currentOpen) && r.array("signals.yellow", currentYellow) &&
+           r.array("signals.stamp", stamp) && r.array("signals.actSlot", actSlot) && r.array("signals.act", act) &&
+           r.array("signals.touched", touched) && r.array("signals.events", events) &&
+           r.value("signals.handled", handled);
+    size_t n = planOf.size();
+    if (!ok || offset.size() != n || clearFrom.size() != n || preemptFrom.size() != n || preemptUntil.size() != n ||
+        preemptMask.size() != n || clearOpen.size() != n || clearYellow.size() != n || clearPending.size() != n ||
+        currentOpen.size() != n || currentYellow.size() != n || stamp.size() != n || actSlot.size() != n) return false;
+
+    // Every index in range, so a foreign file fails here instead of on the next advance()
+    for (const Plan& p : plans) if (p.first > phases.size() || p.count > phases.size() - p.first) return false;
+    std::vector<uint8_t> slotUsed(act.size(), 0);
+    for (size_t c = 0; c < n; c++) {
+        if (planOf[c] >= plans.size()) return false;
+        int slot = actSlot[c];
+        if (slot == -1) continue;
+        if (slot < 0 || slot >= (int)act.size() || slotUsed[slot]++) return false;
+        if (act[slot].phase >= plans[planOf[c]].count || act[slot].interval > 2) return false;
+    }
+    for (int slot : touched) if (slot < 0 || slot >= (int)act.size()) return false;
+    for (const Event& e : events) if (e.c < 0 || e.c >= (int)n) return false;
+    return true;
+}
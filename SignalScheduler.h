@@ -0,0 +1,154 @@
+#ifndef SIGNALSCHEDULER_H
+#define SIGNALSCHEDULER_H
+
+#include "Snapshot.h"
+#include <vector>
+#include <cstdint>
+
+enum class LightState : uint8_t { Green, Yellow, Red };
+
+// Fixed-time signal controllers kept as data. A controller runs a phase plan: each phase lets a
+// set of movements go (one bit per movement, heading * 4 + exitDir as in IntersectionManager),
+// followed by yellow and an all-red clearance. Plans are shared, so a controller is its plan id,
+// an offset and a few bytes of cached state.
+//
+// A controller's state is a pure function of time (plan, offset and any preemption), so nothing
+// has to run per controller per tick: the next transition of every controller sits in a min-heap
+// and advance() only touches the controllers whose state changes. A preemption is a few more timed
+// events (its clearance, its window and the clearance after it); stale events are recognised by a
+// per-controller stamp.
+class SignalScheduler {
+public:
+    struct Phase {
+        uint16_t movements;
+        uint16_t pad; // zero, so equal plans save to equal bytes
+        float green;
+    };
+
+    int addPlan(const std::vector<Phase>& phases, float yellow, float allRed);
+    // Standard plan for a junction whose sides in `openings` (1 << RoadDir) carry roads: per axis
+    // a protected left-turn phase, then through and right turns. An axis with a single approach
+    // (the stem of a T) gets one phase for all of its movements.
+    int addStandardPlan(uint8_t openings, float throughGreen, float leftGreen, float yellow, float allRed);
+    static std::vector<Phase> standardPhases(uint8_t openings, float throughGreen, float leftGreen);
+
+    // Controller running `plan`, starting `offset` seconds into its cycle at time 0
+    int add(int plan, float offset);
+    int count() const { return (int)planOf.size(); }
+    void clear();
+
+    // Actuated control: after minGreen a phase's green is extended `gap` seconds at a time while
+    // cars still queue for or arrive on its movements, and ends early (gaps out) once they stop.
+    // It runs to maxGreen only if someone else is waiting; phases nobody waits for are skipped.
+    // Its state follows these decisions, so unlike a fixed-time controller it is only known up to
+    // the current interval.
+    struct Actuation { float minGreen, maxGreen, gap; };
+    int addActuated(int plan, const Actuation& a);
+    bool isActuated(int c) const { return actSlot[c] >= 0; }
+    // Demand measured this tick, read by the next advance(): `cars` queued on an approach whose
+    // first car waits to make `movement` (the ones behind it can't go before it does), or a car
+    // that just started approaching for `movement` with no queue ahead of it
+    void reportQueued(int c, int movement, int cars);
+    void reportArrival(int c, int movement);
+
+    float cycleLength(int plan) const { return plans[plan].cycle; }
+    int phaseCount(int plan) const { return plans[plan].count; }
+    const Phase& phase(int plan, int k) const { return phases[plans[plan].first + k]; }
+    int planOfController(int c) const { return planOf[c]; }
+
+    // Movements that may enter / are in their yellow at time t
+    uint16_t openAt(int c, float t) const;
+    uint16_t yellowAt(int c, float t) const;
+    LightState movementStateAt(int c, int movement, float t) const;
+    // First time after t at which the controller may change
+    float nextChange(int c, float t) const;
+
+    // State as of the last advance()
+    uint16_t open(int c) const { return currentOpen[c]; }
+    uint16_t yellow(int c) const { return currentYellow[c]; }
+    // Green if any movement from the approach may go, yellow if any is clearing, red otherwise
+    LightState approachState(int c, int heading) const;
+
+    // Pops every transition due by `now` and appends the controllers whose state changed
+    void advance(float now, std::vector<int>& changed);
+
+    // Gives `movements` alone the green until `until`; the next advance() applies it
+    void preempt(int c, uint16_t movements, float now, float until);
+    // Same for a window [from, until) that may lie in the future, replacing any earlier window.
+    // An empty window (until <= from) cancels it. Whatever else was green first runs through its
+    // yellow and all-red, in the clearanceTime() before `from`; a window asked for sooner than that
+    // starts its clearance now and gets its green late (see greenFrom). When the window ends, its
+    // movements clear the same way before the plan takes over again.
+    void preemptWindow(int c, uint16_t movements, float now, float from, float until);
+    // When a window for `movements` asked for now, starting at `from`, would get its green
+    float greenFrom(int c, uint16_t movements, float now, float from) const;
+    float clearanceTime(int c) const { return plans[planOf[c]].yellow + plans[planOf[c]].allRed; }
+    // In the window's green
+    bool isPreempted(int c, float t) const { return t >= preemptFrom[c] && t < preemptUntil[c]; }
+
+    uint64_t eventsHandled() const { return handled; }
+
+    // Plans, controllers and pending transitions, restored exactly as they were
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r);
+
+private:
+    struct Plan {
+        uint32_t first;  // into phases
+        uint8_t count;
+        uint8_t pad[3];
+        float yellow, allRed, cycle;
+    };
+    struct Event { float time; int c; uint32_t stamp; };
+    struct Later {
+        bool operator()(const Event& a, const Event& b) const { return a.time > b.time; }
+    };
+    // Where a controller is in its cycle: phase index, interval (0 green, 1 yellow, 2 all-red)
+    // and the time that interval ends
+    struct Position { int phase; int interval; double end; };
+    struct Actuated {
+        Actuation params;
+        uint8_t phase{0}, interval{0};
+        bool touched{false};
+        uint8_t pad0{0};
+        float greenStart{0.0f}, end{0.0f};
+        uint16_t arrived{0};    // movements with an arrival since their phase last decided
+        uint8_t queued[16]{};   // cars per movement, this tick
+        uint8_t pad1[2]{};
+    };
+
+    std::vector<Phase> phases;
+    std::vector<Plan> plans;
+
+    // Per controller
+    std::vector<uint32_t> planOf;
+    std::vector<float> offset;
+    std::vector<float> clearFrom;            // start of the clearance before the window
+    std::vector<float> preemptFrom;
+    std::vector<float> preemptUntil;
+    std::vector<uint16_t> preemptMask;
+    std::vector<uint16_t> clearOpen;         // green and yellow as the clearance started
+    std::vector<uint16_t> clearYellow;
+    std::vector<uint8_t> clearPending;       // actuated: taken by advance() once the clearance starts
+    std::vector<uint16_t> currentOpen;
+    std::vector<uint16_t> currentYellow;
+    std::vector<uint32_t> stamp; // bumped when a controller's pending event is superseded
+    std::vector<int> actSlot;    // into act, -1 for fixed-time
+
+    std::vector<Actuated> act;
+    std::vector<int> touched;    // act slots with demand reported this tick
+
+    std::vector<Event> events;   // min-heap on time (std::push_heap with Later)
+    uint64_t handled{0};
+
+    Position locate(int c, float t) const;
+    // The plan's state, preemption aside
+    uint16_t planOpenAt(int c, float t) const;
+    uint16_t planYellowAt(int c, float t) const;
+    // In a clearance or window, or the clearance after it; actuated decisions wait meanwhile
+    bool holding(int c, float t) const { return t >= clearFrom[c] && t < preemptUntil[c] + clearanceTime(c); }
+    void stepActuated(Actuated& a, const Plan& p, float now);
+    void schedule(int c, float time);
+};
+
+#endif
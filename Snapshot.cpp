@@ -0,0 +1,110 @@
+#include "Snapshot.h"
+
+static const char MAGIC[4] = { 'C', 'S', 'N', 'P' };
+static const uint32_t ENDIAN_MARK = 0x01020304;
+
+bool SnapshotWriter::open(const char* path) {
+    if (file) fclose(file);
+    file = fopen(path, "wb");
+    toMemory = false;
+    failed = file == nullptr;
+    written = 0;
+    if (failed) return false;
+    uint32_t header[2] = { SNAPSHOT_VERSION, ENDIAN_MARK };
+    failed = !put(MAGIC, 4) || !put(header, sizeof(header));
+    return !failed;
+}
+
+bool SnapshotWriter::open() {
+    if (file) fclose(file);
+    file = nullptr;
+    toMemory = true;
+    memory.clear();
+    written = 0;
+    uint32_t header[2] = { SNAPSHOT_VERSION, ENDIAN_MARK };
+    failed = !put(MAGIC, 4) || !put(header, sizeof(header));
+    return !failed;
+}
+
+bool SnapshotWriter::put(const void* data, size_t size) {
+    written += size;
+    if (toMemory) {
+        const uint8_t* bytes = (const uint8_t*)data;
+        memory.insert(memory.end(), bytes, bytes + size);
+        return true;
+    }
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+void SnapshotWriter::section(const char* name, uint32_t elementSize, uint64_t count, const void* data) {
+    if ((!file && !toMemory) || failed) return;
+    uint16_t length = (uint16_t)strlen(name);
+    failed = !put(&length, sizeof(length)) || !put(name, length) || !put(&elementSize, sizeof(elementSize)) ||
+             !put(&count, sizeof(count)) || !put(data, (size_t)(elementSize * count));
+}
+
+bool SnapshotWriter::close() {
+    if (!file && !toMemory) return false;
+    uint16_t end = 0; // a nameless section ends the file, so a cut-off file is told apart
+    if (!failed) failed = !put(&end, sizeof(end));
+    if (file && fclose(file) != 0) failed = true;
+    file = nullptr;
+    toMemory = false;
+    return !failed;
+}
+
+bool SnapshotReader::open(const char* path) {
+    data.clear();
+    sections.clear();
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size > 0) {
+        data.resize((size_t)size);
+        if (fread(data.data(), 1, data.size(), f) != data.size()) data.clear();
+    }
+    fclose(f);
+    return index();
+}
+
+bool SnapshotReader::open(const std::vector<uint8_t>& bytes) {
+    data = bytes;
+    sections.clear();
+    return index();
+}
+
+bool SnapshotReader::index() {
+    uint32_t header[2];
+    if (data.size() < 4 + sizeof(header) || memcmp(data.data(), MAGIC, 4) != 0) return false;
+    memcpy(header, &data[4], sizeof(header));
+    if (header[0] != SNAPSHOT_VERSION || header[1] != ENDIAN_MARK) return false;
+
+    size_t at = 4 + sizeof(header);
+    while (at + sizeof(uint16_t) <= data.size()) {
+        uint16_t length;
+        memcpy(&length, &data[at], sizeof(length));
+        at += sizeof(length);
+        if (length == 0) return true;
+        Section s;
+        if (at + length + sizeof(uint32_t) + sizeof(uint64_t) > data.size()) break;
+        s.name.assign((const char*)&data[at], length);
+        at += length;
+        memcpy(&s.elementSize, &data[at], sizeof(s.elementSize));
+        at += sizeof(s.elementSize);
+        memcpy(&s.count, &data[at], sizeof(s.count));
+        at += sizeof(s.count);
+        s.offset = at;
+        if (s.elementSize && s.count > (data.size() - at) / s.elementSize) break;
+        at += (size_t)(s.elementSize * s.count);
+        sections.push_back(s);
+    }
+    sections.clear(); // cut off before the end
+    return false;
+}
+
+const SnapshotReader::Section* SnapshotReader::find(const char* name) const {
+    for (const Section& s : sections) if (s.name == name) return &s;
+    return nullptr;
+}
@@ -0,0 +1,99 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Versioned binary snapshots. A file is a header and a list of named sections, each one array of
+// plain values written with a single fwrite, so the state of a million vehicles goes out as a few
+// large writes and comes back as a few memcpys. Sections are looked up by name on load: one the
+// reader doesn't ask for is skipped, one it asks for and doesn't find fails the load, and an
+// array whose element size changed since it was written is refused instead of misread.
+// Values are stored as the machine lays them out; a file written on a machine of the other byte
+// order is refused.
+const uint32_t SNAPSHOT_VERSION = 1;
+
+class SnapshotWriter {
+public:
+    SnapshotWriter() = default;
+    ~SnapshotWriter() { if (file) fclose(file); }
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    bool open(const char* path);
+    // Into memory instead, for keyframes; take the bytes with buffer() after close()
+    bool open();
+    template<class T> void array(const char* name, const T* data, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot sections hold plain values");
+        section(name, sizeof(T), count, data);
+    }
+    template<class T> void array(const char* name, const std::vector<T>& v) { array(name, v.data(), v.size()); }
+    template<class T> void value(const char* name, const T& v) { array(name, &v, 1); }
+    void text(const char* name, const std::string& s) { array(name, s.data(), s.size()); }
+    // False if any write failed
+    bool close();
+
+    uint64_t bytes() const { return written; }
+    std::vector<uint8_t>& buffer() { return memory; }
+
+private:
+    FILE* file{nullptr};
+    bool toMemory{false};
+    bool failed{false};
+    uint64_t written{0};
+    std::vector<uint8_t> memory;
+
+    void section(const char* name, uint32_t elementSize, uint64_t count, const void* data);
+    bool put(const void* data, size_t size);
+};
+
+class SnapshotReader {
+public:
+    // Reads the whole file and indexes its sections; false if it isn't a snapshot of this version
+    bool open(const char* path);
+    // From a snapshot held in memory (a SnapshotWriter's buffer)
+    bool open(const std::vector<uint8_t>& bytes);
+
+    bool has(const char* name) const { return find(name) != nullptr; }
+    template<class T> bool array(const char* name, std::vector<T>& out) const {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot sections hold plain values");
+        const Section* s = find(name);
+        if (!s || s->elementSize != sizeof(T)) return false;
+        out.resize(s->count);
+        if (s->count) memcpy(out.data(), &data[s->offset], s->count * sizeof(T));
+        return true;
+    }
+    template<class T> bool value(const char* name, T& out) const {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot sections hold plain values");
+        const Section* s = find(name);
+        if (!s || s->elementSize != sizeof(T) || s->count != 1) return false;
+        memcpy(&out, &data[s->offset], sizeof(T));
+        return true;
+    }
+    bool text(const char* name, std::string& out) const {
+        const Section* s = find(name);
+        if (!s || s->elementSize != 1) return false;
+        out.assign((const char*)&data[s->offset], s->count);
+        return true;
+    }
+
+private:
+    struct Section {
+        std::string name;
+        uint32_t elementSize;
+        uint64_t count;
+        size_t offset; // into data
+    };
+
+    std::vector<uint8_t> data;
+    std::vector<Section> sections;
+
+    const Section* find(const char* name) const;
+    bool index();
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include "SweptCollision.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+static const float RADIUS = std::sqrt(SweptCollision::HALF_WIDTH * SweptCollision::HALF_WIDTH +
+                                      SweptCollision::HALF_LENGTH * SweptCollision::HALF_LENGTH);
+static const float CONTACT_SLACK = 0.02f; // distance kept between footprints after a clamp
+static const float SKIN = 0.01f;          // the solver keeps footprints at least this far apart
+
+// Oriented box on the ground plane: centre, unit heading, half extents along and across it
+struct Box { float x, z, hx, hz, halfLength, halfWidth; };
+
+static Box footprint(float x, float z, float hx, float hz) {
+    return { x, z, hx, hz, SweptCollision::HALF_LENGTH, SweptCollision::HALF_WIDTH };
+}
+
+// Region a footprint covers while driving `length` straight ahead from (x, z)
+static Box sweptFootprint(float x, float z, float hx, float hz, float length) {
+    return { x + hx * length * 0.5f, z + hz * length * 0.5f, hx, hz,
+             SweptCollision::HALF_LENGTH + length * 0.5f, SweptCollision::HALF_WIDTH };
+}
+
+// Everything a body covers when it makes `distance` of its move: up to two swept boxes,
+// before and after its turn. Returns how many.
+static int sweptRegion(const SweptCollision::Body& b, float distance, Box out[2]) {
+    float straight = std::min(distance, b.turnAt);
+    out[0] = sweptFootprint(b.x, b.z, b.hx, b.hz, straight);
+    if (distance <= b.turnAt) return 1;
+    out[1] = sweptFootprint(b.x + b.hx * b.turnAt, b.z + b.hz * b.turnAt, b.ex, b.ez, distance - b.turnAt);
+    return 2;
+}
+
+// Earliest t in [0, 1] at which box a, moving by (rx, rz), comes within `skin` of box b;
+// -1 if it doesn't. `overlapping` is set when they are already that close at t = 0.
+static float timeOfImpact(const Box& a, const Box& b, float rx, float rz, float skin, bool& overlapping) {
+    const float axes[4][2] = { { a.hx, a.hz }, { -a.hz, a.hx }, { b.hx, b.hz }, { -b.hz, b.hx } };
+    float enter = -std::numeric_limits<float>::infinity();
+    float exit = std::numeric_limits<float>::infinity();
+    overlapping = false;
+
+    for (const auto& l : axes) {
+        float ra = a.halfLength * fabsf(a.hx * l[0] + a.hz * l[1]) + a.halfWidth * fabsf(-a.hz * l[0] + a.hx * l[1]);
+        float rb = b.halfLength * fabsf(b.hx * l[0] + b.hz * l[1]) + b.halfWidth * fabsf(-b.hz * l[0] + b.hx * l[1]);
+        float reach = ra + rb + skin;
+        float s = (b.x - a.x) * l[0] + (b.z - a.z) * l[1];
+        float v = rx * l[0] + rz * l[1];
+        if (fabsf(v) < 1e-9f) {
+            if (fabsf(s) >= reach) return -1.0f; // separated on this axis for the whole tick
+            continue;
+        }
+        float t1 = (s - reach) / v, t2 = (s + reach) / v;
+        enter = std::max(enter, std::min(t1, t2));
+        exit = std::min(exit, std::max(t1, t2));
+        if (enter >= exit) return -1.0f;
+    }
+    if (exit <= 0.0f || enter >= 1.0f) return -1.0f;
+    overlapping = enter < 0.0f;
+    return std::max(enter, 0.0f);
+}
+
+SweptCollision::SweptCollision(float cellSize) : cell(cellSize) {}
+
+uint32_t SweptCollision::hashCell(int cx, int cz) const {
+    return ((uint32_t)cx * 73856093u ^ (uint32_t)cz * 19349663u) & bucketMask;
+}
+
+void SweptCollision::build(const std::vector<Body>& bodies) {
+    int n = (int)bodies.size();
+    uint32_t buckets = 16;
+    while (buckets < (uint32_t)n * 2) buckets <<= 1;
+    bucketMask = buckets - 1;
+
+    cellX.resize(n); cellZ.resize(n); bucketOf.resize(n); sorted.resize(n);
+    cellStart.assign(buckets + 1, 0);
+    for (int i = 0; i < n; i++) {
+        cellX[i] = (int)floorf(bodies[i].x / cell);
+        cellZ[i] = (int)floorf(bodies[i].z / cell);
+        bucketOf[i] = hashCell(cellX[i], cellZ[i]);
+        cellStart[bucketOf[i] + 1]++;
+    }
+    for (uint32_t b = 0; b < buckets; b++) cellStart[b + 1] += cellStart[b];
+    std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+    for (int i = 0; i < n; i++) sorted[fill[bucketOf[i]]++] = i;
+}
+
+template<class Fn> void SweptCollision::forEachNear(int i, int reach, Fn fn) const {
+    for (int cz = cellZ[i] - reach; cz <= cellZ[i] + reach; cz++) {
+        for (int cx = cellX[i] - reach; cx <= cellX[i] + reach; cx++) {
+            uint32_t b = hashCell(cx, cz);
+            for (uint32_t k = cellStart[b]; k < cellStart[b + 1]; k++) {
+                int j = sorted[k];
+                // Other cells can share the bucket; only take bodies really in this one
+                if (j != i && cellX[j] == cx && cellZ[j] == cz) fn(j);
+            }
+        }
+    }
+}
+
+// How far body a can drive before coming into contact with an obstacle region; a.distance if it
+// never does. A turned footprint that would start inside an obstacle ahead of it stops it before
+// the corner. Contact with something behind (a car queued in the lane being turned into) doesn't:
+// that one gives way instead, otherwise the two would wait for each other forever.
+static float clearDistance(const SweptCollision::Body& a, const Box& obstacle) {
+    bool overlapping;
+    float straight = std::min(a.distance, a.turnAt);
+    float t = timeOfImpact(footprint(a.x, a.z, a.hx, a.hz), obstacle, a.hx * straight, a.hz * straight, SKIN, overlapping);
+    if (t >= 0.0f) {
+        if (!overlapping) return std::max(0.0f, t * straight - CONTACT_SLACK);
+        // Already in contact: only forbid moves that push further in
+        if (a.hx * (obstacle.x - a.x) + a.hz * (obstacle.z - a.z) > 0.0f) return 0.0f;
+    }
+    if (a.distance <= a.turnAt) return a.distance;
+
+    float cx = a.x + a.hx * a.turnAt, cz = a.z + a.hz * a.turnAt, rest = a.distance - a.turnAt;
+    t = timeOfImpact(footprint(cx, cz, a.ex, a.ez), obstacle, a.ex * rest, a.ez * rest, SKIN, overlapping);
+    if (t < 0.0f) return a.distance;
+    if (!overlapping) return std::max(0.0f, a.turnAt + t * rest - CONTACT_SLACK);
+    if (a.ex * (obstacle.x - cx) + a.ez * (obstacle.z - cz) > 0.0f) return std::max(0.0f, a.turnAt - CONTACT_SLACK);
+    return a.distance;
+}
+
+void SweptCollision::resolve(const std::vector<Body>& bodies, std::vector<float>& share) {
+    int n = (int)bodies.size();
+    build(bodies);
+    share.assign(n, 1.0f);
+    float maxMove = 0.0f;
+    for (const Body& b : bodies) maxMove = std::max(maxMove, b.distance);
+    int reach = std::max(1, (int)ceilf((2.0f * RADIUS + 2.0f * maxMove) / cell));
+
+    // Whether i gives way to j. If one of them would hit the other even if that one stood still,
+    // it is the one driving into the other. When only the combined moves collide (crossing paths)
+    // the one that has the other more squarely in front of it gives way; near ties both do.
+    auto drivesInto = [&](const Body& a, const Body& b) {
+        Box still = footprint(b.x, b.z, b.hx, b.hz);
+        return clearDistance(a, still) < a.distance;
+    };
+    auto yields = [&](int i, int j) {
+        const Body& a = bodies[i];
+        const Body& b = bodies[j];
+        if (a.pinned) return false;
+        if (b.pinned) return true;
+        if (drivesInto(a, b)) return true;
+        if (drivesInto(b, a)) return false;
+        float ex = b.x - a.x, ez = b.z - a.z;
+        float d = sqrtf(ex * ex + ez * ez);
+        if (d < 1e-6f) return true;
+        float aheadA = (ex * a.hx + ez * a.hz) / d;
+        float aheadB = -(ex * b.hx + ez * b.hz) / d;
+        return aheadA >= aheadB - 0.1f;
+    };
+
+    // Share of its move body i may make. Each body it gives way to is an obstacle covering that
+    // body's whole move this tick, so wherever i stops it is clear of the other at every moment.
+    auto allowedShare = [&](int i) {
+        const Body& a = bodies[i];
+        float allowed = a.distance * share[i];
+        forEachNear(i, reach, [&](int j) {
+            const Body& b = bodies[j];
+            float ex = b.x - a.x, ez = b.z - a.z;
+            float limit = 2.0f * RADIUS + a.distance + b.distance * share[j];
+            if (ex * ex + ez * ez > limit * limit) return;
+
+            Box region[2];
+            int parts = sweptRegion(b, b.distance * share[j], region);
+            float clear = a.distance;
+            for (int k = 0; k < parts; k++) clear = std::min(clear, clearDistance(a, region[k]));
+            if (clear < allowed && yields(i, j)) allowed = clear;
+        });
+        return a.distance > 1e-6f ? allowed / a.distance : share[i];
+    };
+
+    // Holding a body back changes what the ones near it can do: re-check them until nothing moves.
+    // Shares only ever shrink, so this settles; queues of cars settle one car per step.
+    work.clear();
+    queued.assign(n, 1);
+    for (int i = n - 1; i >= 0; i--) work.push_back(i);
+    while (!work.empty()) {
+        int i = work.back();
+        work.pop_back();
+        queued[i] = 0;
+        if (bodies[i].pinned) continue;
+        float f = allowedShare(i);
+        if (f >= share[i]) continue;
+        share[i] = f;
+        forEachNear(i, reach, [&](int j) {
+            if (!queued[j]) { queued[j] = 1; work.push_back(j); }
+        });
+    }
+    for (int i = 0; i < n; i++) if (share[i] < 1.0f) contactCount++;
+}
+
+int SweptCollision::countOverlaps(const std::vector<Body>& bodies) {
+    build(bodies);
+    int overlaps = 0;
+    for (int i = 0; i < (int)bodies.size(); i++) {
+        forEachNear(i, 1, [&](int j) {
+            if (j < i) return;
+            const Body& a = bodies[i];
+            const Body& b = bodies[j];
+            bool overlapping;
+            timeOfImpact(footprint(a.x, a.z, a.hx, a.hz), footprint(b.x, b.z, b.hx, b.hz), 0.0f, 0.0f,
+                         -1e-4f, overlapping); // touching is not overlapping
+            if (overlapping) overlaps++;
+        });
+    }
+    return overlaps;
+}
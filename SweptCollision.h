@@ -0,0 +1,55 @@
+#ifndef SWEPTCOLLISION_H
+#define SWEPTCOLLISION_H
+
+#include <vector>
+#include <cstdint>
+
+// Continuous collision check for vehicle footprints on the ground plane (x, z).
+// Each tick every body proposes a move along its heading, possibly turning once on the way
+// (routes are polylines, so a car's heading switches at a corner). A hashed uniform grid finds the
+// pairs that can touch, and a swept separating-axis test on the oriented boxes gives the time of
+// impact. The body that drives into the other one is held back to just before contact (both when
+// neither is clearly at fault), so a move never ends inside another footprint.
+class SweptCollision {
+public:
+    // Footprint of the car model in Vehicle::draw
+    static constexpr float HALF_WIDTH = 0.325f;
+    static constexpr float HALF_LENGTH = 0.55f;
+
+    struct Body {
+        float x, z;     // centre at the start of the tick
+        float hx, hz;   // unit heading, also the direction of travel
+        float distance; // proposed move
+        float turnAt;   // distance after which the heading becomes (ex, ez); >= distance if it doesn't turn
+        float ex, ez;
+        bool pinned;    // never held back, everything else gives way to it
+    };
+
+    explicit SweptCollision(float cellSize = 2.0f);
+
+    // Writes the share of its move each body may make, in [0, 1]
+    void resolve(const std::vector<Body>& bodies, std::vector<float>& share);
+
+    // Pairs of footprints that overlap at the bodies' start positions
+    int countOverlaps(const std::vector<Body>& bodies);
+
+    // Moves that had to be cut short, over all resolve() calls
+    uint64_t contacts() const { return contactCount; }
+
+private:
+    float cell;
+    std::vector<uint32_t> cellStart; // hash bucket -> first entry in sorted, size buckets + 1
+    std::vector<int> sorted;         // body ids grouped by bucket
+    std::vector<uint32_t> bucketOf;  // per body
+    std::vector<int> cellX, cellZ;   // per body
+    std::vector<int> work;           // bodies to re-check in resolve()
+    std::vector<uint8_t> queued;
+    uint32_t bucketMask{0};
+    uint64_t contactCount{0};
+
+    uint32_t hashCell(int cx, int cz) const;
+    void build(const std::vector<Body>& bodies);
+    template<class Fn> void forEachNear(int i, int reach, Fn fn) const;
+};
+
+#endif
@@ -0,0 +1,320 @@
+#include "Telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const char FILE_MAGIC[4] = { 'C', 'T', 'E', 'L' };
+const char CHUNK_MAGIC[4] = { 'T', 'C', 'H', 'K' };
+const char INDEX_MAGIC[4] = { 'C', 'T', 'I', 'X' };
+const uint32_t ENDIAN_MARK = 0x01020304;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version, endian;
+    Telemetry::Steps steps;
+};
+
+struct ChunkHeader {
+    char magic[4];
+    uint32_t frames;
+    float t0, t1;
+    uint64_t rows;
+    uint64_t bytes; // of frames that follow
+};
+
+// A frame: this header, then its columns back to back
+struct FrameHeader {
+    float time;
+    uint32_t rows;
+    uint32_t bytes[Telemetry::COLUMNS];
+};
+
+struct Footer {
+    uint64_t indexOffset;
+    uint64_t count;
+    char magic[4];
+    uint32_t spare;
+};
+
+// Offsets past 2 GB, where long is 32 bits
+bool seek(FILE* f, uint64_t offset, int whence) {
+#ifdef _WIN32
+    return _fseeki64(f, (__int64)offset, whence) == 0;
+#else
+    return fseeko(f, (off_t)offset, whence) == 0;
+#endif
+}
+
+uint64_t tell(FILE* f) {
+#ifdef _WIN32
+    return (uint64_t)_ftelli64(f);
+#else
+    return (uint64_t)ftello(f);
+#endif
+}
+
+}
+
+int64_t Telemetry::quantize(float value, float step) {
+    return (int64_t)llround((double)value / step);
+}
+
+bool TelemetryWriter::open(const char* path, const Params& p) {
+    close();
+    file = fopen(path, "wb");
+    if (!file) return false;
+    params = p;
+    params.chunkFrames = std::max(1, params.chunkFrames);
+    params.chunkRows = std::max<uint64_t>(1, params.chunkRows);
+    params.ringFrames = std::max(1, params.ringFrames);
+    ring.assign(params.ringFrames, Slot{});
+    head = 0;
+    tail = 0;
+    stopping = false;
+    filling = false;
+    dropped = 0;
+    written = 0;
+    rowCount = 0;
+    byteCount = 0;
+    failed = false;
+    chunk.clear();
+    for (std::vector<int64_t>& v : prev) v.clear();
+    current = {};
+    index.clear();
+
+    FileHeader h{};
+    memcpy(h.magic, FILE_MAGIC, 4);
+    h.version = Telemetry::VERSION;
+    h.endian = ENDIAN_MARK;
+    h.steps = params.steps;
+    put(&h, sizeof(h));
+    worker = std::thread(&TelemetryWriter::run, this);
+    return true;
+}
+
+Telemetry::Row* TelemetryWriter::frame(float time, uint32_t rows) {
+    filling = false;
+    if (!file) return nullptr;
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= ring.size()) { // every slot still queued
+        dropped++;
+        return nullptr;
+    }
+    Slot& s = ring[h % ring.size()];
+    s.time = time;
+    s.rows.resize(rows); // slots keep their size, so this only allocates while traffic grows
+    filling = true;
+    return s.rows.data();
+}
+
+void TelemetryWriter::commit() {
+    if (!filling) return;
+    filling = false;
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool TelemetryWriter::close() {
+    if (!file) return true;
+    stopping.store(true, std::memory_order_release);
+    worker.join();
+    Footer f{};
+    f.indexOffset = byteCount.load();
+    f.count = index.size();
+    memcpy(f.magic, INDEX_MAGIC, 4);
+    put(index.data(), index.size() * sizeof(Telemetry::ChunkInfo));
+    put(&f, sizeof(f));
+    bool ok = fclose(file) == 0 && !failed;
+    file = nullptr;
+    return ok;
+}
+
+void TelemetryWriter::run() {
+    for (;;) {
+        bool stop = stopping.load(std::memory_order_acquire); // before looking, so the last frames are seen
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            if (stop) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        encode(ring[t % ring.size()]);
+        tail.store(t + 1, std::memory_order_release);
+    }
+    flushChunk();
+}
+
+void TelemetryWriter::encode(const Slot& s) {
+    const Telemetry::Steps& q = params.steps;
+    if (current.frames == 0) { // a chunk decodes on its own: its first frame is against zero
+        for (std::vector<int64_t>& v : prev) std::fill(v.begin(), v.end(), 0);
+        current.t0 = s.time;
+    }
+    for (std::vector<uint8_t>& c : column) c.clear();
+    uint32_t rows = 0, lastId = 0;
+    for (const Telemetry::Row& r : s.rows) {
+        if (r.id >= Telemetry::MAX_ID) {
+            failed = true;
+            continue;
+        }
+        if (r.id >= prev[0].size()) for (std::vector<int64_t>& v : prev) v.resize(r.id + 1, 0);
+        Telemetry::putVarint(column[0], Telemetry::zigzag((int64_t)r.id - lastId));
+        lastId = r.id;
+        int64_t value[Telemetry::COLUMNS - 1] = { Telemetry::quantize(r.x, q.position), Telemetry::quantize(r.z, q.position),
+                                                  Telemetry::quantize(r.speed, q.speed), Telemetry::quantize(r.lane, q.lane),
+                                                  r.tile };
+        for (int k = 0; k < Telemetry::COLUMNS - 1; k++) {
+            Telemetry::putVarint(column[k + 1], Telemetry::zigzag(value[k] - prev[k][r.id]));
+            prev[k][r.id] = value[k];
+        }
+        rows++;
+    }
+
+    FrameHeader h{};
+    h.time = s.time;
+    h.rows = rows;
+    for (int k = 0; k < Telemetry::COLUMNS; k++) h.bytes[k] = (uint32_t)column[k].size();
+    const uint8_t* bytes = (const uint8_t*)&h;
+    chunk.insert(chunk.end(), bytes, bytes + sizeof(h));
+    for (const std::vector<uint8_t>& c : column) chunk.insert(chunk.end(), c.begin(), c.end());
+    current.t1 = s.time;
+    current.frames++;
+    current.rows += rows;
+    written++;
+    rowCount += rows;
+    if (current.frames >= (uint32_t)params.chunkFrames || current.rows >= params.chunkRows) flushChunk();
+}
+
+void TelemetryWriter::flushChunk() {
+    if (current.frames == 0) return;
+    ChunkHeader h{};
+    memcpy(h.magic, CHUNK_MAGIC, 4);
+    h.frames = current.frames;
+    h.t0 = current.t0;
+    h.t1 = current.t1;
+    h.rows = current.rows;
+    h.bytes = chunk.size();
+    current.offset = byteCount.load();
+    put(&h, sizeof(h));
+    put(chunk.data(), chunk.size());
+    index.push_back(current);
+    current = {};
+    chunk.clear();
+}
+
+bool TelemetryWriter::put(const void* data, size_t size) {
+    if (size && fwrite(data, 1, size, file) != size) {
+        failed = true;
+        return false;
+    }
+    byteCount += size;
+    return true;
+}
+
+bool TelemetryReader::open(const char* path) {
+    close();
+    file = fopen(path, "rb");
+    if (!file) return false;
+    FileHeader h;
+    if (fread(&h, sizeof(h), 1, file) != 1 || memcmp(h.magic, FILE_MAGIC, 4) != 0 || h.version != Telemetry::VERSION ||
+        h.endian != ENDIAN_MARK || !(h.steps.position > 0.0f && h.steps.speed > 0.0f && h.steps.lane > 0.0f)) {
+        close();
+        return false;
+    }
+    quant = h.steps;
+    seek(file, 0, SEEK_END);
+    uint64_t size = tell(file);
+
+    Footer f;
+    if (size >= sizeof(h) + sizeof(f) && seek(file, size - sizeof(f), SEEK_SET) && fread(&f, sizeof(f), 1, file) == 1 &&
+        memcmp(f.magic, INDEX_MAGIC, 4) == 0 && f.indexOffset >= sizeof(h) &&
+        f.count <= (size - sizeof(f) - f.indexOffset) / sizeof(Telemetry::ChunkInfo)) {
+        index.resize((size_t)f.count);
+        if (seek(file, f.indexOffset, SEEK_SET) &&
+            fread(index.data(), sizeof(Telemetry::ChunkInfo), index.size(), file) == index.size()) return true;
+        index.clear();
+    }
+
+    // No index: walk the chunks that were written whole
+    uint64_t at = sizeof(h);
+    ChunkHeader c;
+    while (at + sizeof(c) <= size && seek(file, at, SEEK_SET) && fread(&c, sizeof(c), 1, file) == 1 &&
+           memcmp(c.magic, CHUNK_MAGIC, 4) == 0 && c.bytes <= size - at - sizeof(c)) {
+        Telemetry::ChunkInfo info{};
+        info.offset = at;
+        info.rows = c.rows;
+        info.t0 = c.t0;
+        info.t1 = c.t1;
+        info.frames = c.frames;
+        index.push_back(info);
+        at += sizeof(c) + c.bytes;
+    }
+    return true;
+}
+
+void TelemetryReader::close() {
+    if (file) fclose(file);
+    file = nullptr;
+    index.clear();
+}
+
+size_t TelemetryReader::firstChunk(float t) const {
+    return std::lower_bound(index.begin(), index.end(), t, [](const Telemetry::ChunkInfo& c, float v) { return c.t1 < v; }) -
+           index.begin();
+}
+
+bool TelemetryReader::readChunk(size_t c) {
+    frameTime.clear();
+    frameStart.assign(1, 0);
+    rows.clear();
+    ChunkHeader h;
+    if (!file || c >= index.size() || !seek(file, index[c].offset, SEEK_SET) || fread(&h, sizeof(h), 1, file) != 1 ||
+        memcmp(h.magic, CHUNK_MAGIC, 4) != 0) return false;
+    buffer.resize((size_t)h.bytes);
+    if (fread(buffer.data(), 1, buffer.size(), file) != buffer.size()) return false;
+    for (std::vector<int64_t>& v : prev) std::fill(v.begin(), v.end(), 0);
+    rows.reserve((size_t)h.rows);
+
+    const uint8_t* p = buffer.data();
+    const uint8_t* end = p + buffer.size();
+    for (uint32_t f = 0; f < h.frames; f++) {
+        FrameHeader fh;
+        if ((size_t)(end - p) < sizeof(fh)) return false;
+        memcpy(&fh, p, sizeof(fh));
+        p += sizeof(fh);
+        const uint8_t* col[Telemetry::COLUMNS];
+        const uint8_t* colEnd[Telemetry::COLUMNS];
+        for (int k = 0; k < Telemetry::COLUMNS; k++) {
+            if ((size_t)(end - p) < fh.bytes[k]) return false;
+            col[k] = p;
+            colEnd[k] = p += fh.bytes[k];
+        }
+        size_t base = rows.size();
+        rows.resize(base + fh.rows);
+        uint32_t id = 0;
+        for (uint32_t i = 0; i < fh.rows; i++) {
+            uint64_t u;
+            if (!Telemetry::getVarint(col[0], colEnd[0], u)) return false;
+            int64_t next = (int64_t)id + Telemetry::unzigzag(u);
+            if (next < 0 || next >= (int64_t)Telemetry::MAX_ID) return false;
+            id = (uint32_t)next;
+            if (id >= prev[0].size()) for (std::vector<int64_t>& v : prev) v.resize(id + 1, 0);
+            for (int k = 0; k < Telemetry::COLUMNS - 1; k++) {
+                if (!Telemetry::getVarint(col[k + 1], colEnd[k + 1], u)) return false;
+                prev[k][id] += Telemetry::unzigzag(u);
+            }
+            Telemetry::Row& r = rows[base + i];
+            r.id = id;
+            r.x = (float)(prev[0][id] * (double)quant.position);
+            r.z = (float)(prev[1][id] * (double)quant.position);
+            r.speed = (float)(prev[2][id] * (double)quant.speed);
+            r.lane = (float)(prev[3][id] * (double)quant.lane);
+            r.tile = (int32_t)prev[4][id];
+        }
+        frameTime.push_back(fh.time);
+        frameStart.push_back(rows.size());
+    }
+    return true;
+}
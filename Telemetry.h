@@ -0,0 +1,185 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+
+// Vehicle trajectories streamed to disk as they are simulated. A frame is the state of every
+// vehicle at one moment, stored by column (ids, x, z, speed, lane offset, tile) so each column is a
+// run of similar small numbers. Values are quantized to fixed steps and each is stored as the
+// change from the same vehicle's value in the frame before, zigzag varint encoded: a car that moved
+// a little costs a byte or two per column. Frames are grouped in chunks that start from zero, so
+// any chunk can be decoded on its own; an index of the chunks by time closes the file.
+//
+// The simulation hands frames over without waiting on the disk: it fills a slot of a ring shared
+// with a writer thread, which encodes and writes it. The ring is single producer, single consumer
+// and lock-free; when every slot is still waiting to be written the frame is dropped and counted
+// rather than holding up the tick.
+namespace Telemetry {
+
+const uint32_t VERSION = 1;
+const int COLUMNS = 6; // id, x, z, speed, lane offset, tile
+const uint32_t MAX_ID = 1u << 24; // ids index per-vehicle tables; rows with larger ids are not written
+
+struct Row {
+    uint32_t id;
+    float x, z;
+    float speed;
+    float lane; // offset from the lane centre line
+    int32_t tile; // -1 off the road grid
+};
+
+struct Steps { // quantization
+    float position{0.01f};
+    float speed{0.01f};
+    float lane{0.01f};
+};
+
+// On disk, after the chunks
+struct ChunkInfo {
+    uint64_t offset; // of the chunk header
+    uint64_t rows;
+    float t0, t1;    // times of its first and last frame
+    uint32_t frames;
+    uint32_t spare;
+};
+
+int64_t quantize(float value, float step);
+
+// Signed deltas as unsigned varints: small either way round, small on the wire
+inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t unzigzag(uint64_t u) { return (int64_t)(u >> 1) ^ -(int64_t)(u & 1); }
+// Appends v seven bits a byte, low bits first, the top bit set on every byte but the last
+inline void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+// Reads one varint at p and moves past it; false if it runs past end
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    if (p < end && *p < 0x80) { // most deltas fit a byte
+        v = *p++;
+        return true;
+    }
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+}
+
+class TelemetryWriter {
+public:
+    struct Params {
+        Telemetry::Steps steps;
+        // A chunk, which decodes on its own, closes at whichever limit it reaches first
+        int chunkFrames{256};
+        uint64_t chunkRows{1 << 20};
+        int ringFrames{8};   // frames that can wait for the writer thread
+    };
+
+    TelemetryWriter() = default;
+    ~TelemetryWriter() { close(); }
+    TelemetryWriter(const TelemetryWriter&) = delete;
+    TelemetryWriter& operator=(const TelemetryWriter&) = delete;
+
+    bool open(const char* path, const Params& p);
+    bool open(const char* path) { return open(path, Params()); }
+    bool isOpen() const { return file != nullptr; }
+
+    // Producer side, from the simulation thread, never waits: room for `rows` rows of a frame at
+    // `time`, to fill and commit(), or nullptr if the writer is behind and this frame is dropped
+    Telemetry::Row* frame(float time, uint32_t rows);
+    void commit();
+    // Writes what is queued, the chunk index and the footer; false if any write failed or a row
+    // was left out
+    bool close();
+
+    uint64_t framesWritten() const { return written.load(); }
+    uint64_t framesDropped() const { return dropped; }
+    uint64_t rowsWritten() const { return rowCount.load(); }
+    uint64_t bytes() const { return byteCount.load(); }
+
+private:
+    struct Slot {
+        float time;
+        std::vector<Telemetry::Row> rows;
+    };
+
+    Params params;
+    FILE* file{nullptr};
+    std::thread worker;
+    std::vector<Slot> ring;
+    std::atomic<uint64_t> head{0}; // next slot the producer fills
+    std::atomic<uint64_t> tail{0}; // next slot the writer takes
+    std::atomic<bool> stopping{false};
+    bool filling{false};
+    uint64_t dropped{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> rowCount{0};
+    std::atomic<uint64_t> byteCount{0};
+    bool failed{false}; // writer thread only until joined
+
+    // Writer thread state
+    std::vector<uint8_t> chunk;             // frames of the open chunk, encoded
+    std::vector<uint8_t> column[Telemetry::COLUMNS];
+    std::vector<int64_t> prev[Telemetry::COLUMNS - 1]; // per id, values of the frame before (x .. tile)
+    Telemetry::ChunkInfo current{};         // the chunk being filled
+    std::vector<Telemetry::ChunkInfo> index;
+
+    void run();
+    void encode(const Slot& s);
+    void flushChunk();
+    bool put(const void* data, size_t size);
+};
+
+class TelemetryReader {
+public:
+    // Reads the header and the chunk index; a file cut off before its index (a run that crashed)
+    // is indexed by walking its chunks
+    bool open(const char* path);
+    void close();
+    ~TelemetryReader() { close(); }
+
+    const std::vector<Telemetry::ChunkInfo>& chunks() const { return index; }
+    const Telemetry::Steps& steps() const { return quant; }
+    float startTime() const { return index.empty() ? 0.0f : index.front().t0; }
+    float endTime() const { return index.empty() ? 0.0f : index.back().t1; }
+
+    // Calls fn(time, rows, count) for every frame from t0 to t1, in time order. Only the chunks
+    // that overlap the range are read. The rows are valid during the call.
+    template<class Fn> bool scan(float t0, float t1, Fn fn) {
+        for (size_t c = firstChunk(t0); c < index.size() && index[c].t0 <= t1; c++) {
+            if (!readChunk(c)) return false;
+            for (size_t f = 0; f < frameTime.size(); f++) {
+                if (frameTime[f] < t0 || frameTime[f] > t1) continue;
+                fn(frameTime[f], &rows[frameStart[f]], frameStart[f + 1] - frameStart[f]);
+            }
+        }
+        return true;
+    }
+    // Decodes chunk c into frames; scan() does this for you
+    bool readChunk(size_t c);
+    size_t firstChunk(float t) const; // first chunk that ends at or after t
+
+private:
+    FILE* file{nullptr};
+    Telemetry::Steps quant;
+    std::vector<Telemetry::ChunkInfo> index;
+    std::vector<uint8_t> buffer;
+    std::vector<int64_t> prev[Telemetry::COLUMNS - 1];
+    std::vector<float> frameTime;      // of the chunk read last
+    std::vector<size_t> frameStart;    // into rows, one more than frames
+    std::vector<Telemetry::Row> rows;
+};
+
+#endif
@@ -0,0 +1,2049 @@
+// Headless benchmarks and validation runs for the traffic kernels.
+//
+//   traffic_bench kernel [vehicles] [seconds]   IDM kernel throughput, vector path vs scalar
+//   traffic_bench fd [out.csv] [out.ppm]        fundamental diagram on a ring road
+//   traffic_bench junction [minutes]            reservation vs signal throughput at one 4-way junction
+//   traffic_bench actuated [minutes]           fixed-time vs actuated signal plans at one junction
+//   traffic_bench soak [vehicles] [seconds]     swept collision checks on a signalled street grid
+//   traffic_bench signals [junctions] [seconds] event-driven signal scheduler vs per-light timers
+//   traffic_bench optimize [network] [plan] [rounds] green-wave offsets and splits, written as a signal plan
+//   traffic_bench preempt [junctions] [vehicles]  emergency preemption: route windows vs checking every light
+//   traffic_bench crossing [side] [seconds]      emergency routes crossing on a grid, with and without arbitration
+//   traffic_bench yield [vehicles] [units]      cars making way: route corridors vs checking every car
+//   traffic_bench dispatch [incidents/h] [units] incident queue: one search per kind vs one per unit
+//   traffic_bench load [incidents/h] [hours] [units] [out.csv] generated incidents: throughput and response tails
+//   traffic_bench snapshot [vehicles] [seconds] [file] checkpoint half way, resume from the file, compare
+//   traffic_bench replay [vehicles] [seconds] [file] record a run with commands, replay it and seek in it
+//   traffic_bench coverage [side] [scenarios]   coverage isochrones under closures: sweep vs recompute vs repair
+//   traffic_bench router [side] [queries]       chunk router vs flat search on a grid with closed roads
+//   traffic_bench reroute [vehicles] [side] [seconds] commuters re-planning against live edge delays
+#include "IdmKernel.h"
+#include "IntersectionManager.h"
+#include "SweptCollision.h"
+#include "SignalScheduler.h"
+#include "GreenWave.h"
+#include "PreemptionArbiter.h"
+#include "RoutePreemption.h"
+#include "YieldCorridor.h"
+#include "Dispatch.h"
+#include "IncidentGenerator.h"
+#include "ReplayLog.h"
+#include "Telemetry.h"
+#include "TrajectoryIndex.h"
+#include "CoverageField.h"
+#include "HierarchicalRouter.h"
+#include "EdgeTravelTimes.h"
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <queue>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Runs step() until `seconds` have passed and returns vehicle updates per second
+template<class Step>
+static double measure(int n, double seconds, Step step) {
+    long long ticks = 0;
+    Clock::time_point t0 = Clock::now();
+    while (secondsSince(t0) < seconds) {
+        for (int k = 0; k < 16; k++) step();
+        ticks += 16;
+    }
+    return (double)ticks * n / secondsSince(t0);
+}
+
+static int runKernel(int n, double seconds) {
+    IdmParams p;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> speed(0.0f, 6.0f), gapDist(0.2f, 40.0f), closing(-2.0f, 2.0f);
+    std::vector<float> v(n), v0(n), gap(n), dv(n), accel(n), ds(n), ref(n);
+    for (int i = 0; i < n; i++) {
+        v[i] = speed(rng);
+        v0[i] = 3.5f + speed(rng) * 0.2f;
+        gap[i] = (i % 7 == 0) ? IDM_FREE_GAP : gapDist(rng);
+        dv[i] = closing(rng);
+    }
+
+    // The vector path must agree with the scalar reference
+    idmAccelerate(p, n, v.data(), v0.data(), gap.data(), dv.data(), accel.data());
+    idmAccelerateScalar(p, n, v.data(), v0.data(), gap.data(), dv.data(), ref.data());
+    float worst = 0.0f;
+    for (int i = 0; i < n; i++) worst = std::max(worst, fabsf(accel[i] - ref[i]) / std::max(1.0f, fabsf(ref[i])));
+
+    std::vector<float> vs = v;
+    const float dt = 1.0f / 60.0f;
+    double vec = measure(n, seconds, [&]() {
+        idmAccelerate(p, n, vs.data(), v0.data(), gap.data(), dv.data(), accel.data());
+        idmAdvance(n, dt, accel.data(), gap.data(), vs.data(), ds.data());
+    });
+    vs = v;
+    double scalar = measure(n, seconds, [&]() {
+        idmAccelerateScalar(p, n, vs.data(), v0.data(), gap.data(), dv.data(), accel.data());
+        idmAdvanceScalar(n, dt, accel.data(), gap.data(), vs.data(), ds.data());
+    });
+
+    printf("vehicles        %d\n", n);
+    printf("%-15s %.1f M vehicle updates/s per core\n", idmKernelName(), vec / 1e6);
+    printf("%-15s %.1f M vehicle updates/s per core\n", "scalar", scalar / 1e6);
+    printf("max rel. error  %.2e (%s vs scalar)\n", worst, idmKernelName());
+    return worst < 1e-4f ? 0 : 1;
+}
+
+// Ring road of circumference L: every car follows the one ahead. Returns mean speed after warm-up.
+static float ringRoad(const IdmParams& p, int cars, float L, float v0, float warmup, float window) {
+    std::vector<float> x(cars), v(cars, 0.0f), desired(cars, v0), gap(cars), dv(cars), accel(cars), ds(cars);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+    float spacing = L / cars;
+    for (int i = 0; i < cars; i++) x[i] = i * spacing + jitter(rng) * std::min(spacing - p.vehicleLength, 1.0f);
+
+    const float dt = 0.1f;
+    double speedSum = 0.0;
+    long samples = 0;
+    for (float t = 0.0f; t < warmup + window; t += dt) {
+        for (int i = 0; i < cars; i++) {
+            int lead = (i + 1) % cars;
+            float d = x[lead] - x[i];
+            if (d <= 0.0f) d += L;
+            gap[i] = (cars == 1) ? IDM_FREE_GAP : d - p.vehicleLength;
+            dv[i] = v[i] - v[lead];
+        }
+        idmAccelerate(p, cars, v.data(), desired.data(), gap.data(), dv.data(), accel.data());
+        idmAdvance(cars, dt, accel.data(), gap.data(), v.data(), ds.data());
+        for (int i = 0; i < cars; i++) {
+            x[i] += ds[i];
+            if (x[i] >= L) x[i] -= L;
+        }
+        if (t >= warmup) {
+            for (float s : v) speedSum += s;
+            samples += cars;
+        }
+    }
+    return (float)(speedSum / samples);
+}
+
+static void plotPPM(const char* path, const std::vector<float>& density, const std::vector<float>& flow) {
+    const int W = 480, Hgt = 320, M = 30;
+    std::vector<unsigned char> img(W * Hgt * 3, 255);
+    auto put = [&](int x, int y, unsigned char r, unsigned char g, unsigned char b) {
+        if (x < 0 || x >= W || y < 0 || y >= Hgt) return;
+        unsigned char* px = &img[(y * W + x) * 3];
+        px[0] = r; px[1] = g; px[2] = b;
+    };
+    for (int x = M; x < W - 10; x++) put(x, Hgt - M, 0, 0, 0);
+    for (int y = 10; y < Hgt - M; y++) put(M, y, 0, 0, 0);
+
+    float maxD = *std::max_element(density.begin(), density.end());
+    float maxQ = std::max(1e-3f, *std::max_element(flow.begin(), flow.end()));
+    for (size_t i = 0; i < density.size(); i++) {
+        int px = M + (int)((W - M - 20) * density[i] / maxD);
+        int py = Hgt - M - (int)((Hgt - M - 20) * flow[i] / maxQ);
+        for (int dy = -2; dy <= 2; dy++)
+            for (int dx = -2; dx <= 2; dx++) put(px + dx, py + dy, 200, 30, 30);
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f) return;
+    fprintf(f, "P6\n%d %d\n255\n", W, Hgt);
+    fwrite(img.data(), 1, img.size(), f);
+    fclose(f);
+}
+
+static int runFundamentalDiagram(const char* csvPath, const char* ppmPath) {
+    IdmParams p;
+    const float L = 400.0f, v0 = 4.0f;
+    int jam = (int)(L / (p.vehicleLength + p.minGap));
+
+    std::vector<float> density, flow;
+    FILE* csv = fopen(csvPath, "w");
+    if (!csv) { fprintf(stderr, "cannot write %s\n", csvPath); return 1; }
+    fprintf(csv, "density,speed,flow\n");
+    for (int cars = 4; cars <= jam; cars += std::max(1, jam / 40)) {
+        float speed = ringRoad(p, cars, L, v0, 300.0f, 200.0f);
+        float k = cars / L;
+        density.push_back(k);
+        flow.push_back(k * speed);
+        fprintf(csv, "%.4f,%.4f,%.4f\n", k, speed, k * speed);
+        printf("density %.3f veh/unit  speed %.2f  flow %.3f veh/s\n", k, speed, k * speed);
+    }
+    fclose(csv);
+    plotPPM(ppmPath, density, flow);
+    printf("wrote %s and %s\n", csvPath, ppmPath);
+    return 0;
+}
+
+// One 4-way junction fed by Poisson arrivals on every approach (60% straight, 20% each turn).
+// Cars wait at the stop line as point queues and cross from a standing start, the next car in
+// the same queue may follow 1 s later. Movements through the box go through IntersectionManager;
+// the signal baseline only opens N/S or E/W at a time (12 s green, 2 s all-red) on the same manager.
+// The plan controls run SignalScheduler's standard four-phase plan, fixed-time or actuated from
+// the queues and arrivals on each movement.
+struct JunctionResult { double perMinute; double meanDelay; };
+enum class JunctionControl { Reservation, TwoPhase, FixedPlan, Actuated };
+
+static JunctionResult runJunction(JunctionControl control, const float perMinute[4], float minutes, unsigned seed) {
+    const float dt = 0.05f, tile = 4.0f, follow = 1.0f, clearance = 0.3f;
+    const float green = 12.0f, allRed = 2.0f;
+    IdmParams p;
+    IntersectionManager box(1);
+    box.addJunction(0);
+
+    SignalScheduler sched;
+    int plan = sched.addStandardPlan(0xF, 12.0f, 5.0f, 2.0f, 1.0f);
+    SignalScheduler::Actuation actuation = { 3.0f, 30.0f, 1.5f };
+    int light = control == JunctionControl::Actuated ? sched.addActuated(plan, actuation) : sched.add(plan, 0.0f);
+    std::vector<int> changed;
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+    std::exponential_distribution<float> gapTime[4];
+    for (int h = 0; h < 4; h++) gapTime[h] = std::exponential_distribution<float>(std::max(perMinute[h], 1e-3f) / 60.0f);
+
+    struct Car { float arrival; int exitDir; };
+    std::vector<Car> queue[4];
+    size_t head[4] = { 0, 0, 0, 0 };
+    float nextArrival[4], readyAt[4] = { 0, 0, 0, 0 };
+    for (int h = 0; h < 4; h++) nextArrival[h] = gapTime[h](rng);
+
+    long long crossed = 0;
+    double delaySum = 0.0;
+    float end = minutes * 60.0f;
+    for (float now = 0.0f; now < end; now += dt) {
+        if (control == JunctionControl::TwoPhase) {
+            float t = fmodf(now, 2.0f * (green + allRed));
+            bool ns = t < green, ew = t >= green + allRed && t < 2.0f * green + allRed;
+            for (int h = 0; h < 4; h++) box.setApproachOpen(0, h, (h & 1) ? ew : ns);
+        } else if (control != JunctionControl::Reservation) {
+            sched.advance(now, changed);
+            box.setOpenMovements(0, sched.open(light));
+        }
+        for (int h = 0; h < 4; h++) {
+            while (nextArrival[h] <= now) {
+                float r = u01(rng);
+                int exitDir = r < 0.6f ? h : (r < 0.8f ? (h + 1) & 3 : (h + 3) & 3);
+                if (head[h] == queue[h].size()) sched.reportArrival(light, IntersectionManager::movementOf(h, exitDir));
+                queue[h].push_back({ nextArrival[h], exitDir });
+                nextArrival[h] += gapTime[h](rng);
+            }
+            if (head[h] >= queue[h].size()) continue;
+            sched.reportQueued(light, IntersectionManager::movementOf(h, queue[h][head[h]].exitDir), (int)(queue[h].size() - head[h]));
+            if (now < readyAt[h]) continue;
+
+            const Car& c = queue[h][head[h]];
+            int turn = (c.exitDir - h) & 3;
+            float path = turn == 0 ? tile : (turn == 1 ? tile * 0.6f : tile * 1.4f);
+            float cross = sqrtf(2.0f * (path + p.vehicleLength) / p.maxAccel);
+            if (!box.request(0, IntersectionManager::movementOf(h, c.exitDir), now, now + cross + clearance)) continue;
+            delaySum += now - c.arrival;
+            crossed++;
+            head[h]++;
+            readyAt[h] = now + follow;
+        }
+    }
+    return { crossed / minutes, crossed ? delaySum / crossed : 0.0 };
+}
+
+static int runJunctionBench(float minutes) {
+    printf("demand/approach   reservation veh/min  delay s   signal veh/min  delay s\n");
+    const float demand[] = { 4, 8, 12, 16, 20, 25, 30 };
+    for (float d : demand) {
+        const float all[4] = { d, d, d, d };
+        JunctionResult r = runJunction(JunctionControl::Reservation, all, minutes, 7);
+        JunctionResult s = runJunction(JunctionControl::TwoPhase, all, minutes, 7);
+        printf("%10.0f/min %16.1f %10.1f %14.1f %10.1f\n", d, r.perMinute, r.meanDelay, s.perMinute, s.meanDelay);
+    }
+
+    // Raw cost of a conflict check over many junctions
+    const int junctions = 4096, requests = 1 << 24;
+    IntersectionManager mgr(junctions);
+    for (int j = 0; j < junctions; j++) mgr.addJunction(j);
+    std::mt19937 rng(3);
+    std::vector<int> tile(1 << 16), move(1 << 16);
+    for (size_t k = 0; k < tile.size(); k++) { tile[k] = rng() % junctions; move[k] = rng() % 16; }
+    size_t mask = tile.size() - 1;
+    Clock::time_point t0 = Clock::now();
+    for (int k = 0; k < requests; k++) {
+        float now = k * 1e-4f;
+        mgr.request(tile[k & mask], move[k & mask], now, now + 2.0f);
+    }
+    double sec = secondsSince(t0);
+    printf("request: %.1f ns each (%llu granted, %llu refused)\n", sec * 1e9 / requests,
+           (unsigned long long)mgr.grantedTotal(), (unsigned long long)mgr.refusedTotal());
+    return 0;
+}
+
+// Fixed-time vs actuated four-phase control at one junction, for balanced demand and for a busy
+// main road (N/S) crossing a quiet side road (E/W)
+static int runActuatedBench(float minutes) {
+    printf("demand N/S E/W veh/min   fixed veh/min  delay s   actuated veh/min  delay s\n");
+    const float mainRoad[] = { 4, 8, 12, 16, 20 };
+    for (float side : { 1.0f, 0.25f }) {
+        for (float d : mainRoad) {
+            const float demand[4] = { d, d * side, d, d * side };
+            JunctionResult f = runJunction(JunctionControl::FixedPlan, demand, minutes, 7);
+            JunctionResult a = runJunction(JunctionControl::Actuated, demand, minutes, 7);
+            printf("%11.0f %4.0f %17.1f %8.1f %18.1f %8.1f\n", d, d * side, f.perMinute, f.meanDelay, a.perMinute, a.meanDelay);
+        }
+    }
+    return 0;
+}
+
+// Cars on a grid of two-way streets with no car following: only SweptCollision keeps them
+// apart, at 20 ticks per second so moves are long. Every crossing has a fixed-time signal, east-west
+// then north-south with an all-red between; a car stops at the line on red, and on green too when
+// there is no room past the crossing for it, so queues never block the box. Each lane wraps
+// around at the map edge, half a block away from any crossing; across that seam a car just keeps
+// its distance to the car it follows. Fails (exit code 1) if any two footprints ever overlap, or if
+// traffic doesn't flow: a mean speed under a third of the mean desired speed.
+static int runSoak(int n, float seconds) {
+    const float block = 20.0f, lane = 0.6f, dt = 0.05f, accel = 2.0f;
+    const float box = 2.0f;                        // half the length of a crossing, along the street
+    const float green = 10.0f, allRed = 2.0f;      // per direction, every crossing in step
+    const float cycle = 2.0f * (green + allRed);
+    int streets = std::max(2, (int)ceilf(sqrtf(n / 8.0f)));
+    float L = streets * block;
+    int lanes = streets * 4; // per street: two directions, streets run both ways
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+    std::vector<int> laneOf(n);
+    std::vector<float> u(n), v(n), v0(n);
+    std::vector<std::vector<int>> ring(lanes);
+    for (int i = 0; i < n; i++) laneOf[i] = i % lanes;
+    for (int l = 0; l < lanes; l++) {
+        for (int i = l; i < n; i += lanes) ring[l].push_back(i);
+        // Start evenly spread over the parts of the lane clear of crossings (which sit mid-block)
+        const float clear = block - 4.0f;
+        float spacing = streets * clear / ring[l].size();
+        for (size_t k = 0; k < ring[l].size(); k++) {
+            int i = ring[l][k];
+            float w = spacing * (k + 0.1f + 0.4f * u01(rng));
+            int b = (int)(w / clear);
+            u[i] = block * b + block * 0.5f + 2.0f + (w - clear * b);
+            if (u[i] >= L) u[i] -= L;
+            v0[i] = 3.0f + 3.0f * u01(rng);
+            v[i] = v0[i];
+        }
+    }
+    if (streets * (block - 4.0f) / std::max<size_t>(1, ring[0].size()) < 2.5f) { fprintf(stderr, "too many vehicles for the grid\n"); return 1; }
+
+    // Lane l: street l / 4, (l & 1) horizontal or vertical, (l & 2) direction
+    auto place = [&](int i, float& x, float& z, float& hx, float& hz) {
+        int l = laneOf[i];
+        float street = block * (l / 4) + block * 0.5f;
+        bool horizontal = (l & 1) == 0, forward = (l & 2) == 0;
+        float along = forward ? u[i] : L - u[i];
+        float sgn = forward ? 1.0f : -1.0f;
+        if (horizontal) { x = along; z = street + sgn * lane; hx = sgn; hz = 0.0f; }
+        else { x = street - sgn * lane; z = along; hx = 0.0f; hz = sgn; }
+    };
+
+    SweptCollision solver;
+    std::vector<SweptCollision::Body> bodies(n);
+    std::vector<float> share, move(n);
+    std::vector<int> rank(n);
+    for (int l = 0; l < lanes; l++)
+        for (size_t k = 0; k < ring[l].size(); k++) rank[ring[l][k]] = (int)k;
+
+    long long overlaps = 0, ticks = 0;
+    double speedSum = 0.0, desiredSum = 0.0, solveSeconds = 0.0;
+    for (int i = 0; i < n; i++) desiredSum += v0[i];
+    for (float now = 0.0f; now < seconds; now += dt, ticks++) {
+        float phase = fmodf(now, cycle);
+        bool greenFor[2] = { phase < green, phase >= green + allRed && phase < 2.0f * green + allRed };
+        for (int i = 0; i < n; i++) {
+            v[i] = std::min(v0[i], v[i] + accel * dt);
+            move[i] = v[i] * dt;
+            const std::vector<int>& r = ring[laneOf[i]];
+            int leader = r[(rank[i] + 1) % r.size()];
+            float gap = u[leader] - u[i] + (u[leader] < u[i] ? L : 0.0f); // centre to centre
+            if (u[leader] < u[i]) // across the seam
+                move[i] = std::min(move[i], std::max(0.0f, gap - 2.0f * SweptCollision::HALF_LENGTH - 0.05f));
+
+            // The next crossing whose stop line is still ahead (crossings sit mid-block both ways)
+            float front = u[i] + SweptCollision::HALF_LENGTH;
+            float centre = block * ceilf((front - box - block * 0.5f) / block) + block * 0.5f;
+            float toLine = centre - box - front;
+            bool room = r.size() == 1 || u[i] + gap - SweptCollision::HALF_LENGTH > centre + box + 2.0f * SweptCollision::HALF_LENGTH + 0.3f;
+            if (toLine >= 0.0f && (!greenFor[laneOf[i] & 1] || !room)) move[i] = std::min(move[i], toLine);
+            SweptCollision::Body& b = bodies[i];
+            place(i, b.x, b.z, b.hx, b.hz);
+            b.distance = b.turnAt = move[i];
+            b.ex = b.hx; b.ez = b.hz;
+            b.pinned = false;
+        }
+
+        Clock::time_point t0 = Clock::now();
+        solver.resolve(bodies, share);
+        solveSeconds += secondsSince(t0);
+
+        for (int i = 0; i < n; i++) {
+            float d = move[i] * share[i];
+            u[i] += d;
+            if (u[i] >= L) u[i] -= L;
+            v[i] = d / dt;
+            speedSum += v[i];
+            place(i, bodies[i].x, bodies[i].z, bodies[i].hx, bodies[i].hz);
+        }
+        overlaps += solver.countOverlaps(bodies);
+    }
+
+    double meanSpeed = speedSum / ((double)n * ticks), desired = desiredSum / n;
+    printf("%d vehicles, %dx%d streets, %.0f s: mean speed %.2f of %.2f desired, %llu moves cut short, %lld overlaps\n",
+           n, streets, streets, seconds, meanSpeed, desired, (unsigned long long)solver.contacts(), overlaps);
+    printf("resolve: %.1f ns per vehicle per tick\n", solveSeconds * 1e9 / ((double)n * ticks));
+    if (meanSpeed < desired / 3.0) printf("traffic is jammed\n");
+    return overlaps == 0 && meanSpeed >= desired / 3.0 ? 0 : 1;
+}
+
+// Timer kept per light and stepped every tick, the way TrafficLight used to run
+struct TickedLight {
+    LightState state;
+    float timer, green, yellow, red;
+    void update(float dt) {
+        timer += dt;
+        if (state == LightState::Green && timer > green) { state = LightState::Yellow; timer = 0.0f; }
+        else if (state == LightState::Yellow && timer > yellow) { state = LightState::Red; timer = 0.0f; }
+        else if (state == LightState::Red && timer > red) { state = LightState::Green; timer = 0.0f; }
+    }
+};
+
+// Cost per tick of keeping `n` signalised junctions current at 60 ticks per second, per-light
+// timers vs the scheduler running four-phase plans, with a random junction preempted now and
+// then. Fails if the scheduler's cached state ever disagrees with openAt().
+static int runSignals(int n, float seconds) {
+    const float dt = 1.0f / 60.0f;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+    SignalScheduler sched;
+    std::vector<int> plans;
+    for (int k = 0; k < 64; k++) {
+        uint8_t openings = k % 4 == 0 ? 0xB : 0xF; // some T-junctions
+        plans.push_back(sched.addStandardPlan(openings, 15.0f + 15.0f * u01(rng), 5.0f + 5.0f * u01(rng), 3.0f, 1.0f));
+    }
+    // Every other junction gets a plan of its own, as coordinated junctions with their own splits do
+    std::vector<TickedLight> ticked(n);
+    std::vector<int> planOf(n);
+    for (int i = 0; i < n; i++) {
+        int plan = plans[rng() % plans.size()];
+        if (i % 2) plan = sched.addStandardPlan(0xF, 15.0f + 15.0f * u01(rng), 5.0f + 5.0f * u01(rng), 3.0f, 1.0f);
+        planOf[i] = plan;
+        sched.add(plan, sched.cycleLength(plan) * u01(rng));
+        float green = 20.0f + 20.0f * u01(rng);
+        ticked[i] = { LightState::Green, green * u01(rng), green, 3.0f, green };
+    }
+    std::vector<int> changed;
+    long long ticks = 0, changes = 0, mismatches = 0;
+    double tickedSeconds = 0.0, schedSeconds = 0.0;
+    for (float now = dt; now < seconds; now += dt, ticks++) {
+        Clock::time_point t0 = Clock::now();
+        for (TickedLight& l : ticked) l.update(dt);
+        tickedSeconds += secondsSince(t0);
+
+        if (ticks % 30 == 0) {
+            int id = rng() % n;
+            sched.preempt(id, (uint16_t)(0xFu << (rng() % 4 * 4)), now, now + 1.2f);
+        }
+        t0 = Clock::now();
+        sched.advance(now, changed);
+        schedSeconds += secondsSince(t0);
+        changes += changed.size();
+
+        for (int k = 0; k < 8; k++) {
+            int id = rng() % n;
+            if (sched.open(id) != sched.openAt(id, now) || sched.yellow(id) != sched.yellowAt(id, now) ||
+                sched.planOfController(id) != planOf[id]) mismatches++;
+        }
+    }
+
+    printf("%d junctions, %.0f s at 60 Hz: %lld state changes, %llu events handled\n", n, seconds, changes,
+           (unsigned long long)sched.eventsHandled());
+    printf("per-light timers: %.1f us per tick\n", tickedSeconds * 1e6 / ticks);
+    printf("scheduler:        %.1f us per tick (%.2f changes per tick)\n", schedSeconds * 1e6 / ticks,
+           (double)changes / ticks);
+    if (mismatches) printf("%lld cached states disagreed with openAt() or had the wrong plan\n", mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Emergency vehicles crossing a grid of fixed-time junctions eastbound at constant speed. Either
+// every vehicle checks every light each tick (the trigger distance and facing test the lights
+// used to run) or each vehicle's route windows are planned with RoutePreemption. Also counts the
+// stop lines a vehicle crossed without the green.
+static int runPreempt(int n, int vehicles) {
+    const float dt = 1.0f / 60.0f, spacing = 16.0f, speed = 5.0f, seconds = 120.0f;
+    int side = std::max(2, (int)sqrtf((float)n));
+    n = side * side;
+    const float length = side * spacing + 40.0f;
+    const int east = 1; // RoadDir
+    const uint16_t eastbound = (uint16_t)(0xFu << (east * 4));
+
+    int result = 0;
+    for (int planned = 0; planned < 2; planned++) {
+        SignalScheduler sched;
+        std::mt19937 rng(11);
+        int plan = sched.addStandardPlan(0xF, 8.0f, 3.0f, 1.5f, 0.5f);
+        for (int i = 0; i < n; i++) sched.add(plan, std::uniform_real_distribution<float>(0.0f, sched.cycleLength(plan))(rng));
+        PreemptionArbiter arbiter(sched);
+
+        std::vector<float> x(vehicles);
+        std::vector<int> row(vehicles);
+        std::vector<RoutePreemption> routes(vehicles);
+        // Each trip runs the length of a row; its stops are the row's junctions
+        auto startTrip = [&](int k, float now) {
+            x[k] = -20.0f;
+            row[k] = (int)(rng() % side);
+            routes[k].clear(arbiter, now);
+            routes[k].setVehicle(k, 0);
+            for (int c = 0; c < side; c++) {
+                float centre = c * spacing + 20.0f;
+                routes[k].addStop(row[k] * side + c, eastbound, centre - 2.0f, centre + 2.0f + SweptCollision::HALF_LENGTH);
+            }
+        };
+        for (int k = 0; k < vehicles; k++) {
+            startTrip(k, 0.0f);
+            x[k] = -20.0f - length * k / vehicles; // spread out along their first trip
+        }
+
+        std::vector<int> changed;
+        long long ticks = 0, crossings = 0, missed = 0;
+        uint64_t windows = 0;
+        double preemptSeconds = 0.0;
+        for (float now = dt; now < seconds; now += dt, ticks++) {
+            Clock::time_point t0 = Clock::now();
+            for (int k = 0; k < vehicles; k++) {
+                if (planned) {
+                    routes[k].update(arbiter, now, x[k] + 20.0f, speed);
+                } else {
+                    float vz = row[k] * spacing;
+                    for (int i = 0; i < n; i++) {
+                        float dx = (i % side) * spacing - x[k], dz = (i / side) * spacing - vz;
+                        float d = sqrtf(dx * dx + dz * dz);
+                        if (d > 12.0f || d < 0.001f || dx / d <= 0.5f) continue;
+                        sched.preempt(i, eastbound, now, now + 1.2f);
+                        windows++;
+                    }
+                }
+            }
+            preemptSeconds += secondsSince(t0);
+            sched.advance(now, changed);
+
+            for (int k = 0; k < vehicles; k++) {
+                float before = x[k];
+                x[k] += speed * dt;
+                for (int c = 0; c < side; c++) {
+                    float stopLine = c * spacing - 2.0f;
+                    if (before < stopLine && x[k] >= stopLine) {
+                        crossings++;
+                        if (!(sched.open(row[k] * side + c) >> (east * 4 + east) & 1)) missed++;
+                    }
+                }
+                if (x[k] > length - 20.0f) startTrip(k, now);
+            }
+        }
+        if (planned) for (const RoutePreemption& r : routes) windows += r.windowsIssued();
+        printf("%-14s %.1f us per tick, %llu windows issued, %lld of %lld stop lines crossed without the green\n",
+               planned ? "route windows" : "every light", preemptSeconds * 1e6 / ticks, (unsigned long long)windows,
+               missed, crossings);
+        if (planned && missed > 0) result = 1;
+    }
+    printf("%d junctions, %d emergency vehicles, %.0f s at 60 Hz\n", n, vehicles, seconds);
+    return result;
+}
+
+// One emergency vehicle per row eastbound and one per column southbound across a grid of
+// fixed-time junctions, so their routes cross at every junction, with random severities. Without
+// arbitration each request goes straight to the controller and the last one wins; with it the
+// vehicle ranked second waits at the stop line. Counts the ticks two vehicles from crossing
+// directions are inside one junction together and the junctions entered without the green, both
+// of which must stay at zero under the arbiter, and how long a vehicle waited at one junction,
+// which must stay within what the windows ahead of it can take.
+static int runCrossing(int side, float seconds) {
+    const float dt = 1.0f / 60.0f, spacing = 16.0f, speed = 5.0f, reach = 1.0f;
+    const float length = side * spacing + 40.0f, clear = 2.0f + SweptCollision::HALF_LENGTH;
+    const float yellow = 1.5f, allRed = 0.5f;
+    const int heading[2] = { 1, 2 }; // RoadDir: east along rows, south along columns
+    int vehicles = side * 2;
+    RoutePreemption::Params rp;
+    PreemptionArbiter::Params ap;
+    const float bound = rp.lead + rp.hold + rp.maxDelay + std::max(ap.clearance, yellow + allRed) + 2 * ap.severityWeight;
+
+    int result = 0;
+    for (int arbitrate = 0; arbitrate < 2; arbitrate++) {
+        SignalScheduler sched;
+        std::mt19937 rng(29);
+        int plan = sched.addStandardPlan(0xF, 8.0f, 3.0f, yellow, allRed);
+        for (int i = 0; i < side * side; i++) sched.add(plan, std::uniform_real_distribution<float>(0.0f, sched.cycleLength(plan))(rng));
+        ap.arbitrate = arbitrate != 0;
+        PreemptionArbiter arbiter(sched, ap);
+
+        // Vehicle k < side drives row k, the others column k - side; x is along its road
+        std::vector<float> x(vehicles), waited(vehicles, 0.0f);
+        std::vector<RoutePreemption> routes(vehicles);
+        auto controller = [&](int k, int c) { return k < side ? k * side + c : c * side + (k - side); };
+        auto startTrip = [&](int k, float now) {
+            x[k] = -20.0f - std::uniform_real_distribution<float>(0.0f, spacing)(rng);
+            routes[k].clear(arbiter, now);
+            routes[k].setVehicle(k, (int)(rng() % 3));
+            uint16_t movements = (uint16_t)(0xFu << (heading[k >= side] * 4));
+            for (int c = 0; c < side; c++)
+                routes[k].addStop(controller(k, c), movements, c * spacing + 18.0f, c * spacing + 20.0f + clear);
+        };
+        for (int k = 0; k < vehicles; k++) {
+            startTrip(k, 0.0f);
+            x[k] -= std::uniform_real_distribution<float>(0.0f, length)(rng);
+        }
+
+        std::vector<int> changed;
+        std::vector<uint8_t> inside(side * side);
+        long long conflicts = 0, crossings = 0, red = 0, waits = 0;
+        double waitSum = 0.0;
+        float waitMax = 0.0f;
+        for (float now = dt; now < seconds; now += dt) {
+            for (int k = 0; k < vehicles; k++) routes[k].update(arbiter, now, x[k] + 20.0f, speed);
+            arbiter.update(now);
+            sched.advance(now, changed);
+
+            std::fill(inside.begin(), inside.end(), 0);
+            for (int k = 0; k < vehicles; k++) {
+                if (routes[k].mustWait(arbiter, now, x[k] + 20.0f, reach)) {
+                    waited[k] += dt;
+                    continue;
+                }
+                float before = x[k];
+                x[k] += speed * dt;
+                int h = heading[k >= side];
+                for (int c = 0; c < side; c++) {
+                    float centre = c * spacing;
+                    if (before < centre - 2.0f && x[k] >= centre - 2.0f) {
+                        crossings++;
+                        if (!(sched.open(controller(k, c)) >> (h * 4 + h) & 1)) red++;
+                        if (waited[k] > 0.0f) {
+                            waits++;
+                            waitSum += waited[k];
+                            waitMax = std::max(waitMax, waited[k]);
+                        }
+                        waited[k] = 0.0f;
+                    }
+                    if (x[k] > centre - 2.0f && x[k] < centre + clear) inside[controller(k, c)] |= (uint8_t)(1 << (k >= side));
+                }
+                if (x[k] > length - 20.0f) startTrip(k, now);
+            }
+            for (uint8_t in : inside) if (in == 3) conflicts++;
+        }
+        printf("%-14s %lld ticks with crossing vehicles in one junction, %lld of %lld junctions entered without the green\n",
+               arbitrate ? "arbiter" : "last one wins", conflicts, red, crossings);
+        if (arbitrate) {
+            printf("%-14s %lld waits, mean %.2f s, longest %.2f s (bound %.1f s)\n", "", waits,
+                   waits ? waitSum / waits : 0.0, waitMax, bound);
+            if (conflicts > 0 || red > 0 || waitMax > bound) result = 1;
+        }
+    }
+    printf("%d x %d junctions, %d emergency vehicles, %.0f s at 60 Hz\n", side, side, vehicles, seconds);
+    return result;
+}
+
+// Emergency units driving east along the rows of a street grid where every tile is a junction, with
+// cars spread over all lanes. Either every unit checks every car each tick (the distance and facing
+// test the simulation used to run) or each unit's corridor is read from the lane occupancy index.
+// Every car the scan finds in a unit's own lanes must be in the corridor too.
+static int runYield(int n, int units) {
+    const float dt = 1.0f / 60.0f, tile = 4.0f, speed = 5.0f, seconds = 10.0f;
+    const int dx[4] = { 0, 1, 0, -1 }, dy[4] = { -1, 0, 1, 0 }; // RoadDir
+    const int east = 1;
+    int side = std::max(8, (int)ceilf(sqrtf(n / 1.5f)));
+    int tiles = side * side;
+
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+    LaneOccupancy occupancy(tiles * 4, n);
+    std::vector<int> carTile(n), carHeading(n);
+    std::vector<float> carPos(n), carSpeed(n);
+    for (int i = 0; i < n; i++) {
+        carTile[i] = (int)(rng() % tiles);
+        carHeading[i] = (int)(rng() % 4);
+        carPos[i] = tile * u01(rng);
+        carSpeed[i] = 4.0f * u01(rng);
+        occupancy.enter(i, carTile[i] * 4 + carHeading[i], carPos[i]);
+    }
+
+    // Each trip runs from a random tile to the end of its row
+    std::vector<int> row(units), firstColumn(units);
+    std::vector<float> arc(units);
+    YieldCorridor corridor;
+    auto startTrip = [&](int k) {
+        row[k] = (int)(rng() % side);
+        firstColumn[k] = (int)(rng() % (side / 2));
+        arc[k] = 0.0f;
+        corridor.clear(k);
+        for (int c = firstColumn[k]; c < side; c++) {
+            int t = row[k] * side + c;
+            float entryArc = (c - firstColumn[k]) * tile - tile * 0.5f;
+            corridor.addLane(k, t * 4 + east, entryArc, entryArc + tile, false);
+            for (int d = 0; d < 4; d += 2) { // cross traffic from the north and south
+                corridor.addLane(k, t * 4 + d, entryArc, entryArc + tile, true);
+                int from = t - dy[d] * side;
+                if (from >= 0 && from < tiles) corridor.addLane(k, from * 4 + d, entryArc, entryArc + tile, true);
+            }
+        }
+    };
+    for (int k = 0; k < units; k++) startTrip(k);
+
+    std::vector<uint8_t> noticed(n);
+    long long ticks = 0, scanHits = 0, corridorHits = 0, ownLane = 0, missed = 0;
+    double scanSeconds = 0.0, corridorSeconds = 0.0;
+    for (float now = 0.0f; now < seconds; now += dt, ticks++) {
+        // Every unit checks every car, as Simulation::Update did
+        Clock::time_point t0 = Clock::now();
+        long long hits = 0;
+        for (int k = 0; k < units; k++) {
+            float ux = (firstColumn[k] + 0.5f) * tile + arc[k], uz = (row[k] + 0.5f) * tile;
+            for (int i = 0; i < n; i++) {
+                int t = carTile[i], h = carHeading[i];
+                float along = carPos[i] - tile * 0.5f;
+                float rx = (t % side + 0.5f) * tile + dx[h] * along - ux, rz = (t / side + 0.5f) * tile + dy[h] * along - uz;
+                float d = sqrtf(rx * rx + rz * rz);
+                if (d < 25.0f && rx > -4.0f && rx < 20.0f && dx[h] >= 0) hits++;
+            }
+        }
+        scanSeconds += secondsSince(t0);
+        scanHits += hits;
+
+        t0 = Clock::now();
+        for (int k = 0; k < units; k++) corridor.setProgress(k, arc[k]);
+        const std::vector<YieldCorridor::Notice>& notices = corridor.collect(occupancy);
+        corridorSeconds += secondsSince(t0);
+        corridorHits += (long long)notices.size();
+
+        std::fill(noticed.begin(), noticed.end(), 0);
+        for (const YieldCorridor::Notice& nt : notices) noticed[nt.vehicle] = 1;
+        for (int k = 0; k < units; k++) {
+            float ux = (firstColumn[k] + 0.5f) * tile + arc[k];
+            for (int c = std::max(firstColumn[k], (int)(ux / tile) - 2); c < side && c * tile < ux + 21.0f; c++) {
+                for (int i = occupancy.head((row[k] * side + c) * 4 + east); i >= 0; i = occupancy.follower(i)) {
+                    float ahead = c * tile + carPos[i] - ux;
+                    if (ahead <= -4.0f || ahead >= 20.0f) continue;
+                    ownLane++;
+                    if (!noticed[i]) missed++;
+                }
+            }
+        }
+
+        for (int k = 0; k < units; k++) {
+            arc[k] += speed * dt;
+            if ((firstColumn[k] + 0.5f) * tile + arc[k] > side * tile) startTrip(k);
+        }
+        for (int i = 0; i < n; i++) {
+            carPos[i] += carSpeed[i] * dt;
+            if (carPos[i] < tile) {
+                occupancy.setPosition(i, carPos[i]);
+                continue;
+            }
+            int h = carHeading[i], x = (carTile[i] % side + dx[h] + side) % side, y = (carTile[i] / side + dy[h] + side) % side;
+            carTile[i] = y * side + x;
+            carPos[i] -= tile;
+            occupancy.enter(i, carTile[i] * 4 + h, carPos[i]);
+        }
+    }
+    printf("%-14s %9.1f us per tick, %.1f cars told per tick\n", "every car", scanSeconds * 1e6 / ticks, (double)scanHits / ticks);
+    printf("%-14s %9.1f us per tick, %.1f cars told per tick, %.1f lanes read\n", "corridor", corridorSeconds * 1e6 / ticks,
+           (double)corridorHits / ticks, (double)corridor.lanesRead() / ticks);
+    printf("%lld of %lld cars in a unit's own lanes missed by the corridor\n", missed, ownLane);
+    printf("%d cars on a %d x %d grid, %d emergency units, %.0f s at 60 Hz\n", n, side, side, units, seconds);
+    return missed == 0 ? 0 : 1;
+}
+
+// Lane states of a side x side street grid where every tile is a junction
+static Dispatch::Graph streetGrid(int side) {
+    const float tileTime = 0.8f, turnTime[4] = { 0.0f, 0.4f, 2.0f, 0.6f }; // straight, right, u-turn, left
+    const int dx[4] = { 0, 1, 0, -1 }, dy[4] = { -1, 0, 1, 0 };          // RoadDir
+    Dispatch::Graph g;
+    g.first.push_back(0);
+    for (int s = 0; s < side * side * 4; s++) {
+        int t = s / 4, h = s % 4, x = t % side, y = t / side;
+        for (int e = 0; e < 4; e++) {
+            int nx = x + dx[e], ny = y + dy[e];
+            if (nx < 0 || ny < 0 || nx >= side || ny >= side) continue;
+            g.to.push_back((ny * side + nx) * 4 + e);
+            g.cost.push_back(tileTime + turnTime[(e - h + 4) % 4]);
+        }
+        g.first.push_back((int)g.to.size());
+    }
+    return g;
+}
+
+// An hour of incidents on a 64 x 64 street grid, arriving at random (Poisson) with random kinds and
+// priorities, handled by units spread over stations of their kind. Units go straight to their
+// incident, spend a fixed time on it and are free again from where they are. Dispatch finds each
+// unit with its one search per kind; the check searches from every free unit of the kind in turn
+// and must find the same arrival time.
+static int runDispatch(float perHour, int units) {
+    const int side = 64, tiles = side * side;
+    const float service[Dispatch::KINDS] = { 480.0f, 600.0f, 240.0f }; // ambulance, fire, police
+    const float hour = 3600.0f, step = 1.0f;
+
+    Dispatch::Graph g = streetGrid(side);
+    std::mt19937 rng(23);
+    Dispatch dispatch;
+    dispatch.setGraph(g);
+    std::vector<int> unitState(units);
+    std::vector<float> freeAt(units, -1.0f);
+    std::vector<int> job(units, -1);
+    for (int u = 0; u < units; u++) {
+        unitState[u] = (int)(rng() % tiles) * 4 + (int)(rng() % 4);
+        dispatch.addUnit(u % Dispatch::KINDS, unitState[u]);
+    }
+
+    // Single-source search from a unit, stopped once the incident tile is reached
+    std::vector<float> time(tiles * 4);
+    auto searchFrom = [&](int state, int tile) {
+        std::fill(time.begin(), time.end(), INFINITY);
+        typedef std::pair<float, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+        time[state] = 0.0f;
+        open.push({ 0.0f, state });
+        while (!open.empty()) {
+            Entry e = open.top();
+            open.pop();
+            if (e.first > time[e.second]) continue;
+            if (e.second / 4 == tile) return e.first;
+            for (int k = g.first[e.second]; k < g.first[e.second + 1]; k++) {
+                float t = e.first + g.cost[k];
+                if (t < time[g.to[k]]) { time[g.to[k]] = t; open.push({ t, g.to[k] }); }
+            }
+        }
+        return (float)INFINITY;
+    };
+
+    std::exponential_distribution<float> gap(perHour / hour);
+    std::vector<Dispatch::Assignment> sent;
+    double dispatchSeconds = 0.0, scanSeconds = 0.0;
+    long long scans = 0, mismatched = 0;
+    float nextIncident = gap(rng);
+    for (float now = 0.0f; now < hour; now += step) {
+        for (; nextIncident < now + step; nextIncident += gap(rng))
+            dispatch.report((int)(rng() % Dispatch::KINDS), (int)(rng() % tiles), (int)(rng() % 3), nextIncident);
+
+        for (int u = 0; u < units; u++) {
+            if (job[u] < 0 || now < freeAt[u]) continue;
+            dispatch.release(u, now);
+            job[u] = -1;
+        }
+
+        // Before assigning, what searching from every free unit would cost for the incident on top
+        // of each queue; the dispatch search has to agree
+        std::vector<float> expected(Dispatch::KINDS, -1.0f);
+        for (int k = 0; k < Dispatch::KINDS; k++) {
+            if (dispatch.queued(k) == 0 || dispatch.available(k) == 0) continue;
+            int best = -1;
+            float bestTime = INFINITY;
+            for (const Dispatch::Incident& inc : dispatch.incidents()) {
+                if (inc.kind != k || inc.unit >= 0) continue;
+                if (best < 0 || inc.priority < dispatch.incidents()[best].priority) best = (int)(&inc - &dispatch.incidents()[0]);
+            }
+            Clock::time_point t0 = Clock::now();
+            for (int u = 0; u < units; u++) {
+                if (dispatch.unitKind(u) != k || dispatch.incidentOf(u) >= 0) continue;
+                bestTime = std::min(bestTime, searchFrom(unitState[u], dispatch.incidents()[best].tile));
+                scans++;
+            }
+            scanSeconds += secondsSince(t0);
+            expected[k] = bestTime;
+        }
+
+        Clock::time_point t0 = Clock::now();
+        sent.clear();
+        dispatch.assign(now, sent);
+        dispatchSeconds += secondsSince(t0);
+
+        std::vector<bool> checked(Dispatch::KINDS, false);
+        for (const Dispatch::Assignment& a : sent) {
+            const Dispatch::Incident& inc = dispatch.incidents()[a.incident];
+            if (!checked[inc.kind] && expected[inc.kind] >= 0.0f) {
+                checked[inc.kind] = true;
+                if (fabsf(expected[inc.kind] - a.eta) > 1e-3f) mismatched++;
+            }
+            dispatch.arrived(a.unit, now + a.eta);
+            job[a.unit] = a.incident;
+            freeAt[a.unit] = now + a.eta + service[inc.kind];
+            unitState[a.unit] = inc.tile * 4 + (int)(rng() % 4);
+            dispatch.moved(a.unit, unitState[a.unit]);
+        }
+    }
+
+    const char* names[Dispatch::KINDS] = { "ambulance", "fire", "police" };
+    for (int k = 0; k < Dispatch::KINDS; k++) {
+        for (int p = 0; p < 3; p++) {
+            std::vector<float> response;
+            for (const Dispatch::Incident& inc : dispatch.incidents()) {
+                if (inc.kind == k && inc.priority == p && inc.arrived >= 0.0f) response.push_back(inc.arrived - inc.reported);
+            }
+            if (response.empty()) continue;
+            std::sort(response.begin(), response.end());
+            double sum = 0.0;
+            for (float r : response) sum += r;
+            printf("%-9s priority %d %5zu incidents, response mean %6.1f s, p95 %6.1f s, max %6.1f s\n", names[k], p,
+                   response.size(), sum / response.size(), response[response.size() * 95 / 100], response.back());
+        }
+    }
+    int waiting = dispatch.queued(Dispatch::AMBULANCE) + dispatch.queued(Dispatch::FIRE) + dispatch.queued(Dispatch::POLICE);
+    printf("%-14s %9.1f us per tick, %llu searches\n", "dispatch", dispatchSeconds * 1e6 / (hour / step),
+           (unsigned long long)dispatch.searches());
+    printf("%-14s %9.1f us per tick, %lld searches\n", "every unit", scanSeconds * 1e6 / (hour / step), scans);
+    printf("%lld arrival times differing from the per-unit searches\n", mismatched);
+    printf("%zu incidents (%d still queued) in an hour, %d units on a %d x %d grid\n", dispatch.incidents().size(), waiting,
+           units, side, side);
+    return mismatched == 0 ? 0 : 1;
+}
+
+// Long run of generated incidents on a 64 x 64 street grid, for dispatch throughput and the tails
+// of response times under load. The grid is cut into 8 x 8 blocks of homes, schools, offices,
+// restaurants and shops, and each kind of incident is more likely around some of them. Units work
+// as in the dispatch bench, without the per-unit check, except that traffic makes a drive take up
+// to 40% longer than searched. Response times are read from the dispatch histograms and written
+// to `csvPath`. Fails if a second generator with the same seed doesn't give the same incidents,
+// or if a histogram percentile is more than 1% off the exact one.
+static int runLoad(float perHour, float hours, int units, const char* csvPath) {
+    enum LandUse { HOMES, SCHOOL, OFFICES, RESTAURANTS, SHOPS, USES };
+    const float weight[USES][IncidentGenerator::KINDS] = { // ambulance, fire, police
+        { 1.0f, 0.5f, 0.5f }, { 4.0f, 1.0f, 2.0f }, { 3.0f, 1.0f, 1.0f }, { 2.0f, 4.0f, 1.5f }, { 1.5f, 1.0f, 3.0f } };
+    const int side = 64, tiles = side * side, block = 8;
+    const float service[Dispatch::KINDS] = { 480.0f, 600.0f, 240.0f };
+    const float step = 1.0f, end = hours * 3600.0f;
+
+    std::mt19937 rng(29);
+    std::vector<int> use((side / block) * (side / block));
+    for (int& u : use) u = rng() % 10 < 6 ? HOMES : 1 + (int)(rng() % (USES - 1));
+    auto useOf = [&](int t) { return use[(t / side / block) * (side / block) + t % side / block]; };
+    std::vector<float> density[IncidentGenerator::KINDS];
+    int homeTiles = 0;
+    for (int k = 0; k < IncidentGenerator::KINDS; k++) {
+        density[k].resize(tiles);
+        for (int t = 0; t < tiles; t++) density[k][t] = weight[useOf(t)][k];
+    }
+    for (int t = 0; t < tiles; t++) homeTiles += useOf(t) == HOMES;
+
+    IncidentGenerator::Params params;
+    params.perHour = perHour;
+    params.seed = 31;
+    IncidentGenerator generator(params), replay(params);
+    for (int k = 0; k < IncidentGenerator::KINDS; k++) {
+        generator.setDensity(k, density[k]);
+        replay.setDensity(k, density[k]);
+    }
+
+    Dispatch dispatch;
+    dispatch.setGraph(streetGrid(side));
+    std::vector<float> freeAt(units, -1.0f);
+    std::vector<int> job(units, -1);
+    for (int u = 0; u < units; u++) dispatch.addUnit(u % Dispatch::KINDS, (int)(rng() % tiles) * 4 + (int)(rng() % 4));
+
+    std::vector<IncidentGenerator::Incident> batch, again;
+    std::vector<Dispatch::Assignment> sent;
+    double dispatchSeconds = 0.0;
+    long long differing = 0, atHomes = 0;
+    int longestQueue = 0;
+    Clock::time_point start = Clock::now();
+    for (float now = 0.0f; now < end; now += step) {
+        batch.clear();
+        again.clear();
+        generator.generate(now, batch); // reported since the last tick
+        replay.generate(now, again);
+        if (again.size() != batch.size()) differing++;
+        for (size_t i = 0; i < batch.size(); i++) {
+            const IncidentGenerator::Incident& inc = batch[i];
+            if (i < again.size() && (again[i].time != inc.time || again[i].kind != inc.kind || again[i].tile != inc.tile ||
+                                     again[i].priority != inc.priority)) differing++;
+            atHomes += useOf(inc.tile) == HOMES;
+            dispatch.report(inc.kind, inc.tile, inc.priority, inc.time);
+        }
+
+        for (int u = 0; u < units; u++) {
+            if (job[u] < 0 || now < freeAt[u]) continue;
+            dispatch.release(u, now);
+            job[u] = -1;
+        }
+        Clock::time_point t0 = Clock::now();
+        sent.clear();
+        dispatch.assign(now, sent);
+        dispatchSeconds += secondsSince(t0);
+        for (const Dispatch::Assignment& a : sent) {
+            const Dispatch::Incident& inc = dispatch.incidents()[a.incident];
+            float travel = a.eta * (0.9f + 0.5f * (float)(rng() % 1000) / 1000.0f);
+            dispatch.arrived(a.unit, now + travel);
+            job[a.unit] = a.incident;
+            freeAt[a.unit] = now + travel + service[inc.kind];
+            dispatch.moved(a.unit, inc.tile * 4 + (int)(rng() % 4));
+        }
+        int queued = dispatch.queued(Dispatch::AMBULANCE) + dispatch.queued(Dispatch::FIRE) + dispatch.queued(Dispatch::POLICE);
+        longestQueue = std::max(longestQueue, queued);
+    }
+    double wall = secondsSince(start);
+
+    const char* names[Dispatch::KINDS] = { "ambulance", "fire", "police" };
+    long long cleared = 0, offPercentile = 0;
+    for (int k = 0; k < Dispatch::KINDS; k++) {
+        std::vector<float> response;
+        for (const Dispatch::Incident& inc : dispatch.incidents()) {
+            if (inc.kind == k && inc.arrived >= 0.0f) response.push_back(inc.arrived - inc.reported);
+            if (inc.kind == k && inc.cleared >= 0.0f) cleared++;
+        }
+        if (response.empty()) continue;
+        std::sort(response.begin(), response.end());
+        const Dispatch::Stats& st = dispatch.stats(k);
+        const float percents[] = { 50.0f, 90.0f, 99.0f, 99.9f, 100.0f };
+        for (float p : percents) {
+            size_t rank = std::max((size_t)1, (size_t)ceil(p * 0.01 * response.size()));
+            float exact = response[std::min(rank, response.size()) - 1];
+            if (fabsf(st.response.percentile(p) - exact) > exact * 0.01f + 0.001f) offPercentile++;
+        }
+        uint64_t predicted = st.late.count() + st.early.count();
+        printf("%-9s %6llu incidents, response p50 %7.1f s, p90 %7.1f s, p99 %7.1f s, max %7.1f s\n", names[k],
+               (unsigned long long)st.response.count(), st.response.percentile(50.0f), st.response.percentile(90.0f),
+               st.response.percentile(99.0f), st.response.max());
+        printf("%-9s travel p50 %5.1f s, %4.1f%% later than predicted (p90 by %4.1f s), mean error %+5.2f s\n", "",
+               st.travel.percentile(50.0f), predicted ? 100.0 * st.late.count() / predicted : 0.0,
+               st.late.percentile(90.0f),
+               predicted ? (st.late.mean() * st.late.count() - st.early.mean() * st.early.count()) / predicted : 0.0);
+    }
+    size_t total = dispatch.incidents().size();
+    int waiting = dispatch.queued(Dispatch::AMBULANCE) + dispatch.queued(Dispatch::FIRE) + dispatch.queued(Dispatch::POLICE);
+    printf("%zu incidents in %.1f h (%.0f expected), %.1f%% around homes on %.1f%% of the tiles\n", total, hours,
+           perHour * hours, total ? 100.0 * atHomes / total : 0.0, 100.0 * homeTiles / tiles);
+    printf("%.1f incidents cleared per hour, longest queue %d, %d still queued\n", cleared / hours, longestQueue, waiting);
+    printf("dispatch %.1f us per tick, %llu searches; %.0f x real time with %d units\n",
+           dispatchSeconds * 1e6 / (end / step), (unsigned long long)dispatch.searches(), end / wall, units);
+    printf("%lld incidents differing between two generators with the same seed\n", differing);
+    printf("%lld histogram percentiles more than 1%% off the exact ones\n", offPercentile);
+    if (!dispatch.exportHistograms(csvPath)) fprintf(stderr, "cannot write %s\n", csvPath);
+    return differing == 0 && offPercentile == 0 ? 0 : 1;
+}
+
+// Headless city for checkpoint runs: cars in SoA arrays on a grid of streets, one lane each way,
+// following with the IDM kernel and stopping at the fixed-time signal on every crossing, plus
+// random incidents sent to units as in runLoad. Cars in a lane are stored together in driving
+// order, so the car ahead is the next one (the first for the last) and the world is nothing but
+// flat arrays and the modules' own state.
+struct BenchWorld {
+    static const int BLOCK = 20, DISPATCH_SIDE = 64;
+    IdmParams idm;
+    int streets, lanes;
+    float length;                       // of every lane, which loops
+    std::vector<int> first;             // per lane, its first car; lanes + 1 entries
+    std::vector<float> u, v, v0;        // per car: distance along its lane, speed, desired speed
+    std::vector<float> gap, dv, accel, ds;
+    SignalScheduler signals;            // one controller per crossing, row * streets + column
+    std::vector<int> changed;
+    Dispatch dispatch;
+    IncidentGenerator incidents;
+    std::vector<IncidentGenerator::Incident> batch;
+    std::vector<Dispatch::Assignment> sent;
+    std::vector<float> freeAt;          // per unit, when its incident is dealt with
+    std::vector<int> job;
+    std::mt19937 rng{41};
+    float now{0.0f};
+    uint64_t ticks{0};
+
+    BenchWorld(int cars, int units, float perHour) {
+        streets = std::max(2, (int)ceilf(sqrtf(cars / 4.0f))); // a car every 10 units
+        lanes = streets * 2; // lane l runs along street l / 2, eastbound when even, southbound when odd
+        length = (float)(streets * BLOCK);
+        for (int l = 0; l <= lanes; l++) first.push_back((int)((int64_t)cars * l / lanes));
+        u.resize(cars);
+        v.resize(cars);
+        v0.resize(cars);
+        gap.resize(cars);
+        dv.resize(cars);
+        accel.resize(cars);
+        ds.resize(cars);
+        std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+        for (int l = 0; l < lanes; l++) {
+            int count = first[l + 1] - first[l];
+            for (int k = 0; k < count; k++) {
+                int i = first[l] + k;
+                u[i] = length * (k + 0.3f * u01(rng)) / count;
+                v0[i] = 3.0f + 3.0f * u01(rng);
+                v[i] = v0[i] * u01(rng);
+            }
+        }
+        int plan = signals.addStandardPlan(0xF, 8.0f, 3.0f, 2.0f, 1.0f);
+        for (int c = 0; c < streets * streets; c++) signals.add(plan, signals.cycleLength(plan) * u01(rng));
+
+        IncidentGenerator::Params params;
+        params.perHour = perHour;
+        params.seed = 43;
+        incidents = IncidentGenerator(params);
+        std::vector<float> density(DISPATCH_SIDE * DISPATCH_SIDE, 1.0f);
+        for (int k = 0; k < IncidentGenerator::KINDS; k++) incidents.setDensity(k, density);
+        dispatch.setGraph(streetGrid(DISPATCH_SIDE));
+        for (int n = 0; n < units; n++) dispatch.addUnit(n % Dispatch::KINDS, (int)(rng() % (DISPATCH_SIDE * DISPATCH_SIDE * 4)));
+        freeAt.assign(units, -1.0f);
+        job.assign(units, -1);
+    }
+
+    void step(float dt) {
+        now += dt;
+        ticks++;
+        signals.advance(now, changed);
+        const int movement[2] = { IntersectionManager::movementOf(1, 1), IntersectionManager::movementOf(2, 2) }; // E, S
+        for (int l = 0; l < lanes; l++) {
+            int street = l / 2, axis = l % 2;
+            for (int i = first[l]; i < first[l + 1]; i++) {
+                int lead = i + 1 < first[l + 1] ? i + 1 : first[l];
+                float g = IDM_FREE_GAP, closing = 0.0f;
+                if (lead != i) {
+                    float ahead = u[lead] - u[i];
+                    if (ahead < 0.0f) ahead += length;
+                    g = std::max(0.0f, ahead - idm.vehicleLength);
+                    closing = v[i] - v[lead];
+                }
+                // Stop line of the next crossing, half a block on from the last one
+                int k = (int)floorf((u[i] + 2.0f) / BLOCK - 0.5f) + 1;
+                float stop = k * BLOCK + BLOCK * 0.5f - 2.0f - u[i];
+                int crossing = k % streets;
+                int c = axis == 0 ? street * streets + crossing : crossing * streets + street;
+                bool green = signals.open(c) >> movement[axis] & 1;
+                if (!green && stop < g && stop > v[i] * v[i] / (4.0f * idm.comfortDecel)) {
+                    g = stop;
+                    closing = v[i];
+                }
+                gap[i] = g;
+                dv[i] = closing;
+            }
+        }
+        int n = (int)u.size();
+        idmAccelerate(idm, n, v.data(), v0.data(), gap.data(), dv.data(), accel.data());
+        idmAdvance(n, dt, accel.data(), gap.data(), v.data(), ds.data());
+        for (int i = 0; i < n; i++) {
+            u[i] += ds[i];
+            if (u[i] >= length) u[i] -= length;
+        }
+
+        batch.clear();
+        incidents.generate(now, batch);
+        for (const IncidentGenerator::Incident& inc : batch) dispatch.report(inc.kind, inc.tile, inc.priority, inc.time);
+        for (size_t unit = 0; unit < job.size(); unit++) {
+            if (job[unit] < 0 || now < freeAt[unit]) continue;
+            dispatch.release((int)unit, now);
+            job[unit] = -1;
+        }
+        sent.clear();
+        dispatch.assign(now, sent);
+        for (const Dispatch::Assignment& a : sent) {
+            const Dispatch::Incident& inc = dispatch.incidents()[a.incident];
+            float travel = a.eta * (0.9f + 0.5f * (float)(rng() % 1000) / 1000.0f);
+            dispatch.arrived(a.unit, now + travel);
+            job[a.unit] = a.incident;
+            freeAt[a.unit] = now + travel + 120.0f;
+            dispatch.moved(a.unit, inc.tile * 4 + (int)(rng() % 4));
+        }
+    }
+
+    // What a user can do to the world, as replay commands
+    enum Command { REPORT, PREEMPT };
+    void apply(const ReplayLog::Command& c) {
+        if (c.type == REPORT) dispatch.report(c.b % Dispatch::KINDS, c.a, c.b / Dispatch::KINDS, now);
+        else if (c.type == PREEMPT) signals.preempt(c.a, (uint16_t)c.b, now, now + 5.0f);
+    }
+
+    // FNV-1a over the cars, lights, units and incident log
+    uint64_t checksum() const {
+        uint64_t h = 1469598103934665603ull;
+        auto mix = [&h](const void* p, size_t size) {
+            const uint8_t* b = (const uint8_t*)p;
+            for (size_t i = 0; i < size; i++) { h ^= b[i]; h *= 1099511628211ull; }
+        };
+        mix(&now, sizeof(now));
+        mix(u.data(), u.size() * sizeof(float));
+        mix(v.data(), v.size() * sizeof(float));
+        mix(freeAt.data(), freeAt.size() * sizeof(float));
+        mix(job.data(), job.size() * sizeof(int));
+        for (int c = 0; c < streets * streets; c++) { uint16_t open = signals.open(c); mix(&open, sizeof(open)); }
+        mix(dispatch.incidents().data(), dispatch.incidents().size() * sizeof(Dispatch::Incident));
+        return h;
+    }
+
+    // The layout (lanes, plans, graph, densities) comes from the constructor; the rest is saved
+    void save(SnapshotWriter& w) const {
+        std::ostringstream state;
+        state << rng;
+        w.value("world.time", now);
+        w.value("world.ticks", ticks);
+        w.text("world.rng", state.str());
+        w.array("world.u", u);
+        w.array("world.v", v);
+        w.array("world.v0", v0);
+        w.array("world.freeAt", freeAt);
+        w.array("world.job", job);
+        signals.save(w);
+        dispatch.save(w);
+        incidents.save(w);
+    }
+
+    bool load(const SnapshotReader& r) {
+        std::string state;
+        size_t n = u.size(), units = job.size();
+        if (!r.value("world.time", now) || !r.value("world.ticks", ticks) || !r.text("world.rng", state) ||
+            !r.array("world.u", u) || !r.array("world.v", v) || !r.array("world.v0", v0) ||
+            !r.array("world.freeAt", freeAt) || !r.array("world.job", job)) return false;
+        if (u.size() != n || v.size() != n || v0.size() != n || freeAt.size() != units || job.size() != units) return false;
+        std::istringstream in(state);
+        in >> rng;
+        return !in.fail() && signals.load(r) && dispatch.load(r) && incidents.load(r);
+    }
+
+    // Where every car is, as telemetry rows: lanes run along the middle of their street and the
+    // tile is the block a car is in
+    void telemetry(Telemetry::Row* rows) const {
+        for (int l = 0; l < lanes; l++) {
+            float across = (l / 2) * BLOCK + BLOCK * 0.5f;
+            for (int i = first[l]; i < first[l + 1]; i++) {
+                Telemetry::Row& r = rows[i];
+                r.id = (uint32_t)i;
+                r.x = l % 2 == 0 ? u[i] : across;
+                r.z = l % 2 == 0 ? across : u[i];
+                r.speed = v[i];
+                r.lane = 0.0f;
+                r.tile = std::min((int)(r.z / BLOCK), streets - 1) * streets + std::min((int)(r.x / BLOCK), streets - 1);
+            }
+        }
+    }
+
+    // Bit for bit: cars, lights, incident log and the random streams
+    bool sameAs(const BenchWorld& o) const {
+        auto same = [](const std::vector<float>& a, const std::vector<float>& b) {
+            return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+        };
+        if (!same(u, o.u) || !same(v, o.v) || !same(freeAt, o.freeAt) || job != o.job || rng != o.rng) return false;
+        for (int c = 0; c < streets * streets; c++) if (signals.open(c) != o.signals.open(c)) return false;
+        const std::vector<Dispatch::Incident>& a = dispatch.incidents(), &b = o.dispatch.incidents();
+        return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(Dispatch::Incident)) == 0 &&
+               incidents.generated() == o.incidents.generated();
+    }
+};
+
+// Checkpoint and resume: a world of `n` cars runs half the time and is saved, goes on to the end,
+// and a second world restored from the file runs the same second half. Both must end bit for bit
+// the same. The restored world saved again must give the file byte for byte, padding included.
+// Reports the time to save and load and the file size.
+static int runSnapshot(int n, float seconds, const char* path) {
+    const float dt = 0.1f;
+    int half = (int)(seconds / dt / 2.0f);
+    BenchWorld world(n, 90, 3600.0f);
+    Clock::time_point t0 = Clock::now();
+    for (int t = 0; t < half; t++) world.step(dt);
+    double stepSeconds = secondsSince(t0);
+
+    SnapshotWriter w;
+    t0 = Clock::now();
+    bool saved = w.open(path);
+    world.save(w);
+    saved = w.close() && saved;
+    double saveSeconds = secondsSince(t0);
+    if (!saved) { fprintf(stderr, "cannot write %s\n", path); return 1; }
+    for (int t = 0; t < half; t++) world.step(dt);
+
+    BenchWorld restored(n, 90, 3600.0f);
+    SnapshotReader r;
+    t0 = Clock::now();
+    bool loaded = r.open(path) && restored.load(r);
+    double loadSeconds = secondsSince(t0);
+    if (!loaded) { fprintf(stderr, "cannot restore %s\n", path); return 1; }
+    SnapshotWriter again;
+    again.open();
+    restored.save(again);
+    again.close();
+    std::vector<uint8_t> file;
+    if (FILE* f = fopen(path, "rb")) {
+        uint8_t buf[65536];
+        for (size_t got; (got = fread(buf, 1, sizeof(buf), f)) > 0;) file.insert(file.end(), buf, buf + got);
+        fclose(f);
+    }
+    bool resaved = file == again.buffer();
+    for (int t = 0; t < half; t++) restored.step(dt);
+    bool same = world.sameAs(restored);
+
+    double speed = 0.0;
+    for (float x : world.v) speed += x;
+    printf("%d vehicles, %d lanes, %d signals: %.1f ms per tick, mean speed %.2f, %zu incidents\n", n, world.lanes,
+           world.streets * world.streets, stepSeconds * 1e3 / std::max(1, half), speed / n, world.dispatch.incidents().size());
+    printf("snapshot %.1f MB: saved in %.1f ms, restored in %.1f ms\n", w.bytes() / 1048576.0, saveSeconds * 1e3,
+           loadSeconds * 1e3);
+    printf("restored world saves to %s bytes\n", resaved ? "the same" : "DIFFERENT");
+    printf("restored run %s the original after %d more ticks\n", same ? "matches" : "DIFFERS from", half);
+    return same && resaved ? 0 : 1;
+}
+
+// One recorded tick played back: its commands, then its step
+static void playTick(BenchWorld& world, const ReplayLog& log, uint64_t t) {
+    const ReplayLog::Command *c, *end;
+    for (log.commandsAt(t, c, end); c != end; ++c) world.apply(*c);
+    world.step(log.stepAt(t));
+}
+
+// The world as it was before tick t: the last keyframe before it, stepped on to t
+static bool seekTo(BenchWorld& world, const ReplayLog& log, uint64_t t) {
+    int k = log.keyframeBefore(t);
+    SnapshotReader r;
+    if (!log.openKeyframe(k, r) || !world.load(r)) return false;
+    for (uint64_t tick = log.keyframeTick(k); tick < t; tick++) playTick(world, log, tick);
+    return true;
+}
+
+// A run with a user in it: frame times that vary, incidents reported by hand and lights forced
+// green, recorded with a keyframe every 30 simulated seconds. The log is written to `path`, read
+// back and played from the start; the replay must end bit for bit where the run did. Then it
+// seeks to ticks in random order and checks each against the checksum taken there while recording.
+static int runReplay(int n, float seconds, const char* path) {
+    const float keyEvery = 30.0f;
+    BenchWorld world(n, 90, 600.0f);
+    ReplayLog log;
+    std::mt19937 user(47);
+    std::vector<std::pair<uint64_t, uint64_t>> probes; // tick, checksum before it
+    float nextKey = 0.0f;
+    int commands = 0;
+    Clock::time_point t0 = Clock::now();
+    double keySeconds = 0.0;
+    while (world.now < seconds) {
+        if (world.now >= nextKey) {
+            Clock::time_point k0 = Clock::now();
+            SnapshotWriter w;
+            w.open();
+            world.save(w);
+            w.close();
+            log.keyframe(std::move(w.buffer()));
+            keySeconds += secondsSince(k0);
+            nextKey += keyEvery;
+        }
+        if (user() % 97 == 0) probes.push_back({ log.ticks(), world.checksum() });
+        if (user() % 20 == 0) {
+            commands++;
+            int tile = (int)(user() % (BenchWorld::DISPATCH_SIDE * BenchWorld::DISPATCH_SIDE));
+            log.command(BenchWorld::REPORT, tile, (int)(user() % (Dispatch::KINDS * IncidentGenerator::PRIORITIES)));
+        }
+        if (user() % 50 == 0) {
+            commands++;
+            int c = (int)(user() % (world.streets * world.streets));
+            log.command(BenchWorld::PREEMPT, c, 0xF << (user() % 4 * 4));
+        }
+        const ReplayLog::Command *c, *end;
+        for (log.commandsAt(log.ticks(), c, end); c != end; ++c) world.apply(*c);
+        float dt = user() % 4 == 0 ? 0.08f + 0.01f * (user() % 5) : 0.1f; // mostly steady, the odd slow frame
+        log.step(dt);
+        world.step(dt);
+    }
+    double recordSeconds = secondsSince(t0);
+    if (!log.save(path)) { fprintf(stderr, "cannot write %s\n", path); return 1; }
+
+    ReplayLog played;
+    BenchWorld replay(n, 90, 600.0f);
+    SnapshotReader r;
+    if (!played.load(path) || !played.openKeyframe(0, r) || !replay.load(r)) { fprintf(stderr, "cannot read %s\n", path); return 1; }
+    t0 = Clock::now();
+    for (uint64_t t = 0; t < played.ticks(); t++) playTick(replay, played, t);
+    double replaySeconds = secondsSince(t0);
+    bool same = replay.sameAs(world);
+
+    std::shuffle(probes.begin(), probes.end(), user);
+    int wrong = 0;
+    uint64_t stepped = 0;
+    t0 = Clock::now();
+    for (const auto& p : probes) {
+        stepped += p.first - played.keyframeTick(played.keyframeBefore(p.first));
+        if (!seekTo(replay, played, p.first) || replay.checksum() != p.second) wrong++;
+    }
+    double seekSeconds = secondsSince(t0);
+
+    printf("%d vehicles, %.0f s in %llu ticks, %d commands, %d keyframes\n", n, seconds,
+           (unsigned long long)log.ticks(), commands, log.keyframeCount());
+    printf("recorded in %.2f s (keyframes %.0f ms), log %.1f MB\n", recordSeconds, keySeconds * 1e3, log.bytes() / 1048576.0);
+    printf("replayed in %.2f s, %.0f x real time: %s the recorded run\n", replaySeconds, world.now / replaySeconds,
+           same ? "matches" : "DIFFERS from");
+    printf("%zu seeks, %.1f ms each (%.0f ticks stepped on average), %d at a different state\n", probes.size(),
+           probes.empty() ? 0.0 : seekSeconds * 1e3 / probes.size(), probes.empty() ? 0.0 : (double)stepped / probes.size(), wrong);
+    return same && wrong == 0 ? 0 : 1;
+}
+
+// FNV-1a over a frame as quantized for the file
+static uint64_t frameHash(const Telemetry::Row* rows, size_t count, const Telemetry::Steps& q) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < count; i++) {
+        const Telemetry::Row& r = rows[i];
+        int64_t value[6] = { r.id, Telemetry::quantize(r.x, q.position), Telemetry::quantize(r.z, q.position),
+                             Telemetry::quantize(r.speed, q.speed), Telemetry::quantize(r.lane, q.lane), r.tile };
+        const uint8_t* b = (const uint8_t*)value;
+        for (size_t k = 0; k < sizeof(value); k++) { h ^= b[k]; h *= 1099511628211ull; }
+    }
+    return h;
+}
+
+// Trajectories of `n` cars sampled `hz` times a simulated second and streamed to `path` while the
+// world runs. Reports how long handing a frame over held up the tick, frames dropped, file size and
+// bytes per sample; then reads the file back, checking every frame against what was handed over,
+// and times pulling a minute out of the middle.
+static int runTelemetry(int n, float seconds, float hz, const char* path) {
+    const float dt = 0.1f;
+    BenchWorld world(n, 90, 600.0f);
+    TelemetryWriter writer;
+    TelemetryWriter::Params params;
+    if (!writer.open(path, params)) { fprintf(stderr, "cannot write %s\n", path); return 1; }
+    std::vector<uint64_t> hashes; // of every frame handed over, by frame
+    std::vector<float> times;
+    double handSeconds = 0.0, worstHand = 0.0;
+    float nextSample = 0.0f;
+    Clock::time_point t0 = Clock::now();
+    while (world.now < seconds) {
+        if (world.now >= nextSample) {
+            Clock::time_point h0 = Clock::now();
+            Telemetry::Row* rows = writer.frame(world.now, (uint32_t)n);
+            if (rows) {
+                world.telemetry(rows);
+                writer.commit();
+            }
+            double held = secondsSince(h0);
+            handSeconds += held;
+            worstHand = std::max(worstHand, held);
+            if (rows) {
+                hashes.push_back(frameHash(rows, n, params.steps));
+                times.push_back(world.now);
+            }
+            nextSample += 1.0f / hz;
+        }
+        world.step(dt);
+    }
+    double runSeconds = secondsSince(t0);
+    t0 = Clock::now();
+    bool closed = writer.close();
+    double drainSeconds = secondsSince(t0);
+    if (!closed) { fprintf(stderr, "cannot write %s\n", path); return 1; }
+
+    TelemetryReader reader;
+    if (!reader.open(path)) { fprintf(stderr, "cannot read %s\n", path); return 1; }
+    size_t frame = 0, wrong = 0;
+    bool read = reader.scan(reader.startTime(), reader.endTime(), [&](float time, const Telemetry::Row* rows, size_t count) {
+        if (frame >= hashes.size() || time != times[frame] || frameHash(rows, count, reader.steps()) != hashes[frame]) wrong++;
+        frame++;
+    });
+    wrong += hashes.size() - std::min(frame, hashes.size());
+
+    uint64_t rowsRead = 0;
+    t0 = Clock::now();
+    reader.scan(reader.startTime(), reader.endTime(), [&](float, const Telemetry::Row*, size_t count) { rowsRead += count; });
+    double scanSeconds = secondsSince(t0);
+    float mid = reader.startTime() + (reader.endTime() - reader.startTime()) * 0.5f;
+    size_t rangeFrames = 0;
+    t0 = Clock::now();
+    reader.scan(mid, mid + 60.0f, [&](float, const Telemetry::Row*, size_t) { rangeFrames++; });
+    double rangeSeconds = secondsSince(t0);
+
+    uint64_t samples = writer.rowsWritten();
+    printf("%d vehicles, %.0f s at %.1f Hz: %llu frames written, %llu dropped, run took %.1f s\n", n, seconds, hz,
+           (unsigned long long)writer.framesWritten(), (unsigned long long)writer.framesDropped(), runSeconds);
+    printf("handing a frame over: %.2f ms mean, %.2f ms worst; %.0f ms left to write at the end\n",
+           hashes.empty() ? 0.0 : handSeconds * 1e3 / hashes.size(), worstHand * 1e3, drainSeconds * 1e3);
+    printf("file %.1f MB in %zu chunks: %.2f bytes per sample (%.1f raw)\n", writer.bytes() / 1048576.0,
+           reader.chunks().size(), samples ? (double)writer.bytes() / samples : 0.0, (double)sizeof(Telemetry::Row));
+    printf("full scan %.2f s, %.1f M samples/s: %zu frames %s\n", scanSeconds, rowsRead / std::max(scanSeconds, 1e-9) / 1e6,
+           frame, read && wrong == 0 ? "match" : "DIFFER");
+    printf("a minute from the middle: %zu frames in %.1f ms\n", rangeFrames, rangeSeconds * 1e3);
+    return read && wrong == 0 ? 0 : 1;
+}
+
+// The reader utility: frames from t0 to t1 of a telemetry file as CSV, one row per vehicle
+static int runExtract(const char* path, float t0, float t1, const char* csvPath) {
+    TelemetryReader reader;
+    if (!reader.open(path)) { fprintf(stderr, "cannot read %s\n", path); return 1; }
+    FILE* out = strcmp(csvPath, "-") == 0 ? stdout : fopen(csvPath, "w");
+    if (!out) { fprintf(stderr, "cannot write %s\n", csvPath); return 1; }
+    fprintf(out, "time,id,x,z,speed,lane,tile\n");
+    uint64_t count = 0;
+    bool read = reader.scan(t0, t1, [&](float time, const Telemetry::Row* rows, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            const Telemetry::Row& r = rows[i];
+            fprintf(out, "%.3f,%u,%.2f,%.2f,%.2f,%.2f,%d\n", time, r.id, r.x, r.z, r.speed, r.lane, r.tile);
+        }
+        count += n;
+    });
+    if (out != stdout) fclose(out);
+    fprintf(stderr, "%s: %.1f to %.1f s recorded, %llu rows from %.1f to %.1f s\n", path, reader.startTime(),
+            reader.endTime(), (unsigned long long)count, t0, t1);
+    if (!read) { fprintf(stderr, "%s is damaged\n", path); return 1; }
+    return 0;
+}
+
+// Builds the query index of a trajectory file (bench_trajectories.ctl from the telemetry mode by
+// default) and times random queries against it: who was on a tile over a minute, and the whole
+// trajectory of a vehicle. A few of each are checked against a scan of the trajectory file.
+static int runTrajectoryIndex(const char* path, const char* indexPath, float bucketSeconds) {
+    Clock::time_point t0 = Clock::now();
+    if (!TrajectoryIndex::build(path, indexPath, bucketSeconds)) {
+        fprintf(stderr, "cannot index %s into %s (traffic_bench telemetry writes one)\n", path, indexPath);
+        return 1;
+    }
+    double buildSeconds = secondsSince(t0);
+    TrajectoryIndex index;
+    t0 = Clock::now();
+    if (!index.open(indexPath)) { fprintf(stderr, "cannot open %s\n", indexPath); return 1; }
+    double openSeconds = secondsSince(t0);
+    if (index.frames() == 0 || index.tiles() == 0 || index.vehicles() == 0) { fprintf(stderr, "%s is empty\n", path); return 1; }
+
+    std::mt19937 pick(53);
+    const int queries = 1000;
+    const uint32_t window = std::min<uint32_t>(60, index.frames() - 1); // frames a tile query spans
+    auto windowAt = [&](uint32_t f, float& from, float& to) {
+        from = index.frameTime(f);
+        to = index.frameTime(std::min(f + window, index.frames() - 1));
+    };
+    std::vector<TrajectoryIndex::Visit> visits;
+    std::vector<TrajectoryIndex::Point> points;
+    double tileSeconds = 0.0, tileWorst = 0.0, pathSeconds = 0.0, pathWorst = 0.0;
+    uint64_t visitCount = 0, pointCount = 0;
+    for (int q = 0; q < queries; q++) {
+        float from, to;
+        windowAt((uint32_t)(pick() % index.frames()), from, to);
+        int tile = (int)(pick() % index.tiles());
+        Clock::time_point q0 = Clock::now();
+        index.visits(tile, from, to, visits);
+        double s = secondsSince(q0);
+        tileSeconds += s;
+        tileWorst = std::max(tileWorst, s);
+        visitCount += visits.size();
+
+        uint32_t id = (uint32_t)(pick() % index.vehicles());
+        q0 = Clock::now();
+        index.trajectory(id, index.frameTime(0), index.frameTime(index.frames() - 1), points);
+        s = secondsSince(q0);
+        pathSeconds += s;
+        pathWorst = std::max(pathWorst, s);
+        pointCount += points.size();
+    }
+
+    // Against the trajectory file: the visits to a tile in the window, one per run of frames a
+    // vehicle spends on it, and the frames of a vehicle in it. The last windows straddle the
+    // first bucket boundaries, where a visit is stored in two pieces.
+    TelemetryReader reader;
+    if (!reader.open(path)) { fprintf(stderr, "cannot read %s\n", path); return 1; }
+    int checks = 0, wrong = 0;
+    std::vector<int64_t> lastOn(index.vehicles());
+    for (int c = 0; c < 6; c++) {
+        uint32_t first = (uint32_t)(pick() % index.frames());
+        if (c >= 3) {
+            float boundary = index.frameTime(0) + bucketSeconds * (c - 2);
+            uint32_t f = 0;
+            while (f < index.frames() && index.frameTime(f) < boundary) f++;
+            if (f == index.frames()) continue;
+            first = f > window / 2 ? f - window / 2 : 0;
+        }
+        float from, to;
+        windowAt(first, from, to);
+        uint32_t id = (uint32_t)(pick() % index.vehicles());
+        int tile = -1;
+        float middle = index.frameTime(std::min(first + window / 2, index.frames() - 1));
+        reader.scan(middle, middle, [&](float, const Telemetry::Row* rows, size_t n) {
+            for (size_t i = 0; i < n && tile < 0; i++) tile = rows[i].tile; // a tile that is in use
+        });
+        std::vector<uint32_t> runs;
+        std::vector<TrajectoryIndex::Point> expected;
+        std::fill(lastOn.begin(), lastOn.end(), -2);
+        int64_t frame = 0;
+        reader.scan(from, to, [&](float time, const Telemetry::Row* rows, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                const Telemetry::Row& r = rows[i];
+                if (r.tile == tile && r.id < lastOn.size()) {
+                    if (lastOn[r.id] != frame - 1) runs.push_back(r.id);
+                    lastOn[r.id] = frame;
+                }
+                if (r.id == id) expected.push_back({ time, r.x, r.z, r.speed, r.lane, r.tile });
+            }
+            frame++;
+        });
+        std::stable_sort(runs.begin(), runs.end());
+        index.visits(tile, from, to, visits);
+        std::vector<uint32_t> found;
+        for (const TrajectoryIndex::Visit& v : visits) found.push_back(v.id);
+        index.trajectory(id, from, to, points);
+        bool samePath = points.size() == expected.size();
+        for (size_t i = 0; samePath && i < points.size(); i++) {
+            const TrajectoryIndex::Point &a = points[i], &b = expected[i];
+            samePath = a.time == b.time && a.x == b.x && a.z == b.z && a.speed == b.speed && a.lane == b.lane && a.tile == b.tile;
+        }
+        checks += 2;
+        wrong += (found != runs) + !samePath;
+    }
+
+    printf("indexed %s in %.1f s: %.1f MB for %u frames, %u vehicles, %u tiles, %llu visits (%.0f s buckets)\n", path,
+           buildSeconds, index.bytes() / 1048576.0, index.frames(), index.vehicles(), index.tiles(),
+           (unsigned long long)index.visitCount(), bucketSeconds);
+    printf("opened in %.2f ms\n", openSeconds * 1e3);
+    printf("tile over %u frames: %.3f ms mean, %.3f ms worst, %.1f visits\n", window, tileSeconds * 1e3 / queries,
+           tileWorst * 1e3, (double)visitCount / queries);
+    printf("whole trajectory of a vehicle: %.3f ms mean, %.3f ms worst, %.0f points\n", pathSeconds * 1e3 / queries,
+           pathWorst * 1e3, (double)pointCount / queries);
+    printf("%d of %d queries %s a scan of the trajectory file\n", checks - wrong, checks, wrong ? "match, the rest DIFFER from" : "match");
+    return wrong == 0 ? 0 : 1;
+}
+
+// Queries on an index as CSV: `tile <tile>` for the visits to a tile, `vehicle <id>` for a trajectory
+static int runQuery(const char* indexPath, const char* what, long key, float t0, float t1) {
+    TrajectoryIndex index;
+    if (!index.open(indexPath)) { fprintf(stderr, "cannot open %s\n", indexPath); return 1; }
+    if (strcmp(what, "tile") == 0) {
+        std::vector<TrajectoryIndex::Visit> visits;
+        index.visits((int)key, t0, t1, visits);
+        printf("id,from,to\n");
+        for (const TrajectoryIndex::Visit& v : visits) printf("%u,%.3f,%.3f\n", v.id, v.t0, v.t1);
+        return 0;
+    }
+    if (strcmp(what, "vehicle") == 0) {
+        std::vector<TrajectoryIndex::Point> points;
+        index.trajectory((uint32_t)key, t0, t1, points);
+        printf("time,x,z,speed,lane,tile\n");
+        for (const TrajectoryIndex::Point& p : points) printf("%.3f,%.2f,%.2f,%.2f,%.2f,%d\n", p.time, p.x, p.z, p.speed, p.lane, p.tile);
+        return 0;
+    }
+    fprintf(stderr, "query tile or vehicle, not %s\n", what);
+    return 1;
+}
+
+// A side x side tile map with a road along every block-th row and column, 4-way junctions where
+// they cross
+static void roadGrid(RoadGraph& g, int side, int block) {
+    std::vector<int> tiles(side * side, GRASS);
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            bool row = y % block == 0, col = x % block == 0;
+            if (row && col) tiles[y * side + x] = INTERSECTION;
+            else if (row) tiles[y * side + x] = ROAD_H;
+            else if (col) tiles[y * side + x] = ROAD_V;
+        }
+    }
+    g.build(tiles.data(), side, side);
+}
+
+// Closure sweep of the coverage isochrones: three groups of stations on a street grid, each
+// scenario closing a handful of road tiles. The sweep is checked against a full recompute of
+// every field on one thread, and against the incremental repair the viewer runs when a road closes.
+static int runCoverage(int side, int scenarios) {
+    const int groups = 3, stations = 4, closures = 12;
+    const float target = 30.0f;
+    RoadGraph base;
+    roadGrid(base, side, 4);
+    std::vector<int> roads;
+    for (int t = 0; t < base.size(); t++) if (base.isPassable(t, true)) roads.push_back(t);
+
+    std::mt19937 rng(27);
+    std::vector<CoverageField> fields(groups);
+    for (CoverageField& f : fields) {
+        for (int s = 0; s < stations; s++) f.sources.push_back(roads[rng() % roads.size()]);
+        std::sort(f.sources.begin(), f.sources.end());
+        f.sources.erase(std::unique(f.sources.begin(), f.sources.end()), f.sources.end());
+        f.solve(base);
+    }
+    auto isSource = [&](int t) {
+        for (const CoverageField& f : fields)
+            if (std::binary_search(f.sources.begin(), f.sources.end(), t)) return true;
+        return false;
+    };
+    std::vector<std::vector<int>> closed(scenarios);
+    for (std::vector<int>& c : closed) {
+        while ((int)c.size() < closures) {
+            int t = roads[rng() % roads.size()];
+            if (!isSource(t) && std::find(c.begin(), c.end(), t) == c.end()) c.push_back(t);
+        }
+    }
+
+    Clock::time_point t0 = Clock::now();
+    std::vector<CoverageField::Stats> swept = CoverageField::sweep(base, fields.data(), groups, closed, target);
+    double sweepSeconds = secondsSince(t0);
+
+    const int checked = std::min(scenarios, 20);
+    int wrong = 0;
+    double fullSeconds = 0.0, repairSeconds = 0.0;
+    for (int s = 0; s < checked; s++) {
+        RoadGraph g = base;
+        for (int t : closed[s]) g.setClosed(t / side, t % side, true);
+        bool same = true;
+        for (int i = 0; i < groups; i++) {
+            CoverageField full;
+            full.sources = fields[i].sources;
+            t0 = Clock::now();
+            full.solve(g);
+            fullSeconds += secondsSince(t0);
+            CoverageField::Stats a = full.stats(g, target), b = swept[s * groups + i];
+            same = same && a.meanTime == b.meanTime && a.worstTime == b.worstTime && a.coveredShare == b.coveredShare;
+
+            CoverageField repaired = fields[i];
+            t0 = Clock::now();
+            for (int t : closed[s]) repaired.repairTile(g, t);
+            repairSeconds += secondsSince(t0);
+            for (int tile = 0; same && tile < g.size(); tile++) {
+                float x = full.tileTime(tile), y = repaired.tileTime(tile);
+                same = (x == y) || fabsf(x - y) <= 1e-3f * std::max(1.0f, x);
+            }
+        }
+        wrong += !same;
+    }
+
+    double meanShare = 0.0;
+    for (const CoverageField::Stats& st : swept) meanShare += st.coveredShare;
+    printf("%d closure scenarios of %d tiles, %d groups, %dx%d grid (%d road tiles)\n", scenarios, closures, groups,
+           side, side, (int)roads.size());
+    printf("sweep: %.2f s on %u threads, %.1f scenarios/s, %.1f%% of road tiles within %.0f s on average\n",
+           sweepSeconds, std::max(1u, std::thread::hardware_concurrency()), scenarios / std::max(sweepSeconds, 1e-9),
+           100.0 * meanShare / std::max<size_t>(1, swept.size()), target);
+    printf("per scenario: full recompute %.2f ms, incremental repair %.2f ms\n", fullSeconds * 1e3 / checked,
+           repairSeconds * 1e3 / checked);
+    printf("%d of %d scenarios %s\n", checked - wrong, checked,
+           wrong ? "match, the rest DIFFER from a recompute" : "match a full recompute and the incremental repair");
+    return wrong == 0 ? 0 : 1;
+}
+
+// Chunk router against the flat lane-graph search on a street grid with closed tiles. Found routes
+// are refined to the end and must cost what the flat search's do; goals it can't reach (closed
+// tiles, and street stubs closed off at both ends) must fail on both, leaving an empty route.
+static int runRouter(int side, int queries) {
+    RoadGraph g;
+    roadGrid(g, side, 4);
+    std::vector<int> roads;
+    for (int t = 0; t < g.size(); t++) if (g.isPassable(t, true)) roads.push_back(t);
+    std::mt19937 rng(29);
+    std::vector<int> closed, cutOff;
+    for (int i = 0; i < side; i++) {
+        int t = roads[rng() % roads.size()];
+        if (g.isPassable(t, true)) { g.setClosed(t / side, t % side, true); closed.push_back(t); }
+    }
+    // Street tiles between two closed ones: on the road, but unreachable
+    for (int i = 0; i < side / 10; i++) {
+        int y = 4 * (int)(rng() % (side / 4)), x = 4 * (int)(rng() % (side / 4)) + 2;
+        if (x + 1 >= side) continue;
+        g.setClosed(y, x - 1, true);
+        g.setClosed(y, x + 1, true);
+        cutOff.push_back(g.id(y, x));
+    }
+    HierarchicalRouter router(g, 32);
+
+    struct Query { int start, goal; };
+    std::vector<Query> list(queries);
+    std::vector<int> open;
+    for (int t : roads) if (g.isPassable(t, true)) open.push_back(t);
+    for (int q = 0; q < queries; q++) {
+        list[q].start = open[rng() % open.size()];
+        if (q % 8 == 0) list[q].goal = closed[rng() % closed.size()];
+        else if (q % 8 == 1 && !cutOff.empty()) list[q].goal = cutOff[rng() % cutOff.size()];
+        else list[q].goal = open[rng() % open.size()];
+    }
+
+    std::vector<float> flatCost(queries);
+    std::vector<bool> flatFound(queries);
+    Clock::time_point t0 = Clock::now();
+    for (int q = 0; q < queries; q++) {
+        float cost = INFINITY;
+        flatFound[q] = !g.findPath(list[q].start, list[q].goal, true, -1, nullptr, &cost).empty();
+        flatCost[q] = cost;
+    }
+    double flatSeconds = secondsSince(t0);
+
+    std::vector<HierarchicalRouter::Route> routes(queries);
+    std::vector<bool> planned(queries);
+    t0 = Clock::now();
+    for (int q = 0; q < queries; q++) planned[q] = router.plan(list[q].start, list[q].goal, true, -1, routes[q]);
+    double planSeconds = secondsSince(t0);
+
+    int found = 0, wrong = 0;
+    double refineSeconds = 0.0;
+    std::vector<int> tiles;
+    for (int q = 0; q < queries; q++) {
+        tiles.clear();
+        t0 = Clock::now();
+        while (router.refine(routes[q], 12, true, tiles)) {}
+        refineSeconds += secondsSince(t0);
+        if (!planned[q]) {
+            wrong += flatFound[q] || !routes[q].done() || !tiles.empty();
+            continue;
+        }
+        found++;
+        float cost = g.pathCost(tiles, true, -1);
+        bool same = flatFound[q] && routes[q].done() && !tiles.empty() && tiles.front() == list[q].start &&
+                    tiles.back() == list[q].goal && fabsf(cost - flatCost[q]) <= 1e-3f * std::max(1.0f, flatCost[q]);
+        wrong += !same;
+    }
+
+    printf("%dx%d grid, %d closed tiles, %d chunks of %d, %d crossings\n", side, side, (int)closed.size() + 2 * (int)cutOff.size(),
+           router.chunkCount(), router.chunkSize(), router.nodeCount());
+    printf("%d queries, %d reachable: flat search %.3f ms, chunk plan %.3f ms (%.1fx), refining a whole route %.3f ms\n",
+           queries, found, flatSeconds * 1e3 / queries, planSeconds * 1e3 / queries, flatSeconds / std::max(planSeconds, 1e-9),
+           refineSeconds * 1e3 / std::max(1, found));
+    printf("%d of %d queries %s\n", queries - wrong, queries,
+           wrong ? "match, the rest DIFFER from the flat search" : "match the flat search (cost, or no route)");
+    return wrong == 0 ? 0 : 1;
+}
+
+// Commuters re-planning against live edge delays, as the viewer does it every tick: a scan of at
+// most 4,096 cars finds those due a check (every 5 s each), and at most 16 of them search a new route,
+// taken if it saves a second. Cars cross a tile in 0.8 s, 4 s more on every fifth street, and log
+// each crossing. Reports the cost per tick of logging plus ageing, and of the reroute scan. Exits
+// non-zero if a route taken is not a legal way from the car to its goal.
+static int runReroute(int n, int side, float seconds) {
+    const int scanPerTick = 4096, budgetPerTick = 16;
+    const float interval = 5.0f, minGain = 1.0f, freeTime = 0.8f, dt = 1.0f / 60.0f;
+    RoadGraph g;
+    roadGrid(g, side, 4);
+    EdgeTravelTimes edges(g);
+    auto dwell = [&](int tile) { return freeTime + (((tile / side) % 20 == 0 || (tile % side) % 20 == 0) ? 4.0f : 0.0f); };
+    auto exitDir = [&](int from, int to) {
+        for (int d = 0; d < 4; d++) if (g.neighbour(from, d) == to) return d;
+        return -1;
+    };
+
+    // Trips between junctions: along the row, then down the column
+    std::mt19937 rng(30);
+    const int blocks = (side - 1) / 4 + 1;
+    std::vector<std::vector<int>> route(n);
+    std::vector<int> cursor(n, 0), goal(n);
+    std::vector<float> left(n), nextCheck(n);
+    for (int i = 0; i < n; i++) {
+        int y = 4 * (int)(rng() % blocks), x = 4 * (int)(rng() % blocks);
+        int gy = 4 * (int)(rng() % blocks), gx = 4 * (int)(rng() % blocks);
+        std::vector<int>& r = route[i];
+        r.push_back(g.id(y, x));
+        while (x != gx) { x += gx > x ? 1 : -1; r.push_back(g.id(y, x)); }
+        while (y != gy) { y += gy > y ? 1 : -1; r.push_back(g.id(y, x)); }
+        goal[i] = r.back();
+        left[i] = dwell(r[0]) * (float)(rng() % 1000) / 1000.0f;
+        nextCheck[i] = interval * (float)(i % 16) / 16.0f;
+    }
+
+    double moveSeconds = 0.0, rerouteSeconds = 0.0, rerouteWorst = 0.0;
+    long long searches = 0, taken = 0, crossings = 0, illegal = 0;
+    size_t scanCursor = 0;
+    std::vector<int> rest, alt;
+    int ticks = (int)(seconds / dt);
+    for (int tick = 0; tick < ticks; tick++) {
+        float now = tick * dt;
+        Clock::time_point t0 = Clock::now();
+        for (int i = 0; i < n; i++) {
+            if (cursor[i] + 1 >= (int)route[i].size() || (left[i] -= dt) > 0.0f) continue;
+            int from = route[i][cursor[i]], to = route[i][cursor[i] + 1];
+            edges.record(from, exitDir(from, to), dwell(from), freeTime);
+            crossings++;
+            left[i] += dwell(to);
+            cursor[i]++;
+        }
+        edges.age(now);
+        moveSeconds += secondsSince(t0);
+
+        t0 = Clock::now();
+        int budget = budgetPerTick;
+        for (int k = 0; k < scanPerTick && budget > 0; k++) {
+            size_t i = scanCursor++ % n;
+            const std::vector<int>& r = route[i];
+            if (now < nextCheck[i]) continue;
+            nextCheck[i] = now + interval;
+            int wp = cursor[i];
+            if (wp < 1 || wp + 2 >= (int)r.size()) continue;
+            budget--;
+            searches++;
+            rest.assign(r.begin() + wp, r.end());
+            int heading = exitDir(r[wp - 1], r[wp]);
+            if (!edges.reroute(g, rest, goal[i], heading, false, minGain, alt)) continue;
+            illegal += alt.front() != rest.front() || alt.back() != goal[i] ||
+                       !std::isfinite(g.pathCost(alt, false, heading, edges.delays()));
+            route[i].resize(wp);
+            route[i].insert(route[i].end(), alt.begin(), alt.end());
+            taken++;
+        }
+        double s = secondsSince(t0);
+        rerouteSeconds += s;
+        rerouteWorst = std::max(rerouteWorst, s);
+    }
+
+    printf("%d commuters on a %dx%d grid for %.0f s (%d ticks), %lld tile crossings logged\n", n, side, side, seconds,
+           ticks, crossings);
+    printf("logging + ageing: %.3f ms per tick\n", moveSeconds * 1e3 / ticks);
+    printf("reroute scan: %.3f ms per tick, %.3f ms worst, %.1f searches per tick (%.3f ms each), %lld routes changed\n",
+           rerouteSeconds * 1e3 / ticks, rerouteWorst * 1e3, (double)searches / ticks,
+           rerouteSeconds * 1e3 / std::max(1LL, searches), taken);
+    printf("%lld of %lld new routes %s\n", taken - illegal, taken, illegal ? "legal, the rest are NOT" : "legal");
+    return illegal == 0 ? 0 : 1;
+}
+
+// Stand-in for an exported city: a 4 x 4 grid of 4-way junctions four tiles apart, every row and
+// column a corridor
+static SignalNetwork gridNetwork() {
+    const int side = 4;
+    const float spacing = 16.0f;
+    SignalNetwork net;
+    for (int k = 0; k < side * side; k++) net.junctions.push_back({ k, 0xF });
+    for (int axis = 0; axis < 2; axis++) {
+        for (int line = 0; line < side; line++) {
+            SignalNetwork::Corridor c{ axis, 4.0f, {}, {} };
+            for (int k = 0; k < side; k++) {
+                c.junction.push_back(axis == 1 ? line * side + k : k * side + line);
+                c.position.push_back(k * spacing);
+            }
+            net.corridors.push_back(c);
+        }
+    }
+    return net;
+}
+
+static int runOptimize(const char* networkPath, const char* planPath, int rounds) {
+    SignalNetwork net;
+    if (strcmp(networkPath, "grid") == 0) {
+        net = gridNetwork();
+    } else if (!net.load(networkPath)) {
+        fprintf(stderr, "can't read signal network %s\n", networkPath);
+        return 1;
+    }
+    GreenWaveOptimizer::Options options;
+    options.rounds = rounds;
+    GreenWaveOptimizer optimizer(net, options);
+
+    // What the simulation runs without a plan: fixed-time lights at random points in their cycle
+    SignalPlan random = optimizer.initialPlan();
+    std::mt19937 rng(3);
+    for (SignalPlan::Entry& e : random.entries) e.offset = std::uniform_real_distribution<float>(0.0f, net.timing.cycle)(rng);
+
+    double before = optimizer.score(random);
+    Clock::time_point t0 = Clock::now();
+    SignalPlan best = optimizer.optimize(random);
+    double seconds = secondsSince(t0);
+    double after = optimizer.score(best);
+    uint64_t evaluations = optimizer.evaluations() - 2;
+
+    printf("%d junctions, %d corridors, %.0f s cycle, %d threads\n", (int)net.junctions.size(),
+           (int)net.corridors.size(), net.timing.cycle, optimizer.threadCount());
+    printf("mean delay per vehicle: %.1f s with random offsets, %.1f s optimised\n", before, after);
+    printf("%llu plans scored in %.1f s (%.0f plans per hour)\n", (unsigned long long)evaluations, seconds,
+           evaluations / std::max(seconds, 1e-9) * 3600.0);
+    if (!best.save(planPath)) {
+        fprintf(stderr, "can't write %s\n", planPath);
+        return 1;
+    }
+    printf("plan written to %s\n", planPath);
+    return after <= before ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    const char* mode = argc > 1 ? argv[1] : "kernel";
+    if (strcmp(mode, "kernel") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 100000;
+        double seconds = argc > 3 ? atof(argv[3]) : 1.0;
+        return runKernel(std::max(1, n), seconds);
+    }
+    if (strcmp(mode, "fd") == 0) {
+        return runFundamentalDiagram(argc > 2 ? argv[2] : "fundamental_diagram.csv",
+                                     argc > 3 ? argv[3] : "fundamental_diagram.ppm");
+    }
+    if (strcmp(mode, "junction") == 0) {
+        return runJunctionBench(argc > 2 ? std::max(1.0f, (float)atof(argv[2])) : 60.0f);
+    }
+    if (strcmp(mode, "actuated") == 0) {
+        return runActuatedBench(argc > 2 ? std::max(1.0f, (float)atof(argv[2])) : 60.0f);
+    }
+    if (strcmp(mode, "soak") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 10000;
+        return runSoak(std::max(1, n), argc > 3 ? (float)atof(argv[3]) : 120.0f);
+    }
+    if (strcmp(mode, "signals") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 50000;
+        return runSignals(std::max(1, n), argc > 3 ? (float)atof(argv[3]) : 600.0f);
+    }
+    if (strcmp(mode, "preempt") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 10000;
+        int vehicles = argc > 3 ? atoi(argv[3]) : 20;
+        return runPreempt(std::max(4, n), std::max(1, vehicles));
+    }
+    if (strcmp(mode, "crossing") == 0) {
+        int side = argc > 2 ? atoi(argv[2]) : 8;
+        return runCrossing(std::max(1, side), argc > 3 ? std::max(1.0f, (float)atof(argv[3])) : 600.0f);
+    }
+    if (strcmp(mode, "yield") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 100000;
+        int units = argc > 3 ? atoi(argv[3]) : 32;
+        return runYield(std::max(1, n), std::max(1, units));
+    }
+    if (strcmp(mode, "dispatch") == 0) {
+        float perHour = argc > 2 ? (float)atof(argv[2]) : 300.0f;
+        int units = argc > 3 ? atoi(argv[3]) : 90;
+        return runDispatch(std::max(1.0f, perHour), std::max((int)Dispatch::KINDS, units));
+    }
+    if (strcmp(mode, "load") == 0) {
+        float perHour = argc > 2 ? (float)atof(argv[2]) : 300.0f;
+        float hours = argc > 3 ? (float)atof(argv[3]) : 24.0f;
+        int units = argc > 4 ? atoi(argv[4]) : 90;
+        return runLoad(std::max(1.0f, perHour), std::max(0.1f, hours), std::max((int)Dispatch::KINDS, units),
+                       argc > 5 ? argv[5] : "response_times.csv");
+    }
+    if (strcmp(mode, "snapshot") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 1000000;
+        float seconds = argc > 3 ? (float)atof(argv[3]) : 20.0f;
+        return runSnapshot(std::max(1, n), std::max(0.2f, seconds), argc > 4 ? argv[4] : "bench_snapshot.bin");
+    }
+    if (strcmp(mode, "replay") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 100000;
+        float seconds = argc > 3 ? (float)atof(argv[3]) : 120.0f;
+        return runReplay(std::max(1, n), std::max(1.0f, seconds), argc > 4 ? argv[4] : "bench_replay.bin");
+    }
+    if (strcmp(mode, "telemetry") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 100000;
+        float seconds = argc > 3 ? (float)atof(argv[3]) : 3600.0f;
+        float hz = argc > 4 ? (float)atof(argv[4]) : 1.0f;
+        return runTelemetry(std::max(1, n), std::max(1.0f, seconds), std::max(0.01f, hz), argc > 5 ? argv[5] : "bench_trajectories.ctl");
+    }
+    if (strcmp(mode, "extract") == 0) {
+        if (argc < 3) { fprintf(stderr, "usage: traffic_bench extract file [t0] [t1] [out.csv]\n"); return 1; }
+        return runExtract(argv[2], argc > 3 ? (float)atof(argv[3]) : 0.0f, argc > 4 ? (float)atof(argv[4]) : 1e30f,
+                          argc > 5 ? argv[5] : "-");
+    }
+    if (strcmp(mode, "trajindex") == 0) {
+        return runTrajectoryIndex(argc > 2 ? argv[2] : "bench_trajectories.ctl", argc > 3 ? argv[3] : "bench_trajectories.cti",
+                                  argc > 4 ? std::max(1.0f, (float)atof(argv[4])) : 60.0f);
+    }
+    if (strcmp(mode, "query") == 0) {
+        if (argc < 5) { fprintf(stderr, "usage: traffic_bench query index tile|vehicle key [t0] [t1]\n"); return 1; }
+        return runQuery(argv[2], argv[3], atol(argv[4]), argc > 5 ? (float)atof(argv[5]) : -1e30f,
+                        argc > 6 ? (float)atof(argv[6]) : 1e30f);
+    }
+    if (strcmp(mode, "coverage") == 0) {
+        int side = argc > 2 ? atoi(argv[2]) : 200;
+        int scenarios = argc > 3 ? atoi(argv[3]) : 100;
+        return runCoverage(std::max(8, side), std::max(1, scenarios));
+    }
+    if (strcmp(mode, "router") == 0) {
+        int side = argc > 2 ? atoi(argv[2]) : 200;
+        int queries = argc > 3 ? atoi(argv[3]) : 400;
+        return runRouter(std::max(16, side), std::max(1, queries));
+    }
+    if (strcmp(mode, "reroute") == 0) {
+        int n = argc > 2 ? atoi(argv[2]) : 100000;
+        int side = argc > 3 ? atoi(argv[3]) : 100;
+        return runReroute(std::max(1, n), std::max(8, side), argc > 4 ? std::max(1.0f, (float)atof(argv[4])) : 30.0f);
+    }
+    if (strcmp(mode, "optimize") == 0) {
+        return runOptimize(argc > 2 ? argv[2] : "grid", argc > 3 ? argv[3] : "signal_plan.txt",
+                           argc > 4 ? std::max(1, atoi(argv[4])) : 30);
+    }
+    fprintf(stderr, "usage: traffic_bench kernel [vehicles] [seconds] | fd [out.csv] [out.ppm] | junction [minutes]"
+                    " | actuated [minutes] | soak [vehicles] [seconds] | signals [junctions] [seconds]"
+                    " | optimize [network] [plan] [rounds] | preempt [junctions] [vehicles]"
+                    " | crossing [side] [seconds] | yield [vehicles] [units]"
+                    " | dispatch [incidents/h] [units] | load [incidents/h] [hours] [units] [out.csv]"
+                    " | snapshot [vehicles] [seconds] [file] | replay [vehicles] [seconds] [file]"
+                    " | telemetry [vehicles] [seconds] [Hz] [file] | extract file [t0] [t1] [out.csv]"
+                    " | trajindex [file] [index] [bucket seconds] | query index tile|vehicle key [t0] [t1]"
+                    " | coverage [side] [scenarios] | router [side] [queries] | reroute [vehicles] [side] [seconds]\n");
+    return 1;
+}
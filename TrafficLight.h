@@ -3,79 +3,36 @@
 
 #include "raylib.h"
 #include "raymath.h"
-#include <algorithm>
-#include <cstdlib> // Required for rand()
-
-enum class LightState { Green, Yellow, Red };
+#include "SignalScheduler.h"
 
+// Drawable signal with one head per approach. Its timing lives in SignalScheduler; the simulation
+// copies the per-approach states over only when the scheduler reports a change.
+// Approaches are numbered by the heading of the cars using them (RoadDir order, y grows south).
 class TrafficLight {
 private:
     Vector3 position{};
-    LightState state{LightState::Green};
-    float timer{0.0f};
-    float greenTime{3.0f};      // Default cycle time (matches main.cpp)
-    float forcedGreen{0.0f};    
-
-public:
-    TrafficLight() = default;
-
-    // This is the constructor used in main.cpp
-    TrafficLight(Vector3 pos, float greenSeconds = 3.0f)
-        : position(pos), state(LightState::Green), greenTime(greenSeconds), forcedGreen(0.0f) {
-        
-        // FIX 1: Randomize start time so lights are out of sync
-        timer = (float)(rand() % (int)(greenSeconds * 100)) / 100.0f;
-        
-        // FIX 2: Randomize starting color
-        if (rand() % 2 == 0) state = LightState::Red;
-    }
-
-    void update(float dt) {
-        if (forcedGreen > 0.0f) {
-            forcedGreen -= dt;
-            state = LightState::Green;
-            return;
-        }
+    LightState state[4]{LightState::Red, LightState::Red, LightState::Red, LightState::Red};
+    uint8_t approaches{0xF}; // headings that have a head
 
-        timer += dt;
-
-        // Green -> Yellow -> Red -> Green
-        if (state == LightState::Green && timer > greenTime) {
-            state = LightState::Yellow;
-            timer = 0.0f;
-        } else if (state == LightState::Yellow && timer > 2.0f) {
-            state = LightState::Red;
-            timer = 0.0f;
-        } else if (state == LightState::Red && timer > greenTime) {
-            state = LightState::Green;
-            timer = 0.0f;
-        }
+    // Closest heading to a ground-plane direction
+    static int headingOf(const Vector3& dir) {
+        if (fabsf(dir.x) > fabsf(dir.z)) return dir.x > 0.0f ? 1 : 3;
+        return dir.z > 0.0f ? 2 : 0;
     }
 
-    void forceGreen(float seconds = 1.2f) {
-        forcedGreen = std::max(forcedGreen, seconds);
-        state = LightState::Green;
-        timer = 0.0f;
-    }
+public:
+    TrafficLight() = default;
 
-    void greenForEmergencyIfApproaching(const Vector3& emPos, const Vector3& emForward, float triggerDist = 12.0f) {
-        Vector3 toLight = Vector3Subtract(position, emPos);
-        float d = Vector3Length(toLight);
-        if (d > triggerDist || d < 0.001f) return;
+    TrafficLight(Vector3 pos, uint8_t approachMask) : position(pos), approaches(approachMask) {}
 
-        Vector3 dir = Vector3Normalize(toLight);
-        // If the light is in front of the emergency vehicle, keep it green
-        if (Vector3DotProduct(dir, emForward) > 0.5f) {
-            forceGreen(1.2f);
-        }
-    }
+    void setState(int heading, LightState s) { state[heading] = s; }
 
-    bool isRed() const { return forcedGreen <= 0.0f && state == LightState::Red; }
-    LightState getState() const { return state; }
+    bool isRed(int heading) const { return state[heading] == LightState::Red; }
+    LightState getState(int heading) const { return state[heading]; }
     Vector3 getPosition() const { return position; }
 
     bool shouldStop(const Vector3& vehPos, const Vector3& vehForward, float stopDist = 2.2f) const {
-        if (!isRed()) return false;
+        if (!isRed(headingOf(vehForward))) return false;
 
         Vector3 toLight = Vector3Subtract(position, vehPos);
         float d = Vector3Length(toLight);
@@ -93,15 +50,19 @@ public:
         Vector3 boxPos = { position.x, position.y + 3.0f, position.z };
         DrawCube(boxPos, 0.4f, 1.0f, 0.4f, BLACK);
 
-        // Light color
-        Color lightColor = GRAY;
-        if (state == LightState::Red) lightColor = RED;
-        if (state == LightState::Yellow) lightColor = ORANGE;
-        if (state == LightState::Green) lightColor = GREEN;
-
-        Vector3 lightSphere = { position.x, position.y + 3.0f, position.z + 0.35f };
-        DrawSphere(lightSphere, 0.25f, lightColor);
+        // One head facing each approach, on the side its cars come from
+        static const float dx[4] = { 0, 1, 0, -1 }, dz[4] = { -1, 0, 1, 0 };
+        for (int h = 0; h < 4; h++) {
+            if (!(approaches >> h & 1)) continue;
+            Color lightColor = GRAY;
+            if (state[h] == LightState::Red) lightColor = RED;
+            if (state[h] == LightState::Yellow) lightColor = ORANGE;
+            if (state[h] == LightState::Green) lightColor = GREEN;
+
+            Vector3 lightSphere = { position.x - dx[h] * 0.35f, position.y + 3.0f, position.z - dz[h] * 0.35f };
+            DrawSphere(lightSphere, 0.18f, lightColor);
+        }
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,283 @@
+#include "TrajectoryIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+const char INDEX_MAGIC[4] = { 'C', 'T', 'R', 'I' };
+const uint32_t INDEX_VERSION = 1;
+const uint32_t ENDIAN_MARK = 0x01020304;
+
+// Builds the index a bucket at a time as the trajectory file is read in time order. Each sample
+// goes onto its vehicle's stream for the bucket, as the frames since its last one and the change
+// in each value, and either extends the visit the vehicle is on or closes it and starts another.
+// When the frames move on to the next bucket, the visits under way are closed, sorted by tile and
+// written out with the streams.
+struct Builder {
+    FILE* out{nullptr};
+    bool failed{false};
+    uint64_t at{0}; // bytes written
+    Telemetry::Steps steps;
+    float start{0.0f}, bucketSeconds{60.0f};
+    uint32_t frame{0};
+    std::vector<float> times;
+    std::vector<TrajectoryIndex::Bucket> directory;
+    TrajectoryIndex::Header header{};
+
+    // Per vehicle, in the bucket being filled
+    std::vector<int64_t> prev[Telemetry::COLUMNS - 1];
+    std::vector<int64_t> lastFrame;      // firstFrame - 1 before its first
+    std::vector<int32_t> visitTile;      // of the visit under way, -1 if none
+    std::vector<float> visitStart, visitEnd;
+    std::vector<std::vector<uint8_t>> stream;
+    uint32_t vehicles{0};
+    uint32_t firstFrame{0};
+    std::vector<TrajectoryIndex::Visit> visits;
+    std::vector<int32_t> visitTiles;     // parallel to visits
+    std::vector<TrajectoryIndex::Visit> sorted;
+    std::vector<uint64_t> cells, starts;
+
+    void put(const void* data, size_t size) {
+        if (failed || (size && fwrite(data, 1, size, out) != size)) failed = true;
+        at += size;
+    }
+    void align() {
+        static const uint8_t zero[8] = {};
+        put(zero, (size_t)((8 - at % 8) % 8));
+    }
+
+    void closeVisit(uint32_t id) {
+        if (visitTile[id] < 0) return;
+        visits.push_back({ id, visitStart[id], visitEnd[id] });
+        visitTiles.push_back(visitTile[id]);
+        visitTile[id] = -1;
+    }
+
+    void add(float time, const Telemetry::Row* rows, size_t n) {
+        int bucket = std::min((int)((time - start) / bucketSeconds), (int)header.buckets - 1);
+        while ((int)directory.size() < bucket) flush();
+        times.push_back(time);
+        for (size_t i = 0; i < n; i++) {
+            const Telemetry::Row& r = rows[i];
+            uint32_t id = r.id;
+            if (id >= lastFrame.size()) {
+                size_t size = (size_t)id + 1;
+                for (std::vector<int64_t>& v : prev) v.resize(size, 0);
+                lastFrame.resize(size, (int64_t)firstFrame - 1);
+                visitTile.resize(size, -1);
+                visitStart.resize(size, 0.0f);
+                visitEnd.resize(size, 0.0f);
+                stream.resize(size);
+            }
+            vehicles = std::max(vehicles, id + 1);
+            int64_t value[Telemetry::COLUMNS - 1] = { Telemetry::quantize(r.x, steps.position), Telemetry::quantize(r.z, steps.position),
+                                                      Telemetry::quantize(r.speed, steps.speed), Telemetry::quantize(r.lane, steps.lane),
+                                                      r.tile };
+            std::vector<uint8_t>& s = stream[id];
+            Telemetry::putVarint(s, (uint64_t)(frame - lastFrame[id]));
+            for (int k = 0; k < Telemetry::COLUMNS - 1; k++) {
+                Telemetry::putVarint(s, Telemetry::zigzag(value[k] - prev[k][id]));
+                prev[k][id] = value[k];
+            }
+
+            if (visitTile[id] == r.tile && lastFrame[id] == (int64_t)frame - 1) {
+                visitEnd[id] = time;
+            } else {
+                closeVisit(id);
+                if (r.tile >= 0) {
+                    visitTile[id] = r.tile;
+                    visitStart[id] = visitEnd[id] = time;
+                }
+            }
+            lastFrame[id] = frame;
+        }
+        frame++;
+    }
+
+    // Writes the bucket being filled and starts the next one
+    void flush() {
+        for (uint32_t id = 0; id < vehicles; id++) closeVisit(id);
+        TrajectoryIndex::Bucket b{};
+        b.firstFrame = firstFrame;
+        b.frames = frame - firstFrame;
+        b.vehicles = vehicles;
+        b.visits = visits.size();
+        for (int32_t tile : visitTiles) b.tiles = std::max(b.tiles, (uint32_t)tile + 1);
+
+        // Visits by tile, in the order they ended
+        cells.assign((size_t)b.tiles + 1, 0);
+        for (int32_t tile : visitTiles) cells[tile + 1]++;
+        for (uint32_t t = 0; t < b.tiles; t++) cells[t + 1] += cells[t];
+        sorted.resize(visits.size());
+        for (size_t v = 0; v < visits.size(); v++) sorted[cells[visitTiles[v]]++] = visits[v];
+        for (uint32_t t = b.tiles; t > 0; t--) cells[t] = cells[t - 1];
+        cells[0] = 0;
+
+        starts.assign((size_t)vehicles + 1, 0);
+        for (uint32_t id = 0; id < vehicles; id++) starts[id + 1] = starts[id] + stream[id].size();
+        b.streamBytes = starts[vehicles];
+
+        align();
+        b.cellAt = at;
+        put(cells.data(), cells.size() * sizeof(uint64_t));
+        b.visitAt = at;
+        put(sorted.data(), sorted.size() * sizeof(TrajectoryIndex::Visit));
+        align();
+        b.streamStartAt = at;
+        put(starts.data(), starts.size() * sizeof(uint64_t));
+        b.streamAt = at;
+        for (uint32_t id = 0; id < vehicles; id++) put(stream[id].data(), stream[id].size());
+        directory.push_back(b);
+        header.tiles = std::max(header.tiles, b.tiles);
+        header.vehicles = std::max(header.vehicles, b.vehicles);
+        header.visits += b.visits;
+
+        // The next bucket decodes on its own
+        for (uint32_t id = 0; id < vehicles; id++) {
+            for (std::vector<int64_t>& v : prev) v[id] = 0;
+            stream[id].clear(); // keeps its capacity for the next bucket
+        }
+        firstFrame = frame;
+        std::fill(lastFrame.begin(), lastFrame.end(), (int64_t)firstFrame - 1);
+        vehicles = 0;
+        visits.clear();
+        visitTiles.clear();
+    }
+};
+
+}
+
+bool TrajectoryIndex::build(const char* trajectoryPath, const char* indexPath, float bucketSeconds) {
+    TelemetryReader reader;
+    if (!reader.open(trajectoryPath) || reader.chunks().empty()) return false;
+    Builder b;
+    b.out = fopen(indexPath, "wb");
+    if (!b.out) return false;
+    b.steps = reader.steps();
+    b.start = reader.startTime();
+    b.bucketSeconds = std::max(bucketSeconds, 0.001f);
+    Header& h = b.header;
+    memcpy(h.magic, INDEX_MAGIC, 4);
+    h.version = INDEX_VERSION;
+    h.endian = ENDIAN_MARK;
+    h.steps = b.steps;
+    h.start = b.start;
+    h.bucketSeconds = b.bucketSeconds;
+    h.buckets = (uint32_t)((reader.endTime() - b.start) / b.bucketSeconds) + 1;
+    b.put(&h, sizeof(h)); // written again once it is known
+
+    bool read = reader.scan(reader.startTime(), reader.endTime(),
+                            [&b](float time, const Telemetry::Row* rows, size_t n) { b.add(time, rows, n); });
+    while (b.directory.size() < h.buckets) b.flush();
+    h.frames = (uint32_t)b.times.size();
+    b.align();
+    h.frameTimeAt = b.at;
+    b.put(b.times.data(), b.times.size() * sizeof(float));
+    b.align();
+    h.bucketAt = b.at;
+    b.put(b.directory.data(), b.directory.size() * sizeof(Bucket));
+    h.bytes = b.at;
+    if (fseek(b.out, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, b.out) != 1) b.failed = true;
+    bool ok = fclose(b.out) == 0 && !b.failed;
+    return read && ok;
+}
+
+bool TrajectoryIndex::open(const char* path) {
+    header = nullptr;
+    if (!file.open(path)) return false;
+    const Header* h = (const Header*)file.data();
+    uint64_t size = file.size();
+    if (size < sizeof(Header) || memcmp(h->magic, INDEX_MAGIC, 4) != 0 || h->version != INDEX_VERSION ||
+        h->endian != ENDIAN_MARK || h->bytes != size || h->buckets == 0 || !(h->bucketSeconds > 0.0f) ||
+        h->frameTimeAt > size || h->frames > (size - h->frameTimeAt) / sizeof(float) || h->bucketAt > size ||
+        h->buckets > (size - h->bucketAt) / sizeof(Bucket)) {
+        file.close();
+        return false;
+    }
+    const uint8_t* base = file.data();
+    const Bucket* dir = (const Bucket*)(base + h->bucketAt);
+    for (uint32_t k = 0; k < h->buckets; k++) { // every section of every bucket inside the file
+        const Bucket& b = dir[k];
+        if (b.cellAt > size || b.tiles >= (size - b.cellAt) / sizeof(uint64_t) || b.visitAt > size ||
+            b.visits > (size - b.visitAt) / sizeof(Visit) || b.streamStartAt > size ||
+            b.vehicles >= (size - b.streamStartAt) / sizeof(uint64_t) || b.streamAt > size ||
+            b.streamBytes > size - b.streamAt || (uint64_t)b.firstFrame + b.frames > h->frames) {
+            file.close();
+            return false;
+        }
+    }
+    header = h;
+    frameTimes = (const float*)(base + h->frameTimeAt);
+    buckets = dir;
+    return true;
+}
+
+int TrajectoryIndex::bucketOf(float t) const {
+    float b = floorf((t - header->start) / header->bucketSeconds);
+    if (!(b >= 0.0f)) return 0;
+    return b >= (float)header->buckets ? (int)header->buckets - 1 : (int)b;
+}
+
+void TrajectoryIndex::visits(int tile, float t0, float t1, std::vector<Visit>& out) const {
+    out.clear();
+    if (!header || tile < 0 || !(t0 <= t1)) return;
+    const uint8_t* base = file.data();
+    for (int k = bucketOf(t0), last = bucketOf(t1); k <= last; k++) {
+        const Bucket& b = buckets[k];
+        if (tile >= (int)b.tiles) continue;
+        const uint64_t* cells = (const uint64_t*)(base + b.cellAt);
+        const Visit* list = (const Visit*)(base + b.visitAt);
+        for (uint64_t v = cells[tile], end = std::min(cells[tile + 1], b.visits); v < end; v++) {
+            if (list[v].t1 >= t0 && list[v].t0 <= t1) out.push_back(list[v]);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const Visit& a, const Visit& b) { return a.id != b.id ? a.id < b.id : a.t0 < b.t0; });
+
+    // A visit cut at a bucket's end goes on in the next bucket's first frame: join the pieces
+    const float* framesEnd = frameTimes + header->frames;
+    size_t n = 0;
+    for (const Visit& v : out) {
+        if (n > 0 && out[n - 1].id == v.id) {
+            const float* next = std::upper_bound(frameTimes, framesEnd, out[n - 1].t1);
+            if (next != framesEnd && *next == v.t0) {
+                out[n - 1].t1 = v.t1;
+                continue;
+            }
+        }
+        out[n++] = v;
+    }
+    out.resize(n);
+}
+
+void TrajectoryIndex::trajectory(uint32_t id, float t0, float t1, std::vector<Point>& out) const {
+    out.clear();
+    if (!header || !(t0 <= t1)) return;
+    const uint8_t* base = file.data();
+    const Telemetry::Steps& q = header->steps;
+    for (int k = bucketOf(t0), last = bucketOf(t1); k <= last; k++) {
+        const Bucket& b = buckets[k];
+        if (id >= b.vehicles) continue;
+        const uint64_t* starts = (const uint64_t*)(base + b.streamStartAt);
+        uint64_t end = std::min(starts[id + 1], b.streamBytes);
+        const uint8_t* p = base + b.streamAt + std::min(starts[id], end);
+        const uint8_t* stop = base + b.streamAt + end;
+        int64_t frame = (int64_t)b.firstFrame - 1, value[Telemetry::COLUMNS - 1] = {};
+        uint64_t u;
+        while (p < stop) {
+            if (!Telemetry::getVarint(p, stop, u)) return;
+            frame += (int64_t)u;
+            for (int c = 0; c < Telemetry::COLUMNS - 1; c++) {
+                if (!Telemetry::getVarint(p, stop, u)) return;
+                value[c] += Telemetry::unzigzag(u);
+            }
+            if (frame < (int64_t)b.firstFrame || frame >= (int64_t)b.firstFrame + b.frames) return;
+            float time = frameTimes[frame];
+            if (time > t1) return;
+            if (time < t0) continue;
+            out.push_back({ time, (float)(value[0] * (double)q.position), (float)(value[1] * (double)q.position),
+                            (float)(value[2] * (double)q.speed), (float)(value[3] * (double)q.lane), (int32_t)value[4] });
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef TRAJECTORYINDEX_H
+#define TRAJECTORYINDEX_H
+
+#include "Telemetry.h"
+#include "MappedFile.h"
+#include <vector>
+#include <cstdint>
+
+// A trajectory file (see Telemetry.h) rearranged for queries, built once after the run. Time is
+// cut into buckets and each bucket holds
+//  - per tile, the visits made to it: which vehicle, from which frame time to which, so "who was on
+//    tile t between t0 and t1" reads one short list per bucket the range touches;
+//  - per vehicle, its trajectory through the bucket as one delta-encoded stream, so "where did
+//    vehicle k go" decodes a few hundred bytes per bucket instead of every frame of the run.
+// The index is served from a mapped file: opening it reads the header and the bucket directory,
+// and a query touches only the pages it needs, so it answers in a millisecond or less however long
+// the run. Buckets are built one at a time and written in order, so building takes one pass over
+// the trajectory file and the memory of one bucket.
+// A visit is stored as a vehicle on one tile over consecutive frames of one bucket; one that stays
+// longer is cut at the bucket's end, and visits() joins the pieces again. Tiles are numbered as the
+// recording numbered them (y * width + x for the city and the bench grid).
+class TrajectoryIndex {
+public:
+    struct Visit {
+        uint32_t id;
+        float t0, t1; // times of its first and last frame on the tile
+    };
+    struct Point {
+        float time;
+        float x, z, speed, lane;
+        int32_t tile;
+    };
+
+    // False if the trajectory file can't be read or the index can't be written
+    static bool build(const char* trajectoryPath, const char* indexPath, float bucketSeconds = 60.0f);
+
+    bool open(const char* path);
+    void close() {
+        file.close();
+        header = nullptr;
+    }
+
+    // Visits to `tile` overlapping [t0, t1], by vehicle and then time
+    void visits(int tile, float t0, float t1, std::vector<Visit>& out) const;
+    // Vehicle `id` from t0 to t1, in time order
+    void trajectory(uint32_t id, float t0, float t1, std::vector<Point>& out) const;
+
+    uint32_t frames() const { return header->frames; }
+    float frameTime(uint32_t f) const { return frameTimes[f]; }
+    uint32_t tiles() const { return header->tiles; }
+    uint32_t vehicles() const { return header->vehicles; }
+    uint64_t visitCount() const { return header->visits; }
+    uint64_t bytes() const { return file.size(); }
+
+    // On disk: the header, the buckets, the frame times and the bucket directory
+    struct Header {
+        char magic[4];
+        uint32_t version, endian;
+        Telemetry::Steps steps;
+        float start, bucketSeconds;
+        uint32_t buckets;
+        uint32_t tiles, vehicles; // the most of any bucket
+        uint32_t frames;
+        uint64_t visits;
+        uint64_t frameTimeAt;     // float per frame
+        uint64_t bucketAt;        // Bucket per bucket
+        uint64_t bytes;
+    };
+    struct Bucket {
+        uint64_t cellAt;          // uint64 per tile, + 1: first visit of each
+        uint64_t visitAt;         // Visit per visit
+        uint64_t streamStartAt;   // uint64 per vehicle, + 1: first byte of its stream
+        uint64_t streamAt;
+        uint32_t tiles, vehicles; // one more than the largest tile and id in the bucket
+        uint32_t firstFrame, frames;
+        uint64_t visits, streamBytes;
+    };
+
+private:
+    MappedFile file;
+    const Header* header{nullptr};
+    const float* frameTimes{nullptr};
+    const Bucket* buckets{nullptr};
+
+    int bucketOf(float t) const;
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "raylib.h"
 #include "raymath.h"
+#include "RouteTable.h"
 #include <vector>
 #include <cmath>
 
@@ -12,11 +13,15 @@ protected:
     Vector3 destination;
     float speed;
     float baseSpeed;
+    float velocity{0.0f}; // actual speed over the last step
     Color color;
     bool looping;
-    // Pathfinding data
-    std::vector<Vector3> path;
-    int currentWp;
+    // Route data: the baked lane polyline lives in the shared table, the vehicle only keeps its place on it
+    RouteTable& routes;
+    int routeId{-1};
+    float s{0.0f};   // arc length driven along the route's polyline
+    int segment{0};  // polyline segment containing s (cursor, only ever moves a step or two per tick)
+    int phase{0};    // waypoint the vehicle joined the route at
     
     // Rotation for visuals
     float rotation;
@@ -31,12 +36,19 @@ protected:
 
 public:
     // Update vehicle each frame. Use step() to control forward motion while keeping lane/yield smoothing.
-    Vehicle(Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor);
-    virtual ~Vehicle() = default;
+    Vehicle(RouteTable& routeTable, Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor);
+    virtual ~Vehicle();
+    Vehicle(const Vehicle&) = delete;
+    Vehicle& operator=(const Vehicle&) = delete;
     void setSpeedScale(float scale, float holdSeconds = 0.0f);
     Vector3 getIntendedDir() const;
     void step(float dt, bool allowForward = true);
-    void setLooping(bool loop) { looping = loop; }
+    // Same as step() with the distance decided outside (car-following kernel)
+    void advance(float dt, float distance, float newVelocity);
+    // Distance the car can still drive straight along its route (at most `distance`) and the
+    // heading it turns to after that
+    float distanceToTurn(float distance, Vector3& nextDir) const;
+    void setLooping(bool loop);
     void setLaneOffset(float offset);
     // Temporary lane change that returns to default after holdSeconds
     void nudgeLaneOffset(float targetOffset, float holdSeconds = 0.8f);
@@ -51,14 +63,65 @@ public:
     Vector3 getForwardDir() const { return { sinf(rotation * DEG2RAD), 0.0f, cosf(rotation * DEG2RAD) }; }
     float getSpeed() const { return speed; }
     float getBaseSpeed() const { return baseSpeed; }
+    float getVelocity() const { return velocity; }
+    // Cruise speed the driver is aiming for right now (yielding scales it down)
+    float getDesiredSpeed() const { return speed * speedScale; }
     float getLaneOffset() const { return laneOffset; }
-    bool hasFinishedPath() const { return path.empty() || currentWp >= (int)path.size(); }
+    bool hasFinishedPath() const {
+        if (routeId < 0) return true;
+        const RouteTable::Polyline& line = routes.polyline(routeId);
+        return !line.loops && s >= line.length;
+    }
+    int remainingWaypoints() const { return hasFinishedPath() ? 0 : routes.length(routeId) - waypointIndex(); }
+    // Index into getPath() of the waypoint being driven to
+    int currentWaypoint() const { return waypointIndex(); }
+    const std::vector<Vector3>& getPath() const;
+    int getRouteId() const { return routeId; }
+    float getArcPosition() const { return s; }
+    bool isLooping() const { return looping; }
 
     // Setters
+    // Interns the waypoints; cars given the same list share one route
     void setPath(const std::vector<Vector3>& newPath);
+    // Joins an already interned route at waypoint `startWp` (phase-shifted cars on one loop)
+    void setRoute(int id, int startWp = 0);
+    // Extends a lazily refined path; waypoints already driven past are dropped
+    void appendPath(const std::vector<Vector3>& more);
+    // Swaps everything from the current waypoint on for a new route starting at that waypoint
+    void replaceRemainingPath(const std::vector<Vector3>& tail);
+
+    // Everything a vehicle is, as plain values, for snapshots. The route is held by id only:
+    // restoreState takes no reference on it, the restored RouteTable already counts this vehicle.
+    struct State {
+        Vector3 position, destination;
+        float speed, baseSpeed, velocity;
+        Color color;
+        int routeId, segment, phase;
+        float s, rotation, laneOffset;
+        float laneOffsetDefault, laneOffsetTarget, laneOffsetMax;
+        float yieldHold, speedScale, speedScaleHold;
+        uint8_t looping;
+    };
+    State saveState() const;
+    void restoreState(const State& st);
 
     // Teammate's feature: Yield to ambulance
     void yieldTo(Vector3 emergencyPos, Vector3 emergencyDir, float yieldStrength, float yieldRadius);
+
+private:
+    int waypointIndex() const {
+        if (hasFinishedPath()) return routeId < 0 ? 0 : routes.length(routeId);
+        const RouteTable::Polyline& line = routes.polyline(routeId);
+        return line.segments() > 0 ? line.vertexWp[segment + 1] : 0;
+    }
+    // Position and heading from s
+    void placeOnRoute();
+    // Moves onto another route (taking over the reference) where it passes the car near waypoint newWp
+    void switchRoute(int newId, int newWp);
+    // Re-bakes the current route for a changed lane offset or loop mode
+    void rebind();
+    // Re-interns the waypoints from `from` on followed by `more`; the car stays where it is
+    void rebaseRoute(int from, const std::vector<Vector3>& more, bool keepTail);
 };
 
 #endif
\ No newline at end of file
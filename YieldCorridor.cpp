@@ -0,0 +1,122 @@
+#include "YieldCorridor.h"
+#include <cmath>
+
+YieldCorridor::Unit& YieldCorridor::unitAt(int unit) {
+    if (unit >= (int)units.size()) units.resize(unit + 1);
+    return units[unit];
+}
+
+void YieldCorridor::addLane(int unit, int lane, float entryArc, float exitArc, bool crossing) {
+    unitAt(unit).lanes.push_back({ lane, entryArc, exitArc, crossing });
+}
+
+void YieldCorridor::clear(int unit) {
+    Unit& u = unitAt(unit);
+    u.lanes.clear();
+    u.next = 0;
+    u.arc = 0.0f;
+}
+
+void YieldCorridor::setProgress(int unit, float arc) {
+    Unit& u = unitAt(unit);
+    u.arc = arc;
+    while (u.next < u.lanes.size() && u.lanes[u.next].exitArc < arc - params.behind) u.next++;
+}
+
+int YieldCorridor::lanesAhead(int unit) const {
+    if (unit >= (int)units.size()) return 0;
+    return (int)(units[unit].lanes.size() - units[unit].next);
+}
+
+void YieldCorridor::notice(int vehicle, int unit, float ahead, bool crossing) {
+    if (vehicle >= (int)stamp.size()) {
+        stamp.resize(vehicle + 1, 0);
+        noticeOf.resize(vehicle + 1, -1);
+    }
+    // A car in several corridors makes way for the unit closest to it
+    if (stamp[vehicle] == tick) {
+        Notice& n = notices[noticeOf[vehicle]];
+        if (fabsf(ahead) < fabsf(n.ahead)) n = { vehicle, unit, ahead, crossing };
+        return;
+    }
+    stamp[vehicle] = tick;
+    noticeOf[vehicle] = (int)notices.size();
+    notices.push_back({ vehicle, unit, ahead, crossing });
+}
+
+const std::vector<YieldCorridor::Notice>& YieldCorridor::collect(const LaneOccupancy& occupancy) {
+    notices.clear();
+    if (++tick == 0) {
+        stamp.assign(stamp.size(), 0);
+        tick = 1;
+    }
+    for (int k = 0; k < (int)units.size(); k++) {
+        const Unit& u = units[k];
+        for (size_t l = u.next; l < u.lanes.size(); l++) {
+            const Lane& lane = u.lanes[l];
+            if (lane.entryArc - u.arc > params.reach) break; // the rest are further along the route
+            read++;
+            if (lane.crossing) {
+                // Cross traffic is only held while the unit is about to enter or is in the junction
+                float ahead = lane.entryArc - u.arc;
+                if (ahead > params.junctionReach || lane.exitArc < u.arc) continue;
+                for (int car = occupancy.head(lane.lane); car >= 0; car = occupancy.follower(car))
+                    notice(car, k, ahead, true);
+                continue;
+            }
+            for (int car = occupancy.head(lane.lane); car >= 0; car = occupancy.follower(car)) {
+                float ahead = lane.entryArc + occupancy.position(car) - u.arc;
+                if (ahead > params.reach) continue;
+                if (ahead < -params.behind) break; // followers are further back
+                notice(car, k, ahead, false);
+            }
+        }
+    }
+    return notices;
+}
+
+void YieldCorridor::save(SnapshotWriter& w) const {
+    std::vector<Progress> progress;
+    std::vector<Lane> lanes;
+    for (const Unit& u : units) {
+        progress.push_back({ lanes.size(), u.lanes.size(), u.next, u.arc });
+        lanes.insert(lanes.end(), u.lanes.begin(), u.lanes.end());
+    }
+    uint64_t counters[2] = { tick, read };
+    w.array("corridor.units", progress);
+    w.array("corridor.lanes", lanes);
+    w.array("corridor.notices", notices);
+    w.array("corridor.stamp", stamp);
+    w.array("corridor.noticeOf", noticeOf);
+    w.array("corridor.counters", counters, 2);
+}
+
+bool YieldCorridor::load(const SnapshotReader& r, const LaneOccupancy& occupancy) {
+    std::vector<Progress> progress;
+    std::vector<Lane> lanes;
+    std::vector<uint64_t> counters;
+    if (!r.array("corridor.units", progress) || !r.array("corridor.lanes", lanes) || !r.array("corridor.notices", notices) ||
+        !r.array("corridor.stamp", stamp) || !r.array("corridor.noticeOf", noticeOf) ||
+        !r.array("corridor.counters", counters) || counters.size() != 2) return false;
+    tick = (uint32_t)counters[0];
+    read = counters[1];
+
+    // Every index in range, so a foreign file fails here instead of on the next collect()
+    if (stamp.size() != noticeOf.size() || stamp.size() > (size_t)occupancy.vehicles()) return false;
+    for (const Lane& lane : lanes) if (lane.lane < 0 || lane.lane >= occupancy.lanes()) return false;
+    for (const Notice& n : notices) {
+        if (n.vehicle < 0 || n.vehicle >= (int)stamp.size() || n.unit < 0 || n.unit >= (int)progress.size()) return false;
+    }
+    for (size_t v = 0; v < stamp.size(); v++) {
+        if (stamp[v] == tick && (noticeOf[v] < 0 || noticeOf[v] >= (int)notices.size())) return false;
+    }
+    units.assign(progress.size(), Unit());
+    for (size_t k = 0; k < progress.size(); k++) {
+        const Progress& p = progress[k];
+        if (p.begin > lanes.size() || p.count > lanes.size() - p.begin || p.next > p.count) return false;
+        units[k].lanes.assign(lanes.begin() + p.begin, lanes.begin() + p.begin + p.count);
+        units[k].next = (size_t)p.next;
+        units[k].arc = p.arc;
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef YIELDCORRIDOR_H
+#define YIELDCORRIDOR_H
+
+#include "LaneOccupancy.h"
+#include "Snapshot.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Which cars have to make way for emergency vehicles, found from the lanes on the vehicles' routes
+// instead of by checking every car against every vehicle. Each emergency vehicle (unit) publishes
+// its corridor as its route is planned: the lanes it will drive, in route order, with the distance
+// along its route to where each begins, plus the cross lanes of the junctions it passes. A tick only
+// reads the lanes between `behind` and `reach` of each unit from the lane occupancy index, so it
+// costs those few lanes and the cars on them however big the city and however many units respond.
+class YieldCorridor {
+public:
+    struct Params {
+        float behind{4.0f};        // cars this far behind a unit still make way
+        float reach{20.0f};        // and this far ahead of it
+        float junctionReach{5.0f}; // cross traffic holds at a junction the unit is this close to
+    };
+    struct Lane {
+        int lane;                 // LaneOccupancy lane
+        float entryArc, exitArc;  // route distance to where the unit enters and leaves its tile
+        bool crossing;            // cross traffic in a junction on the route, not the unit's own lane
+        uint8_t pad[3];           // zero, so equal corridors save to equal bytes
+    };
+    struct Notice {
+        int vehicle;   // as in LaneOccupancy
+        int unit;      // the nearest unit it makes way for
+        float ahead;   // route distance from that unit to the car, negative behind it
+        bool crossing;
+        uint8_t pad[3];
+    };
+
+    YieldCorridor() = default;
+    explicit YieldCorridor(const Params& p) : params(p) {}
+
+    // Lanes are added in route order as the unit's route is planned; clear() when it is replaced
+    void addLane(int unit, int lane, float entryArc, float exitArc, bool crossing);
+    void clear(int unit);
+    // Progress along the route; a unit that isn't moving should be cleared instead
+    void setProgress(int unit, float arc);
+
+    // Cars to notify this tick, each once
+    const std::vector<Notice>& collect(const LaneOccupancy& lanes);
+    const std::vector<Notice>& noticed() const { return notices; }
+
+    int lanesAhead(int unit) const;
+    uint64_t lanesRead() const { return read; }
+
+    // Sections corridor.*: every unit's lanes and progress, and the cars noticed last tick.
+    // Refuses lanes and cars that `occupancy` doesn't have.
+    void save(SnapshotWriter& w) const;
+    bool load(const SnapshotReader& r, const LaneOccupancy& occupancy);
+
+private:
+    struct Unit {
+        std::vector<Lane> lanes;
+        size_t next{0}; // first lane the unit isn't `behind` past yet
+        float arc{0.0f};
+    };
+
+    Params params;
+    std::vector<Unit> units;
+    std::vector<Notice> notices;
+    std::vector<uint32_t> stamp;  // per car, the collect() that last noticed it
+    std::vector<int> noticeOf;    // per car, its entry in `notices` if stamped this time
+    uint32_t tick{0};
+    uint64_t read{0};
+
+    struct Progress { uint64_t begin, count, next; float arc; uint32_t pad; }; // a unit as saved
+
+    Unit& unitAt(int unit);
+    void notice(int vehicle, int unit, float ahead, bool crossing);
+};
+
+#endif
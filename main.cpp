@@ -4,41 +4,170 @@
 #include <vector>
 #include <string>
 #include <cstdlib> 
+#include <cstdio>
+#include <cstring>
 #include <ctime>   
 #include <algorithm>
 #include <cmath>
+#include <random>
+#include <sstream>
+#include <map>
 #include "GameCommon.h"   
 #include "CityMap.h"
 #include "Vehicle.h"
 #include "EmergencyVehicle.h"
 #include "TrafficLight.h"
+#include "FacilityRoutes.h"
+#include "CoverageMap.h"
+#include "HierarchicalRouter.h"
+#include "EdgeTravelTimes.h"
+#include "RouteTable.h"
+#include "IdmKernel.h"
+#include "LaneOccupancy.h"
+#include "IntersectionManager.h"
+#include "SweptCollision.h"
+#include "SignalPlan.h"
+#include "PreemptionArbiter.h"
+#include "RoutePreemption.h"
+#include "YieldCorridor.h"
+#include "Dispatch.h"
+#include "IncidentGenerator.h"
+#include "Snapshot.h"
+#include "ReplayLog.h"
+#include "Telemetry.h"
 
 #define TILE_SIZE 4.0f
+#define ROUTE_LOOKAHEAD 12 // waypoints kept ahead of a vehicle on a lazily refined route
+#define COMMUTER_COUNT 6
+#define REROUTE_SCAN 4096     // vehicles checked per tick for a due reroute
+#define REROUTE_BUDGET 16     // route searches per tick at most (traffic_bench reroute times them)
+#define REROUTE_INTERVAL 5.0f // seconds between reroute checks of the same vehicle
+#define REROUTE_MIN_GAIN 1.0f // seconds a new route must save to be taken
+#define JUNCTION_APPROACH 4.0f  // distance to a junction's edge at which cars ask for a slot
+#define JUNCTION_MARGIN 0.4f    // seconds of slack on both ends of a reservation
+#define SIGNALS_ACTUATED true   // signals follow measured queues instead of fixed-time plans
+#define SIGNAL_PLAN_FILE "signal_plan.txt"       // coordinated timing from traffic_bench optimize, if present
+#define SIGNAL_NETWORK_FILE "signal_network.txt" // written on export, input to traffic_bench optimize
+#define UNITS_PER_SITE 2       // emergency units based at each hospital, fire and police station
+#define ON_SCENE_TIME 20.0f     // seconds fire and police units spend at an incident
+#define INCIDENT_FILE "incidents.csv" // response times, written on export and on exit
+#define RESPONSE_HISTOGRAM_FILE "response_times.csv" // percentiles per kind, written with INCIDENT_FILE
+#define ETA_DELAY_SHARE 0.25f // share of the delay cars measure on an edge that a unit under siren still sees
+#define INCIDENT_RATE 120.0f    // random incidents per hour of simulated time, when switched on
+#define INCIDENT_SEED 1
+#define SNAPSHOT_FILE "snapshot.bin" // F5 saves the running simulation here, F9 restores it
+#define REPLAY_FILE "replay.bin"     // R records into it, V plays it back
+#define REPLAY_KEYFRAME_TICKS 600    // frames between keyframes in a recording
+#define REPLAY_SEEK_TICKS 600        // frames skipped by one seek during playback
+#define TELEMETRY_FILE "trajectories.ctl" // T streams every vehicle's trajectory into it
+#define TELEMETRY_INTERVAL 0.1f           // simulated seconds between trajectory frames
+#define CHECK_SECONDS 300.0f      // length of a `CitySmart --check [seconds] [seed]` run
+#define CHECK_INCIDENT_RATE 720.0f // random incidents per hour during a check
+#define CHECK_NEAR_MISS 0.8f       // cars from crossing directions closer than this count as a near miss
+#define CHECK_ETA_ERROR 5.0f       // mean seconds units may arrive off their prediction in a check
 
 // =====================================================
 // SIMULATION CLASS
 // =====================================================
 class Simulation {
 private:
-    EmergencyVehicle* ambulance;
+    RouteTable routes; // every vehicle's waypoints, shared between cars on the same route
     std::vector<Vehicle*> normalTraffic; 
     
    
     std::vector<Vector3> lastPos;
     std::vector<float> stuckTime;
 CityMap* cityMap;
+    FacilityRoutes* facilityRoutes;
+    CoverageMap* coverage;
+    HierarchicalRouter* chunkRouter;
+    EdgeTravelTimes* edgeTimes;
+    // Parallel to normalTraffic
+    std::vector<int> tripGoal;          // tile a commuter is heading for, -1 for looping cars
+    std::vector<int> currentTile;       // tile the car was on last tick
+    std::vector<float> tileEnterTime;
+    std::vector<float> laneArcBase;     // route arc length at which the car entered its lane
+    std::vector<int> laneRouteId;       // route that arc length refers to
+    LaneOccupancy* laneIndex = nullptr; // cars per road graph lane, ordered, for leader lookups
+    IntersectionManager* junctions = nullptr; // space-time slots through junction tiles
+    std::vector<int> slotTile;          // junction a car holds a slot for and has not entered yet, -1 if none
+    std::vector<int> slotMovement;
+    std::vector<float> nextRerouteTime;
+    std::vector<int> commuterTiles;     // road tiles commuters pick destinations from
+    size_t rerouteCursor = 0;
+    std::vector<int> rerouteRest;       // scratch: tiles left of the trip being re-planned
+    float simTime = 0.0f;
+
+    // Car following inputs/outputs, one entry per car in normalTraffic
+    IdmParams idm;
+    std::vector<float> idmSpeed, idmDesired, idmGap, idmClosing, idmAccel, idmDistance;
+    // Footprint sweep inputs/outputs; the emergency units on duty come after the cars
+    SweptCollision collisions;
+    std::vector<SweptCollision::Body> bodies;
+    std::vector<float> moveShare;
+    int coverageView = -1; // -1 = overlay off, otherwise a FacilityGroup
     bool isMoving;   
     std::vector<Vector3> previewPath;
-    bool ambulanceMoving = false; 
-    Vector3 hospitalPos;
-    bool isReturning;
-    std::vector<Vector3> outboundPath;
+    HierarchicalRouter::Route previewRoute;
+    int previewTile = -1;             // tile picked for the next incident
 
     std::vector<TrafficLight> lights;
+    SignalScheduler signals;          // one controller per light, same index as lights
+    PreemptionArbiter arbiter{signals}; // shares the lights between units under siren
+    std::vector<int> signalChanges;   // lights whose state changed this tick
+    std::vector<int> lightOfTile;     // per tile, index into lights or -1
+    std::vector<int> lightTile;       // per light
+
+    enum class MissionState { Idle, ToIncident, OnScene, ToHospital, Returning };
+    // An emergency unit and the leg it is driving; same index in dispatch and yieldCorridor
+    struct Responder {
+        EmergencyVehicle* vehicle;
+        FacilityGroup group;
+        MissionState mission{MissionState::Idle};
+        float sceneUntil{0.0f};
+        HierarchicalRouter::Route route; // chunk-level plan, refined as the unit drives
+        RoutePreemption preemption;      // green windows along its route
+        std::vector<Vector3> points;     // waypoints planned for this leg
+        std::vector<int> tiles;
+        std::vector<int> heading;        // heading the unit enters each of them with
+        std::vector<float> arc;          // distance along the route to each of them
+        size_t cursor{0};                // waypoint whose tile the unit is on
+        float blockedTime{0.0f};
+        bool driving() const { return mission != MissionState::Idle && mission != MissionState::OnScene; }
+    };
+    std::vector<Responder> responders;
+    struct SavedUnit { // a responder as saved, less its waypoints and preemption
+        Vehicle::State vehicle;
+        int mission;
+        float sceneUntil, blockedTime;
+        uint64_t cursor;
+        int start, goal, startHeading; // chunk-level plan
+        int32_t pad0;                  // the pads stay zero, so equal units save to equal bytes
+        uint64_t nextLeg;
+        uint32_t revision;
+        uint8_t siren, pad1[3];
+    };
+    Dispatch dispatch;
+    std::vector<Dispatch::Assignment> assignments;
+    uint32_t dispatchRevision = 0;    // road graph revision the dispatch graph was built from
+    YieldCorridor yieldCorridor;      // lanes the units under siren will drive, for cars to make way
+    IncidentGenerator incidents;
+    std::vector<IncidentGenerator::Incident> generatedIncidents;
+    bool randomIncidents = false;
+    std::mt19937 rng;                 // commuter trips and signal offsets; saved with snapshots
 
-    enum class MissionState { Idle, ToIncident, ToHospital };
-    MissionState mission{MissionState::Idle};
-    Vector3 incidentPos{0,0,0};
+    // What the user does to the run, as replay commands; a and b are the arguments
+    enum CommandType { CMD_PICK, CMD_CALL, CMD_PAUSE, CMD_INCIDENTS, CMD_ROAD }; // a: tile, kind, -, -, tile
+    std::vector<ReplayLog::Command> input; // this frame's
+    ReplayLog replay;
+    bool recording = false;
+    uint64_t nextKeyframe = 0;
+    bool playing = false;
+    uint64_t playTick = 0;            // next tick of the recording to play
+    int playSpeed = 1;                // ticks played per frame
+    TelemetryWriter telemetry;        // trajectories, written by a thread of its own
+    float telemetryTime = 0.0f;       // of the last frame streamed
+    float nextTelemetry = 0.0f;
 
 
 public:
@@ -47,32 +176,21 @@ public:
         return { (float)x * TILE_SIZE + 2.0f, 0, (float)y * TILE_SIZE + 2.0f };
     }
 
-    Simulation(CityMap* map) {
+    Simulation(CityMap* map, unsigned int seed) {
         cityMap = map;
-        srand((unsigned int)time(NULL));
-        // Find the hospital tile in the map (portable: no hardcoded coords)
-        hospitalPos = Tile(8, 6); // fallback
-        for (int y = 0; y < CityMap::H; y++) {
-            for (int x = 0; x < CityMap::W; x++) {
-                if (cityMap->facilityMap[y][x] == HOSPITAL) {
-                    hospitalPos = cityMap->tileCenter(y, x);
-                    y = CityMap::H; // break both loops
-                    break;
-                }
-            }
-        }
-        isReturning = false;
-        
-        
-        ambulance = new EmergencyVehicle(hospitalPos, {0,0,0}, 5.0f, RED, "Ambulance");
-    
-   
-        ambulance->toggleSiren(true);
-    
-    
-        ambulance->setLaneOffset(0.2f); 
-        ambulance->setLooping(false);
+        facilityRoutes = new FacilityRoutes(*map);
+        coverage = new CoverageMap(*map);
+        chunkRouter = new HierarchicalRouter(map->roadGraph());
+        edgeTimes = new EdgeTravelTimes(map->roadGraph());
+        rng.seed(seed);
+        IncidentGenerator::Params incidentParams;
+        incidentParams.perHour = INCIDENT_RATE;
+        incidentParams.seed = INCIDENT_SEED;
+        incidents = IncidentGenerator(incidentParams);
+        InitResponders();
         InitHardcodedTraffic();
+        tripGoal.assign(normalTraffic.size(), -1);
+        SpawnCommuters(COMMUTER_COUNT);
         InitTrafficLights();
         for (size_t i = 0; i < normalTraffic.size(); i++) {
     normalTraffic[i]->setLaneOffset(0.6f); 
@@ -82,47 +200,707 @@ public:
         lastPos.clear();
         stuckTime.clear();
         for (auto v : normalTraffic) { lastPos.push_back(v->getPosition()); stuckTime.push_back(0.0f); }
+        InitTileTracking();
 isMoving = false; 
     }
 
     ~Simulation() { 
-        delete ambulance; 
+        for (Responder& r : responders) delete r.vehicle;
+        delete facilityRoutes;
+        delete coverage;
+        delete chunkRouter;
+        delete edgeTimes;
+        delete laneIndex;
+        delete junctions;
         for(auto v : normalTraffic) delete v;
     }
 
+    // Appends the fastest route from a to b, continuing in the direction the path already ends in
+    // so legs don't join with a u-turn
+    void AppendLeg(std::vector<Vector3>& path, Vector3 a, Vector3 b) {
+        int heading = -1;
+        if (path.size() >= 2) heading = headingOf(Vector3Subtract(path.back(), path[path.size() - 2]));
+        std::vector<Vector3> segment = cityMap->findFastestPath(a, b, false, heading);
+        path.insert(path.end(), segment.begin(), segment.end());
+    }
+
+    // Ambulances, fire engines and police units wait in front of their stations
+    void InitResponders() {
+        static const Color colour[] = { RED, ORANGE, DARKBLUE };
+        static const char* kind[] = { "Ambulance", "Fire Engine", "Police" };
+        const RoadGraph& roads = cityMap->roadGraph();
+        for (int g = 0; g < (int)FacilityGroup::Count; g++) {
+            for (int tile : facilityRoutes->siteAccess((FacilityGroup)g)) {
+                Vector3 p = cityMap->tileCenter(tile / roads.width(), tile % roads.width());
+                for (int k = 0; k < UNITS_PER_SITE; k++) {
+                    Responder r;
+                    r.vehicle = new EmergencyVehicle(routes, p, {0,0,0}, 5.0f, colour[g], kind[g]);
+                    r.vehicle->toggleSiren(false);
+                    r.vehicle->setLaneOffset(0.2f);
+                    r.vehicle->setLooping(false);
+                    r.group = (FacilityGroup)g;
+                    responders.push_back(r);
+                }
+            }
+        }
+        BuildDispatchGraph();
+        for (size_t u = 0; u < responders.size(); u++) dispatch.addUnit((int)responders[u].group, UnitState(u));
+    }
+
+    // Emergency moves between lane states, for the dispatch searches; rebuilt after road edits
+    void BuildDispatchGraph() {
+        dispatch.setGraph(DispatchGraph(cityMap->roadGraph()));
+        dispatchRevision = cityMap->roadGraph().revision();
+        BuildIncidentDensity();
+    }
+
+    static Dispatch::Graph DispatchGraph(const RoadGraph& roads) {
+        Dispatch::Graph g;
+        g.first.reserve(roads.stateCount() + 1);
+        g.first.push_back(0);
+        for (int s = 0; s < roads.stateCount(); s++) {
+            roads.forEachSuccessor(s, true, [&](int next, float cost) {
+                g.to.push_back(next);
+                g.cost.push_back(cost);
+            });
+            g.first.push_back((int)g.to.size());
+        }
+        return g;
+    }
+
+    // Random incidents happen on open roads, more of them next to the facilities that draw them
+    void BuildIncidentDensity() {
+        // ambulance, fire, police incidents a facility adds to each road tile next to it; the road
+        // itself counts as 1 of each
+        static const struct { FacilityType type; float weight[IncidentGenerator::KINDS]; } draws[] = {
+            { SCHOOL, { 4.0f, 1.0f, 2.0f } },     { SCHOOL1, { 4.0f, 1.0f, 2.0f } }, { SCHOOL2, { 4.0f, 1.0f, 2.0f } },
+            { OFFICE_C, { 3.0f, 1.0f, 1.0f } },   { BUILDING_b1, { 2.0f, 1.0f, 1.0f } },
+            { RESTAURANT, { 2.0f, 4.0f, 1.0f } }, { BCOFFEE, { 1.0f, 2.0f, 0.5f } }, { COFFE_S, { 1.0f, 2.0f, 0.5f } },
+            { BAKERY, { 1.0f, 3.0f, 0.5f } },     { SHOP, { 1.0f, 1.0f, 3.0f } },    { MINIMARKET, { 1.0f, 1.0f, 3.0f } },
+            { BOUTIQUE, { 1.0f, 1.0f, 3.0f } },   { BOOKSTORE, { 1.0f, 1.0f, 1.0f } }, { GSC, { 1.0f, 3.0f, 1.0f } },
+            { PHARMACY, { 2.0f, 0.5f, 2.0f } },
+        };
+        const RoadGraph& roads = cityMap->roadGraph();
+        std::vector<float> weight[IncidentGenerator::KINDS];
+        for (int k = 0; k < IncidentGenerator::KINDS; k++) weight[k].assign(roads.size(), 0.0f);
+        for (int t = 0; t < roads.size(); t++) {
+            if (!roads.isRoadType(roads.tileType(t), true) || roads.isClosed(t)) continue;
+            int y = t / roads.width(), x = t % roads.width();
+            for (int k = 0; k < IncidentGenerator::KINDS; k++) weight[k][t] = 1.0f;
+            const int dy[4] = { -1, 0, 1, 0 }, dx[4] = { 0, 1, 0, -1 };
+            for (int d = 0; d < 4; d++) {
+                int ny = y + dy[d], nx = x + dx[d];
+                if (ny < 0 || nx < 0 || ny >= CityMap::ROWS || nx >= CityMap::COLS) continue;
+                for (const auto& f : draws) {
+                    if (f.type != cityMap->facilityMap[ny][nx]) continue;
+                    for (int k = 0; k < IncidentGenerator::KINDS; k++) weight[k][t] += f.weight[k];
+                }
+            }
+        }
+        for (int k = 0; k < IncidentGenerator::KINDS; k++) incidents.setDensity(k, weight[k]);
+    }
+
+    // Lane state a unit is in, -1 off the map
+    int UnitState(size_t u) {
+        EmergencyVehicle* v = responders[u].vehicle;
+        int y, x;
+        if (!cityMap->worldToTile(v->getPosition(), y, x)) return -1;
+        return RoadGraph::stateOf(cityMap->roadGraph().id(y, x), headingOf(v->getForwardDir()));
+    }
+
+    // Queued incidents go to the nearest free unit of their kind, which sets off under siren
+    void DispatchUnits() {
+        const RoadGraph& roads = cityMap->roadGraph();
+        if (roads.revision() != dispatchRevision) BuildDispatchGraph();
+        for (size_t u = 0; u < responders.size(); u++) dispatch.moved((int)u, UnitState(u));
+        assignments.clear();
+        dispatch.assign(simTime, assignments);
+        for (const Dispatch::Assignment& a : assignments) {
+            Responder& r = responders[a.unit];
+            int tile = dispatch.incidents()[a.incident].tile;
+            std::vector<Vector3> path = PlanRoute(r.vehicle, cityMap->tileCenter(tile / roads.width(), tile % roads.width()), r.route);
+            if (path.empty()) path.push_back(r.vehicle->getPosition()); // already there
+            dispatch.predict(a.incident, PredictTravel(a.unit, path, a.eta));
+            StartLeg(a.unit, path, MissionState::ToIncident, true);
+        }
+    }
+
+    // Seconds a unit under siren should take along a planned path: its length at the unit's speed,
+    // plus the share of the delay measured on its edges now that cars making way leave. The part
+    // of a long route not refined yet gets what the dispatch search left for it, at the same speed.
+    float PredictTravel(size_t u, const std::vector<Vector3>& path, float searchEta) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        EmergencyVehicle* unit = responders[u].vehicle;
+        std::vector<int> tiles;
+        float length = 0.0f;
+        Vector3 from = unit->getPosition();
+        for (const Vector3& p : path) {
+            length += Vector3Distance(from, p);
+            from = p;
+            int y, x;
+            if (!cityMap->worldToTile(p, y, x)) continue;
+            if (tiles.empty() || tiles.back() != roads.id(y, x)) tiles.push_back(roads.id(y, x));
+        }
+        float seconds = length / unit->getSirenSpeed();
+        if (tiles.size() < 2) return seconds;
+        int heading = headingOf(unit->getForwardDir());
+        float free = roads.pathCost(tiles, true, heading);
+        float live = roads.pathCost(tiles, true, heading, edgeTimes->delays());
+        if (!std::isfinite(live)) return searchEta;
+        if (!responders[u].route.done()) {
+            float scale = TILE_SIZE / unit->getSirenSpeed() / roads.travelTime(tiles[1], true);
+            seconds += std::max(0.0f, searchEta - free) * scale;
+        }
+        return seconds + ETA_DELAY_SHARE * (live - free);
+    }
+
+    // Maps spanning several chunks are planned on the chunk graph and only the first stretch is
+    // refined; TopUpRoute() refines the rest as the unit drives
+    std::vector<Vector3> PlanRoute(EmergencyVehicle* unit, Vector3 goalWorld, HierarchicalRouter::Route& plan) {
+        int heading = headingOf(unit->getForwardDir());
+        plan = HierarchicalRouter::Route();
+        if (chunkRouter->chunkCount() <= 1) {
+            return cityMap->findFastestPath(unit->getPosition(), goalWorld, true, heading);
+        }
+
+        const RoadGraph& roads = cityMap->roadGraph();
+        int sy, sx, gy, gx;
+        std::vector<Vector3> wp;
+        if (!cityMap->worldToTile(unit->getPosition(), sy, sx) || !cityMap->worldToTile(goalWorld, gy, gx)) return wp;
+        if (!chunkRouter->plan(roads.id(sy, sx), roads.id(gy, gx), true, heading, plan) &&
+            !chunkRouter->plan(roads.id(sy, sx), roads.id(gy, gx), true, -1, plan)) return wp;
+
+        std::vector<int> tiles;
+        chunkRouter->refine(plan, ROUTE_LOOKAHEAD, true, tiles);
+        for (int t : tiles) wp.push_back(cityMap->tileCenter(t / roads.width(), t % roads.width()));
+        return wp;
+    }
+
+    void TopUpRoute(size_t u) {
+        Responder& r = responders[u];
+        if (r.route.done() || r.vehicle->remainingWaypoints() > ROUTE_LOOKAHEAD) return;
+        const RoadGraph& roads = cityMap->roadGraph();
+        std::vector<int> tiles;
+        chunkRouter->refine(r.route, ROUTE_LOOKAHEAD, true, tiles);
+        std::vector<Vector3> wp;
+        for (int t : tiles) wp.push_back(cityMap->tileCenter(t / roads.width(), t % roads.width()));
+        if (!wp.empty()) r.vehicle->appendPath(wp);
+        if (r.vehicle->getSirenActive()) PlanPreemption(u, wp);
+    }
+
+    // Starts a unit on a new path: lights held for its last one are handed back. Only units under
+    // siren get green windows and a corridor.
+    void StartLeg(size_t u, const std::vector<Vector3>& path, MissionState mission, bool siren) {
+        Responder& r = responders[u];
+        r.vehicle->setPath(path);
+        r.vehicle->toggleSiren(siren);
+        r.mission = mission;
+        ClearLeg(u);
+        int incident = dispatch.incidentOf((int)u);
+        r.preemption.setVehicle((int)u, incident >= 0 ? dispatch.incidents()[incident].priority : 0);
+        if (siren) PlanPreemption(u, path);
+    }
+
+    void ClearLeg(size_t u) {
+        Responder& r = responders[u];
+        r.preemption.clear(arbiter, simTime);
+        r.points.clear();
+        r.tiles.clear();
+        r.heading.clear();
+        r.arc.clear();
+        r.cursor = 0;
+        yieldCorridor.clear((int)u);
+    }
+
+    // Back to the nearest station of the unit's kind, without siren
+    void ReturnToStation(size_t u) {
+        Responder& r = responders[u];
+        r.route = HierarchicalRouter::Route();
+        std::vector<Vector3> back = facilityRoutes->routeToNearest(r.group, r.vehicle->getPosition(),
+                                                                   headingOf(r.vehicle->getForwardDir()));
+        if (!back.empty()) {
+            StartLeg(u, back, MissionState::Returning, false);
+        } else {
+            r.mission = MissionState::Idle;
+            r.vehicle->toggleSiren(false);
+            ClearLeg(u);
+        }
+    }
+
+    // A unit reached the end of its path. Ambulances take the patient to the nearest hospital; fire
+    // and police units stay on scene for a while. Units are free again once the incident is dealt
+    // with, and can be sent on from their way back.
+    void FinishLeg(size_t u) {
+        Responder& r = responders[u];
+        switch (r.mission) {
+        case MissionState::ToIncident:
+            dispatch.arrived((int)u, simTime);
+            if (r.group == FacilityGroup::Hospital) {
+                r.route = HierarchicalRouter::Route();
+                std::vector<Vector3> toHosp = facilityRoutes->routeToNearest(FacilityGroup::Hospital, r.vehicle->getPosition(),
+                                                                          headingOf(r.vehicle->getForwardDir()));
+                if (!toHosp.empty()) {
+                    StartLeg(u, toHosp, MissionState::ToHospital, true);
+                    break;
+                }
+                dispatch.release((int)u, simTime);
+                ReturnToStation(u);
+            } else {
+                r.mission = MissionState::OnScene;
+                r.sceneUntil = simTime + ON_SCENE_TIME;
+                r.vehicle->toggleSiren(false);
+                ClearLeg(u);
+            }
+            break;
+        case MissionState::ToHospital:
+            dispatch.delivered((int)u, simTime);
+            dispatch.release((int)u, simTime);
+            r.mission = MissionState::Idle; // the hospital is its station
+            r.vehicle->toggleSiren(false);
+            ClearLeg(u);
+            break;
+        default:
+            r.mission = MissionState::Idle;
+            break;
+        }
+    }
+
+    // Registers the lights and lanes on newly planned waypoints of a unit, once per waypoint. The
+    // unit gets its whole approach, so the cars queued ahead of it can clear whatever their
+    // movement; the lanes it will drive, and the cross lanes of junctions, go into its corridor.
+    void PlanPreemption(size_t u, const std::vector<Vector3>& wp) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        Responder& r = responders[u];
+        for (const Vector3& p : wp) {
+            int y, x;
+            if (!cityMap->worldToTile(p, y, x)) continue;
+            int tile = roads.id(y, x);
+            if (!r.tiles.empty() && r.tiles.back() == tile) continue; // legs share their end tile
+            float arc = r.arc.empty() ? 0.0f : r.arc.back() + Vector3Distance(r.points.back(), p);
+            int heading = r.points.empty() ? headingOf(r.vehicle->getForwardDir())
+                                           : headingOf(Vector3Subtract(p, r.points.back()));
+            if (!r.tiles.empty()) AddJunctionLanes(u, r.tiles.size() - 1, heading);
+            r.points.push_back(p);
+            r.tiles.push_back(tile);
+            r.heading.push_back(heading);
+            r.arc.push_back(arc);
+            yieldCorridor.addLane((int)u, RoadGraph::stateOf(tile, heading), arc - TILE_SIZE * 0.5f, arc + TILE_SIZE * 0.5f, false);
+            int id = lightOfTile[tile];
+            if (id >= 0) {
+                r.preemption.addStop(id, (uint16_t)(0xFu << (heading * 4)), arc - TILE_SIZE * 0.5f,
+                                     arc + TILE_SIZE * 0.5f + SweptCollision::HALF_LENGTH);
+            }
+        }
+    }
+
+    // Once a unit's way out of route junction k is known: cross traffic in the junction and
+    // driving up to it from the sides it doesn't use holds while it passes. Cars coming from where
+    // it leaves are oncoming and go on in their own lane.
+    void AddJunctionLanes(size_t u, size_t k, int exitHeading) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        const Responder& r = responders[u];
+        int tile = r.tiles[k], heading = r.heading[k];
+        int type = cityMap->tileMap[tile / roads.width()][tile % roads.width()];
+        if (type != INTERSECTION && type != ROUNDABOUT && type != TROAD && type != TROAD1 && type != ROTROAD) return;
+        float entryArc = r.arc[k] - TILE_SIZE * 0.5f, exitArc = r.arc[k] + TILE_SIZE * 0.5f;
+        for (int side = 0; side < 4; side++) {
+            if (side == (heading + 2) % 4 || side == exitHeading) continue;
+            int d = (side + 2) % 4; // heading of cars coming from that side
+            yieldCorridor.addLane((int)u, RoadGraph::stateOf(tile, d), entryArc, exitArc, true);
+            int from = roads.neighbour(tile, side);
+            if (from >= 0) yieldCorridor.addLane((int)u, RoadGraph::stateOf(from, d), entryArc, exitArc, true);
+        }
+    }
+
+    // A unit's progress along its planned waypoints: the waypoint of the tile it is on, plus how
+    // far it is past that tile's centre
+    float RouteProgress(size_t u) {
+        Responder& r = responders[u];
+        if (r.points.empty()) return 0.0f;
+        Vector3 pos = r.vehicle->getPosition();
+        int y, x;
+        if (cityMap->worldToTile(pos, y, x)) {
+            int tile = cityMap->roadGraph().id(y, x);
+            while (r.cursor + 1 < r.tiles.size() && r.tiles[r.cursor + 1] == tile) r.cursor++;
+        }
+        size_t k = r.cursor;
+        Vector3 dir = k + 1 < r.points.size() ? Vector3Normalize(Vector3Subtract(r.points[k + 1], r.points[k]))
+                                              : r.vehicle->getForwardDir();
+        return r.arc[k] + Vector3DotProduct(Vector3Subtract(pos, r.points[k]), dir);
+    }
+
+    // Cars within a unit's footprint just ahead: the ones making way for a unit under siren,
+    // otherwise the ones in the lane it is in and the next
+    bool UnitBlocked(size_t u, Vector3 dir) {
+        EmergencyVehicle* unit = responders[u].vehicle;
+        Vector3 pos = unit->getPosition();
+        auto inFront = [&](int car) {
+            Vector3 rel = Vector3Subtract(normalTraffic[car]->getPosition(), pos);
+            float forward = Vector3DotProduct(rel, dir);
+            if (forward <= 0.0f || forward > 1.4f) return false;
+            return Vector3Length(Vector3Subtract(rel, Vector3Scale(dir, forward))) < 0.75f;
+        };
+        if (unit->getSirenActive()) {
+            for (const YieldCorridor::Notice& n : yieldCorridor.noticed()) if (inFront(n.vehicle)) return true;
+            return false;
+        }
+        int state = UnitState(u);
+        if (state < 0) return false;
+        int tile = RoadGraph::stateTile(state), heading = RoadGraph::stateHeading(state);
+        int next = cityMap->roadGraph().neighbour(tile, heading);
+        for (int car = laneIndex->head(state); car >= 0; car = laneIndex->follower(car)) if (inFront(car)) return true;
+        if (next < 0) return false;
+        for (int car = laneIndex->head(RoadGraph::stateOf(next, heading)); car >= 0; car = laneIndex->follower(car))
+            if (inFront(car)) return true;
+        return false;
+    }
+
+    // Moves the units on duty. The cars on the corridors of units under siren are the only ones
+    // that can be in their way or have to make way for them.
+    void UpdateResponders(float dt) {
+        for (size_t u = 0; u < responders.size(); u++) {
+            Responder& r = responders[u];
+            if (r.mission == MissionState::OnScene && simTime >= r.sceneUntil) {
+                dispatch.release((int)u, simTime);
+                ReturnToStation(u);
+            }
+            if (r.driving() && r.vehicle->getSirenActive()) yieldCorridor.setProgress((int)u, RouteProgress(u));
+        }
+        yieldCorridor.collect(*laneIndex);
+
+        for (size_t u = 0; u < responders.size(); u++) {
+            Responder& r = responders[u];
+            if (!r.driving()) continue;
+            EmergencyVehicle* unit = r.vehicle;
+            // A junction another unit has first: wait at its stop line
+            if (unit->getSirenActive() && r.preemption.mustWait(arbiter, simTime, RouteProgress(u), 1.0f)) continue;
+            // Don't drive through cars (wait until they yield). Units meeting in a junction can hold
+            // up each other's cross traffic in front of themselves, so a unit kept waiting squeezes past.
+            Vector3 fwd = Vector3Subtract(unit->getDestination(), unit->getPosition());
+            if (Vector3Length(fwd) > 0.001f) fwd = Vector3Normalize(fwd); else fwd = unit->getForwardDir();
+            bool blocked = UnitBlocked(u, fwd);
+            r.blockedTime = blocked ? r.blockedTime + dt : 0.0f;
+            if (r.blockedTime > 2.0f) unit->nudgeLaneOffset(-0.7f, 0.35f);
+            if (!blocked || r.blockedTime > 2.0f) {
+                // Slow down a bit if a car is directly ahead (prevents "ghosting" through cars)
+                unit->setSpeedScale(blocked || UnitBlocked(u, unit->getIntendedDir()) ? 0.15f : 1.0f, 0.12f);
+                TopUpRoute(u);
+                unit->step(dt, true);
+                if (!cityMap->isDriveableWorld(unit->getPosition())) {
+                    unit->setPosition(cityMap->clampToDriveable(unit->getPosition()));
+                }
+            }
+            if (unit->hasFinishedPath() && r.route.done()) FinishLeg(u);
+        }
+    }
+
+    // Commuters drive between random road tiles and pick a new destination on arrival
+    void SpawnCommuters(int count) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        commuterTiles.clear();
+        for (int t = 0; t < roads.size(); t++) if (roads.isPassable(t, false)) commuterTiles.push_back(t);
+        if (commuterTiles.size() < 2) return;
+
+        static const Color palette[] = { PURPLE, LIME, PINK, BEIGE, MAROON, DARKBLUE };
+        for (int k = 0; k < count; k++) {
+            int start = commuterTiles[rng() % commuterTiles.size()];
+            Vector3 p = cityMap->tileCenter(start / roads.width(), start % roads.width());
+            normalTraffic.push_back(new Vehicle(routes, p, p, 3.6f + (rng() % 6) * 0.1f, palette[k % 6]));
+            tripGoal.push_back(-1);
+            NewCommuterTrip(normalTraffic.size() - 1);
+        }
+    }
+
+    void NewCommuterTrip(size_t i) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        Vehicle* v = normalTraffic[i];
+        for (int attempt = 0; attempt < 4; attempt++) {
+            int goal = commuterTiles[rng() % commuterTiles.size()];
+            std::vector<Vector3> path = cityMap->findFastestPath(v->getPosition(), cityMap->tileCenter(goal / roads.width(), goal % roads.width()),
+                                                                 false, headingOf(v->getForwardDir()), edgeTimes->delays());
+            if (path.size() < 2) continue;
+            // A finished trip continues from where the car stopped instead of snapping it to the tile centre
+            if (v->getRouteId() < 0) v->setPath(path);
+            else v->replaceRemainingPath(path);
+            tripGoal[i] = goal;
+            return;
+        }
+    }
+
+    void InitTileTracking() {
+        const RoadGraph& roads = cityMap->roadGraph();
+        size_t count = normalTraffic.size();
+        currentTile.assign(count, -1);
+        tileEnterTime.assign(count, simTime);
+        laneArcBase.assign(count, 0.0f);
+        laneRouteId.assign(count, -1);
+        nextRerouteTime.resize(count);
+        slotTile.assign(count, -1);
+        slotMovement.assign(count, -1);
+        delete laneIndex;
+        laneIndex = new LaneOccupancy(roads.stateCount(), (int)count);
+        for (size_t i = 0; i < count; i++) {
+            Vehicle* v = normalTraffic[i];
+            int y, x;
+            if (cityMap->worldToTile(v->getPosition(), y, x)) {
+                currentTile[i] = roads.id(y, x);
+                int heading = headingOf(v->getIntendedDir());
+                float into = DistanceIntoTile(v->getPosition(), currentTile[i], heading);
+                laneArcBase[i] = v->getArcPosition() - into;
+                laneRouteId[i] = v->getRouteId();
+                laneIndex->enter((int)i, RoadGraph::stateOf(currentTile[i], heading), into);
+            }
+            nextRerouteTime[i] = simTime + REROUTE_INTERVAL * (float)(i % 16) / 16.0f; // spread the checks out
+        }
+    }
+
+    // How far past the entry edge of a tile a point is, for a car that entered heading `heading`
+    float DistanceIntoTile(Vector3 p, int tile, int heading) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        Vector3 c = cityMap->tileCenter(tile / roads.width(), tile % roads.width());
+        float along = (p.x - c.x) * dirDX(heading) + (p.z - c.z) * dirDY(heading);
+        return Clamp(along + TILE_SIZE * 0.5f, 0.0f, TILE_SIZE);
+    }
+
+    // Distance car i has driven in its current lane, measured along its route
+    float LanePosition(size_t i) {
+        Vehicle* v = normalTraffic[i];
+        float arc = v->getArcPosition();
+        if (v->getRouteId() != laneRouteId[i]) {
+            // New trip or reroute: keep the in-lane distance, rebase it on the new route
+            laneArcBase[i] = arc - laneIndex->position((int)i);
+            laneRouteId[i] = v->getRouteId();
+        }
+        const RouteTable::Polyline& line = routes.polyline(v->getRouteId());
+        if (arc < laneArcBase[i] && line.loops) laneArcBase[i] -= line.length; // wrapped around the loop
+        return arc - laneArcBase[i];
+    }
+
+    // Per tick: when a car crosses into the next tile, log how long the last one took and move it
+    // to the lane it entered; otherwise just update its place in the lane
+    void TrackTileTransitions() {
+        const RoadGraph& roads = cityMap->roadGraph();
+        for (size_t i = 0; i < normalTraffic.size(); i++) {
+            Vehicle* v = normalTraffic[i];
+            int y, x;
+            if (!cityMap->worldToTile(v->getPosition(), y, x) || v->getRouteId() < 0) continue;
+            int tile = roads.id(y, x);
+            int prev = currentTile[i];
+            if (tile == prev) {
+                laneIndex->setPosition((int)i, LanePosition(i));
+                continue;
+            }
+
+            int heading = -1;
+            for (int d = 0; d < 4 && prev >= 0; d++) {
+                if (roads.neighbour(prev, d) != tile) continue;
+                edgeTimes->record(prev, d, simTime - tileEnterTime[i], TILE_SIZE / v->getBaseSpeed());
+                heading = d;
+            }
+            if (heading < 0) heading = headingOf(v->getIntendedDir()); // jumped (clamped or respawned)
+            currentTile[i] = tile;
+            tileEnterTime[i] = simTime;
+            float into = DistanceIntoTile(v->getPosition(), tile, heading);
+            laneArcBase[i] = v->getArcPosition() - into;
+            laneRouteId[i] = v->getRouteId();
+            laneIndex->enter((int)i, RoadGraph::stateOf(tile, heading), into);
+            ReportSignalArrival(i, tile, heading);
+        }
+        edgeTimes->age(simTime);
+    }
+
+    // The next tiles car i will drive onto after its current one, following its route;
+    // stops early at a break in the route (a jump between non-adjacent tiles)
+    int RouteTilesAhead(size_t i, int* out, int maxTiles) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        Vehicle* v = normalTraffic[i];
+        const std::vector<Vector3>& path = v->getPath();
+        int n = (int)path.size();
+        int tile = currentTile[i];
+        int count = 0;
+        for (int k = v->currentWaypoint(), scanned = 0; count < maxTiles && scanned < 8 && tile >= 0; scanned++, k++) {
+            if (k >= n) {
+                if (!v->isLooping() || n == 0) break;
+                k = 0;
+            }
+            int y, x;
+            if (!cityMap->worldToTile(path[k], y, x)) break;
+            int t = roads.id(y, x);
+            if (t == tile) continue;
+            if (HeadingBetween(tile, t) < 0) break;
+            out[count++] = t;
+            tile = t;
+        }
+        return count;
+    }
+
+    // Direction from a tile to its neighbour, -1 if they are not adjacent
+    int HeadingBetween(int from, int to) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        for (int d = 0; d < 4; d++) if (roads.neighbour(from, d) == to) return d;
+        return -1;
+    }
+
+    // Nearest car ahead of car i: the next one in its own lane, otherwise the last car to enter one
+    // of the next two lanes on its route. Returns -1 if nothing is within lookahead.
+    int FindLeader(size_t i, float lookahead, float& gap) {
+        int j = laneIndex->leader((int)i);
+        if (j >= 0) {
+            gap = std::max(0.0f, laneIndex->position(j) - laneIndex->position((int)i) - idm.vehicleLength);
+            return gap <= lookahead ? j : -1;
+        }
+
+        Vehicle* v = normalTraffic[i];
+        int ahead[2];
+        int count = RouteTilesAhead(i, ahead, 2);
+        for (int k = 0, tile = currentTile[i]; k < count; tile = ahead[k++]) {
+            int last = laneIndex->tail(RoadGraph::stateOf(ahead[k], HeadingBetween(tile, ahead[k])));
+            if (last >= 0 && last != (int)i) {
+                // Across a lane boundary the straight-line distance is close enough (and never too long)
+                gap = std::max(0.0f, Vector3Distance(normalTraffic[last]->getPosition(), v->getPosition()) - idm.vehicleLength);
+                return gap <= lookahead ? last : -1;
+            }
+        }
+        return -1;
+    }
+
+    // Junction slots for car i. Inside a junction the car keeps its movement busy until it is out;
+    // approaching one it asks for a slot and, until it has one, treats the entry edge as a stopped
+    // leader. Returns that stop-line gap, or IDM_FREE_GAP when the car may go on.
+    float JunctionGap(size_t i) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        Vehicle* v = normalTraffic[i];
+        int tile = currentTile[i];
+        if (tile < 0) return IDM_FREE_GAP;
+        int ahead[2];
+        int count = RouteTilesAhead(i, ahead, 2);
+        float speed = std::max(v->getVelocity(), 1.0f); // estimates for a stopped car assume it pulls away
+        Vector3 p = v->getPosition();
+        Vector3 c = cityMap->tileCenter(tile / roads.width(), tile % roads.width());
+
+        if (junctions->isJunction(tile) && count > 0) {
+            int heading = RoadGraph::stateHeading(laneIndex->laneOf((int)i));
+            int exitDir = HeadingBetween(tile, ahead[0]);
+            float left = TILE_SIZE * 0.5f - ((p.x - c.x) * dirDX(exitDir) + (p.z - c.z) * dirDY(exitDir));
+            junctions->hold(tile, IntersectionManager::movementOf(heading, exitDir),
+                            simTime + (left + idm.vehicleLength) / speed + JUNCTION_MARGIN);
+        }
+        if (slotTile[i] == tile) slotTile[i] = -1; // entered the junction it had a slot for
+        if (count == 0 || !junctions->isJunction(ahead[0])) { slotTile[i] = -1; return IDM_FREE_GAP; }
+
+        int next = ahead[0];
+        int heading = HeadingBetween(tile, next);
+        int exitDir = count > 1 ? HeadingBetween(next, ahead[1]) : heading;
+        int movement = IntersectionManager::movementOf(heading, exitDir);
+        float edge = TILE_SIZE * 0.5f - ((p.x - c.x) * dirDX(heading) + (p.z - c.z) * dirDY(heading));
+        float stopGap = std::max(0.0f, edge - idm.vehicleLength * 0.5f);
+        if (edge > JUNCTION_APPROACH) return IDM_FREE_GAP;
+        // The first car of the lane stands for the whole queue behind it
+        if (lightOfTile[next] >= 0 && laneIndex->leader((int)i) < 0) {
+            signals.reportQueued(lightOfTile[next], movement, laneIndex->count(laneIndex->laneOf((int)i)));
+        }
+
+        bool holding = slotTile[i] == next && slotMovement[i] == movement;
+        float brake = v->getVelocity() * v->getVelocity() / (2.0f * idm.comfortDecel);
+        float enter = simTime + edge / speed;
+        float leave = enter + (TILE_SIZE + idm.vehicleLength) / speed + JUNCTION_MARGIN;
+        if (holding && stopGap <= brake) {
+            // Committed: too close to stop now. Keep the slot alive in case the car gets held up
+            // on the way in (a blocked footprint sweep) and arrives later than it booked for.
+            junctions->hold(next, movement, leave);
+            return IDM_FREE_GAP;
+        }
+
+        // Don't enter unless the lane behind the junction has room to leave it
+        if (count > 1) {
+            int last = laneIndex->tail(RoadGraph::stateOf(ahead[1], exitDir));
+            if (last >= 0 && last != (int)i && laneIndex->position(last) < idm.vehicleLength + idm.minGap) {
+                slotTile[i] = -1;
+                return stopGap;
+            }
+        }
+
+        if (!junctions->request(next, movement, enter - JUNCTION_MARGIN, leave)) {
+            slotTile[i] = -1;
+            return stopGap;
+        }
+        slotTile[i] = next;
+        slotMovement[i] = movement;
+        return IDM_FREE_GAP;
+    }
+
+    // A car that enters an empty lane leading into a signalised junction is an arrival for the
+    // movement it will make there (actuated signals keep the green for it)
+    void ReportSignalArrival(size_t i, int tile, int heading) {
+        if (laneIndex->count(RoadGraph::stateOf(tile, heading)) != 1) return;
+        int ahead[2];
+        int count = RouteTilesAhead(i, ahead, 2);
+        if (count == 0 || lightOfTile[ahead[0]] < 0) return;
+        int enter = HeadingBetween(tile, ahead[0]);
+        int exitDir = count > 1 ? HeadingBetween(ahead[0], ahead[1]) : enter;
+        signals.reportArrival(lightOfTile[ahead[0]], IntersectionManager::movementOf(enter, exitDir));
+    }
+
+    // A bounded number of commuters per tick re-plan the rest of their trip against the live
+    // delays, and switch only when the new route saves a clear margin
+    void RerouteCommuters() {
+        const RoadGraph& roads = cityMap->roadGraph();
+        size_t scan = std::min(normalTraffic.size(), (size_t)REROUTE_SCAN);
+        int budget = REROUTE_BUDGET;
+        for (size_t n = 0; n < scan && budget > 0; n++) {
+            size_t i = rerouteCursor++ % normalTraffic.size();
+            if (tripGoal[i] < 0 || simTime < nextRerouteTime[i]) continue;
+            nextRerouteTime[i] = simTime + REROUTE_INTERVAL;
+
+            Vehicle* v = normalTraffic[i];
+            const std::vector<Vector3>& path = v->getPath();
+            int wp = v->currentWaypoint();
+            if (wp < 1 || wp + 2 >= (int)path.size()) continue; // too little left to re-plan
+            budget--;
+
+            rerouteRest.clear();
+            for (int k = wp; k < (int)path.size(); k++) {
+                int y, x;
+                if (!cityMap->worldToTile(path[k], y, x)) break;
+                rerouteRest.push_back(roads.id(y, x));
+            }
+            if ((int)rerouteRest.size() < (int)path.size() - wp) continue; // runs off the map, keep it
+            int heading = headingOf(Vector3Subtract(path[wp], path[wp - 1]));
+            std::vector<int> alt;
+            if (!edgeTimes->reroute(roads, rerouteRest, tripGoal[i], heading, false, REROUTE_MIN_GAIN, alt)) continue;
+
+            std::vector<Vector3> tail;
+            tail.reserve(alt.size());
+            for (int t : alt) tail.push_back(cityMap->tileCenter(t / roads.width(), t % roads.width()));
+            v->replaceRemainingPath(tail);
+        }
+    }
+
     // PATHS aligned with the new 10x10 road network
     std::vector<Vector3> GetTopLapPath() {
         std::vector<Vector3> fullPath;
-        std::vector<Vector3> segment;
-        segment = cityMap->findFastestPath(Tile(6, 0), Tile(6, 2), false);
-        fullPath.insert(fullPath.end(), segment.begin(), segment.end());
-        segment = cityMap->findFastestPath(Tile(6, 2), Tile(9, 2), false);
-        fullPath.insert(fullPath.end(), segment.begin(), segment.end());
-        segment = cityMap->findFastestPath(Tile(9, 2), Tile(6, 2), false);
-        fullPath.insert(fullPath.end(), segment.begin(), segment.end());
-        segment = cityMap->findFastestPath(Tile(6, 2), Tile(6, 0), false);
-        fullPath.insert(fullPath.end(), segment.begin(), segment.end());
+        AppendLeg(fullPath, Tile(6, 0), Tile(6, 2));
+        AppendLeg(fullPath, Tile(6, 2), Tile(9, 2));
+        AppendLeg(fullPath, Tile(9, 2), Tile(6, 2));
+        AppendLeg(fullPath, Tile(6, 2), Tile(6, 0));
         return fullPath;
     }
 
     std::vector<Vector3> GetBottomLapPath() {
         std::vector<Vector3> fullPath;
-        std::vector<Vector3> segment;
-        segment = cityMap->findFastestPath(Tile(0, 9), Tile(4, 9), false);
-        fullPath.insert(fullPath.end(), segment.begin(), segment.end());
-        segment = cityMap->findFastestPath(Tile(4, 9), Tile(9, 9), false);
-        fullPath.insert(fullPath.end(), segment.begin(), segment.end());
+        AppendLeg(fullPath, Tile(0, 9), Tile(4, 9));
+        AppendLeg(fullPath, Tile(4, 9), Tile(9, 9));
         return fullPath;
     }
 
     void SetupLoopingCar(int index) {
         Vehicle* v = nullptr;
         if (index == 0) {
-            v = new Vehicle(Tile(6, 0), Tile(6, 0), 3.5f, BLUE);
+            v = new Vehicle(routes, Tile(6, 0), Tile(6, 0), 3.5f, BLUE);
             v->setPath(GetTopLapPath());
         }
         else if (index == 1) {
-            v = new Vehicle(Tile(0, 9), Tile(0, 9), 4.0f, GREEN);
+            v = new Vehicle(routes, Tile(0, 9), Tile(0, 9), 4.0f, GREEN);
             v->setPath(GetBottomLapPath());
         }
         
@@ -135,19 +913,137 @@ isMoving = false;
     
     void InitTrafficLights() {
     lights.clear();
+    lightTile.clear();
+    signals.clear();
+    lightOfTile.assign(cityMap->roadGraph().size(), -1);
+    ResetJunctions();
 
-    for (int y = 0; y < CityMap::H; y++) {
-        for (int x = 0; x < CityMap::W; x++) {
+    const float throughGreen = 4.0f, leftGreen = 2.0f, yellow = 1.5f, allRed = 0.5f;
+    int planFor[16]; // by road openings; junctions of the same shape share a plan
+    std::map<std::pair<int, float>, int> coordinatedPlan; // by openings and N/S share, shared the same way
+    SignalPlan coordinated; // junctions it lists run its offsets and splits instead
+    coordinated.load(SIGNAL_PLAN_FILE);
+    std::fill(planFor, planFor + 16, -1);
+    for (int y = 0; y < CityMap::ROWS; y++) {
+        for (int x = 0; x < CityMap::COLS; x++) {
             int t = cityMap->tileMap[y][x];
+            int tile = cityMap->roadGraph().id(y, x);
+
+            // Roundabouts are yield-controlled; the reservations alone handle them
+            if (t == INTERSECTION || t == TROAD || t == TROAD1) {
+                uint8_t open = RoadGraph::openings(t);
+                const SignalPlan::Entry* entry = coordinated.find(tile);
+                int plan, id;
+                if (entry) {
+                    const SignalTiming& timing = coordinated.timing;
+                    auto shared = coordinatedPlan.find({ open, entry->nsShare });
+                    if (shared == coordinatedPlan.end()) {
+                        int p = signals.addPlan(coordinatedPhases(open, timing, entry->nsShare), timing.yellow, timing.allRed);
+                        shared = coordinatedPlan.insert({ { open, entry->nsShare }, p }).first;
+                    }
+                    plan = shared->second;
+                    id = signals.add(plan, entry->offset);
+                } else {
+                    if (planFor[open] < 0) planFor[open] = signals.addStandardPlan(open, throughGreen, leftGreen, yellow, allRed);
+                    plan = planFor[open];
+                    if (SIGNALS_ACTUATED) {
+                        id = signals.addActuated(plan, { 2.0f, 12.0f, 1.0f });
+                    } else {
+                        // Random point in the cycle so lights are out of sync
+                        float offset = (float)(rng() % (int)(signals.cycleLength(plan) * 100)) / 100.0f;
+                        id = signals.add(plan, offset);
+                    }
+                }
+
+                uint16_t movements = 0;
+                for (int k = 0; k < signals.phaseCount(plan); k++) movements |= signals.phase(plan, k).movements;
+                uint8_t approaches = 0;
+                for (int h = 0; h < 4; h++) if (movements >> (h * 4) & 0xF) approaches |= (uint8_t)(1u << h);
 
-            if (t == INTERSECTION || t == TROAD || t == TROAD1 || t == ROUNDABOUT || t == ROTROAD) {
                 Vector3 p = cityMap->tileCenter(y, x);
                 p.y = 0.0f;
-                lights.emplace_back(p, 3.0f); 
+                lights.emplace_back(p, approaches);
+                lightTile.push_back(tile);
+                lightOfTile[tile] = id;
+                ApplySignal(id);
             }
         }
     }
 }
+
+    // Junction tiles with no reservations held
+    void ResetJunctions() {
+        delete junctions;
+        junctions = new IntersectionManager(cityMap->roadGraph().size());
+        AddJunctions(*junctions);
+    }
+
+    void AddJunctions(IntersectionManager& m) const {
+        for (int y = 0; y < CityMap::ROWS; y++) {
+            for (int x = 0; x < CityMap::COLS; x++) {
+                int t = cityMap->tileMap[y][x];
+                if (t == INTERSECTION || t == TROAD || t == TROAD1 || t == ROUNDABOUT || t == ROTROAD) {
+                    m.addJunction(cityMap->roadGraph().id(y, x));
+                }
+            }
+        }
+    }
+
+    // Signalised junctions and the straight roads linking them, for traffic_bench optimize. A
+    // corridor is a run of connected tiles along a row or column with at least two signals on it.
+    void ExportSignalNetwork(const char* path) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        SignalNetwork net;
+        std::vector<int> index(roads.size(), -1);
+        for (size_t id = 0; id < lights.size(); id++) {
+            index[lightTile[id]] = (int)net.junctions.size();
+            net.junctions.push_back({ lightTile[id], RoadGraph::openings(roads.tileType(lightTile[id])) });
+        }
+        for (int axis = 0; axis < 2; axis++) {
+            int lines = axis == 0 ? roads.width() : roads.height();
+            int length = axis == 0 ? roads.height() : roads.width();
+            int along = axis == 0 ? DIR_S : DIR_E;
+            for (int line = 0; line < lines; line++) {
+                SignalNetwork::Corridor c{ axis, 4.0f, {}, {} }; // typical commuter speed
+                for (int k = 0; k < length; k++) {
+                    int tile = axis == 0 ? roads.id(k, line) : roads.id(line, k);
+                    if (index[tile] >= 0) {
+                        c.junction.push_back(index[tile]);
+                        c.position.push_back(k * TILE_SIZE);
+                    }
+                    if (k == length - 1 || !roads.connects(tile, along)) {
+                        if (c.junction.size() >= 2) net.corridors.push_back(c);
+                        c.junction.clear();
+                        c.position.clear();
+                    }
+                }
+            }
+        }
+        net.save(path);
+    }
+
+    // Copies a controller's state to its light heads and to the junction's open movements
+    void ApplySignal(int id) {
+        for (int h = 0; h < 4; h++) lights[id].setState(h, signals.approachState(id, h));
+        junctions->setOpenMovements(lightTile[id], signals.open(id));
+    }
+
+    // Only lights that change state are touched. Under siren the lights on a unit's route get
+    // green windows planned from its arrival estimates (see PlanPreemption); where units meet, the
+    // arbiter lets them through one after another.
+    void UpdateSignals() {
+        for (size_t u = 0; u < responders.size(); u++) {
+            Responder& r = responders[u];
+            if (r.driving() && r.vehicle->getSirenActive()) {
+                r.preemption.update(arbiter, simTime, RouteProgress(u), r.vehicle->getBaseSpeed());
+            } else if (r.preemption.pendingStops() > 0) {
+                r.preemption.clear(arbiter, simTime);
+            }
+        }
+        arbiter.update(simTime);
+        signals.advance(simTime, signalChanges);
+        for (int id : signalChanges) ApplySignal(id);
+    }
 void InitHardcodedTraffic() {
         normalTraffic.clear();
 
@@ -158,32 +1054,26 @@ void InitHardcodedTraffic() {
         Vector3 t4 = Tile(4, 9);
 
         std::vector<Vector3> longPath;
-        std::vector<Vector3> segment;
 
-        segment = cityMap->findFastestPath(t1, t2, false);
-        longPath.insert(longPath.end(), segment.begin(), segment.end()); 
-        segment = cityMap->findFastestPath(t2, t3, false);
-        longPath.insert(longPath.end(), segment.begin(), segment.end()); 
-        segment = cityMap->findFastestPath(t3, t4, false);
-        longPath.insert(longPath.end(), segment.begin(), segment.end()); 
-        segment = cityMap->findFastestPath(t4, t1, false);
-        longPath.insert(longPath.end(), segment.begin(), segment.end()); 
+        AppendLeg(longPath, t1, t2);
+        AppendLeg(longPath, t2, t3);
+        AppendLeg(longPath, t3, t4);
+        AppendLeg(longPath, t4, t1);
 
         if (!longPath.empty()) {
-            Vehicle* v1 = new Vehicle(longPath[0], {0,0,0}, 4.0f, BLUE);
-            v1->setPath(longPath);
+            int loop = routes.intern(longPath);
+            Vehicle* v1 = new Vehicle(routes, longPath[0], {0,0,0}, 4.0f, BLUE);
             v1->setLooping(true);
+            v1->setRoute(loop);
             normalTraffic.push_back(v1);
 
+            // Second car on the same loop, half a lap ahead
             int half = (int)longPath.size() / 2;
-            if (longPath.size() > half) {
-                std::vector<Vector3> p2 = longPath;
-                std::rotate(p2.begin(), p2.begin() + half, p2.end());
-                Vehicle* v2 = new Vehicle(p2[0], {0,0,0}, 4.2f, GREEN);
-                v2->setPath(p2);
-                v2->setLooping(true);
-                normalTraffic.push_back(v2);
-            }
+            Vehicle* v2 = new Vehicle(routes, longPath[half], {0,0,0}, 4.2f, GREEN);
+            v2->setLooping(true);
+            v2->setRoute(loop, half);
+            normalTraffic.push_back(v2);
+            routes.release(loop);
         }
 
         // ROUTE B: THE CITY CENTER (Short Loop)
@@ -194,228 +1084,662 @@ void InitHardcodedTraffic() {
 
         std::vector<Vector3> shortPath;
         
-        segment = cityMap->findFastestPath(s1, s2, false);
-        shortPath.insert(shortPath.end(), segment.begin(), segment.end()); 
-        segment = cityMap->findFastestPath(s2, s3, false);
-        shortPath.insert(shortPath.end(), segment.begin(), segment.end()); 
-        segment = cityMap->findFastestPath(s3, s4, false);
-        shortPath.insert(shortPath.end(), segment.begin(), segment.end()); 
-        segment = cityMap->findFastestPath(s4, s1, false);
-        shortPath.insert(shortPath.end(), segment.begin(), segment.end()); 
+        AppendLeg(shortPath, s1, s2);
+        AppendLeg(shortPath, s2, s3);
+        AppendLeg(shortPath, s3, s4);
+        AppendLeg(shortPath, s4, s1);
 
         if (!shortPath.empty()) {
-            Vehicle* v3 = new Vehicle(shortPath[0], {0,0,0}, 3.8f, YELLOW);
-            v3->setPath(shortPath);
+            int loop = routes.intern(shortPath);
+            Vehicle* v3 = new Vehicle(routes, shortPath[0], {0,0,0}, 3.8f, YELLOW);
             v3->setLooping(true);
+            v3->setRoute(loop);
             normalTraffic.push_back(v3);
 
             int half = (int)shortPath.size() / 2;
-            if (shortPath.size() > half) {
-                std::vector<Vector3> p4_path = shortPath;
-                std::rotate(p4_path.begin(), p4_path.begin() + half, p4_path.end());
-                Vehicle* v4 = new Vehicle(p4_path[0], {0,0,0}, 3.5f, ORANGE);
-                v4->setPath(p4_path);
-                v4->setLooping(true);
-                normalTraffic.push_back(v4);
-            }
+            Vehicle* v4 = new Vehicle(routes, shortPath[half], {0,0,0}, 3.5f, ORANGE);
+            v4->setLooping(true);
+            v4->setRoute(loop, half);
+            normalTraffic.push_back(v4);
+            routes.release(loop);
         }
     }
 
+    // Tile under the mouse on the ground plane
+    bool PickTile(Camera3D camera, int& tile) {
+        Ray ray = GetMouseRay(GetMousePosition(), camera);
+        RayCollision collision = GetRayCollisionQuad(ray, {0,0,0}, {0,0,40}, {40,0,40}, {40,0,0});
+        int ty, tx;
+        if (!collision.hit || !cityMap->worldToTile(collision.point, ty, tx)) return false;
+        tile = cityMap->roadGraph().id(ty, tx);
+        return true;
+    }
+
     void Update(Camera3D camera) {
-        float dt = GetFrameTime();
-        for (auto &l : lights) {
-            l.update(dt);
-            if (ambulanceMoving && ambulance->getSirenActive()) {
-                l.greenForEmergencyIfApproaching(ambulance->getPosition(), ambulance->getForwardDir());
-            }
+        // Views, files and the recorder; none of these change the run
+        if (IsKeyPressed(KEY_H)) {
+            coverageView++; // off -> hospital -> fire -> police -> off
+            if (coverageView >= (int)FacilityGroup::Count) coverageView = -1;
+        }
+        if (IsKeyPressed(KEY_E)) {
+            coverage->exportPGM("coverage_hospital.pgm", FacilityGroup::Hospital, 30.0f);
+            coverage->exportPGM("coverage_fire.pgm", FacilityGroup::Fire, 30.0f);
+            coverage->exportPGM("coverage_police.pgm", FacilityGroup::Police, 30.0f);
+            coverage->exportCSV("coverage.csv");
+            ExportSignalNetwork(SIGNAL_NETWORK_FILE);
+            ExportResponseTimes();
+        }
+        if (IsKeyPressed(KEY_F5)) {
+            bool ok = SaveSnapshot(SNAPSHOT_FILE);
+            TraceLog(ok ? LOG_INFO : LOG_WARNING, "Snapshot %s %s", ok ? "saved to" : "could not be saved to", SNAPSHOT_FILE);
+        }
+        if (IsKeyPressed(KEY_F9)) {
+            StopRecording(); // the log can't follow a jump
+            playing = false;
+            bool ok = LoadSnapshot(SNAPSHOT_FILE);
+            TraceLog(ok ? LOG_INFO : LOG_WARNING, "Snapshot %s %s", ok ? "restored from" : "could not be restored from", SNAPSHOT_FILE);
+        }
+        if (IsKeyPressed(KEY_R)) {
+            if (recording) StopRecording();
+            else if (!playing) StartRecording();
+        }
+        if (IsKeyPressed(KEY_V)) {
+            if (playing) playing = false; // live again from here
+            else StartPlayback(REPLAY_FILE);
+        }
+        if (IsKeyPressed(KEY_T)) {
+            if (telemetry.isOpen()) StopTelemetry();
+            else StartTelemetry();
         }
 
-        // 1. Mouse Input
-        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-            Ray ray = GetMouseRay(GetMousePosition(), camera);
-            RayCollision collision = GetRayCollisionQuad(ray, {0,0,0}, {0,0,40}, {40,0,40}, {40,0,0});
-            
-            if (collision.hit) {
-                previewPath = cityMap->findFastestPath(ambulance->getPosition(), collision.point, true);
-                ambulanceMoving = false; 
-                isReturning = false; 
+        if (playing) {
+            if (IsKeyPressed(KEY_RIGHT)) SeekReplay(playTick + REPLAY_SEEK_TICKS);
+            if (IsKeyPressed(KEY_LEFT)) SeekReplay(playTick > REPLAY_SEEK_TICKS ? playTick - REPLAY_SEEK_TICKS : 0);
+            if (IsKeyPressed(KEY_UP)) playSpeed = std::min(playSpeed * 2, 64);
+            if (IsKeyPressed(KEY_DOWN)) playSpeed = std::max(playSpeed / 2, 1);
+            for (int k = 0; k < playSpeed && playTick < replay.ticks(); k++) PlayTick(playTick++);
+            if (playTick >= replay.ticks()) playing = false; // the run goes on live where the recording ended
+            return;
+        }
+
+        // Everything that changes the run becomes a command, so a recording can give it again
+        input.clear();
+        int tile;
+        if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && PickTile(camera, tile)) input.push_back({ 0, CMD_PICK, tile, 0 });
+        int callKind = IsKeyPressed(KEY_G) ? Dispatch::AMBULANCE : IsKeyPressed(KEY_F) ? Dispatch::FIRE
+                     : IsKeyPressed(KEY_P) ? Dispatch::POLICE : -1;
+        if (callKind >= 0) input.push_back({ 0, CMD_CALL, callKind, 0 });
+        if (IsKeyPressed(KEY_SPACE)) input.push_back({ 0, CMD_PAUSE, 0, 0 });
+        if (IsKeyPressed(KEY_I)) input.push_back({ 0, CMD_INCIDENTS, 0, 0 });
+        if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT) && PickTile(camera, tile)) input.push_back({ 0, CMD_ROAD, tile, 0 });
+
+        float dt = GetFrameTime();
+        if (recording) {
+            if (replay.ticks() >= nextKeyframe) {
+                SnapshotWriter w;
+                w.open();
+                SaveSnapshot(w);
+                w.close();
+                replay.keyframe(std::move(w.buffer()));
+                nextKeyframe += REPLAY_KEYFRAME_TICKS;
             }
+            for (const ReplayLog::Command& c : input) replay.command(c.type, c.a, c.b);
+            replay.step(dt);
         }
+        Tick(dt, input.data(), input.data() + input.size());
+    }
 
-        // 2. Start Mission
-        if (IsKeyPressed(KEY_G) && !previewPath.empty()) {
-            outboundPath = previewPath;
-            ambulance->setPath(previewPath);
-            ambulanceMoving = true;
-            isReturning = false;
-            mission = MissionState::ToIncident;
-            if (!outboundPath.empty()) incidentPos = outboundPath.back();
+    void Apply(const ReplayLog::Command& c) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        switch (c.type) {
+        case CMD_PICK: {
+            // Preview the way the nearest free ambulance would take
+            previewTile = c.a;
             previewPath.clear();
+            if (roads.revision() != dispatchRevision) BuildDispatchGraph();
+            int u = dispatch.nearest(Dispatch::AMBULANCE, previewTile);
+            Vector3 goal = cityMap->tileCenter(previewTile / roads.width(), previewTile % roads.width());
+            if (u >= 0) previewPath = PlanRoute(responders[u].vehicle, goal, previewRoute);
+            break;
         }
+        case CMD_CALL: // an incident at the picked tile; the dispatcher sends the nearest free unit
+            if (previewTile < 0) break;
+            dispatch.report(c.a, previewTile, 0, simTime);
+            previewTile = -1;
+            previewPath.clear();
+            break;
+        case CMD_PAUSE:
+            isMoving = !isMoving;
+            break;
+        case CMD_INCIDENTS:
+            randomIncidents = !randomIncidents;
+            generatedIncidents.clear();
+            if (randomIncidents) incidents.generate(simTime, generatedIncidents); // none for the time it was off
+            break;
+        case CMD_ROAD: // closes or reopens a road tile; routes and coverage update incrementally
+            if (roads.isRoadType(roads.tileType(c.a), true)) {
+                cityMap->setRoadClosed(c.a / roads.width(), c.a % roads.width(), !roads.isClosed(c.a));
+                coverage->sync();
+            }
+            break;
+        }
+    }
 
-        if (IsKeyPressed(KEY_SPACE)) isMoving = !isMoving;
+    // One frame: the commands given during it, then everything moves on by dt
+    void Tick(float dt, const ReplayLog::Command* first, const ReplayLog::Command* last) {
+        UpdateSignals();
+        for (const ReplayLog::Command* c = first; c != last; ++c) Apply(*c);
 
-        // 3. Main Loop
+        // Main Loop
         if (isMoving) {
-            if (ambulanceMoving) {
-                // Prevent the ambulance from driving through cars (wait until they yield)
-                bool blocked = false;
-                Vector3 aPos = ambulance->getPosition();
-                Vector3 aFwd = Vector3Subtract(ambulance->getDestination(), ambulance->getPosition());
-                if (Vector3Length(aFwd) > 0.001f) aFwd = Vector3Normalize(aFwd); else aFwd = ambulance->getForwardDir();
-                for (auto v : normalTraffic) {
-                    Vector3 rel = Vector3Subtract(v->getPosition(), aPos);
-                    float forward = Vector3DotProduct(rel, aFwd);
-                    if (forward <= 0.0f || forward > 1.4f) continue;
-                    Vector3 lateralVec = Vector3Subtract(rel, Vector3Scale(aFwd, forward));
-                    float lateral = Vector3Length(lateralVec);
-                    if (lateral < 0.75f) { blocked = true; break; }
-                }
-                if (!blocked) {
-                    // Slow down a bit if a car is directly blocking the ambulance (prevents "ghosting" through cars)
-                float ambScale = 1.0f;
-                Vector3 ambDir = ambulance->getIntendedDir();
-                for (auto *car : normalTraffic) {
-                    Vector3 rel = Vector3Subtract(car->getPosition(), ambulance->getPosition());
-                    float forward = Vector3DotProduct(rel, ambDir);
-                    if (forward <= 0.0f || forward > 1.4f) continue;
-                    Vector3 latV = Vector3Subtract(rel, Vector3Scale(ambDir, forward));
-                    float lateral = Vector3Length(latV);
-                    if (lateral < 0.75f) { ambScale = 0.15f; break; }
-                }
-                ambulance->setSpeedScale(ambScale, 0.12f);
-                ambulance->step(dt, true);
-                if (!cityMap->isDriveableWorld(ambulance->getPosition())) {
-                    ambulance->setPosition(cityMap->clampToDriveable(ambulance->getPosition()));
-                }
-                }
-if (ambulance->hasFinishedPath()) {
-                    if (mission == MissionState::ToIncident) {
-                        // After reaching the incident, go to the hospital
-                        std::vector<Vector3> toHosp = cityMap->findFastestPath(ambulance->getPosition(), hospitalPos, true);
-                        if (!toHosp.empty()) {
-                            ambulance->setPath(toHosp);
-                            mission = MissionState::ToHospital;
-                        } else {
-                            ambulanceMoving = false;
-                            mission = MissionState::Idle;
-                            ambulance->toggleSiren(false);
-                        }
-                    } else if (mission == MissionState::ToHospital) {
-                        ambulanceMoving = false;
-                        mission = MissionState::Idle;
-                        ambulance->toggleSiren(false);
-                    } else {
-                        ambulanceMoving = false;
-                    }
-                    isReturning = false;
-                }
+            if (randomIncidents) {
+                generatedIncidents.clear();
+                incidents.generate(simTime, generatedIncidents);
+                for (const IncidentGenerator::Incident& inc : generatedIncidents)
+                    dispatch.report(inc.kind, inc.tile, inc.priority, inc.time);
             }
+            DispatchUnits();
+            UpdateResponders(dt);
+
+            size_t fleet = normalTraffic.size();
+            idmSpeed.resize(fleet); idmDesired.resize(fleet); idmGap.resize(fleet);
+            idmClosing.resize(fleet); idmAccel.resize(fleet); idmDistance.resize(fleet);
 
             // GENTLE YIELDING LOGIC
-                        for (size_t i = 0; i < normalTraffic.size(); i++) {
+            // Cross traffic holds at a junction a unit is about to enter; cars in its lanes shift
+            // within the lane and stop once on the shoulder
+            for (const YieldCorridor::Notice& n : yieldCorridor.noticed()) {
+                Vehicle* v = normalTraffic[n.vehicle];
+                if (n.crossing) {
+                    v->setSpeedScale(0.0f, 0.1f); // STOP immediately
+                    continue;
+                }
+                EmergencyVehicle* unit = responders[n.unit].vehicle;
+                v->yieldTo(unit->getPosition(), unit->getIntendedDir(), 10.0f, 30.0f);
+                // Safe on the shoulder: stop. Not yet: keep 90% speed so they move sideways faster
+                v->setSpeedScale(fabsf(v->getLaneOffset()) > 1.3f ? 0.0f : 0.9f, 0.1f);
+            }
+
+            for (size_t i = 0; i < normalTraffic.size(); i++) {
                 Vehicle* v = normalTraffic[i];
 
                 // Intended direction (stable even when stopped)
                 Vector3 fwd = v->getIntendedDir();
 
-                // 1) Yield to the ambulance (shift within the lane, no drifting into buildings)
-                // 1) Yield to the ambulance
-       if (ambulanceMoving) {
-        Vector3 ambDir = ambulance->getIntendedDir();
-        Vector3 rel = Vector3Subtract(v->getPosition(), ambulance->getPosition());
-        float dist = Vector3Length(rel);
-        float ahead = Vector3DotProduct(rel, ambDir);
-
-        // A. INTERSECTION SAFETY (Frozen if very close to intersection crash)
-        int ay, ax;
-        cityMap->worldToTile(ambulance->getPosition(), ay, ax);
-        int aTile = cityMap->tileMap[ay][ax];
-        bool ambInIntersection = (aTile == INTERSECTION || aTile == ROUNDABOUT || 
-                                  aTile == TROAD || aTile == TROAD1 || aTile == ROTROAD);
+                // 1) Without a junction slot the entry edge acts as a stopped leader
+                float gap = JunctionGap(i), closing = 0.0f;
+                bool waitingForSlot = gap < IDM_FREE_GAP;
+                if (waitingForSlot) closing = v->getVelocity();
 
-        if (ambInIntersection && dist < 5.0f && ahead > -2.0f) {
-             v->setSpeedScale(0.0f, 0.1f); // STOP immediately
-        }
-        
-
-        else if (dist < 25.0f && ahead > -4.0f && ahead < 20.0f) {
-            
-            
-            v->yieldTo(ambulance->getPosition(), ambDir, 10.0f, 30.0f);
-            
-            // Check if we are safely on the shoulder
-            float myOffset = fabsf(v->getLaneOffset());
-
-            if (myOffset > 1.3f) {
-                // WE ARE SAFE: Stop completely
-                v->setSpeedScale(0.0f, 0.1f); 
-            } else {
-                // NOT SAFE YET: 
-                // CHANGE 3: Don't slow down! Keep speed at 0.9f (90%) 
-                // This allows them to drive *sideways* faster.
-                v->setSpeedScale(0.9f, 0.1f); 
-            }
-        }
-    }
-                   // 2) Stop at red lights
-                   bool stopForRed = false;
-                for (const auto& l : lights) {
-                    if (l.shouldStop(v->getPosition(), fwd)) { stopForRed = true; break; }
-                }
-
-                // 3) Follow the car IN FRONT (same direction + same lane)
-                bool stopForCars = false;
-                const float followDist = 2.6f;
-                const float laneWidth  = 0.65f;
-                for (size_t j = 0; j < normalTraffic.size(); j++) {
-                    if (i == j) continue;
-
-                    Vector3 otherDir = normalTraffic[j]->getIntendedDir();
-                    if (Vector3DotProduct(otherDir, fwd) < 0.65f) continue; // ignore opposite/crossing cars
-
-                    Vector3 rel = Vector3Subtract(normalTraffic[j]->getPosition(), v->getPosition());
-                    float forward = Vector3DotProduct(rel, fwd);
-                    if (forward <= 0.0f || forward > followDist) continue;
-
-                    Vector3 lateralVec = Vector3Subtract(rel, Vector3Scale(fwd, forward));
-                    float lateral = Vector3Length(lateralVec);
-                    if (lateral < laneWidth) { stopForCars = true; break; }
+                // 2) Follow the car ahead in the same lane (or the next lanes on the route)
+                float leaderGap;
+                int leader = FindLeader(i, 10.0f, leaderGap);
+                if (leader >= 0 && leaderGap < gap) {
+                    float align = std::max(0.0f, Vector3DotProduct(normalTraffic[leader]->getIntendedDir(), fwd));
+                    gap = leaderGap;
+                    closing = v->getVelocity() - normalTraffic[leader]->getVelocity() * align;
                 }
 
-                bool allowMove = (!stopForRed && !stopForCars);
-
-                // Mild deadlock recovery (only when NOT waiting at a red light)
+                // Mild deadlock recovery (only when NOT waiting for a junction slot)
                 if (i < stuckTime.size()) {
                     float moved = Vector3Distance(v->getPosition(), lastPos[i]);
                     if (moved < 0.01f) stuckTime[i] += dt; else stuckTime[i] = 0.0f;
                     lastPos[i] = v->getPosition();
 
-                    if (!stopForRed && stuckTime[i] > 2.0f) {
+                    if (!waitingForSlot && stuckTime[i] > 2.0f) {
                         // tiny nudge forward + small lane nudge to break perfect overlaps
-                        allowMove = true;
+                        gap = IDM_FREE_GAP;
+                        closing = 0.0f;
                         v->nudgeLaneOffset((v->getLaneOffset() >= 0.0f) ? 0.70f : -0.70f, 0.35f);
                         stuckTime[i] = 0.0f;
                     }
                 }
 
+                idmSpeed[i] = v->getVelocity();
+                idmDesired[i] = std::max(v->getDesiredSpeed(), 0.05f);
+                idmGap[i] = gap;
+                idmClosing[i] = closing;
+            }
+
+            // IDM over every car in one batch, then move them
+            int count = (int)normalTraffic.size();
+            idmAccelerate(idm, count, idmSpeed.data(), idmDesired.data(), idmGap.data(), idmClosing.data(), idmAccel.data());
+            idmAdvance(count, dt, idmAccel.data(), idmGap.data(), idmSpeed.data(), idmDistance.data());
+            SweepFootprints(count);
+            for (size_t i = 0; i < normalTraffic.size(); i++) {
+                Vehicle* v = normalTraffic[i];
                 // Always step so lane/yield smoothing continues even when stopped
-                v->step(dt, allowMove);
+                if (moveShare[i] < 1.0f) v->advance(dt, idmDistance[i] * moveShare[i], idmDistance[i] * moveShare[i] / dt);
+                else v->advance(dt, idmDistance[i], idmSpeed[i]);
 
                 // Hard safety: keep vehicles on driveable tiles
                 if (!cityMap->isDriveableWorld(v->getPosition())) {
                     v->setPosition(cityMap->clampToDriveable(v->getPosition()));
                 }
+
+                if (tripGoal[i] >= 0 && v->hasFinishedPath()) NewCommuterTrip(i);
+            }
+
+            simTime += dt;
+            TrackTileTransitions();
+            RerouteCommuters();
+            if (telemetry.isOpen()) StreamTelemetry();
+        }
+    }
+
+    // Swept footprint test on this tick's moves: a car about to run into another one (or into an
+    // emergency unit, which has already moved and never gives way) only drives up to the point of
+    // contact. Units parked at their station are off the road.
+    void SweepFootprints(int count) {
+        bodies.resize(count);
+        for (int i = 0; i < count; i++) {
+            Vehicle* v = normalTraffic[i];
+            Vector3 p = v->getPosition(), dir = v->getIntendedDir(), next;
+            float turnAt = v->distanceToTurn(idmDistance[i], next);
+            bodies[i] = { p.x, p.z, dir.x, dir.z, idmDistance[i], turnAt, next.x, next.z, false };
+        }
+        for (const Responder& r : responders) {
+            if (r.mission == MissionState::Idle) continue;
+            Vector3 a = r.vehicle->getPosition(), aFwd = r.vehicle->getForwardDir();
+            bodies.push_back({ a.x, a.z, aFwd.x, aFwd.z, 0.0f, 0.0f, aFwd.x, aFwd.z, true });
+        }
+        collisions.resolve(bodies, moveShare);
+    }
+
+    // Car moves cut short by the footprint sweep so far
+    uint64_t CollisionCount() const { return collisions.contacts(); }
+    bool RandomIncidents() const { return randomIncidents; }
+    const Dispatch::Stats& ResponseStats(int kind) const { return dispatch.stats(kind); }
+    void ExportResponseTimes() const {
+        dispatch.exportCSV(INCIDENT_FILE);
+        dispatch.exportHistograms(RESPONSE_HISTOGRAM_FILE);
+    }
+
+    // `--check`: runs the city at 60 Hz with nothing drawn and random incidents on, then prints how
+    // far unit arrivals fell from PredictTravel, the missions completed, and the ticks in which two
+    // cars from crossing directions came closer than CHECK_NEAR_MISS. The seed picks the incidents
+    // as well as the traffic. False if no unit arrived or the mean prediction error is over
+    // CHECK_ETA_ERROR.
+    bool RunCheck(float seconds, unsigned int seed) {
+        const float dt = 1.0f / 60.0f;
+        incidents.setRate(CHECK_INCIDENT_RATE);
+        incidents.setSeed(seed);
+        isMoving = true;
+        randomIncidents = true;
+        long long ticks = 0, nearMisses = 0;
+        while (simTime < seconds) {
+            Tick(dt, nullptr, nullptr);
+            ticks++;
+            bool near = false;
+            for (size_t i = 0; i < normalTraffic.size() && !near; i++) {
+                Vector3 p = normalTraffic[i]->getPosition(), d = normalTraffic[i]->getIntendedDir();
+                for (size_t j = i + 1; j < normalTraffic.size() && !near; j++) {
+                    Vector3 q = normalTraffic[j]->getPosition();
+                    near = fabsf(Vector3DotProduct(d, normalTraffic[j]->getIntendedDir())) < 0.5f &&
+                           Vector3Distance(p, q) < CHECK_NEAR_MISS;
+                }
             }
+            if (near) nearMisses++;
+        }
+
+        int sent = 0, arrived = 0, completed = 0;
+        double absError = 0.0, error = 0.0;
+        for (const Dispatch::Incident& inc : dispatch.incidents()) {
+            if (inc.assigned >= 0.0f) sent++;
+            if (inc.cleared >= 0.0f) completed++;
+            if (inc.arrived < 0.0f || inc.assigned < 0.0f) continue;
+            float late = (inc.arrived - inc.assigned) - inc.predicted;
+            absError += fabsf(late);
+            error += late;
+            arrived++;
+        }
+        printf("%.0f s, %lld ticks: %d incidents, %d units sent, %d arrived, %d missions completed\n",
+               simTime, ticks, (int)dispatch.incidents().size(), sent, arrived, completed);
+        if (arrived) printf("arrival vs prediction: mean |error| %.2f s, mean error %+.2f s (late is positive)\n",
+                            absError / arrived, error / arrived);
+        printf("ticks with crossing cars closer than %.1f: %lld\n", CHECK_NEAR_MISS, nearMisses);
+        printf("car moves cut short by the footprint sweep: %llu\n", (unsigned long long)CollisionCount());
+        return arrived > 0 && absError / arrived <= CHECK_ETA_ERROR;
+    }
+    // Everything that moves the simulation on, in sections of plain arrays: the cars and units as
+    // Vehicle::State plus the per-car arrays beside normalTraffic, the lights as their controllers,
+    // the lane lists, junction reservations, preemption and corridors as the modules hold them, the
+    // incident queues and the random streams. A restored run goes on as the saved one would have.
+    bool SaveSnapshot(const char* path) const {
+        SnapshotWriter w;
+        if (!w.open(path)) return false;
+        SaveSnapshot(w);
+        return w.close();
+    }
+
+    void SaveSnapshot(SnapshotWriter& w) const {
+        const RoadGraph& roads = cityMap->roadGraph();
+        std::vector<int> closed;
+        for (int t = 0; t < roads.size(); t++) if (roads.isClosed(t)) closed.push_back(t);
+        std::vector<Vehicle::State> cars;
+        cars.reserve(normalTraffic.size());
+        for (const Vehicle* v : normalTraffic) cars.push_back(v->saveState());
+        std::ostringstream state;
+        state << rng;
+
+        w.value("sim.time", simTime);
+        w.value("sim.rerouteCursor", (uint64_t)rerouteCursor);
+        w.value("sim.randomIncidents", (uint8_t)randomIncidents);
+        w.value("sim.moving", (uint8_t)isMoving);
+        w.value("sim.previewTile", previewTile);
+        w.text("sim.rng", state.str());
+        w.array("sim.closed", closed);
+        w.array("sim.commuterTiles", commuterTiles);
+        routes.save(w);
+        w.array("cars.state", cars);
+        w.array("cars.tripGoal", tripGoal);
+        w.array("cars.currentTile", currentTile);
+        w.array("cars.tileEnterTime", tileEnterTime);
+        w.array("cars.laneArcBase", laneArcBase);
+        w.array("cars.laneRouteId", laneRouteId);
+        w.array("cars.slotTile", slotTile);
+        w.array("cars.slotMovement", slotMovement);
+        w.array("cars.nextReroute", nextRerouteTime);
+        w.array("cars.stuckTime", stuckTime);
+        w.array("cars.lastPos", lastPos);
+        laneIndex->save(w);
+        junctions->save(w);
+        signals.save(w);
+        arbiter.save(w);
+
+        std::vector<SavedUnit> units(responders.size());
+        for (size_t u = 0; u < responders.size(); u++) {
+            const Responder& r = responders[u];
+            SavedUnit& su = units[u];
+            su.vehicle = r.vehicle->saveState();
+            su.mission = (int)r.mission;
+            su.sceneUntil = r.sceneUntil;
+            su.blockedTime = r.blockedTime;
+            su.cursor = r.cursor;
+            su.start = r.route.start;
+            su.goal = r.route.goal;
+            su.startHeading = r.route.startHeading;
+            su.nextLeg = r.route.nextLeg;
+            su.revision = r.route.revision;
+            su.siren = r.vehicle->getSirenActive() ? 1 : 0;
+            std::string name = "units." + std::to_string(u);
+            w.array((name + ".points").c_str(), r.points);
+            w.array((name + ".tiles").c_str(), r.tiles);
+            w.array((name + ".heading").c_str(), r.heading);
+            w.array((name + ".arc").c_str(), r.arc);
+            w.array((name + ".entries").c_str(), r.route.entries);
+            r.preemption.save(w, name + ".preemption");
+        }
+        w.array("units.state", units);
+        yieldCorridor.save(w);
+        dispatch.save(w);
+        incidents.save(w);
+        edgeTimes->save(w);
+    }
+
+    // Restores a file from SaveSnapshot taken on the same city. Every section is read and checked
+    // into scratch copies first, and only swapped in once all of them have loaded, so a file that
+    // isn't a whole snapshot of this version leaves the run as it was.
+    bool LoadSnapshot(const char* path) {
+        SnapshotReader r;
+        return r.open(path) && LoadSnapshot(r);
+    }
+
+    bool LoadSnapshot(const SnapshotReader& r) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        std::vector<int> closed, tiles;
+        std::vector<Vehicle::State> cars;
+        std::vector<SavedUnit> units;
+        std::string state;
+        float time;
+        uint64_t cursor;
+        uint8_t random, moving;
+        int preview;
+        if (!r.value("sim.time", time) || !r.value("sim.rerouteCursor", cursor) ||
+            !r.value("sim.randomIncidents", random) || !r.value("sim.moving", moving) || !r.value("sim.previewTile", preview) || !r.text("sim.rng", state) || !r.array("sim.closed", closed) ||
+            !r.array("sim.commuterTiles", tiles) || !r.array("cars.state", cars) || !r.array("units.state", units)) return false;
+        if (units.size() != responders.size()) return false;
+        for (int t : closed) if (t < 0 || t >= roads.size()) return false;
+        std::mt19937 savedRng;
+        std::istringstream in(state);
+        in >> savedRng;
+        if (in.fail()) return false;
+
+        // The roads as saved: the dispatch fields were solved over them
+        std::vector<uint8_t> isClosed(roads.size(), 0);
+        for (int t : closed) isClosed[t] = 1;
+        RoadGraph savedRoads = roads;
+        for (int t = 0; t < roads.size(); t++) {
+            if (roads.isClosed(t) != (isClosed[t] != 0)) savedRoads.setClosed(t / roads.width(), t % roads.width(), isClosed[t] != 0);
+        }
+
+        // Vehicles hold route ids into the table as saved, with its reference counts
+        RouteTable savedRoutes;
+        if (!savedRoutes.load(r)) return false;
+        size_t n = cars.size();
+        std::vector<int> goal, tile, routeId, holdTile, holdMovement;
+        std::vector<float> enterTime, arcBase, reroute, stuck;
+        std::vector<Vector3> last;
+        if (!r.array("cars.tripGoal", goal) || !r.array("cars.currentTile", tile) ||
+            !r.array("cars.tileEnterTime", enterTime) || !r.array("cars.laneArcBase", arcBase) ||
+            !r.array("cars.laneRouteId", routeId) || !r.array("cars.slotTile", holdTile) ||
+            !r.array("cars.slotMovement", holdMovement) || !r.array("cars.nextReroute", reroute) ||
+            !r.array("cars.stuckTime", stuck) || !r.array("cars.lastPos", last)) return false;
+        if (goal.size() != n || tile.size() != n || enterTime.size() != n || arcBase.size() != n ||
+            routeId.size() != n || holdTile.size() != n || holdMovement.size() != n || reroute.size() != n ||
+            stuck.size() != n || last.size() != n) return false;
+        LaneOccupancy savedLanes(roads.stateCount(), (int)n);
+        if (!savedLanes.load(r)) return false;
+
+        struct SavedLeg { // a responder's waypoints and preemption as read
+            std::vector<Vector3> points;
+            std::vector<int> tiles, heading, entries;
+            std::vector<float> arc;
+            RoutePreemption preemption;
+        };
+        std::vector<SavedLeg> legs(responders.size());
+        for (size_t u = 0; u < responders.size(); u++) {
+            SavedLeg& leg = legs[u];
+            std::string name = "units." + std::to_string(u);
+            leg.preemption = responders[u].preemption;
+            if (!r.array((name + ".points").c_str(), leg.points) || !r.array((name + ".tiles").c_str(), leg.tiles) ||
+                !r.array((name + ".heading").c_str(), leg.heading) || !r.array((name + ".arc").c_str(), leg.arc) ||
+                !r.array((name + ".entries").c_str(), leg.entries) ||
+                !leg.preemption.load(r, name + ".preemption")) return false;
+        }
+
+        Dispatch savedDispatch = dispatch;
+        savedDispatch.setGraph(DispatchGraph(savedRoads));
+        IntersectionManager savedJunctions(roads.size());
+        AddJunctions(savedJunctions);
+        SignalScheduler savedSignals;
+        PreemptionArbiter savedArbiter(savedSignals);
+        YieldCorridor savedCorridor = yieldCorridor;
+        IncidentGenerator savedIncidents = incidents;
+        EdgeTravelTimes savedEdges = *edgeTimes;
+        if (!savedJunctions.load(r) || !savedSignals.load(r) || savedSignals.count() != signals.count() ||
+            !savedArbiter.load(r) || !savedCorridor.load(r, savedLanes) || !savedDispatch.load(r) ||
+            !savedIncidents.load(r) || !savedEdges.load(r)) return false;
+
+        // All read: swap it in
+        for (int t = 0; t < roads.size(); t++) {
+            if (roads.isClosed(t) != (isClosed[t] != 0)) cityMap->setRoadClosed(t / roads.width(), t % roads.width(), isClosed[t] != 0);
         }
+        coverage->sync();
+
+        for (Vehicle* v : normalTraffic) delete v;
+        normalTraffic.clear();
+        routes = std::move(savedRoutes);
+        for (const Vehicle::State& st : cars) {
+            Vehicle* v = new Vehicle(routes, st.position, st.destination, st.baseSpeed, st.color);
+            v->restoreState(st);
+            normalTraffic.push_back(v);
+        }
+        tripGoal.swap(goal);
+        currentTile.swap(tile);
+        tileEnterTime.swap(enterTime);
+        laneArcBase.swap(arcBase);
+        laneRouteId.swap(routeId);
+        slotTile.swap(holdTile);
+        slotMovement.swap(holdMovement);
+        nextRerouteTime.swap(reroute);
+        stuckTime.swap(stuck);
+        lastPos.swap(last);
+        delete laneIndex;
+        laneIndex = new LaneOccupancy(std::move(savedLanes));
+
+        for (size_t u = 0; u < responders.size(); u++) {
+            Responder& resp = responders[u];
+            const SavedUnit& su = units[u];
+            SavedLeg& leg = legs[u];
+            resp.vehicle->toggleSiren(su.siren != 0);
+            resp.vehicle->restoreState(su.vehicle);
+            resp.mission = (MissionState)su.mission;
+            resp.sceneUntil = su.sceneUntil;
+            resp.blockedTime = su.blockedTime;
+            resp.cursor = (size_t)su.cursor;
+            resp.route.start = su.start;
+            resp.route.goal = su.goal;
+            resp.route.startHeading = su.startHeading;
+            resp.route.nextLeg = (size_t)su.nextLeg;
+            resp.route.revision = su.revision;
+            resp.route.entries.swap(leg.entries);
+            resp.points.swap(leg.points);
+            resp.tiles.swap(leg.tiles);
+            resp.heading.swap(leg.heading);
+            resp.arc.swap(leg.arc);
+            resp.preemption = std::move(leg.preemption);
+        }
+
+        dispatch = std::move(savedDispatch);
+        dispatchRevision = roads.revision();
+        delete junctions;
+        junctions = new IntersectionManager(std::move(savedJunctions));
+        signals = std::move(savedSignals);
+        arbiter.swap(savedArbiter);
+        yieldCorridor = std::move(savedCorridor);
+        incidents = std::move(savedIncidents);
+        *edgeTimes = std::move(savedEdges);
+        for (size_t id = 0; id < lights.size(); id++) ApplySignal((int)id);
+
+        rng = savedRng;
+        simTime = time;
+        rerouteCursor = (size_t)cursor;
+        randomIncidents = random != 0;
+        isMoving = moving != 0;
+        commuterTiles.swap(tiles);
+        generatedIncidents.clear();
+        previewTile = preview;
+        previewPath.clear();
+        return true;
+    }
+
+    // Recording starts with a keyframe of the run as it is; stopping writes REPLAY_FILE
+    void StartRecording() {
+        replay.clear();
+        recording = true;
+        nextKeyframe = 0;
+    }
+
+    void StopRecording() {
+        if (!recording) return;
+        recording = false;
+        bool ok = replay.save(REPLAY_FILE);
+        TraceLog(ok ? LOG_INFO : LOG_WARNING, "Recording of %llu frames %s %s", (unsigned long long)replay.ticks(),
+                 ok ? "saved to" : "could not be saved to", REPLAY_FILE);
+    }
+
+    void StartPlayback(const char* path) {
+        StopRecording();
+        playing = replay.load(path) && replay.keyframeCount() > 0 && SeekReplay(replay.keyframeTick(0));
+        playSpeed = 1;
+        if (!playing) TraceLog(LOG_WARNING, "No recording to play in %s", path);
+    }
+
+    void PlayTick(uint64_t t) {
+        const ReplayLog::Command *first, *last;
+        replay.commandsAt(t, first, last);
+        Tick(replay.stepAt(t), first, last);
+    }
+
+    // The last keyframe at or before tick t, played on to t
+    bool SeekReplay(uint64_t t) {
+        t = std::min(t, replay.ticks());
+        int k = replay.keyframeBefore(t);
+        SnapshotReader r;
+        if (!replay.openKeyframe(k, r) || !LoadSnapshot(r)) return false;
+        for (uint64_t tick = replay.keyframeTick(k); tick < t; tick++) PlayTick(tick);
+        playTick = t;
+        return true;
+    }
+
+    // Telemetry is a view of the run, so it streams live runs and replays alike
+    void StartTelemetry() {
+        bool ok = telemetry.open(TELEMETRY_FILE);
+        telemetryTime = nextTelemetry = simTime;
+        if (!ok) TraceLog(LOG_WARNING, "Trajectories could not be written to %s", TELEMETRY_FILE);
+    }
+
+    void StopTelemetry() {
+        if (!telemetry.isOpen()) return;
+        uint64_t frames = telemetry.framesWritten(), dropped = telemetry.framesDropped();
+        bool ok = telemetry.close();
+        TraceLog(ok ? LOG_INFO : LOG_WARNING, "Trajectories: %llu frames (%llu dropped) %s %s", (unsigned long long)frames,
+                 (unsigned long long)dropped, ok ? "written to" : "could not be written to", TELEMETRY_FILE);
+    }
+
+    // Every TELEMETRY_INTERVAL, a frame of trajectories, cars by index and then the units, handed to
+    // the writer thread. A file holds one stretch of time: a jump back (a snapshot restored, a seek)
+    // closes it.
+    void StreamTelemetry() {
+        if (simTime < telemetryTime) {
+            StopTelemetry();
+            return;
+        }
+        if (simTime < nextTelemetry) return;
+        telemetryTime = simTime;
+        nextTelemetry = std::max(nextTelemetry + TELEMETRY_INTERVAL, simTime);
+        size_t fleet = normalTraffic.size();
+        Telemetry::Row* rows = telemetry.frame(simTime, (uint32_t)(fleet + responders.size()));
+        if (!rows) return; // the writer is behind; this frame is dropped and counted
+        const RoadGraph& roads = cityMap->roadGraph();
+        for (size_t i = 0; i < fleet + responders.size(); i++) {
+            const Vehicle* v = i < fleet ? normalTraffic[i] : responders[i - fleet].vehicle;
+            Vector3 p = v->getPosition();
+            int y, x;
+            rows[i] = { (uint32_t)i, p.x, p.z, v->getVelocity(), v->getLaneOffset(),
+                        cityMap->worldToTile(p, y, x) ? roads.id(y, x) : -1 };
+        }
+        telemetry.commit();
+    }
+
+    bool Recording() const { return recording; }
+    bool Playing() const { return playing; }
+    uint64_t PlayTickNow() const { return playTick; }
+    uint64_t ReplayTicks() const { return replay.ticks(); }
+    bool StreamingTelemetry() const { return telemetry.isOpen(); }
+    uint64_t TelemetryFrames() const { return telemetry.framesWritten(); }
+    int PlaySpeed() const { return playSpeed; }
+
+    int QueuedIncidents() const {
+        return dispatch.queued(Dispatch::AMBULANCE) + dispatch.queued(Dispatch::FIRE) + dispatch.queued(Dispatch::POLICE);
     }
 
     void Draw() {
-        if (ambulance) ambulance->draw();
+        for (const Responder& r : responders) r.vehicle->draw();
         for (auto v : normalTraffic) v->draw();
         for (const auto& l : lights) l.draw();
 
-        if (!previewPath.empty() && !ambulanceMoving) {
+        const RoadGraph& roads = cityMap->roadGraph();
+        for (int t = 0; t < roads.size(); t++) {
+            if (!roads.isClosed(t)) continue;
+            Vector3 p = cityMap->tileCenter(t / roads.width(), t % roads.width());
+            DrawCube({p.x, 0.5f, p.z}, TILE_SIZE * 0.8f, 0.3f, 0.3f, RED);
+            DrawCubeWires({p.x, 0.5f, p.z}, TILE_SIZE * 0.8f, 0.3f, 0.3f, WHITE);
+        }
+        if (coverageView >= 0) coverage->draw((FacilityGroup)coverageView, 30.0f);
+
+        if (!previewPath.empty()) {
             Color flashColor = ((int)(GetTime() * 5) % 2 == 0) ? RED : BLUE;
             for (size_t i = 0; i < previewPath.size() - 1; i++) {
                 DrawLine3D(Vector3Add(previewPath[i], {0, 0.5f, 0}), Vector3Add(previewPath[i+1], {0, 0.5f, 0}), flashColor);
@@ -428,7 +1752,16 @@ if (ambulance->hasFinishedPath()) {
 // =====================================================
 // MAIN FUNCTION
 // =====================================================
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+        float seconds = argc > 2 ? (float)atof(argv[2]) : CHECK_SECONDS;
+        unsigned int seed = argc > 3 ? (unsigned int)atoi(argv[3]) : 1;
+        SetTraceLogLevel(LOG_WARNING);
+        CityMap city(false); // no window: nothing is drawn, so no textures or models
+        Simulation sim(&city, seed);
+        return sim.RunCheck(seconds, seed) ? 0 : 1;
+    }
+
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     int w = (int)(GetMonitorWidth(0) * 0.85f);
     int h = (int)(GetMonitorHeight(0) * 0.85f);
@@ -439,7 +1772,7 @@ int main() {
     SetTargetFPS(60);
     
     CityMap city; 
-    Simulation sim(&city);
+    Simulation sim(&city, (unsigned int)time(NULL));
 
     Camera3D cam = {0};
     cam.target = {20, 0, 20}; 
@@ -474,9 +1807,28 @@ int main() {
                 city.draw(); 
                 sim.Draw();
             EndMode3D();
-            DrawText("A/D: Rotate | W/S: Zoom | L-Click: Set Path | G: Go", 10, 10, 20, DARKGREEN);
+            DrawText("A/D: Rotate | W/S: Zoom | L-Click: Pick Incident | G/F/P: Call Ambulance/Fire/Police | R-Click: Close Road | I: Random Incidents | H: Coverage | E: Export | F5/F9: Save/Load | R: Record | V: Replay | T: Trajectories", 10, 10, 20, DARKGREEN);
+            DrawText(TextFormat("Collisions prevented: %llu", (unsigned long long)sim.CollisionCount()), 10, 35, 20, DARKGREEN);
+            DrawText(TextFormat("Incidents waiting: %d%s", sim.QueuedIncidents(), sim.RandomIncidents() ? " (random incidents on)" : ""),
+                     10, 60, 20, DARKGREEN);
+            if (sim.Recording()) DrawText(TextFormat("REC %llu frames", (unsigned long long)sim.ReplayTicks()), 10, 110, 20, RED);
+            if (sim.StreamingTelemetry()) {
+                DrawText(TextFormat("TRAJECTORIES %llu frames", (unsigned long long)sim.TelemetryFrames()), 10, 135, 20, DARKBLUE);
+            }
+            if (sim.Playing()) {
+                DrawText(TextFormat("REPLAY %llu / %llu x%d | Left/Right: Seek | Up/Down: Speed", (unsigned long long)sim.PlayTickNow(),
+                                    (unsigned long long)sim.ReplayTicks(), sim.PlaySpeed()), 10, 110, 20, MAROON);
+            }
+            const LatencyHistogram& response = sim.ResponseStats(Dispatch::AMBULANCE).response;
+            if (response.count() > 0) {
+                DrawText(TextFormat("Ambulance response p50 %.1f s | p90 %.1f s | p99 %.1f s", response.percentile(50.0f),
+                                    response.percentile(90.0f), response.percentile(99.0f)), 10, 85, 20, DARKGREEN);
+            }
         EndDrawing();
     } 
+    sim.StopRecording();
+    sim.StopTelemetry();
+    sim.ExportResponseTimes();
     CloseWindow();
     return 0;
 }
\ No newline at end of file
@@ -1,10 +1,11 @@
 #include "Vehicle.h"
 #include "rlgl.h" 
 #include <algorithm>
+#include <cstring>
 
-Vehicle::Vehicle(Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor)
+Vehicle::Vehicle(RouteTable& routeTable, Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor)
     : position(startPos), destination(endPos), speed(vSpeed), baseSpeed(vSpeed), 
-      color(vColor), currentWp(0), rotation(0.0f), looping(false) {
+      color(vColor), routes(routeTable), rotation(0.0f), looping(false) {
         laneOffsetDefault = 0.55f;
         laneOffsetTarget  = 0.55f;
         laneOffsetMax     = 1.5f;
@@ -14,6 +15,62 @@ Vehicle::Vehicle(Vector3 startPos, Vector3 endPos, float vSpeed, Color vColor)
         yieldHold         = 0.0f;
 }
 
+Vehicle::~Vehicle() {
+    routes.release(routeId);
+}
+
+Vehicle::State Vehicle::saveState() const {
+    State st;
+    memset(&st, 0, sizeof(st)); // padding too, so equal states save to equal bytes
+    st.position = position;
+    st.destination = destination;
+    st.speed = speed;
+    st.baseSpeed = baseSpeed;
+    st.velocity = velocity;
+    st.color = color;
+    st.routeId = routeId;
+    st.segment = segment;
+    st.phase = phase;
+    st.s = s;
+    st.rotation = rotation;
+    st.laneOffset = laneOffset;
+    st.laneOffsetDefault = laneOffsetDefault;
+    st.laneOffsetTarget = laneOffsetTarget;
+    st.laneOffsetMax = laneOffsetMax;
+    st.yieldHold = yieldHold;
+    st.speedScale = speedScale;
+    st.speedScaleHold = speedScaleHold;
+    st.looping = looping ? 1 : 0;
+    return st;
+}
+
+void Vehicle::restoreState(const State& st) {
+    position = st.position;
+    destination = st.destination;
+    speed = st.speed;
+    baseSpeed = st.baseSpeed;
+    velocity = st.velocity;
+    color = st.color;
+    routeId = st.routeId;
+    segment = st.segment;
+    phase = st.phase;
+    s = st.s;
+    rotation = st.rotation;
+    laneOffset = st.laneOffset;
+    laneOffsetDefault = st.laneOffsetDefault;
+    laneOffsetTarget = st.laneOffsetTarget;
+    laneOffsetMax = st.laneOffsetMax;
+    yieldHold = st.yieldHold;
+    speedScale = st.speedScale;
+    speedScaleHold = st.speedScaleHold;
+    looping = st.looping != 0;
+}
+
+const std::vector<Vector3>& Vehicle::getPath() const {
+    static const std::vector<Vector3> none;
+    return routeId >= 0 ? routes.points(routeId) : none;
+}
+
 
 void Vehicle::setSpeedScale(float scale, float holdSeconds) {
     // Clamp and hold the scale so we can slow/stop temporarily (e.g., red light, ambulance ahead).
@@ -23,15 +80,19 @@ void Vehicle::setSpeedScale(float scale, float holdSeconds) {
 
 Vector3 Vehicle::getIntendedDir() const {
     // Prefer path direction when available; fallback to current forward.
-    if (!path.empty() && currentWp < (int)path.size()) {
-        Vector3 d = Vector3Subtract(path[currentWp], position);
-        d.y = 0.0f;
-        if (Vector3Length(d) > 0.05f) return Vector3Normalize(d);
+    if (!hasFinishedPath()) {
+        const RouteTable::Polyline& line = routes.polyline(routeId);
+        if (line.segments() > 0) return { line.dirX[segment], 0.0f, line.dirZ[segment] };
     }
     return getForwardDir();
 }
 
 void Vehicle::step(float dt, bool allowForward) {
+    float v = allowForward ? speed * speedScale : 0.0f;
+    advance(dt, v * dt, v);
+}
+
+void Vehicle::advance(float dt, float distance, float newVelocity) {
     // --- Yield / lane offset smoothing always runs ---
     if (yieldHold > 0.0f) {
         yieldHold -= dt;
@@ -53,65 +114,74 @@ void Vehicle::step(float dt, bool allowForward) {
         speedScale = speedScale + (1.0f - speedScale) * Clamp(dt * 6.0f, 0.0f, 1.0f);
     }
 
-    if (path.empty() || currentWp >= (int)path.size()) return;
-
-    Vector3 logicTarget = path[currentWp];
-    logicTarget.y = position.y;
-
-    // --- 1. Direction calculation (stable even when stopped) ---
-    Vector3 roadDir = {0,0,1};
-    if (currentWp == 0) {
-        float distToStart = Vector3Distance(path[0], position);
-        if (distToStart < 1.0f && path.size() > 1) roadDir = Vector3Subtract(path[1], path[0]);
-        else { roadDir = Vector3Subtract(path[0], position); roadDir.y = 0; }
-    } else {
-        roadDir = Vector3Subtract(path[currentWp], path[currentWp - 1]);
-    }
-
-    if (Vector3Length(roadDir) > 0.001f) roadDir = Vector3Normalize(roadDir);
-    else roadDir = getForwardDir();
-
-    // --- 2. Lane offset target (right-hand driving) ---
-    Vector3 rightDir = { -roadDir.z, 0.0f, roadDir.x };
-    Vector3 driveTarget = Vector3Add(logicTarget, Vector3Scale(rightDir, laneOffset));
-
-    float dist = Vector3Distance(position, driveTarget);
+    velocity = newVelocity;
+    if (hasFinishedPath()) { velocity = 0.0f; return; }
 
-    // --- 3. Waypoint advancement (independent of allowForward) ---
-    if (dist < 0.5f) {
-        currentWp++;
-        if (currentWp >= (int)path.size()) {
-            if (looping) currentWp = 0;
-            else currentWp = (int)path.size() - 1;
+    // --- Follow the baked lane polyline ---
+    const RouteTable::Polyline& line = routes.polyline(routeId);
+    s += distance;
+    if (line.loops) {
+        if (s >= line.length) {
+            s = fmodf(s, line.length);
+            segment = 0;
         }
-        if (!path.empty()) destination = path[currentWp];
-        return; // next frame will steer towards new target
+    } else if (s > line.length) {
+        s = line.length;
     }
+    placeOnRoute();
+    if (!hasFinishedPath()) destination = routes.points(routeId)[waypointIndex()];
+}
 
-    // --- 4. Movement (optional) ---
-    Vector3 dir = Vector3Subtract(driveTarget, position);
-    dir.y = 0.0f;
-    float distToTarget = Vector3Length(dir);
-    if (distToTarget < 0.001f) return;
-
-    Vector3 moveDir = Vector3Normalize(dir);
-    rotation = atan2(moveDir.x, moveDir.z) * RAD2DEG;
-
-    if (!allowForward) return;
-
-    float moveAmount = speed * speedScale * dt;
-    if (moveAmount > distToTarget) moveAmount = distToTarget;
-
-    Vector3 stepv = Vector3Scale(moveDir, moveAmount);
-    position = Vector3Add(position, stepv);
+float Vehicle::distanceToTurn(float distance, Vector3& nextDir) const {
+    nextDir = getIntendedDir();
+    if (hasFinishedPath()) return distance;
+    const RouteTable::Polyline& line = routes.polyline(routeId);
+    int last = line.segments() - 1;
+    if (last < 0) return distance;
+
+    int next = segment + 1;
+    float corner = segment < last ? line.arc[next] : line.length;
+    if (segment == last) {
+        if (!line.loops) return distance;
+        next = 0;
+    }
+    if (corner - s >= distance) return distance;
+    nextDir = { line.dirX[next], 0.0f, line.dirZ[next] };
+    return std::max(0.0f, corner - s);
 }
 
+void Vehicle::placeOnRoute() {
+    const RouteTable::Polyline& line = routes.polyline(routeId);
+    if (line.vertex.empty()) return;
+    int last = line.segments() - 1;
+    if (last < 0) {
+        position.x = line.vertex[0].x;
+        position.z = line.vertex[0].z;
+        return;
+    }
+    while (segment < last && line.arc[segment + 1] <= s) segment++;
+    while (segment > 0 && line.arc[segment] > s) segment--;
+
+    // Yielding and nudges move the car sideways from the lane the route was baked for
+    float t = s - line.arc[segment];
+    float lateral = laneOffset - routes.laneOffset(routeId);
+    float dx = line.dirX[segment], dz = line.dirZ[segment];
+    position.x = line.vertex[segment].x + dx * t - dz * lateral;
+    position.z = line.vertex[segment].z + dz * t + dx * lateral;
+    rotation = line.yaw[segment];
+}
 
 void Vehicle::setLaneOffset(float offset) {
     laneOffsetDefault = offset;
     laneOffsetTarget  = offset;
     laneOffset        = offset;
     yieldHold         = 0.0f;
+    rebind();
+}
+
+void Vehicle::setLooping(bool loop) {
+    looping = loop;
+    rebind();
 }
 
 void Vehicle::nudgeLaneOffset(float targetOffset, float holdSeconds) {
@@ -120,10 +190,89 @@ void Vehicle::nudgeLaneOffset(float targetOffset, float holdSeconds) {
 }
 
 void Vehicle::setPath(const std::vector<Vector3>& newPath) {
-    path = newPath;
-    currentWp = 0;
-    if (!path.empty()) destination = path[0];
-    
+    int id = routes.intern(newPath, laneOffsetDefault, looping);
+    routes.release(routeId);
+    routeId = id;
+    phase = 0;
+    s = 0.0f;
+    segment = 0;
+    placeOnRoute();
+    if (!newPath.empty()) destination = newPath[0];
+}
+
+void Vehicle::setRoute(int id, int startWp) {
+    int own = routes.variant(id, laneOffsetDefault, looping);
+    routes.release(routeId);
+    routeId = own;
+    phase = startWp;
+    s = routes.polyline(own).wpArc.empty() ? 0.0f : routes.polyline(own).wpArc[startWp];
+    segment = 0;
+    placeOnRoute();
+    if (!hasFinishedPath()) destination = routes.points(routeId)[waypointIndex()];
+}
+
+void Vehicle::switchRoute(int newId, int newWp) {
+    routes.release(routeId);
+    routeId = newId;
+
+    // Carry on from the point of the new polyline nearest to the car, looking only around the
+    // joining waypoint so a route passing close to itself can't capture it
+    const RouteTable::Polyline& line = routes.polyline(newId);
+    int last = line.segments() - 1;
+    s = 0.0f;
+    segment = 0;
+    if (last >= 0) {
+        float base = (newWp < (int)line.wpArc.size()) ? line.wpArc[newWp] : 0.0f;
+        int k0 = 0;
+        while (k0 < last && line.arc[k0 + 1] <= base) k0++;
+        float bestDist = -1.0f;
+        for (int k = std::max(0, k0 - 1); k <= std::min(last, k0 + 2); k++) {
+            float segLen = line.arc[k + 1] - line.arc[k];
+            float t = (position.x - line.vertex[k].x) * line.dirX[k] + (position.z - line.vertex[k].z) * line.dirZ[k];
+            t = Clamp(t, 0.0f, segLen);
+            float px = line.vertex[k].x + line.dirX[k] * t - position.x;
+            float pz = line.vertex[k].z + line.dirZ[k] * t - position.z;
+            float d = px * px + pz * pz;
+            if (bestDist < 0.0f || d < bestDist) { bestDist = d; s = line.arc[k] + t; segment = k; }
+        }
+    }
+    placeOnRoute();
+    if (!hasFinishedPath()) destination = routes.points(routeId)[waypointIndex()];
+}
+
+void Vehicle::rebind() {
+    if (routeId < 0) return;
+    int id = routes.variant(routeId, laneOffsetDefault, looping);
+    if (id == routeId) { routes.release(id); return; }
+    switchRoute(id, std::max(0, std::min(waypointIndex() - 1, routes.length(routeId) - 1)));
+}
+
+void Vehicle::rebaseRoute(int from, const std::vector<Vector3>& more, bool keepTail) {
+    int wp = waypointIndex();
+    std::vector<Vector3> merged;
+    if (routeId >= 0) {
+        const std::vector<Vector3>& path = routes.points(routeId);
+        int end = keepTail ? (int)path.size() : std::min(wp, (int)path.size());
+        merged.assign(path.begin() + from, path.begin() + end);
+    }
+    merged.insert(merged.end(), more.begin(), more.end());
+
+    phase = 0;
+    switchRoute(routes.intern(merged, laneOffsetDefault, looping), 0);
+}
+
+void Vehicle::appendPath(const std::vector<Vector3>& more) {
+    // Keep the previous waypoint so the car's current segment survives the rebase
+    // (for a finished route that is the last segment, not the end point)
+    int len = routeId >= 0 ? routes.length(routeId) : 0;
+    int wp = std::min(waypointIndex(), len - 1);
+    rebaseRoute(std::max(0, std::min(wp - 1, len - 1)), more, true);
+}
+
+void Vehicle::replaceRemainingPath(const std::vector<Vector3>& tail) {
+    int len = routeId >= 0 ? routes.length(routeId) : 0;
+    int wp = std::min(waypointIndex(), len - 1);
+    rebaseRoute(std::max(0, std::min(wp - 1, len)), tail, false);
 }
 
 void Vehicle::update() {